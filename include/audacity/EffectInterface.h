@@ -155,6 +155,11 @@ public:
    virtual unsigned GetAudioInCount() = 0;
    virtual unsigned GetAudioOutCount() = 0;
 
+   // Whether the host may make more instances with the same settings, and
+   // process several tracks at once, each with its own instance on its own
+   // thread.  True only if instances share no state.
+   virtual bool SupportsParallelInstances() { return false; }
+
    virtual int GetMidiInCount() = 0;
    virtual int GetMidiOutCount() = 0;
 
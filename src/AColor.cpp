@@ -22,6 +22,8 @@ It is also a place to document colour usage policy in Audacity
 
 #include "Experimental.h"
 
+#include <algorithm>
+
 #include <wx/window.h>
 #include <wx/colour.h>
 #include <wx/dc.h>
@@ -635,6 +637,7 @@ void AColor::DarkMIDIChannel(wxDC * dc, int channel /* 1 - 16 */ )
 
 
 unsigned char AColor::gradient_pre[ColorGradientTotal][2][gradientSteps][3];
+unsigned char AColor::gradient_rgbx[ColorGradientTotal][2][gradientSteps][4];
 
 void AColor::PreComputeGradient() {
    {
@@ -714,6 +717,10 @@ void AColor::PreComputeGradient() {
                   gradient_pre[selected][grayscale][i][0] = (unsigned char) (255 * r);
                   gradient_pre[selected][grayscale][i][1] = (unsigned char) (255 * g);
                   gradient_pre[selected][grayscale][i][2] = (unsigned char) (255 * b);
+                  std::copy(gradient_pre[selected][grayscale][i],
+                     gradient_pre[selected][grayscale][i] + 3,
+                     gradient_rgbx[selected][grayscale][i]);
+                  gradient_rgbx[selected][grayscale][i][3] = 0;
                }
             }
       }
@@ -125,6 +125,9 @@ class AColor {
    static bool gradient_inited;
    static const int gradientSteps = 512;
    static unsigned char gradient_pre[ColorGradientTotal][2][gradientSteps][3];
+   // The same colours, each in four bytes, the last unused, for copying
+   // whole words at once
+   static unsigned char gradient_rgbx[ColorGradientTotal][2][gradientSteps][4];
 
    // For experiments in mouse-over highlighting only
    static wxPen uglyPen;
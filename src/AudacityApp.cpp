@@ -85,6 +85,7 @@ It handles initialization and termination by subclassing wxApp.
 #include "Project.h"
 #include "ProjectAudioIO.h"
 #include "ProjectAudioManager.h"
+#include "ProjectFileIO.h"
 #include "ProjectFileManager.h"
 #include "ProjectHistory.h"
 #include "ProjectManager.h"
@@ -99,6 +100,7 @@ It handles initialization and termination by subclassing wxApp.
 #include "FileNames.h"
 #include "AutoRecovery.h"
 #include "AutoRecoveryDialog.h"
+#include "BatchWorkers.h"
 #include "SplashDialog.h"
 #include "FFT.h"
 #include "BlockFile.h"
@@ -1465,6 +1467,15 @@ bool AudacityApp::OnInit()
       exit(1);
    }
 
+   // A worker started by BatchWorkers has nobody to answer dialogs, and its
+   // project is thrown away, so it neither saves nor recovers auto-save files
+   const bool isWorker = parser->Found(wxT("w"));
+   if (isWorker)
+   {
+      SuppressAudacityMessageBoxes(true);
+      ProjectFileIO::SetAutoSaveEnabled(false);
+   }
+
    // BG: Create a temporary window to set as the top window
    wxImage logoimage((const char **)AudacityLogoWithName_xpm);
    logoimage.Rescale(logoimage.GetWidth() / 2, logoimage.GetHeight() / 2);
@@ -1559,7 +1570,7 @@ bool AudacityApp::OnInit()
    // Root cause is problem with wxSplashScreen and other dialogs co-existing, that
    // seemed to arrive with wx3.
    {
-      project = ProjectManager::New();
+      project = ProjectManager::New( !isWorker );
       wxWindow * pWnd = MakeHijackPanel();
       if (pWnd)
       {
@@ -1571,7 +1582,8 @@ bool AudacityApp::OnInit()
       }
    }
 
-   if( ProjectSettings::Get( *project ).GetShowSplashScreen() ){
+   if( !parser->Found(wxT("m")) &&
+       ProjectSettings::Get( *project ).GetShowSplashScreen() ){
       // This may do a check-for-updates at every start up.
       // Mainly this is to tell users of ALPHAS who don't know that they have an ALPHA.
       // Disabled for now, after discussion.
@@ -1598,7 +1610,8 @@ bool AudacityApp::OnInit()
       // Auto-recovery
       //
       bool didRecoverAnything = false;
-      if (!ShowAutoRecoveryDialogIfNeeded(&project, &didRecoverAnything))
+      if (!isWorker &&
+          !ShowAutoRecoveryDialogIfNeeded(&project, &didRecoverAnything))
       {
          // Important: Prevent deleting any temporary files!
          DirManager::SetDontDeleteTempFiles();
@@ -1616,6 +1629,30 @@ bool AudacityApp::OnInit()
             QuitAudacity(true);
          }
 
+         wxString macroName;
+         if (parser->Found(wxT("m"), &macroName))
+         {
+            long jobs = 1;
+            parser->Found(wxT("j"), &jobs);
+            wxString resultsPath;
+            parser->Found(wxT("r"), &resultsPath);
+            long timeout = 0;
+            parser->Found(wxT("timeout"), &timeout);
+
+            FilePaths files;
+            for (size_t i = 0, cnt = parser->GetParamCount(); i < cnt; i++)
+            {
+               wxFileName filename(parser->GetParam(i));
+               if (filename.MakeAbsolute())
+                  files.push_back(filename.GetLongPath());
+            }
+
+            BatchWorkers::Main( *project, macroName, files,
+               std::max( 1L, jobs ), resultsPath, isWorker, timeout );
+            QuitAudacity(true);
+            return;
+         }
+
          // As of wx3, there's no need to process the filename arguments as they
          // will be sent via the MacOpenFile() method.
 #if !defined(__WXMAC__)
@@ -1795,6 +1832,20 @@ bool AudacityApp::InitTempDir()
    chmod(OSFILENAME(temp), 0755);
    #endif
 
+   // A worker started by BatchWorkers runs alongside another Audacity, in a
+   // directory of its own
+   {
+      auto parser = ParseCommandLine();
+      if (parser && parser->Found(wxT("w")))
+      {
+         temp = BatchWorkers::WorkerTempDir(temp, wxGetProcessId());
+         if (!wxDirExists(temp) && !wxMkdir(temp, 0755))
+            return false;
+         DirManager::SetTempDir(temp);
+         return true;
+      }
+   }
+
    bool bSuccess = gPrefs->Write(wxT("/Directories/TempDir"), temp) && gPrefs->Flush();
    DirManager::SetTempDir(temp);
 
@@ -2067,6 +2118,28 @@ std::unique_ptr<wxCmdLineParser> AudacityApp::ParseCommandLine()
    /*i18n-hint: This displays the Audacity version */
    parser->AddSwitch(wxT("v"), wxT("version"), _("display Audacity version"));
 
+   /*i18n-hint: This applies a macro to the files named on the command line
+    *           and then exits */
+   parser->AddOption(wxT("m"), wxT("macro"), _("apply a macro to the files and exit"),
+                     wxCMD_LINE_VAL_STRING);
+
+   /*i18n-hint: This sets how many files a macro is applied to at once */
+   parser->AddOption(wxT("j"), wxT("jobs"), _("number of files to apply the macro to at once"),
+                     wxCMD_LINE_VAL_NUMBER);
+
+   /*i18n-hint: This names a file to list the results of applying a macro */
+   parser->AddOption(wxT("r"), wxT("results"), _("write the results of the macro to a file"),
+                     wxCMD_LINE_VAL_STRING);
+
+   /*i18n-hint: This limits the time that applying a macro to one file may
+    *           take, when several are done at once */
+   parser->AddOption(wxEmptyString, wxT("timeout"), _("seconds after which a file the macro is applied to fails"),
+                     wxCMD_LINE_VAL_NUMBER);
+
+   // Used by BatchWorkers when it starts Audacity for one file
+   parser->AddSwitch(wxT("w"), wxT("worker"), wxEmptyString,
+                     wxCMD_LINE_HIDDEN);
+
    /*i18n-hint: This is a list of one or more files that Audacity
     *           should open upon startup */
    parser->AddParam(_("audio or project file name"),
@@ -421,7 +421,10 @@ time warp info and AudioIOListener and whether the playback is looped.
 #include "AudioIOListener.h"
 
 #include "float_cast.h"
+#include "BlockFileWriter.h"
 #include "DeviceManager.h"
+#include "Envelope.h"
+#include "FileException.h"
 
 #include <cfloat>
 #include <math.h>
@@ -461,6 +464,7 @@ time warp info and AudioIOListener and whether the playback is looped.
 #include "Prefs.h"
 #include "Project.h"
 #include "WaveTrack.h"
+#include "WorkerPool.h"
 #include "AutoRecovery.h"
 
 #include "effects/RealtimeEffectManager.h"
@@ -939,6 +943,15 @@ void AudioIO::Deinit()
    ugAudioIO.reset();
 }
 
+size_t AudioIO::GetPlaybackMixingThreads()
+{
+   const auto nThreads =
+      gPrefs->Read(wxT("/AudioIO/PlaybackMixingThreads"), 0L);
+   if (nThreads <= 0)
+      return WorkerPool::GetHardwareConcurrency();
+   return nThreads;
+}
+
 bool AudioIO::ValidateDeviceNames(const wxString &play, const wxString &rec)
 {
    const PaDeviceInfo *pInfo = Pa_GetDeviceInfo(getPlayDevIndex(play));
@@ -1567,6 +1580,15 @@ int AudioIO::StartStream(const TransportTracks &tracks,
    mMidiPlaybackTracks = tracks.midiTracks;
 #endif
 
+   if (!mCaptureTracks.empty()) {
+      // Read preferences here, on the main thread
+      auto &writer = BlockFileWriter::Get();
+      writer.UpdatePrefs();
+      writer.ResetStatistics();
+      writer.TakeFailure();
+      mPendingBlockFileLogs.clear();
+   }
+
    bool commit = false;
    auto cleanupTracks = finally([&]{
       if (!commit) {
@@ -1584,6 +1606,8 @@ int AudioIO::StartStream(const TransportTracks &tracks,
 
    mPlaybackBuffers.reset();
    mPlaybackMixers.reset();
+   mPlaybackProcessed.reset();
+   mPlaybackWarpEnvelopes.reset();
    mCaptureBuffers.reset();
    mResample.reset();
    mTimeQueue.mData.reset();
@@ -1685,6 +1709,34 @@ int AudioIO::StartStream(const TransportTracks &tracks,
          // stream, not the rate of the track.
          em.RealtimeAddProcessor(group++, std::min(2u, chanCnt), mRate);
       }
+
+      // Buffers so that the callback can give all groups to the effects at
+      // once.  Callbacks longer than this, which come with latencies too
+      // long to need the help, process the groups in turn.
+      const auto nTracks = mPlaybackTracks.size();
+      if (group > 1 && RealtimeEffectManager::GetRealtimeThreads() > 1)
+      {
+         mRealtimeFrames = 4096;
+         mRealtimeBuffers.reinit(2 * nTracks * mRealtimeFrames);
+         mRealtimeChannels.reinit(nTracks);
+         mRealtimeScratch.reinit(nTracks);
+         mRealtimeTracks.reinit(nTracks);
+         mRealtimeGroups.reinit(group);
+         mRealtimeMixes.reinit(group);
+         for (size_t i = 0; i < nTracks; i++)
+            mRealtimeScratch[i] =
+               &mRealtimeBuffers[(nTracks + i) * mRealtimeFrames];
+      }
+      else
+      {
+         mRealtimeFrames = 0;
+         mRealtimeBuffers.reset();
+         mRealtimeChannels.reset();
+         mRealtimeScratch.reset();
+         mRealtimeTracks.reset();
+         mRealtimeGroups.reset();
+         mRealtimeMixes.reset();
+      }
    }
 
 #ifdef EXPERIMENTAL_AUTOMATED_INPUT_LEVEL_ADJUSTMENT
@@ -1733,6 +1785,7 @@ int AudioIO::StartStream(const TransportTracks &tracks,
    // audio thread call FillBuffers here makes the code more predictable, since
    // FillBuffers will ALWAYS get called from the Audio thread.
    mAudioThreadShouldCallFillBuffersOnce = true;
+   WakeAudioThread();
 
    while( mAudioThreadShouldCallFillBuffersOnce ) {
       auto interval = 50ull;
@@ -1775,6 +1828,7 @@ int AudioIO::StartStream(const TransportTracks &tracks,
       // playback, since our ring buffers have been primed already with 4 sec
       // of audio, but then we might be scrubbing, so do it.
       mAudioThreadFillBuffersLoopRunning = true;
+      WakeAudioThread();
 
       // Now start the PortAudio stream!
       PaError err;
@@ -1887,6 +1941,18 @@ bool AudioIO::AllocateBuffers(
 
             mPlaybackBuffers.reinit(mPlaybackTracks.size());
             mPlaybackMixers.reinit(mPlaybackTracks.size());
+            mPlaybackProcessed.reinit(mPlaybackTracks.size(), true);
+            mPlaybackWarpEnvelopes.reinit(mPlaybackTracks.size());
+
+            // The audio thread counts as one of the threads
+            const auto nMixingThreads = std::min(
+               GetPlaybackMixingThreads(), mPlaybackTracks.size());
+            if (nMixingThreads <= 1)
+               mPlaybackMixPool.reset();
+            else if (!mPlaybackMixPool ||
+               mPlaybackMixPool->GetWorkerCount() != nMixingThreads - 1)
+               mPlaybackMixPool =
+                  std::make_unique<WorkerPool>(nMixingThreads - 1);
 
             const Mixer::WarpOptions &warpOptions =
 #ifdef EXPERIMENTAL_SCRUBBING_SUPPORT
@@ -1938,11 +2004,22 @@ bool AudioIO::AllocateBuffers(
                   // at the right time, though transport may continue to record
                   endTime = t1;
 
+               auto mixerWarpOptions = warpOptions;
+               if (mPlaybackMixPool && !scrubbing &&
+                   mPlaybackSchedule.mEnvelope) {
+                  // Envelope lookups update a search hint, so each mixer
+                  // that may run in another thread gets its own copy
+                  mPlaybackWarpEnvelopes[i] = std::make_unique<BoundedEnvelope>(
+                     *mPlaybackSchedule.mEnvelope);
+                  mixerWarpOptions =
+                     Mixer::WarpOptions(mPlaybackWarpEnvelopes[i].get());
+               }
+
                mPlaybackMixers[i] = std::make_unique<Mixer>
                   (mixTracks,
                   // Don't throw for read errors, just play silence:
                   false,
-                  warpOptions,
+                  mixerWarpOptions,
                   mPlaybackSchedule.mT0,
                   endTime,
                   1,
@@ -2018,6 +2095,8 @@ void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
 
    mPlaybackBuffers.reset();
    mPlaybackMixers.reset();
+   mPlaybackProcessed.reset();
+   mPlaybackWarpEnvelopes.reset();
    mCaptureBuffers.reset();
    mResample.reset();
    mTimeQueue.mData.reset();
@@ -2312,6 +2391,7 @@ void AudioIO::StopStream()
       // call FillBuffers one last time (it normally would not do so since
       // Pa_GetStreamActive() would now return false
       mAudioThreadShouldCallFillBuffersOnce = true;
+      WakeAudioThread();
 
       while( mAudioThreadShouldCallFillBuffersOnce )
       {
@@ -2329,6 +2409,8 @@ void AudioIO::StopStream()
       {
          mPlaybackBuffers.reset();
          mPlaybackMixers.reset();
+         mPlaybackProcessed.reset();
+         mPlaybackWarpEnvelopes.reset();
          mTimeQueue.mData.reset();
       }
 
@@ -2571,6 +2653,10 @@ finished:
 //
 //////////////////////////////////////////////////////////////////////
 
+// The audio thread is normally woken by the PortAudio callback, or by the
+// main thread, when there is work; but it wakes at least this often anyway
+static constexpr unsigned AudioThreadMaxWait_ms = 50;
+
 AudioThread::ExitCode AudioThread::Entry()
 {
    AudioIO *gAudioIO;
@@ -2581,6 +2667,10 @@ AudioThread::ExitCode AudioThread::Entry()
       auto loopPassStart = Clock::now();
       const auto interval = ScrubPollInterval_ms;
 
+      // Clear this before the pass, so that a wakeup requested during
+      // FillBuffers causes another pass
+      gAudioIO->mAudioThreadWakeupPending.store(false);
+
       // Set LoopActive outside the tests to avoid race condition
       gAudioIO->mAudioThreadFillBuffersLoopActive = true;
       if( gAudioIO->mAudioThreadShouldCallFillBuffersOnce )
@@ -2598,7 +2688,8 @@ AudioThread::ExitCode AudioThread::Entry()
          std::this_thread::sleep_until(
             loopPassStart + std::chrono::milliseconds( interval ) );
       else
-         Sleep(10);
+         gAudioIO->mAudioThreadWakeup.WaitFor(
+            std::chrono::milliseconds( AudioThreadMaxWait_ms ) );
    }
 
    return 0;
@@ -2775,18 +2866,34 @@ void AudioIO::FillBuffers()
                (mPlaybackSchedule.Interactive() ? mScrubSpeed : 1.0),
                frames);
 
-            for (i = 0; i < mPlaybackTracks.size(); i++)
+            if (frames > 0 && toProcess)
             {
                // The mixer here isn't actually mixing: it's just doing
                // resampling, format conversion, and possibly time track
-               // warping
+               // warping.  The mixers of different tracks share nothing, so
+               // they may run concurrently.  The ring buffers are still
+               // written below by this thread alone, after the time queue.
+               const auto process = [this, toProcess]( size_t ii ) {
+                  mPlaybackProcessed[ii] =
+                     mPlaybackMixers[ii]->Process( toProcess );
+               };
+               if (mPlaybackMixPool)
+                  mPlaybackMixPool->ParallelFor(
+                     mPlaybackTracks.size(), process );
+               else
+                  for (i = 0; i < mPlaybackTracks.size(); i++)
+                     process( i );
+            }
+
+            for (i = 0; i < mPlaybackTracks.size(); i++)
+            {
                samplePtr warpedSamples;
 
                if (frames > 0)
                {
                   size_t processed = 0;
                   if ( toProcess )
-                     processed = mPlaybackMixers[i]->Process( toProcess );
+                     processed = mPlaybackProcessed[i];
                   //wxASSERT(processed <= toProcess);
                   warpedSamples = mPlaybackMixers[i]->GetBuffer();
                   const auto put = mPlaybackBuffers[i]->Put(
@@ -2892,7 +2999,8 @@ void AudioIO::FillBuffers()
          {
             // Append captured samples to the end of the WaveTracks.
             // The WaveTracks have their own buffering for efficiency.
-            AutoSaveFile blockFileLog;
+            auto pBlockFileLog = std::make_unique< AutoSaveFile >();
+            auto &blockFileLog = *pBlockFileLog;
             auto numChannels = mCaptureTracks.size();
 
             for( i = 0; i < numChannels; i++ )
@@ -3033,9 +3141,27 @@ void AudioIO::FillBuffers()
             mRecordingSchedule.mPosition += avail / mRate;
             mRecordingSchedule.mLatencyCorrected = latencyCorrected;
 
+            // Report a failure of the block writer thread as if the append
+            // had failed
+            auto &writer = BlockFileWriter::Get();
+            const auto failure = writer.TakeFailure();
+            if (!failure.empty())
+               throw FileException{
+                  FileException::Cause::Write, wxFileName{ failure } };
+
+            // Journal only the files that the writer has finished; the
+            // auto-save when recording stops covers any left
+            if (!blockFileLog.IsEmpty())
+               mPendingBlockFileLogs.push_back(
+                  { writer.GetLastTicket(), std::move( pBlockFileLog ) } );
             auto pListener = GetListener();
-            if (pListener && !blockFileLog.IsEmpty())
-               pListener->OnAudioIONewBlockFiles(blockFileLog);
+            while (!mPendingBlockFileLogs.empty() &&
+                   writer.IsDone( mPendingBlockFileLogs.front().ticket )) {
+               if (pListener)
+                  pListener->OnAudioIONewBlockFiles(
+                     *mPendingBlockFileLogs.front().pLog );
+               mPendingBlockFileLogs.pop_front();
+            }
          }
          // end of record buffering
       },
@@ -3875,12 +4001,48 @@ bool AudioIoCallback::FillOutputBuffers(
    // I would expect us not to need the fast paths, since linearly interpolated gain
    // is very cheap to process.
 
+   // Mix the channels of one group, which aren't silent, into the output.
+   //
+   // Note that there are two kinds of channel count.
+   // c and nChans are counting channels in the Tracks.
+   // chan (and numPlayBackChannels) is counting output channels on the device.
+   // chan = 0 is left channel
+   // chan = 1 is right channel.
+   //
+   // Each channel in the tracks can output to more than one channel on the device.
+   // For example mono channels output to both left and right output channels.
+   auto mixGroup = [&]( WaveTrack **groupChans, float **groupBufs,
+      unsigned nChans, bool drop, size_t len )
+   {
+      if (len > 0) for (unsigned c = 0; c < nChans; c++)
+      {
+         auto vt = groupChans[c];
+
+         if (vt->GetChannelIgnoringPan() == Track::LeftChannel ||
+               vt->GetChannelIgnoringPan() == Track::MonoChannel )
+            AddToOutputChannel( 0, outputMeterFloats, outputFloats, tempFloats, groupBufs[c], drop, len, vt);
+
+         if (vt->GetChannelIgnoringPan() == Track::RightChannel ||
+               vt->GetChannelIgnoringPan() == Track::MonoChannel  )
+            AddToOutputChannel( 1, outputMeterFloats, outputFloats, tempFloats, groupBufs[c], drop, len, vt);
+      }
+   };
+
+   // With realtime effects on several threads, each group is read into
+   // buffers of its own, and mixed only after all groups are processed
+   const bool parallelEffects =
+      mRealtimeFrames > 0 && framesPerBuffer <= mRealtimeFrames;
+   size_t nRealtimeGroups = 0;
+   size_t nRealtimeMixes = 0;
+   WaveTrack **groupChans = chans;
+   float **groupBufs = tempBufs;
+   float **groupScratch = nullptr;
+
    bool drop = false;        // Track should become silent.
    bool dropQuickly = false; // Track has already been faded to silence.
    for (unsigned t = 0; t < numPlaybackTracks; t++)
    {
       WaveTrack *vt = mPlaybackTracks[t].get();
-      chans[chanCnt] = vt;
 
       // TODO: more-than-two-channels
       auto nextTrack =
@@ -3893,6 +4055,16 @@ bool AudioIoCallback::FillOutputBuffers(
       bool firstChannel = vt->IsLeader();
       bool lastChannel = !nextTrack || nextTrack->IsLeader();
 
+      if ( firstChannel && parallelEffects )
+      {
+         groupChans = &mRealtimeTracks[t];
+         groupBufs = &mRealtimeChannels[t];
+         groupScratch = &mRealtimeScratch[t];
+      }
+      groupChans[chanCnt] = vt;
+      if ( parallelEffects )
+         groupBufs[chanCnt] = &mRealtimeBuffers[t * mRealtimeFrames];
+
       if ( firstChannel )
       {
          selected = vt->GetSelected();
@@ -3918,7 +4090,7 @@ bool AudioIoCallback::FillOutputBuffers(
       }
       else
       {
-         len = mPlaybackBuffers[t]->Get((samplePtr)tempBufs[chanCnt],
+         len = mPlaybackBuffers[t]->Get((samplePtr)groupBufs[chanCnt],
                                                    floatSample,
                                                    toGet);
          // wxASSERT( len == toGet );
@@ -3929,7 +4101,7 @@ bool AudioIoCallback::FillOutputBuffers(
             // real-time demand in this thread (see bug 1932).  We
             // must supply something to the sound card, so pad it with
             // zeroes and not random garbage.
-            memset((void*)&tempBufs[chanCnt][len], 0,
+            memset((void*)&groupBufs[chanCnt][len], 0,
                (framesPerBuffer - len) * sizeof(float));
          chanCnt++;
       }
@@ -3949,6 +4121,24 @@ bool AudioIoCallback::FillOutputBuffers(
       // Last channel of a track seen now
       len = mMaxFramesOutput;
 
+      if ( parallelEffects )
+      {
+         // Effects return the length they are given, so completion can be
+         // checked before they run
+         CallbackCheckCompletion(mCallbackReturn, len);
+         if ( !dropQuickly )
+         {
+            if ( selected )
+               mRealtimeGroups[nRealtimeGroups++] =
+                  { group, (unsigned)chanCnt, groupBufs, groupScratch, len };
+            mRealtimeMixes[nRealtimeMixes++] =
+               { groupChans, groupBufs, (unsigned)chanCnt, drop, len };
+         }
+         group++;
+         chanCnt = 0;
+         continue;
+      }
+
       if( !dropQuickly && selected )
          len = em.RealtimeProcess(group, chanCnt, tempBufs, len);
       group++;
@@ -3957,30 +4147,19 @@ bool AudioIoCallback::FillOutputBuffers(
       if (dropQuickly) // no samples to process, they've been discarded
          continue;
 
-      // Our channels aren't silent.  We need to pass their data on.
-      //
-      // Note that there are two kinds of channel count.
-      // c and chanCnt are counting channels in the Tracks.
-      // chan (and numPlayBackChannels) is counting output channels on the device.
-      // chan = 0 is left channel
-      // chan = 1 is right channel.
-      //
-      // Each channel in the tracks can output to more than one channel on the device.
-      // For example mono channels output to both left and right output channels.
-      if (len > 0) for (int c = 0; c < chanCnt; c++)
-      {
-         vt = chans[c];
+      mixGroup( chans, tempBufs, chanCnt, drop, len );
 
-         if (vt->GetChannelIgnoringPan() == Track::LeftChannel ||
-               vt->GetChannelIgnoringPan() == Track::MonoChannel )
-            AddToOutputChannel( 0, outputMeterFloats, outputFloats, tempFloats, tempBufs[c], drop, len, vt);
+      chanCnt = 0;
+   }
 
-         if (vt->GetChannelIgnoringPan() == Track::RightChannel ||
-               vt->GetChannelIgnoringPan() == Track::MonoChannel  )
-            AddToOutputChannel( 1, outputMeterFloats, outputFloats, tempFloats, tempBufs[c], drop, len, vt);
+   if ( parallelEffects )
+   {
+      em.RealtimeProcessGroups( mRealtimeGroups.get(), nRealtimeGroups );
+      for (size_t i = 0; i < nRealtimeMixes; i++)
+      {
+         const auto &mix = mRealtimeMixes[i];
+         mixGroup( mix.tracks, mix.buffers, mix.chans, mix.drop, mix.len );
       }
-
-      chanCnt = 0;
    }
 
    // Poke: If there are no playback tracks, then the earlier check
@@ -4455,6 +4634,8 @@ int AudioIoCallback::AudioCallback(const void *inputBuffer, void *outputBuffer,
 
    SendVuOutputMeterData( outputMeterFloats, framesPerBuffer);
 
+   CallbackCheckLowWaterMarks();
+
    return mCallbackReturn;
 }
 
@@ -4499,6 +4680,7 @@ PaStreamCallbackResult AudioIoCallback::CallbackDoSeek()
 
    // Reload the ring buffers
    mAudioThreadShouldCallFillBuffersOnce = true;
+   WakeAudioThread();
    while( mAudioThreadShouldCallFillBuffersOnce )
    {
       wxMilliSleep( 50 );
@@ -4506,10 +4688,48 @@ PaStreamCallbackResult AudioIoCallback::CallbackDoSeek()
 
    // Reenable the audio thread
    mAudioThreadFillBuffersLoopRunning = true;
+   WakeAudioThread();
 
    return paContinue;
 }
 
+void AudioIoCallback::CallbackCheckLowWaterMarks()
+{
+   if (!mAudioThreadFillBuffersLoopRunning ||
+       // The audio thread paces itself while scrubbing
+       mPlaybackSchedule.Interactive())
+      return;
+
+   if (!mPlaybackTracks.empty()) {
+      auto commonlyFree = mPlaybackBuffers[0]->AvailForPut();
+      for (unsigned i = 1; i < mPlaybackTracks.size(); ++i)
+         commonlyFree = std::min(commonlyFree,
+            mPlaybackBuffers[i]->AvailForPut());
+      // Compare as GetCommonlyFreePlayback() and FillBuffers() do, with the
+      // same allowance for rounding
+      if (commonlyFree >= mPlaybackSamplesToCopy + 10 ||
+          GetCommonlyReadyPlayback() < mPlaybackQueueMinimum) {
+         WakeAudioThread();
+         return;
+      }
+   }
+
+   if (!mCaptureTracks.empty()) {
+      auto commonlyAvail = mCaptureBuffers[0]->AvailForGet();
+      for (unsigned i = 1; i < mCaptureTracks.size(); ++i)
+         commonlyAvail = std::min(commonlyAvail,
+            mCaptureBuffers[i]->AvailForGet());
+      if (commonlyAvail / mRate >= mMinCaptureSecsToCopy)
+         WakeAudioThread();
+   }
+}
+
+void AudioIoCallback::WakeAudioThread()
+{
+   if (!mAudioThreadWakeupPending.exchange(true))
+      mAudioThreadWakeup.Post();
+}
+
 void AudioIoCallback::CallbackCheckCompletion(
    int &callbackReturn, unsigned long len)
 {
@@ -18,7 +18,11 @@
 #include "AudioIOBase.h" // to inherit
 
 #include "Experimental.h"
+#include "Semaphore.h" // member variable
+#include "effects/RealtimeEffectManager.h" // member variable
 
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <utility>
 #include <wx/atomic.h> // member variable
@@ -52,9 +56,12 @@ class RingBuffer;
 class Mixer;
 class Resample;
 class AudioThread;
+class BoundedEnvelope;
 class SelectedRegion;
+class WorkerPool;
 
 class AudacityProject;
+class AutoSaveFile;
 
 class WaveTrack;
 using WaveTrackArray = std::vector < std::shared_ptr < WaveTrack > >;
@@ -254,6 +261,18 @@ public:
    void CallbackCheckCompletion(
       int &callbackReturn, unsigned long len);
 
+   // Part of the callback
+   // Wakes the audio thread if the playback buffers have drained to the
+   // point where FillBuffers would refill them, or the capture buffers
+   // hold enough to be written to the tracks
+   void CallbackCheckLowWaterMarks();
+
+   /** \brief Ask the audio thread to make a pass through FillBuffers soon
+    *
+    * Does not block or allocate, so it may be called from the PortAudio
+    * callback */
+   void WakeAudioThread();
+
    int mbHasSoloTracks;
    int mCallbackReturn;
    // Helpers to determine if tracks have already been faded out.
@@ -425,6 +444,32 @@ public:
    WaveTrackArray      mPlaybackTracks;
 
    ArrayOf<std::unique_ptr<Mixer>> mPlaybackMixers;
+   /// Results of the last Process() call of each of mPlaybackMixers
+   ArrayOf<size_t>     mPlaybackProcessed;
+   /// Private copies of the time track envelope, one for each mixer, so
+   /// that mixers never share mutable state
+   ArrayOf<std::unique_ptr<BoundedEnvelope>> mPlaybackWarpEnvelopes;
+   /// Fills mPlaybackMixers concurrently; null when only one thread is used
+   std::unique_ptr<WorkerPool> mPlaybackMixPool;
+
+   /// When realtime effects use several threads, each playback track is read
+   /// into a buffer of its own, with a scratch buffer for the effects, so
+   /// that all groups can be processed before any is mixed.  Empty when
+   /// the groups are processed in turn.
+   struct RealtimeMix {
+      WaveTrack **tracks;
+      float **buffers;
+      unsigned chans;
+      bool drop;
+      size_t len;
+   };
+   size_t              mRealtimeFrames{ 0 };
+   Floats              mRealtimeBuffers;
+   ArrayOf<float *>    mRealtimeChannels;
+   ArrayOf<float *>    mRealtimeScratch;
+   ArrayOf<WaveTrack *> mRealtimeTracks;
+   ArrayOf<RealtimeEffectManager::Group> mRealtimeGroups;
+   ArrayOf<RealtimeMix> mRealtimeMixes;
    static int          mNextStreamToken;
    double              mFactor;
    unsigned long       mMaxFramesOutput; // The actual number of frames output.
@@ -452,6 +497,11 @@ public:
    volatile bool       mAudioThreadFillBuffersLoopRunning;
    volatile bool       mAudioThreadFillBuffersLoopActive;
 
+   /// The audio thread waits on this between passes, instead of polling
+   Semaphore           mAudioThreadWakeup;
+   /// So that WakeAudioThread posts only once between passes
+   std::atomic<bool>   mAudioThreadWakeupPending{ false };
+
    wxLongLong          mLastPlaybackTimeMillis;
 
 #ifdef EXPERIMENTAL_MIDI_OUT
@@ -713,6 +763,13 @@ public:
    static void Init();
    static void Deinit();
 
+   /** \brief Number of threads, counting the audio thread, that may fill the
+    * playback buffers of different tracks at once
+    *
+    * Reads the preference /AudioIO/PlaybackMixingThreads, in which zero
+    * means one thread per processor. */
+   static size_t GetPlaybackMixingThreads();
+
 
 
 private:
@@ -782,6 +839,15 @@ private:
      *
      * If bOnlyBuffers is specified, it only cleans up the buffers. */
    void StartStreamCleanup(bool bOnlyBuffers = false);
+
+   // Entries of the auto-save journal of the recording, held by the audio
+   // thread until BlockFileWriter has written the files that they name,
+   // up to the ticket of the last of them
+   struct PendingBlockFileLog {
+      unsigned long long ticket;
+      std::unique_ptr< AutoSaveFile > pLog;
+   };
+   std::deque< PendingBlockFileLog > mPendingBlockFileLogs;
 };
 
 static constexpr unsigned ScrubPollInterval_ms = 50;
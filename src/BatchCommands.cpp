@@ -30,6 +30,7 @@ processing.  See also MacrosWindow and ApplyMacroDialog.
 #include "ProjectSettings.h"
 #include "ProjectWindow.h"
 #include "commands/CommandManager.h"
+#include "effects/EffectChain.h"
 #include "effects/EffectManager.h"
 #include "effects/EffectUI.h"
 #include "FileNames.h"
@@ -39,6 +40,7 @@ processing.  See also MacrosWindow and ApplyMacroDialog.
 #include "SelectUtilities.h"
 #include "Shuttle.h"
 #include "Track.h"
+#include "ViewInfo.h"
 #include "export/ExportMP3.h"
 
 #include "AllThemeResources.h"
@@ -807,6 +809,85 @@ bool MacroCommands::ApplyEffectCommand(
    return res;
 }
 
+size_t MacroCommands::CountChainableEffects( size_t iCommand )
+{
+   int bDebug;
+   gPrefs->Read(wxT("/Batch/Debug"), &bDebug, false);
+   if( bDebug != 0 || !gPrefs->ReadBool(wxT("/Batch/ChainEffects"), true) )
+      return 0;
+
+   EffectManager & em = EffectManager::Get();
+   // The user's settings of each effect probed are restored on return
+   std::vector< EffectManager::BatchProcessingScope > scopes;
+   std::vector< Effect* > effects;
+   for (auto ii = iCommand; ii < mCommandMacro.size(); ++ii) {
+      const PluginID & ID = em.GetEffectByIdentifier( mCommandMacro[ii] );
+      if (ID.empty())
+         break;
+      auto effect = em.GetEffect(ID);
+      // One instance can't hold the settings of two steps
+      if (!effect ||
+          std::find(effects.begin(), effects.end(), effect) != effects.end())
+         break;
+      if (!effect->SupportsChaining())
+         break;
+      // The numbers of channels may depend on the settings
+      scopes.push_back( em.SetBatchProcessing(ID) );
+      if (!em.SetEffectParameters(ID, mParamsMacro[ii]))
+         break;
+      effects.push_back(effect);
+      if (!EffectChain::CanChain(effects)) {
+         effects.pop_back();
+         break;
+      }
+   }
+
+   return effects.size();
+}
+
+// Like ApplyEffectCommand() for each of the effects in turn, but the tracks
+// are copied and their new audio written just once, for all of them
+bool MacroCommands::ApplyEffectChain( size_t iCommand, size_t nEffects )
+{
+   AudacityProject &project = mProject;
+   auto &settings = ProjectSettings::Get( project );
+   auto &tracks = TrackList::Get( project );
+   auto &trackFactory = TrackFactory::Get( project );
+   auto &selectedRegion = ViewInfo::Get( project ).selectedRegion;
+
+   MenuManager::Get(project).UpdateMenus(false);
+   bool prevShowMode = settings.GetShowId3Dialog();
+   project.mBatchMode++;
+   auto cleanup = finally( [&] {
+      settings.SetShowId3Dialog(prevShowMode);
+      project.mBatchMode--;
+   } );
+
+   EffectManager & em = EffectManager::Get();
+   std::vector< EffectManager::BatchProcessingScope > scopes;
+   std::vector< Effect* > effects;
+   for (auto ii = iCommand; ii < iCommand + nEffects; ++ii) {
+      const PluginID & ID = em.GetEffectByIdentifier( mCommandMacro[ii] );
+      scopes.push_back( em.SetBatchProcessing(ID) );
+      if (!em.SetEffectParameters(ID, mParamsMacro[ii]))
+         return false;
+      effects.push_back( em.GetEffect(ID) );
+   }
+   if (!EffectChain::CanChain(effects))
+      return false;
+
+   ProjectAudioManager::Get( project ).Stop();
+   SelectUtilities::SelectAllIfNone( project );
+
+   EffectChain chain{ std::move( effects ) };
+   if (!chain.DoEffect(
+      settings.GetRate(), &tracks, &trackFactory, selectedRegion ))
+      return false;
+
+   ProjectWindow::Get( project ).RedrawProject();
+   return true;
+}
+
 bool MacroCommands::HandleTextualCommand( CommandManager &commandManager,
    const CommandID & Str,
    const CommandContext & context, CommandFlag flags, bool alwaysEnabled)
@@ -948,6 +1029,15 @@ bool MacroCommands::ApplyMacro(
 
    size_t i = 0;
    for (; i < mCommandMacro.size(); i++) {
+      // Apply a run of effects that allow it together, in one pass
+      const auto nEffects = CountChainableEffects(i);
+      if (nEffects > 1) {
+         if (!ApplyEffectChain(i, nEffects) || mAbort)
+            break;
+         i += nEffects - 1;
+         continue;
+      }
+
       const auto &command = mCommandMacro[i];
       auto iter = catalog.ByCommandId(command);
       const auto friendly = (iter == catalog.end())
@@ -80,6 +80,11 @@ class MacroCommands final {
       const CommandID & command,
       const wxString & params, const CommandContext & Context);
    bool ReportAndSkip( const TranslatableString & friendlyCommand, const wxString & params );
+
+   // How many effects, starting at the given step, can be applied together
+   // in one pass; 0 or 1 if they should be applied one at a time
+   size_t CountChainableEffects( size_t iCommand );
+   bool ApplyEffectChain( size_t iCommand, size_t nEffects );
    void AbortBatch();
 
    // Utility functions for the special commands.
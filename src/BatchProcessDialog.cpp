@@ -27,6 +27,7 @@
 #include <wx/checkbox.h>
 #include <wx/choice.h>
 #include <wx/filedlg.h>
+#include <wx/filename.h>
 #include <wx/intl.h>
 #include <wx/sizer.h>
 #include <wx/statbox.h>
@@ -39,6 +40,7 @@
 #include <wx/settings.h>
 
 #include "ShuttleGui.h"
+#include "BatchWorkers.h"
 #include "Menus.h"
 #include "Prefs.h"
 #include "Project.h"
@@ -358,7 +360,7 @@ void ApplyMacroDialog::OnApplyToFiles(wxCommandEvent & WXUNUSED(event))
    }
    Raise();
    
-   wxArrayString files;
+   FilePaths files;
    dlog.GetPaths(files);
 
    files.Sort();
@@ -424,6 +426,51 @@ void ApplyMacroDialog::OnApplyToFiles(wxCommandEvent & WXUNUSED(event))
    // and hiding this one temporarily has some advantages.
    Hide();
 
+   // Several files at once, each in an Audacity process of its own
+   const auto nJobs = gPrefs->Read(wxT("/Batch/Jobs"), 1L);
+   if (nJobs > 1 && files.size() > 1) {
+      BatchWorkers workers{ name, (size_t)nJobs,
+         gPrefs->Read(wxT("/Batch/WorkerTimeout"), 3600L) };
+      long previous = -1;
+      const auto results = workers.Run( files,
+         [&]( size_t index, const BatchWorkers::Result &result ) {
+            // The arrow marks the file done last, and red those that failed
+            if (previous >= 0)
+               fileList->SetItemImage(previous, 0, 0);
+            previous = index;
+            fileList->SetItemImage(index, 1, 1);
+            if (!result.success)
+               fileList->SetItemTextColour(index, *wxRED);
+            fileList->EnsureVisible(index);
+            return activityWin.IsShown() && !mAbort;
+         } );
+
+      // Say which files failed and why, as the command line does
+      wxString failures;
+      size_t nFailed = 0;
+      for (const auto &result : results) {
+         if (result.success)
+            continue;
+         ++nFailed;
+         failures += wxString::Format( wxT("\n%s: %s"),
+            wxFileName{ result.file }.GetFullName(), result.message );
+      }
+      if (nFailed > 0)
+         AudacityMessageBox(
+            /* i18n-hint: followed by a list of file names, each with the
+               reason it failed */
+            XO("The macro failed for %lu of %lu files:\n%s")
+               .Format( (unsigned long)nFailed, (unsigned long)results.size(),
+                  failures ),
+            XO("Apply Macro"),
+            wxOK | wxICON_WARNING,
+            &activityWin );
+
+      Show();
+      Raise();
+      return;
+   }
+
    mMacroCommands.ReadMacro(name);
    for (i = 0; i < (int)files.size(); i++) {
       wxWindowDisabler wd(&activityWin);
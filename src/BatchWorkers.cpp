@@ -0,0 +1,345 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BatchWorkers.cpp
+
+*******************************************************************//**
+
+\class BatchWorkers
+\brief Applies a macro to many files, each file in an Audacity process of
+its own.
+
+  Applying a macro to files in one project does them one after another,
+  and an error in one file stops the rest.  BatchWorkers starts Audacity
+  again for each file, with the hidden --worker switch, so that several
+  files are done at once, each with its own project and temporary
+  directory.  Each worker writes the result for its file, and the results
+  are gathered into one list with the time taken for each file.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BatchWorkers.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <wx/app.h>
+#include <wx/filename.h>
+#include <wx/process.h>
+#include <wx/stopwatch.h>
+#include <wx/textfile.h>
+#include <wx/utils.h>
+
+#include "AudacityException.h"
+#include "BatchCommands.h"
+#include "DirManager.h"
+#include "PlatformCompatibility.h"
+#include "ProjectFileManager.h"
+#include "ProjectManager.h"
+#include "ProjectWindow.h"
+#include "SelectUtilities.h"
+
+namespace {
+
+class BatchWorkerProcess final : public wxProcess
+{
+public:
+   BatchWorkerProcess()
+   {
+      mActive = true;
+      mStatus = -555;
+   }
+
+   bool IsActive()
+   {
+      return mActive;
+   }
+
+   void OnTerminate(int WXUNUSED( pid ), int status) override
+   {
+      mStatus = status;
+      mActive = false;
+   }
+
+   int GetStatus()
+   {
+      return mStatus;
+   }
+
+private:
+   bool mActive;
+   int mStatus;
+};
+
+}
+
+BatchWorkers::BatchWorkers( const wxString &macroName, size_t nWorkers,
+   long timeoutSeconds )
+   : mMacroName{ macroName }
+   , mnWorkers{ std::max< size_t >( 1, nWorkers ) }
+   , mTimeoutSeconds{ std::max( 0L, timeoutSeconds ) }
+{
+}
+
+BatchWorkers::Results BatchWorkers::Run(
+   const FilePaths &files, const Callback &callback )
+{
+   Results results( files.size() );
+   for (size_t ii = 0; ii < files.size(); ++ii)
+      results[ii].file = files[ii];
+
+   struct Job {
+      size_t index;
+      long pid;
+      FilePath resultsPath;
+      std::unique_ptr< BatchWorkerProcess > process;
+      wxStopWatch timer;
+      bool killed{ false };
+   };
+   std::vector< std::unique_ptr< Job > > running;
+
+   const auto &tempDir = DirManager::GetTempDir();
+   const auto &cmdpath = PlatformCompatibility::GetExecutablePath();
+   bool cancelled = false;
+
+   auto finish = [&]( size_t index ) {
+      if (callback && !callback( index, results[index] ))
+         cancelled = true;
+   };
+
+   size_t next = 0;
+   while ((!cancelled && next < files.size()) || !running.empty())
+   {
+      while (!cancelled && next < files.size() && running.size() < mnWorkers)
+      {
+         auto pJob = std::make_unique< Job >();
+         pJob->index = next++;
+         pJob->resultsPath = wxFileName{ tempDir, wxString::Format(
+            wxT("batch-%lu-%lu.txt"),
+            wxGetProcessId(), (unsigned long)pJob->index ) }.GetFullPath();
+         pJob->process = std::make_unique< BatchWorkerProcess >();
+
+         // Pass the arguments separately, not in one command line, so that
+         // wxExecute quotes them as the platform requires; paths and macro
+         // names may contain quotes and spaces
+         const wxString args[] = {
+            cmdpath, wxT("--worker"), wxT("--macro"), mMacroName,
+            wxT("--results"), pJob->resultsPath, files[pJob->index] };
+         std::vector< const wxChar* > argv;
+         for (const auto &arg : args)
+            argv.push_back( arg.wc_str() );
+         argv.push_back( nullptr );
+         pJob->timer.Start();
+         pJob->pid = wxExecute(argv.data(), wxEXEC_ASYNC, pJob->process.get());
+         if (pJob->pid == 0)
+         {
+            pJob->process->Detach();
+            results[pJob->index].message = _("Could not start a worker");
+            finish( pJob->index );
+            continue;
+         }
+         running.push_back( std::move( pJob ) );
+      }
+
+      // Let wxProcess learn of terminations
+      wxMilliSleep(20);
+      wxTheApp->Yield(true);
+
+      for (auto iter = running.begin(); iter != running.end();)
+      {
+         auto &job = **iter;
+         if (job.process->IsActive())
+         {
+            // Kill a worker that hangs, as on a dialog that nobody answers,
+            // and wait for its termination to be reported
+            if (mTimeoutSeconds > 0 && !job.killed &&
+                job.timer.Time() / 1000 >= mTimeoutSeconds)
+            {
+               wxKill( job.pid, wxSIGKILL, nullptr, wxKILL_CHILDREN );
+               job.killed = true;
+            }
+            ++iter;
+            continue;
+         }
+
+         auto &result = results[job.index];
+         Results workerResults;
+         if (job.killed)
+         {
+            result.success = false;
+            result.seconds = job.timer.Time() / 1000.0;
+            result.message = wxString::Format(
+               _("Worker timed out after %ld seconds"), mTimeoutSeconds);
+         }
+         else if (ReadResults( job.resultsPath, workerResults ) &&
+             workerResults.size() == 1)
+         {
+            result = workerResults[0];
+            result.file = files[job.index];
+         }
+         else
+         {
+            result.success = false;
+            result.seconds = job.timer.Time() / 1000.0;
+            result.message = wxString::Format(
+               _("Worker exited with status %d"), job.process->GetStatus());
+         }
+
+         // Remove what a worker left, even if it crashed
+         wxRemoveFile( job.resultsPath );
+         const auto workerDir = WorkerTempDir( tempDir, job.pid );
+         if (wxDirExists( workerDir ))
+            wxFileName::Rmdir( workerDir, wxPATH_RMDIR_RECURSIVE );
+
+         const auto index = job.index;
+         iter = running.erase( iter );
+         finish( index );
+      }
+   }
+
+   for (; next < files.size(); ++next)
+      results[next].message = _("Cancelled");
+
+   return results;
+}
+
+BatchWorkers::Result BatchWorkers::ApplyToFile( AudacityProject &project,
+   MacroCommands &commands, const MacroCommandsCatalog &catalog,
+   const FilePath &file )
+{
+   Result result;
+   result.file = file;
+
+   wxStopWatch timer;
+   result.success = GuardedCall< bool >( [&] {
+      if (!ProjectFileManager::Get( project ).Import( file ))
+      {
+         result.message = _("Could not import the file");
+         return false;
+      }
+      ProjectWindow::Get( project ).ZoomAfterImport(nullptr);
+      SelectUtilities::DoSelectAll( project );
+      if (!commands.ApplyMacro( catalog ))
+      {
+         result.message = _("The macro failed");
+         return false;
+      }
+      return true;
+   } );
+   result.seconds = timer.Time() / 1000.0;
+
+   ProjectManager::Get( project ).ResetProjectToEmpty();
+   return result;
+}
+
+bool BatchWorkers::WriteResults( const FilePath &path, const Results &results )
+{
+   wxTextFile tf( path );
+   if (tf.Exists())
+      tf.Open();
+   else
+      tf.Create();
+   if (!tf.IsOpened())
+      return false;
+
+   tf.Clear();
+   for (const auto &result : results)
+   {
+      auto message = result.message;
+      message.Replace( wxT("\t"), wxT(" ") );
+      message.Replace( wxT("\n"), wxT(" ") );
+      tf.AddLine( wxString::Format( wxT("%s\t%s\t%.3f\t%s"),
+         result.file,
+         result.success ? wxT("ok") : wxT("failed"),
+         result.seconds,
+         message ) );
+   }
+
+   return tf.Write() && tf.Close();
+}
+
+bool BatchWorkers::ReadResults( const FilePath &path, Results &results )
+{
+   results.clear();
+
+   wxTextFile tf( path );
+   if (!tf.Exists() || !tf.Open())
+      return false;
+
+   for (size_t ii = 0; ii < tf.GetLineCount(); ++ii)
+   {
+      auto fields = wxSplit( tf[ii], wxT('\t'), 0 );
+      if (fields.size() < 3)
+         continue;
+
+      Result result;
+      result.file = fields[0];
+      result.success = (fields[1] == wxT("ok"));
+      fields[2].ToCDouble( &result.seconds );
+      if (fields.size() > 3)
+         result.message = fields[3];
+      results.push_back( result );
+   }
+
+   return true;
+}
+
+FilePath BatchWorkers::WorkerTempDir( const FilePath &tempDir, unsigned long pid )
+{
+   return tempDir + wxFILE_SEP_PATH + wxString::Format( wxT("worker-%lu"), pid );
+}
+
+bool BatchWorkers::Main( AudacityProject &project, const wxString &macroName,
+   const FilePaths &files, size_t nWorkers, const FilePath &resultsPath,
+   bool isWorker, long timeoutSeconds )
+{
+   Results results;
+   if (isWorker || nWorkers <= 1)
+   {
+      MacroCommands commands{ project };
+      const bool haveMacro = commands.ReadMacro( macroName );
+      MacroCommandsCatalog catalog{ &project };
+      for (const auto &file : files)
+      {
+         if (!haveMacro)
+         {
+            Result result;
+            result.file = file;
+            result.message = _("No such macro");
+            results.push_back( result );
+            continue;
+         }
+         results.push_back(
+            ApplyToFile( project, commands, catalog, file ) );
+      }
+   }
+   else
+   {
+      BatchWorkers workers{ macroName, nWorkers, timeoutSeconds };
+      results = workers.Run( files,
+         [&]( size_t index, const Result &result ) {
+            wxPrintf( wxT("[%lu/%lu] %s: %s\n"),
+               (unsigned long)index + 1, (unsigned long)files.size(),
+               result.file, result.success ? wxT("ok") : result.message );
+            return true;
+         } );
+   }
+
+   if (!resultsPath.empty())
+      WriteResults( resultsPath, results );
+   else if (!isWorker)
+   {
+      for (const auto &result : results)
+         wxPrintf( wxT("%s\t%s\t%.3f\t%s\n"),
+            result.file,
+            result.success ? wxT("ok") : wxT("failed"),
+            result.seconds,
+            result.message );
+   }
+
+   return std::all_of( results.begin(), results.end(),
+      []( const Result &result ){ return result.success; } );
+}
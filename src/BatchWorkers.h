@@ -0,0 +1,76 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BatchWorkers.h
+
+  Applies a macro to many files at once, in several Audacity processes.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BATCH_WORKERS__
+#define __AUDACITY_BATCH_WORKERS__
+
+#include "audacity/Types.h"
+
+#include <functional>
+#include <vector>
+
+class AudacityProject;
+class MacroCommands;
+class MacroCommandsCatalog;
+
+class BatchWorkers final {
+public:
+   // What became of one file
+   struct Result {
+      FilePath file;
+      bool success{ false };
+      double seconds{ 0.0 };
+      wxString message; // why it failed
+   };
+   using Results = std::vector< Result >;
+
+   // Called on the main thread as each file is done; return false to start
+   // no more files
+   using Callback = std::function< bool( size_t index, const Result & ) >;
+
+   // A worker still running after timeoutSeconds is killed, and its file
+   // fails; zero means no limit
+   BatchWorkers( const wxString &macroName, size_t nWorkers,
+      long timeoutSeconds = 0 );
+
+   // Start a worker process for each file, with at most nWorkers running
+   // at once.  A worker that fails, crashes or hangs spoils only its own
+   // file.
+   Results Run( const FilePaths &files, const Callback &callback = {} );
+
+   // Import the file into the empty project, apply the macro (which may
+   // export), and empty the project again
+   static Result ApplyToFile( AudacityProject &project,
+      MacroCommands &commands, const MacroCommandsCatalog &catalog,
+      const FilePath &file );
+
+   // One line for each file: path, "ok" or "failed", seconds, and message,
+   // separated by tabs
+   static bool WriteResults( const FilePath &path, const Results &results );
+   static bool ReadResults( const FilePath &path, Results &results );
+
+   // Each worker keeps its blocks in its own subdirectory of the temporary
+   // directory, and needs no lock on the temporary directory
+   static FilePath WorkerTempDir( const FilePath &tempDir, unsigned long pid );
+
+   // For the command line:  apply the macro to the files, in this process if
+   // isWorker or nWorkers is 1, and write results to resultsPath, or
+   // standard output if it is empty.  Returns whether all files succeeded.
+   static bool Main( AudacityProject &project, const wxString &macroName,
+      const FilePaths &files, size_t nWorkers, const FilePath &resultsPath,
+      bool isWorker, long timeoutSeconds = 0 );
+
+private:
+   wxString mMacroName;
+   size_t mnWorkers;
+   long mTimeoutSeconds;
+};
+
+#endif
@@ -10,7 +10,7 @@
 
 \class BenchmarkDialog
 \brief BenchmarkDialog is used for measuring performance and accuracy
-of the BlockFile system.
+of the BlockFile system, and of the preparation of tracks for playback.
 
 *//*******************************************************************/
 
@@ -34,7 +34,10 @@ of the BlockFile system.
 #include <wx/valtext.h>
 #include <wx/intl.h>
 
+#include "AudioIO.h"
 #include "DirManager.h"
+#include "Envelope.h"
+#include "Mix.h"
 #include "ShuttleGui.h"
 #include "Project.h"
 #include "WaveClip.h"
@@ -42,7 +45,11 @@ of the BlockFile system.
 #include "Sequence.h"
 #include "Prefs.h"
 #include "ProjectSettings.h"
+#include "TimeTrack.h"
 #include "ViewInfo.h"
+#include "WorkerPool.h"
+#include "xml/XMLFileReader.h"
+#include "xml/XMLWriter.h"
 
 #include "FileNames.h"
 #include "widgets/AudacityMessageBox.h"
@@ -59,6 +66,8 @@ public:
 private:
    // WDR: handler declarations
    void OnRun( wxCommandEvent &event );
+   void OnMixTest( wxCommandEvent &event );
+   void OnStorageTest( wxCommandEvent &event );
    void OnSave( wxCommandEvent &event );
    void OnClear( wxCommandEvent &event );
    void OnClose( wxCommandEvent &event );
@@ -121,11 +130,15 @@ enum {
    BlockSizeID,
    DataSizeID,
    NumEditsID,
-   RandSeedID
+   RandSeedID,
+   MixTestID,
+   StorageTestID
 };
 
 BEGIN_EVENT_TABLE(BenchmarkDialog, wxDialogWrapper)
    EVT_BUTTON( RunID,   BenchmarkDialog::OnRun )
+   EVT_BUTTON( MixTestID, BenchmarkDialog::OnMixTest )
+   EVT_BUTTON( StorageTestID, BenchmarkDialog::OnStorageTest )
    EVT_BUTTON( BSaveID,  BenchmarkDialog::OnSave )
    EVT_BUTTON( ClearID, BenchmarkDialog::OnClear )
    EVT_BUTTON( wxID_CANCEL, BenchmarkDialog::OnClose )
@@ -233,6 +246,8 @@ void BenchmarkDialog::MakeBenchmarkDialog()
          S.StartHorizontalLay(wxALIGN_LEFT, false);
          {
             S.Id(RunID).AddButton(XO("Run"), wxALIGN_CENTRE, true);
+            S.Id(MixTestID).AddButton(XO("Mixing Test"));
+            S.Id(StorageTestID).AddButton(XO("Storage Test"));
             S.Id(BSaveID).AddButton(XO("Save"));
             /* i18n-hint verb; to empty or erase */
             S.Id(ClearID).AddButton(XO("Clear"));
@@ -501,7 +516,7 @@ void BenchmarkDialog::OnRun( wxCommandEvent & WXUNUSED(event))
    elapsed = timer.Time();
 
    if (mBlockDetail) {
-      auto seq = t->GetClipByIndex(0)->GetSequence();
+      const Sequence *seq = t->GetClipByIndex(0)->GetSequence();
       seq->DebugPrintf(seq->GetBlockArray(), seq->GetNumSamples(), &tempStr);
       mToPrint += tempStr;
    }
@@ -576,3 +591,289 @@ void BenchmarkDialog::OnRun( wxCommandEvent & WXUNUSED(event))
    Printf( XO("Benchmark completed successfully.\n") );
    HoldPrint(false);
 }
+
+void BenchmarkDialog::OnMixTest( wxCommandEvent & WXUNUSED(event))
+{
+   // A stress test of AudioIO::FillBuffers: find how many tracks, each
+   // resampled and warped by a time track, can be prepared for playback
+   // faster than real time.  Slower than that, playback would underrun.
+   const double outRate = 44100.0;
+   const double trackRate = 48000.0;
+   const double trackSecs = 4.0;
+   const double testSecs = 2.0;
+   const size_t chunk = outRate / 4;
+   const size_t nSources = 8;
+   const size_t maxTracks = 256;
+
+   wxBusyCursor busy;
+
+   HoldPrint(true);
+
+   ZoomInfo zoomInfo(0.0, ZoomInfo::GetDefaultZoom());
+   auto dd = DirManager::Create();
+   TrackFactory factory{ mSettings, dd, &zoomInfo };
+
+   Printf( XO("Preparing %d tracks of noise at %.0f Hz...\n")
+      .Format( (int)nSources, trackRate ) );
+   FlushPrint();
+   wxTheApp->Yield();
+
+   // Mixers of more tracks than this mix copies of the sources
+   std::vector< std::shared_ptr< WaveTrack > > sources;
+   {
+      const auto len = (size_t)(trackSecs * trackRate);
+      Floats noise{ len };
+      for (size_t ii = 0; ii < nSources; ++ii) {
+         for (size_t jj = 0; jj < len; ++jj)
+            noise[jj] = rand() / (float)RAND_MAX - 0.5f;
+         auto track = factory.NewWaveTrack(floatSample, trackRate);
+         track->Append((samplePtr)noise.get(), floatSample, len);
+         track->Flush();
+         sources.push_back(track);
+      }
+   }
+
+   const auto timeTrack = factory.NewTimeTrack();
+   timeTrack->GetEnvelope()->InsertOrReplace(0.0, 0.9);
+   timeTrack->GetEnvelope()->InsertOrReplace(trackSecs, 1.1);
+
+   // Returns the speed of preparing nTracks, relative to real time
+   auto trial = [&]( size_t nTracks, WorkerPool *pPool ) {
+      // As in AudioIO, each mixer has its own copy of the envelope, and
+      // its own track, because reading a track is not thread-safe; the
+      // copies share the sample blocks
+      std::vector< std::unique_ptr< BoundedEnvelope > > envelopes;
+      std::vector< std::shared_ptr< WaveTrack > > tracks;
+      std::vector< std::unique_ptr< Mixer > > mixers;
+      for (size_t ii = 0; ii < nTracks; ++ii) {
+         envelopes.push_back(
+            std::make_unique< BoundedEnvelope >( *timeTrack->GetEnvelope() ) );
+         tracks.push_back( std::static_pointer_cast< WaveTrack >(
+            sources[ii % nSources]->Duplicate() ) );
+         mixers.push_back( std::make_unique< Mixer >(
+            WaveTrackConstArray{ tracks.back() }, false,
+            Mixer::WarpOptions( envelopes.back().get() ),
+            0.0, trackSecs, 1, chunk, false, outRate, floatSample, false ) );
+         mixers.back()->ApplyTrackGains(false);
+      }
+
+      const auto process = [&]( size_t ii ){ mixers[ii]->Process( chunk ); };
+      const auto total = (size_t)(testSecs * outRate);
+      wxStopWatch timer;
+      for (size_t done = 0; done < total; done += chunk) {
+         if (pPool)
+            pPool->ParallelFor( nTracks, process );
+         else
+            for (size_t ii = 0; ii < nTracks; ++ii)
+               process( ii );
+      }
+      const auto elapsed = std::max( 1L, timer.Time() );
+      const double speed = testSecs * 1000.0 / elapsed;
+
+      Printf( XO("   %d tracks: %.2f times real time\n")
+         .Format( (int)nTracks, speed ) );
+      FlushPrint();
+      wxTheApp->Yield();
+      return speed;
+   };
+
+   // Double the track count until too slow, then bisect
+   auto findMaximum = [&]( WorkerPool *pPool ) {
+      size_t good = 0, bad = 0;
+      for (size_t nTracks = 1; nTracks <= maxTracks; nTracks *= 2) {
+         if (trial( nTracks, pPool ) < 1.0) {
+            bad = nTracks;
+            break;
+         }
+         good = nTracks;
+      }
+      while (bad > good + 1) {
+         const auto nTracks = (good + bad) / 2;
+         if (trial( nTracks, pPool ) < 1.0)
+            bad = nTracks;
+         else
+            good = nTracks;
+      }
+      return good;
+   };
+
+   Printf( XO("Output at %.0f Hz, warped by a time track, %.1f seconds per trial.\n")
+      .Format( outRate, testSecs ) );
+
+   Printf( XO("One thread:\n") );
+   const auto serial = findMaximum( nullptr );
+
+   const auto nThreads = AudioIO::GetPlaybackMixingThreads();
+   size_t parallel = serial;
+   if (nThreads > 1) {
+      Printf( XO("%d threads:\n").Format( (int)nThreads ) );
+      WorkerPool pool{ nThreads - 1 };
+      parallel = findMaximum( &pool );
+   }
+
+   Printf( XO("Maximum number of tracks before underrun, with one thread: %d\n")
+      .Format( (int)serial ) );
+   if (nThreads > 1)
+      Printf( XO("Maximum number of tracks before underrun, with %d threads: %d\n")
+         .Format( (int)nThreads, (int)parallel ) );
+   if (serial == maxTracks || parallel == maxTracks)
+      Printf( XO("(The test stops at %d tracks.)\n").Format( (int)maxTracks ) );
+
+   Printf( XO("Benchmark completed successfully.\n") );
+   HoldPrint(false);
+}
+
+void BenchmarkDialog::OnStorageTest( wxCommandEvent & WXUNUSED(event))
+{
+   // Compare block files, one file each, with packed blocks, in
+   // containers of many:
+   //  "save" moves the data of a new project out of temporary storage,
+   //  "save as" copies them to another folder, "open" loads the blocks
+   //  again from the XML of the track and then lists the folder to find
+   //  orphans as ProjectFSCK does, and "read" reads all samples back.
+   TransferDataFromWindow();
+
+   if (!Validate())
+      return;
+
+   long blockSize, dataSize;
+   mBlockSizeStr.ToLong(&blockSize);
+   mDataSizeStr.ToLong(&dataSize);
+
+   if (blockSize < 1 || blockSize > 1024) {
+      AudacityMessageBox(
+         XO("Block size should be in the range 1 - 1024 KB.") );
+      return;
+   }
+
+   if (dataSize < 1 || dataSize > 2000) {
+      AudacityMessageBox(
+         XO("Test data size should be in the range 1 - 2000 MB.") );
+      return;
+   }
+
+   auto oldBlockSize = Sequence::GetMaxDiskBlockSize();
+   Sequence::SetMaxDiskBlockSize(blockSize * 1024);
+   const auto cleanup = finally( [&] {
+      Sequence::SetMaxDiskBlockSize(oldBlockSize);
+   } );
+
+   wxBusyCursor busy;
+
+   HoldPrint(true);
+
+   const size_t chunk = 65536;
+   const size_t nSamples = dataSize * 1048576 / sizeof(float);
+   Floats noise{ chunk };
+   for (size_t ii = 0; ii < chunk; ++ii)
+      noise[ii] = rand() / (float)RAND_MAX - 0.5f;
+
+   Printf( XO("%ld MB of samples in blocks of up to %ld KB.\n")
+      .Format( dataSize, blockSize ) );
+   FlushPrint();
+   wxTheApp->Yield();
+
+   auto trial = [&]( bool packed ) {
+      const auto dir = FileNames::TempDir();
+      FilePath projPath = dir;
+      const auto saveName = wxT("benchmark-save_data");
+      const auto saveAsName = wxT("benchmark-saveas_data");
+      const auto xmlPath =
+         dir + wxFILE_SEP_PATH + wxT("benchmark-track.xml");
+
+      // The files of the blocks are removed here, not by the blocks
+      const auto removeAll = finally( [&] {
+         for (auto name : { saveName, saveAsName })
+            DirManager::CleanDir( dir + wxFILE_SEP_PATH + name,
+               wxEmptyString, wxEmptyString,
+               XO("Cleaning up benchmark files"), kCleanTopDirToo );
+         wxRemoveFile( xmlPath );
+      } );
+
+      ZoomInfo zoomInfo(0.0, ZoomInfo::GetDefaultZoom());
+      auto dd = DirManager::Create();
+      dd->SetPackedBlockFiles( packed );
+      const auto track =
+         TrackFactory{ mSettings, dd, &zoomInfo }.NewWaveTrack(floatSample);
+
+      wxStopWatch timer;
+      for (size_t done = 0; done < nSamples; done += chunk)
+         track->Append( (samplePtr)noise.get(), floatSample,
+            std::min( chunk, nSamples - done ) );
+      track->Flush();
+      const auto writeTime = timer.Time();
+
+      const auto nFiles = dd->NumBlockFiles();
+
+      timer.Start();
+      if (!dd->SetProject( projPath, saveName, true )) {
+         Printf( XO("Save failed.\n") );
+         return;
+      }
+      const auto saveTime = timer.Time();
+
+      timer.Start();
+      {
+         DirManager::ProjectSetter setter{
+            *dd, projPath, saveAsName, true, false };
+         if (!setter.Ok()) {
+            Printf( XO("Save As failed.\n") );
+            track->CloseLock();
+            return;
+         }
+         setter.Commit();
+      }
+      const auto saveAsTime = timer.Time();
+
+      {
+         XMLFileWriter writer{ xmlPath, XO("Error Writing Benchmark File") };
+         track->WriteXML( writer );
+         writer.Commit();
+      }
+
+      timer.Start();
+      auto dd2 = DirManager::Create();
+      dd2->SetProject( projPath, saveAsName, false );
+      const auto track2 = TrackFactory{ mSettings, dd2, &zoomInfo }
+         .NewWaveTrack();
+      XMLFileReader reader;
+      const bool loaded = reader.Parse( track2.get(), xmlPath );
+      FilePaths files, orphans;
+      DirManager::RecursivelyEnumerate( dd2->GetDataFilesDir(),
+         files, wxEmptyString, wxEmptyString, true, false );
+      dd2->FindOrphanBlockFiles( files, orphans );
+      const auto openTime = timer.Time();
+
+      timer.Start();
+      Floats buffer{ chunk };
+      bool same = loaded;
+      for (size_t done = 0; done < nSamples; done += chunk) {
+         const auto len = std::min( chunk, nSamples - done );
+         track2->Get( (samplePtr)buffer.get(), floatSample, done, len );
+         same = same &&
+            std::equal( buffer.get(), buffer.get() + len, noise.get() );
+      }
+      const auto readTime = timer.Time();
+
+      // Don't let the blocks remove files; removeAll does that
+      track->CloseLock();
+      track2->CloseLock();
+
+      Printf( packed
+         ? XO("Packed blocks (%d files):\n")
+            .Format( (int)files.size() )
+         : XO("One file per block (%d files):\n")
+            .Format( (int)nFiles ) );
+      Printf( XO("   write %ld ms, save %ld ms, save as %ld ms, open %ld ms, read %ld ms%s\n")
+         .Format( writeTime, saveTime, saveAsTime, openTime, readTime,
+            same ? wxT("") : wxT(", DATA DIFFER") ) );
+      FlushPrint();
+      wxTheApp->Yield();
+   };
+
+   trial( false );
+   trial( true );
+
+   Printf( XO("Benchmark completed successfully.\n") );
+   HoldPrint(false);
+}
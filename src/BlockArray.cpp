@@ -0,0 +1,298 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockArray.cpp
+
+*******************************************************************//**
+
+\class BlockArray
+\brief The blocks of a Sequence, in a persistent balanced tree.
+
+  With tens of thousands of blocks in a long track, a plain vector made
+  every edit in the middle cost time in proportion to the whole track:
+  the blocks after the edit had their starts shifted, the array was
+  copied to give the strong guarantee, and each undo state copied it
+  again.
+
+  Instead the blocks are the nodes of a treap, a binary search tree by
+  position that is balanced by random priorities.  Each node stores the
+  number of blocks and of samples in its subtree, so that starts need
+  not be stored, and any block or sample is found by descending from the
+  root.  Nodes are never changed after construction; splitting, joining
+  and replacing make NEW nodes only along one path, and share the rest.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BlockArray.h"
+
+#include "BlockFile.h"
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+
+struct BlockArray::Node {
+   Node(const BlockFilePtr &f_, unsigned priority_)
+      : f{ f_ }
+      , length{ f_->GetLength() }
+      , priority{ priority_ }
+   {
+      Update();
+   }
+
+   // Copy the block and priority of another, with other children
+   Node(const Node &other, const NodePtr &left_, const NodePtr &right_)
+      : f{ other.f }
+      , left{ left_ }
+      , right{ right_ }
+      , length{ other.length }
+      , priority{ other.priority }
+   {
+      Update();
+   }
+
+   void Update()
+   {
+      count = 1;
+      samples = length;
+      maxLength = length;
+      for (auto pChild : { left.get(), right.get() })
+         if (pChild) {
+            count += pChild->count;
+            samples += pChild->samples;
+            maxLength = std::max(maxLength, pChild->maxLength);
+         }
+   }
+
+   BlockFilePtr f;
+   NodePtr left, right;
+
+   size_t length;
+   // Parents have priorities not less than those of their children
+   unsigned priority;
+
+   // Totals for the subtree
+   size_t count;
+   sampleCount samples;
+   size_t maxLength;
+};
+
+namespace {
+
+unsigned NewPriority()
+{
+   // Blocks may be made on several threads
+   thread_local std::minstd_rand engine{ static_cast<unsigned>(
+      std::hash< std::thread::id >{}( std::this_thread::get_id() ) ) };
+   return engine();
+}
+
+}
+
+size_t BlockArray::size() const
+{
+   return mRoot ? mRoot->count : 0;
+}
+
+sampleCount BlockArray::GetNumSamples() const
+{
+   return mRoot ? mRoot->samples : sampleCount{ 0 };
+}
+
+size_t BlockArray::GetMaxBlockLength() const
+{
+   return mRoot ? mRoot->maxLength : 0;
+}
+
+SeqBlock BlockArray::operator [] (size_t index) const
+{
+   wxASSERT(index < size());
+   sampleCount start = 0;
+   auto pNode = mRoot.get();
+   while (true) {
+      const auto leftCount = pNode->left ? pNode->left->count : 0;
+      if (index < leftCount)
+         pNode = pNode->left.get();
+      else {
+         if (pNode->left)
+            start += pNode->left->samples;
+         if (index == leftCount)
+            return { pNode->f, start };
+         start += pNode->length;
+         index -= leftCount + 1;
+         pNode = pNode->right.get();
+      }
+   }
+}
+
+size_t BlockArray::FindBlock(sampleCount pos) const
+{
+   wxASSERT(pos >= 0 && pos < GetNumSamples());
+   size_t index = 0;
+   auto pNode = mRoot.get();
+   while (true) {
+      const auto leftSamples =
+         pNode->left ? pNode->left->samples : sampleCount{ 0 };
+      if (pos < leftSamples)
+         pNode = pNode->left.get();
+      else {
+         const auto leftCount = pNode->left ? pNode->left->count : 0;
+         pos -= leftSamples;
+         if (pos < pNode->length || !pNode->right)
+            return index + leftCount;
+         pos -= pNode->length;
+         index += leftCount + 1;
+         pNode = pNode->right.get();
+      }
+   }
+}
+
+void BlockArray::push_back(const BlockFilePtr &f)
+{
+   mRoot = Merge(mRoot, std::make_shared< const Node >(f, NewPriority()));
+}
+
+void BlockArray::pop_back()
+{
+   Truncate(size() - 1);
+}
+
+void BlockArray::SetFile(size_t index, const BlockFilePtr &f)
+{
+   wxASSERT(index < size());
+   mRoot = Replace(mRoot, index, f);
+}
+
+BlockArray BlockArray::Slice(size_t from, size_t to) const
+{
+   to = std::min(to, size());
+   if (from >= to)
+      return {};
+   return BlockArray{ Split(Split(mRoot, to).first, from).second };
+}
+
+void BlockArray::Append(const BlockArray &other)
+{
+   mRoot = Merge(mRoot, other.mRoot);
+}
+
+void BlockArray::Append(const std::vector< BlockFilePtr > &files)
+{
+   // Give the larger priorities to the nodes nearer the root of a complete
+   // tree, which is then a treap, as if made by pushing back each file
+   std::vector< unsigned > priorities;
+   priorities.reserve(files.size());
+   for (size_t ii = 0; ii < files.size(); ++ii)
+      priorities.push_back(NewPriority());
+   std::sort(priorities.begin(), priorities.end(), std::greater<unsigned>{});
+
+   size_t next = 0;
+   mRoot = Merge(mRoot, Build(files, priorities, 0, next));
+}
+
+void BlockArray::Truncate(size_t count)
+{
+   mRoot = Split(mRoot, count).first;
+}
+
+auto BlockArray::MakeNode(const Node &node,
+   const NodePtr &left, const NodePtr &right) -> NodePtr
+{
+   return std::make_shared< const Node >(node, left, right);
+}
+
+auto BlockArray::Merge(const NodePtr &left, const NodePtr &right) -> NodePtr
+{
+   if (!left)
+      return right;
+   if (!right)
+      return left;
+   if (left->priority >= right->priority)
+      return MakeNode(*left, left->left, Merge(left->right, right));
+   else
+      return MakeNode(*right, Merge(left, right->left), right->right);
+}
+
+auto BlockArray::Split(const NodePtr &pNode, size_t count)
+   -> std::pair< NodePtr, NodePtr >
+{
+   if (!pNode)
+      return {};
+   if (count == 0)
+      return { {}, pNode };
+   if (count >= pNode->count)
+      return { pNode, {} };
+
+   const auto leftCount = pNode->left ? pNode->left->count : 0;
+   if (count <= leftCount) {
+      auto pair = Split(pNode->left, count);
+      return { pair.first, MakeNode(*pNode, pair.second, pNode->right) };
+   }
+   else {
+      auto pair = Split(pNode->right, count - leftCount - 1);
+      return { MakeNode(*pNode, pNode->left, pair.first), pair.second };
+   }
+}
+
+auto BlockArray::Replace(
+   const NodePtr &pNode, size_t index, const BlockFilePtr &f) -> NodePtr
+{
+   const auto leftCount = pNode->left ? pNode->left->count : 0;
+   if (index < leftCount)
+      return MakeNode(*pNode, Replace(pNode->left, index, f), pNode->right);
+   else if (index > leftCount)
+      return MakeNode(*pNode, pNode->left,
+         Replace(pNode->right, index - leftCount - 1, f));
+   else {
+      auto result = std::make_shared< Node >(f, pNode->priority);
+      result->left = pNode->left;
+      result->right = pNode->right;
+      result->Update();
+      return result;
+   }
+}
+
+auto BlockArray::Build(const std::vector< BlockFilePtr > &files,
+   const std::vector< unsigned > &priorities, size_t index, size_t &next)
+   -> NodePtr
+{
+   if (index >= files.size())
+      return {};
+   // In order:  the left subtree, this node, the right subtree
+   auto left = Build(files, priorities, 2 * index + 1, next);
+   auto result = std::make_shared< Node >(files[next++], priorities[index]);
+   result->left = std::move(left);
+   result->right = Build(files, priorities, 2 * index + 2, next);
+   result->Update();
+   return result;
+}
+
+auto BlockArray::begin() const -> const_iterator
+{
+   const_iterator result;
+   result.Descend(mRoot.get());
+   return result;
+}
+
+void BlockArray::const_iterator::Descend(const Node *pNode)
+{
+   for (; pNode; pNode = pNode->left.get())
+      mStack.push_back(pNode);
+}
+
+SeqBlock BlockArray::const_iterator::operator * () const
+{
+   return { mStack.back()->f, mStart };
+}
+
+auto BlockArray::const_iterator::operator ++ () -> const_iterator &
+{
+   const auto pNode = mStack.back();
+   mStack.pop_back();
+   mStart += pNode->length;
+   Descend(pNode->right.get());
+   return *this;
+}
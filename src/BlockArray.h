@@ -0,0 +1,130 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockArray.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_ARRAY__
+#define __AUDACITY_BLOCK_ARRAY__
+
+#include "audacity/Types.h"
+
+#include <memory>
+#include <vector>
+
+class BlockFile;
+using BlockFilePtr = std::shared_ptr<BlockFile>;
+
+// This is an internal data structure!  For advanced use only.
+class SeqBlock {
+ public:
+   BlockFilePtr f;
+   ///the sample in the global wavetrack that this block starts at.
+   sampleCount start;
+
+   SeqBlock()
+      : f{}, start(0)
+   {}
+
+   SeqBlock(const BlockFilePtr &f_, sampleCount start_)
+      : f(f_), start(start_)
+   {}
+};
+
+// The blocks of a Sequence, in order.  The start of each block is not
+// stored but is the total length of the blocks before it, so inserting
+// or removing blocks never shifts the others.
+//
+// The blocks are kept in a balanced tree of immutable nodes, shared by
+// copies of the array, so that copying is constant time, and lookup,
+// splitting and joining are logarithmic in the number of blocks.
+// Undo states of a long track share all but the edited paths.
+//
+// Elements are returned by value; use SetFile() to replace one.
+class BlockArray {
+   struct Node;
+   using NodePtr = std::shared_ptr< const Node >;
+
+ public:
+   BlockArray() = default;
+
+   size_t size() const;
+   bool empty() const { return !mRoot; }
+   // Total length of the blocks
+   sampleCount GetNumSamples() const;
+   // Length of the longest block
+   size_t GetMaxBlockLength() const;
+
+   // Logarithmic time
+   SeqBlock operator [] (size_t index) const;
+   SeqBlock front() const { return (*this)[0]; }
+   SeqBlock back() const { return (*this)[size() - 1]; }
+
+   // Index of the block containing the sample; pos must be nonnegative
+   // and less than GetNumSamples()
+   size_t FindBlock(sampleCount pos) const;
+
+   // Lengths of the files are taken when they are added
+   void push_back(const BlockFilePtr &f);
+   void pop_back();
+   void SetFile(size_t index, const BlockFilePtr &f);
+
+   // Blocks from index from up to but excluding to, sharing structure
+   BlockArray Slice(size_t from, size_t to) const;
+   // Append blocks of another array, sharing structure
+   void Append(const BlockArray &other);
+   // Append many files in linear time, rather than push_back() each
+   void Append(const std::vector< BlockFilePtr > &files);
+   // Keep only the first count blocks
+   void Truncate(size_t count);
+
+   void swap(BlockArray &other) { mRoot.swap(other.mRoot); }
+   void clear() { mRoot.reset(); }
+
+   // Visits the blocks in order in amortized constant time each
+   class const_iterator {
+    public:
+      SeqBlock operator * () const;
+      const_iterator &operator ++ ();
+      bool operator == (const const_iterator &other) const
+         { return Top() == other.Top(); }
+      bool operator != (const const_iterator &other) const
+         { return !(*this == other); }
+
+    private:
+      friend BlockArray;
+      const Node *Top() const
+         { return mStack.empty() ? nullptr : mStack.back(); }
+      void Descend(const Node *pNode);
+
+      // Path from the root to the current node, excluding nodes whose
+      // blocks were already visited
+      std::vector< const Node* > mStack;
+      sampleCount mStart{ 0 };
+   };
+
+   const_iterator begin() const;
+   const_iterator end() const { return {}; }
+
+ private:
+   explicit BlockArray(const NodePtr &root) : mRoot{ root } {}
+
+   static NodePtr MakeNode(const Node &node,
+      const NodePtr &left, const NodePtr &right);
+   static NodePtr Merge(const NodePtr &left, const NodePtr &right);
+   // First count blocks, and the rest
+   static std::pair< NodePtr, NodePtr > Split(
+      const NodePtr &pNode, size_t count);
+   static NodePtr Replace(
+      const NodePtr &pNode, size_t index, const BlockFilePtr &f);
+   // The subtree at index of a complete binary tree of the files, taken in
+   // order from next; the priorities are in the same breadth first order
+   static NodePtr Build(const std::vector< BlockFilePtr > &files,
+      const std::vector< unsigned > &priorities, size_t index, size_t &next);
+
+   NodePtr mRoot;
+};
+
+#endif
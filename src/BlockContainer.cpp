@@ -0,0 +1,401 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockContainer.cpp
+
+*******************************************************************//**
+
+\class BlockContainer
+\brief An append-only file of the data of many blocks.
+
+  A long project kept as SimpleBlockFiles is tens of thousands of files
+  of about a megabyte each, and opening, saving as, copying and checking
+  it take as long as the file system takes to visit them all, which is
+  long indeed on network storage.  With the preference
+  /Directories/PackedBlockFiles, DirManager instead appends the data of
+  NEW blocks to a container in the _data folder, and the project file
+  names the container and the offset of each block; see PackedBlockFile.
+
+  Each extent is a small header, then the summary, then the samples in
+  their own format, as a SimpleBlockFile would write them after its .au
+  header.  The header repeats the format and length, so that a damaged
+  file or a wrong offset is detected when the summary is read.
+
+  Bytes are never rewritten.  When no block uses an extent any more, its
+  bytes are garbage, and Compact() copies what is still used to a NEW
+  container, leaving the old one to be discarded after the project is
+  saved.
+
+\class BlockExtent
+\brief The location and size in a BlockContainer of the data of a block.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BlockContainer.h"
+
+#include "BlockFile.h"
+#include "FileException.h"
+
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct ExtentHeader {
+   char magic[4];
+   wxUint32 format;
+   wxUint64 samples;
+};
+
+const char ExtentMagic[4] = { 'A', 'u', 'P', 'k' };
+
+}
+
+const wxChar *const BlockContainer::Extension = wxT("aupk");
+
+BlockExtent::BlockExtent(const std::shared_ptr< BlockContainer > &pContainer,
+   wxFileOffset offset, sampleFormat format, size_t samples)
+   : mpContainer{ pContainer }
+   , mOffset{ offset }
+   , mFormat{ format }
+   , mSamples{ samples }
+   , mSummaryBytes{ SummaryInfo{ samples }.totalSummaryBytes }
+{
+}
+
+BlockExtent::~BlockExtent()
+{
+   auto location = GetLocation();
+   location.pContainer->Forget(*this, location.offset);
+}
+
+auto BlockExtent::GetLocation() const -> Location
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return { mpContainer, mOffset };
+}
+
+size_t BlockExtent::GetBytes() const
+{
+   return sizeof(ExtentHeader) + mSummaryBytes +
+      mSamples * SAMPLE_SIZE(mFormat);
+}
+
+std::shared_ptr< BlockContainer > BlockContainer::Open(const FilePath &path)
+{
+   if (!wxFileExists(path)) {
+      wxFFile file{ path, wxT("wb") };
+      if (!file.IsOpened())
+         return {};
+   }
+
+   // Private constructor
+   std::shared_ptr< BlockContainer > result{ safenew BlockContainer{ path } };
+   result->mFileSize = wxFileName::GetSize(path).GetValue();
+   return result;
+}
+
+BlockContainer::BlockContainer(const FilePath &path)
+   : mPath{ path }
+{
+}
+
+BlockContainer::~BlockContainer()
+{
+   mAppendFile.Close();
+   mpReadFile.reset();
+   if (!mRetained && !mDiscarded)
+      wxRemoveFile(mPath);
+}
+
+FilePath BlockContainer::GetPath() const
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mPath;
+}
+
+void BlockContainer::SetPath(const FilePath &path)
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mAppendFile.Close();
+   mpReadFile.reset();
+   mPath = path;
+}
+
+BlockExtentPtr BlockContainer::Append(sampleFormat format, size_t samples,
+   const void *summary, size_t summaryBytes, samplePtr sampleData)
+{
+   ExtentHeader header;
+   memcpy(header.magic, ExtentMagic, sizeof(header.magic));
+   header.format = format;
+   header.samples = samples;
+
+   const auto sampleBytes = samples * SAMPLE_SIZE(format);
+
+   std::unique_lock< std::mutex > lock{ mMutex };
+   if (!mAppendFile.IsOpened() && !mAppendFile.Open(mPath, wxT("ab")))
+      throw FileException{ FileException::Cause::Open, mPath };
+
+   const auto offset = mFileSize;
+   const bool ok =
+      mAppendFile.Write(&header, sizeof(header)) == sizeof(header) &&
+      mAppendFile.Write(summary, summaryBytes) == summaryBytes &&
+      mAppendFile.Write(sampleData, sampleBytes) == sampleBytes &&
+      // So that the other handle can read it
+      mAppendFile.Flush();
+   if (!ok) {
+      // What was written of this extent is garbage, but later appends go
+      // after it
+      mAppendFile.Close();
+      mFileSize = wxFileName::GetSize(mPath).GetValue();
+      throw FileException{ FileException::Cause::Write, mPath };
+   }
+
+   auto result = std::make_shared< BlockExtent >(
+      shared_from_this(), offset, format, samples);
+   mFileSize += result->GetBytes();
+   mLiveBytes += result->GetBytes();
+   mExtents[offset] = result;
+   return result;
+}
+
+BlockExtentPtr BlockContainer::GetExtent(
+   wxFileOffset offset, sampleFormat format, size_t samples)
+{
+   const wxFileOffset bytes = sizeof(ExtentHeader) +
+      SummaryInfo{ samples }.totalSummaryBytes + samples * SAMPLE_SIZE(format);
+
+   std::lock_guard< std::mutex > lock{ mMutex };
+   if (offset < 0 || offset + bytes > mFileSize)
+      return {};
+
+   auto &wExtent = mExtents[offset];
+   if (auto pExtent = wExtent.lock())
+      // Another block of the project file has the same data
+      return pExtent;
+
+   auto pExtent = std::make_shared< BlockExtent >(
+      shared_from_this(), offset, format, samples);
+   wExtent = pExtent;
+   mLiveBytes += bytes;
+   return pExtent;
+}
+
+bool BlockContainer::Read(wxFileOffset offset, void *data, size_t bytes)
+{
+   // Hold the lock only to find the handle.  Reads give their own offsets,
+   // so that threads reading blocks of the same container don't wait for
+   // each other, and a handle closed meanwhile by SetPath() or Discard()
+   // stays open until the read is done.
+   std::shared_ptr< wxFile > pFile;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      if (!mpReadFile) {
+         wxLogNull silence;
+         auto pNewFile = std::make_shared< wxFile >();
+         if (!pNewFile->Open(mPath))
+            return false;
+         mpReadFile = pNewFile;
+      }
+      pFile = mpReadFile;
+   }
+
+   auto buffer = static_cast< char * >(data);
+   while (bytes > 0) {
+#if defined(__WXMSW__)
+      const auto hFile =
+         reinterpret_cast< HANDLE >(_get_osfhandle(pFile->fd()));
+      OVERLAPPED overlapped{};
+      overlapped.Offset = static_cast< DWORD >(offset);
+      overlapped.OffsetHigh = static_cast< DWORD >(
+         static_cast< unsigned long long >(offset) >> 32);
+      DWORD nRead = 0;
+      const auto toRead = static_cast< DWORD >(
+         std::min< size_t >(bytes, 1 << 30));
+      if (!ReadFile(hFile, buffer, toRead, &nRead, &overlapped) || nRead == 0)
+         return false;
+#else
+      const auto nRead = pread(pFile->fd(), buffer, bytes, offset);
+      if (nRead <= 0)
+         return false;
+#endif
+      buffer += nRead;
+      offset += nRead;
+      bytes -= nRead;
+   }
+   return true;
+}
+
+bool BlockContainer::ReadSummary(const BlockExtent &extent, void *data)
+{
+   const auto location = extent.GetLocation();
+   const auto summaryBytes = extent.GetSummaryBytes();
+
+   ArrayOf< char > buffer{ sizeof(ExtentHeader) + summaryBytes };
+   ExtentHeader header;
+   if (location.pContainer->Read(
+          location.offset, buffer.get(), sizeof(header) + summaryBytes)) {
+      memcpy(&header, buffer.get(), sizeof(header));
+      if (!memcmp(header.magic, ExtentMagic, sizeof(header.magic)) &&
+          header.format == (wxUint32)extent.GetFormat() &&
+          header.samples == extent.GetSamples()) {
+         memcpy(data, buffer.get() + sizeof(header), summaryBytes);
+         return true;
+      }
+   }
+
+   memset(data, 0, summaryBytes);
+   return false;
+}
+
+size_t BlockContainer::ReadSamples(const BlockExtent &extent,
+   samplePtr data, size_t start, size_t len)
+{
+   if (start >= extent.GetSamples())
+      return 0;
+   len = std::min(len, extent.GetSamples() - start);
+
+   const auto location = extent.GetLocation();
+   const auto sampleSize = SAMPLE_SIZE(extent.GetFormat());
+   const auto offset = location.offset + sizeof(ExtentHeader) +
+      extent.GetSummaryBytes() + start * sampleSize;
+   if (!location.pContainer->Read(offset, data, len * sampleSize))
+      return 0;
+   return len;
+}
+
+void BlockContainer::Forget(const BlockExtent &extent, wxFileOffset offset)
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   if (extent.mRetained)
+      mRetained = true;
+   mLiveBytes -= extent.GetBytes();
+   // GetExtent() may already have replaced the entry
+   auto iter = mExtents.find(offset);
+   if (iter != mExtents.end() && iter->second.expired())
+      mExtents.erase(iter);
+}
+
+wxFileOffset BlockContainer::GetFileSize() const
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mFileSize;
+}
+
+wxFileOffset BlockContainer::GetLiveBytes() const
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mLiveBytes;
+}
+
+bool BlockContainer::IsLocked() const
+{
+   // Release the extents only after unlocking the mutex, as they may
+   // call Forget()
+   std::vector< BlockExtentPtr > live;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      for (const auto &pair : mExtents)
+         if (auto pExtent = pair.second.lock())
+            live.push_back(pExtent);
+   }
+   return std::any_of(live.begin(), live.end(),
+      [](const BlockExtentPtr &pExtent){ return pExtent->IsLocked(); });
+}
+
+std::shared_ptr< BlockContainer > BlockContainer::Compact(
+   const FilePath &newPath)
+{
+   auto pNew = Open(newPath);
+   if (!pNew)
+      throw FileException{ FileException::Cause::Open, newPath };
+
+   // Hold the extents, so that none goes away while moving
+   std::vector< BlockExtentPtr > live;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      for (const auto &pair : mExtents)
+         if (auto pExtent = pair.second.lock())
+            live.push_back(pExtent);
+   }
+
+   // Copy, in the order of the old file
+   std::vector< wxFileOffset > oldOffsets, newOffsets;
+   oldOffsets.reserve(live.size());
+   newOffsets.reserve(live.size());
+   ArrayOf< char > buffer;
+   size_t bufferSize = 0;
+   for (const auto &pExtent : live) {
+      const auto bytes = pExtent->GetBytes();
+      if (bytes > bufferSize)
+         buffer.reinit(bufferSize = bytes);
+      oldOffsets.push_back(pExtent->GetLocation().offset);
+      if (!Read(oldOffsets.back(), buffer.get(), bytes))
+         // pNew removes its file as it is destroyed
+         throw FileException{ FileException::Cause::Read, mPath };
+
+      std::lock_guard< std::mutex > lock{ pNew->mMutex };
+      if (!pNew->mAppendFile.IsOpened() &&
+          !pNew->mAppendFile.Open(newPath, wxT("ab")))
+         throw FileException{ FileException::Cause::Open, newPath };
+      if (pNew->mAppendFile.Write(buffer.get(), bytes) != bytes)
+         throw FileException{ FileException::Cause::Write, newPath };
+      newOffsets.push_back(pNew->mFileSize);
+      pNew->mFileSize += bytes;
+   }
+   if (pNew->mAppendFile.IsOpened() && !pNew->mAppendFile.Flush())
+      throw FileException{ FileException::Cause::Write, newPath };
+
+   // No more failures
+   wxFileOffset moved = 0;
+   for (size_t ii = 0; ii < live.size(); ++ii) {
+      auto &extent = *live[ii];
+      {
+         std::lock_guard< std::mutex > lock{ extent.mMutex };
+         extent.mpContainer = pNew;
+         extent.mOffset = newOffsets[ii];
+      }
+      std::lock_guard< std::mutex > lock{ pNew->mMutex };
+      pNew->mExtents[newOffsets[ii]] = live[ii];
+      pNew->mLiveBytes += extent.GetBytes();
+      moved += extent.GetBytes();
+   }
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      for (auto offset : oldOffsets)
+         mExtents.erase(offset);
+      mLiveBytes -= moved;
+   }
+
+   return pNew;
+}
+
+void BlockContainer::Retain()
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mRetained = true;
+}
+
+void BlockContainer::Discard()
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   if (mDiscarded)
+      return;
+   mAppendFile.Close();
+   mpReadFile.reset();
+   wxRemoveFile(mPath);
+   mDiscarded = true;
+}
@@ -0,0 +1,156 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockContainer.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_CONTAINER__
+#define __AUDACITY_BLOCK_CONTAINER__
+
+#include "audacity/Types.h"
+#include "MemoryX.h"
+#include "SampleFormat.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <wx/ffile.h>
+
+class wxFile;
+
+class BlockContainer;
+
+// The place in a container of the summary and samples of one block.
+// Blocks that share data share the extent.  When the last reference goes,
+// the bytes become garbage, to be reclaimed by Compact().
+class BlockExtent {
+ public:
+   BlockExtent(const std::shared_ptr< BlockContainer > &pContainer,
+      wxFileOffset offset, sampleFormat format, size_t samples);
+   ~BlockExtent();
+
+   BlockExtent(const BlockExtent&) PROHIBITED;
+   BlockExtent &operator= (const BlockExtent&) PROHIBITED;
+
+   // Compact() may move the extent to another container, on the main
+   // thread, while other threads read; so get both at once
+   struct Location {
+      std::shared_ptr< BlockContainer > pContainer;
+      wxFileOffset offset;
+   };
+   Location GetLocation() const;
+
+   sampleFormat GetFormat() const { return mFormat; }
+   size_t GetSamples() const { return mSamples; }
+   size_t GetSummaryBytes() const { return mSummaryBytes; }
+   // Including the header
+   size_t GetBytes() const;
+
+   // Lock counts of all PackedBlockFiles using this extent.
+   // A container with a locked extent must be copied, not moved, by
+   // DirManager::ProjectSetter.
+   void Lock() { ++mLocks; }
+   void Unlock() { --mLocks; }
+   bool IsLocked() const { return mLocks > 0; }
+   // A locked block was destroyed:  a saved project may refer to the
+   // extent, so its container file must outlive this session
+   void Retain() { mRetained = true; }
+
+ private:
+   friend BlockContainer;
+
+   mutable std::mutex mMutex;
+   std::shared_ptr< BlockContainer > mpContainer;
+   wxFileOffset mOffset;
+
+   const sampleFormat mFormat;
+   const size_t mSamples;
+   const size_t mSummaryBytes;
+
+   int mLocks{ 0 };
+   bool mRetained{ false };
+};
+
+using BlockExtentPtr = std::shared_ptr< BlockExtent >;
+
+// One append-only file holding the data of many blocks, one after another.
+// The project file names the container and the offset of each block, so
+// that the container needs no index of its own.
+class BlockContainer final
+   : public std::enable_shared_from_this< BlockContainer >
+{
+ public:
+   // The file extension of containers
+   static const wxChar *const Extension;
+
+   // Creates the file if it does not exist
+   static std::shared_ptr< BlockContainer > Open(const FilePath &path);
+
+   // Removes the file, unless some extent was retained
+   ~BlockContainer();
+
+   BlockContainer(const BlockContainer&) PROHIBITED;
+   BlockContainer &operator= (const BlockContainer&) PROHIBITED;
+
+   FilePath GetPath() const;
+   // Only changes the name; the file must already be there.
+   // Used by DirManager::ProjectSetter::Commit()
+   void SetPath(const FilePath &path);
+
+   // Throws FileException
+   BlockExtentPtr Append(sampleFormat format, size_t samples,
+      const void *summary, size_t summaryBytes, samplePtr sampleData);
+
+   // Find the extent saved at the offset, as when loading a project.
+   // Returns null if the offset is not within the file.
+   BlockExtentPtr GetExtent(
+      wxFileOffset offset, sampleFormat format, size_t samples);
+
+   // Return false, having cleared the buffer, on failure
+   static bool ReadSummary(const BlockExtent &extent, void *data);
+   // Returns the number of samples read, in the stored format
+   static size_t ReadSamples(const BlockExtent &extent, samplePtr data,
+      size_t start, size_t len);
+
+   wxFileOffset GetFileSize() const;
+   // Bytes of extents that blocks still use
+   wxFileOffset GetLiveBytes() const;
+   bool IsLocked() const;
+
+   // Copy the extents still in use to a new container at newPath, and
+   // move them there.  This object is left with no extents.  Throws
+   // FileException; then nothing has moved.  Call on the main thread.
+   std::shared_ptr< BlockContainer > Compact(const FilePath &newPath);
+
+   // Keep the file when this is destroyed, as when a saved project
+   // refers to it
+   void Retain();
+   // Remove the file now, even if retained.  For a container emptied by
+   // Compact(), once the project no longer refers to it.
+   void Discard();
+
+ private:
+   explicit BlockContainer(const FilePath &path);
+
+   bool Read(wxFileOffset offset, void *data, size_t bytes);
+   void Forget(const BlockExtent &extent, wxFileOffset offset);
+
+   mutable std::mutex mMutex;
+   FilePath mPath;
+   // Opened as needed, and closed when the file is renamed
+   wxFFile mAppendFile;
+   // Shared with Read() calls in progress, which don't hold mMutex
+   std::shared_ptr< wxFile > mpReadFile;
+   wxFileOffset mFileSize{ 0 };
+   wxFileOffset mLiveBytes{ 0 };
+   std::map< wxFileOffset, std::weak_ptr< BlockExtent > > mExtents;
+   bool mRetained{ false };
+   bool mDiscarded{ false };
+
+   friend BlockExtent;
+};
+
+#endif
@@ -51,6 +51,7 @@ out.
 #include <wx/log.h>
 
 #include "sndfile.h"
+#include "BlockSampleCache.h"
 #include "FileException.h"
 #include "FileFormats.h"
 
@@ -106,10 +107,18 @@ BlockFile::BlockFile(wxFileNameWrapper &&fileName, size_t samples):
 }
 
 // static
-unsigned long BlockFile::gBlockFileDestructionCount { 0 };
+std::atomic<unsigned long> BlockFile::gBlockFileDestructionCount { 0 };
+
+// static
+std::atomic<unsigned long> BlockFile::gLockedBlockFileCount { 0 };
 
 BlockFile::~BlockFile()
 {
+   BlockSampleCache::Get().Invalidate(this);
+
+   if (mLockCount > 0)
+      --gLockedBlockFileCount;
+
    if (!IsLocked() && mFileName.HasName())
       // PRL: what should be done if this fails?
       wxRemoveFile(mFileName.GetFullPath());
@@ -155,14 +164,16 @@ void BlockFile::SetExternalFileName( wxFileNameWrapper && )
 /// refcount hits zero.
 void BlockFile::Lock()
 {
-   mLockCount++;
+   if (mLockCount++ == 0)
+      ++gLockedBlockFileCount;
    BLOCKFILE_DEBUG_OUTPUT("Lock", mLockCount);
 }
 
 /// Marks this BlockFile as "unlocked."
 void BlockFile::Unlock()
 {
-   mLockCount--;
+   if (mLockCount-- == 1)
+      --gLockedBlockFileCount;
    BLOCKFILE_DEBUG_OUTPUT("Unlock", mLockCount);
 }
 
@@ -178,7 +189,7 @@ bool BlockFile::IsLocked()
 /// after which they should write that data to their disk file.
 ///
 /// This method also has the side effect of setting the mMin, mMax,
-/// and mRMS members of this class.
+/// mRMS and mSum members of this class.
 ///
 /// You must not DELETE the returned buffer; it is static to this
 /// method.
@@ -216,6 +227,7 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
    float min, max;
    float sumsq;
    double totalSquares = 0.0;
+   double total = 0.0;
    double fraction { 0.0 };
 
    // Recalc 256 summaries
@@ -226,6 +238,7 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
       min = fbuffer[i * 256];
       max = fbuffer[i * 256];
       sumsq = ((float)min) * ((float)min);
+      double sum = min;
       decltype(len) jcount = 256;
       if (jcount > len - i * 256) {
          jcount = len - i * 256;
@@ -234,6 +247,7 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
       for (decltype(jcount) j = 1; j < jcount; j++) {
          float f1 = fbuffer[i * 256 + j];
          sumsq += ((float)f1) * ((float)f1);
+         sum += f1;
          if (f1 < min)
             min = f1;
          else if (f1 > max)
@@ -241,6 +255,7 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
       }
 
       totalSquares += sumsq;
+      total += sum;
       float rms = (float)sqrt(sumsq / jcount);
 
       summary256[i * 3] = min;
@@ -258,6 +273,8 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
 
    // Calculate now while we can do it accurately
    mRMS = sqrt(totalSquares/len);
+   mSum = total;
+   mHasSum = true;
 
    // Recalc 64K summaries
    sumLen = (len + 65535) / 65536;
@@ -409,6 +426,53 @@ auto BlockFile::GetMinMaxRMS(bool)
    return { mMin, mMax, mRMS };
 }
 
+/// Retrieves the sum of the specified sample data in this block.
+///
+/// @param start The offset in this block where the region should begin
+/// @param len   The number of samples to include in the region
+double BlockFile::GetSum(size_t start, size_t len, bool mayThrow) const
+{
+   SampleBuffer blockData(len, floatSample);
+
+   this->ReadData(blockData.ptr(), floatSample, start, len, mayThrow);
+
+   const auto samples = (const float *)blockData.ptr();
+   double sum = 0.0;
+   for( decltype(len) i = 0; i < len; i++ )
+      sum += samples[i];
+
+   return sum;
+}
+
+/// Retrieves the sum of all sample data in this block.  Blocks whose
+/// summaries were computed in this session, or that were saved with a
+/// sum, have it already; others read their data the first time.
+double BlockFile::GetSum(bool mayThrow) const
+{
+   if (mHasSum)
+      return mSum;
+
+   // Data that is not yet decoded would only give zeroes; don't keep them
+   if (!IsDataAvailable())
+      return 0.0;
+
+   SampleBuffer blockData(mLen, floatSample);
+   const auto count =
+      this->ReadData(blockData.ptr(), floatSample, 0, mLen, mayThrow);
+
+   const auto samples = (const float *)blockData.ptr();
+   double sum = 0.0;
+   for( size_t i = 0; i < count; i++ )
+      sum += samples[i];
+
+   // Don't keep the sum of a block that could not be read
+   if (count == mLen) {
+      mSum = sum;
+      mHasSum = true;
+   }
+   return sum;
+}
+
 /// Retrieves a portion of the 256-byte summary buffer from this BlockFile.  This
 /// data provides information about the minimum value, the maximum
 /// value, and the maximum RMS value for every group of 256 samples in the
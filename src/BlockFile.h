@@ -18,6 +18,7 @@
 
 #include "ondemand/ODTaskThread.h"
 
+#include <atomic>
 #include <functional>
 
 class XMLWriter;
@@ -65,7 +66,12 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    BlockFile(wxFileNameWrapper &&fileName, size_t samples);
    virtual ~BlockFile();
 
-   static unsigned long gBlockFileDestructionCount;
+   // Block files may be destroyed on worker threads, while
+   // DirManager::GetBalanceInfo() reads this
+   static std::atomic<unsigned long> gBlockFileDestructionCount;
+   // How many BlockFiles are now locked; while none is,
+   // DirManager::CopyBlockFile() copies nothing
+   static std::atomic<unsigned long> gLockedBlockFileCount;
 
    // Reading
 
@@ -137,6 +143,12 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
                           bool mayThrow = true) const;
    /// Gets extreme values for the entire block
    virtual MinMaxRMS GetMinMaxRMS(bool mayThrow = true) const;
+   /// Gets the sum of the samples in the specified region
+   double GetSum(size_t start, size_t len, bool mayThrow = true) const;
+   /// Gets the sum of all samples in the block.  It is computed with the
+   /// other summaries, or read from the project; if neither, it is computed
+   /// from the data once and kept.
+   double GetSum(bool mayThrow = true) const;
    /// Returns the 256 byte summary data block
    virtual bool Read256(float *buffer, size_t start, size_t len);
    /// Returns the 64K summary data block
@@ -245,6 +257,9 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    size_t mLen;
    SummaryInfo mSummaryInfo;
    float mMin, mMax, mRMS;
+   // The sum of the samples, for the mean; valid only if mHasSum
+   mutable std::atomic<double> mSum{ 0.0 };
+   mutable std::atomic<bool> mHasSum{ false };
    mutable bool mSilentLog;
 };
 
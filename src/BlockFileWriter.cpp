@@ -0,0 +1,264 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockFileWriter.cpp
+
+*******************************************************************//**
+
+\class BlockFileWriter
+\brief Writes the block files of a recording on its own thread.
+
+  AudioIO's FillBuffers appends captured samples to the WaveTracks, and
+  each full block used to be written, header, summary and samples, on
+  the audio thread, so that any stall of the disk became an overrun of
+  the capture buffers.  Now such a block keeps its data in memory (see
+  SimpleBlockFile::IsWritePending()) and is queued here.
+
+  The thread takes the whole queue at once and writes it, then, if the
+  preference /Directories/SyncRecordedBlocks is set, syncs all the files
+  of the batch to the device.  Each block takes a ticket, and AudioIO
+  holds back the entries of the auto-save journal of the recording until
+  IsDone() says the files they name are written and synced, so that the
+  journal does not name files that a crash would lose.  (Blocks written
+  inline, when the queue is full, are not synced.)
+
+  The queue is bounded by the preference /Directories/RecordingWriteQueue,
+  in megabytes.  Zero disables the thread.  When the queue is full, the
+  recording thread writes the block itself, and the statistics count
+  that, so that dropouts can be blamed on the disk.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BlockFileWriter.h"
+
+#include "FileException.h"
+#include "Prefs.h"
+#include "blockfile/SimpleBlockFile.h"
+
+#include <chrono>
+
+#ifdef __WXMSW__
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Flush the file's data from the operating system's cache to the device.
+// The data were already written through another handle; syncing any
+// handle of the file suffices.
+void SyncFile(const wxString &path)
+{
+#ifdef __WXMSW__
+   // FlushFileBuffers needs write access
+   HANDLE handle = CreateFileW(path.wc_str(), GENERIC_WRITE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, nullptr);
+   if (handle == INVALID_HANDLE_VALUE)
+      return;
+   FlushFileBuffers(handle);
+   CloseHandle(handle);
+#else
+   int fd = open(path.fn_str(), O_RDONLY);
+   if (fd < 0)
+      return;
+   fsync(fd);
+   close(fd);
+#endif
+}
+
+}
+
+BlockFileWriter &BlockFileWriter::Get()
+{
+   static BlockFileWriter theWriter{ GetCapacityPref(), GetSyncPref() };
+   return theWriter;
+}
+
+size_t BlockFileWriter::GetCapacityPref()
+{
+   const long megabytes =
+      gPrefs ? gPrefs->Read(wxT("/Directories/RecordingWriteQueue"), 64L) : 0;
+   return size_t(std::max(0L, megabytes)) << 20;
+}
+
+bool BlockFileWriter::GetSyncPref()
+{
+   return gPrefs &&
+      gPrefs->ReadBool(wxT("/Directories/SyncRecordedBlocks"), true);
+}
+
+BlockFileWriter::BlockFileWriter(size_t capacityBytes, bool sync)
+   : mCapacity{ capacityBytes }
+   , mSync{ sync }
+{
+}
+
+BlockFileWriter::~BlockFileWriter()
+{
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      mStopping = true;
+   }
+   mAvailable.notify_one();
+   if (mThread.joinable())
+      mThread.join();
+}
+
+void BlockFileWriter::Submit(const std::shared_ptr< SimpleBlockFile > &pFile)
+{
+   const auto bytes = pFile->GetPendingBytes();
+   bool queued = false;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      const auto ticket = ++mLastTicket;
+      if (!mStopping && mQueuedBytes + bytes <= mCapacity) {
+         if (!mThread.joinable())
+            mThread = std::thread{ [this]{ Run(); } };
+         mQueue.push_back({ pFile, bytes, ticket });
+         mQueuedBytes += bytes;
+         ++mStatistics.blocksQueued;
+         mStatistics.peakQueuedBytes =
+            std::max(mStatistics.peakQueuedBytes, mQueuedBytes);
+         queued = true;
+      }
+      else
+         ++mStatistics.blocksWrittenInline;
+   }
+
+   if (queued) {
+      mAvailable.notify_one();
+      return;
+   }
+
+   // The disk is not keeping up.  Write here, as if there were no thread.
+   WriteInline(*pFile);
+}
+
+void BlockFileWriter::WriteInline(SimpleBlockFile &file)
+{
+   if (!file.WritePending())
+      throw FileException{
+         FileException::Cause::Write, file.GetFileName().name };
+}
+
+void BlockFileWriter::Flush()
+{
+   std::unique_lock< std::mutex > lock{ mMutex };
+   mDrained.wait(lock, [this]{ return mQueue.empty() && !mBusy; });
+}
+
+auto BlockFileWriter::GetLastTicket() const -> Ticket
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mLastTicket;
+}
+
+bool BlockFileWriter::IsDone(Ticket ticket) const
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   // Tickets are queued in increasing order, and files written inline are
+   // done before Submit() returns
+   if (mBusy && mBatchTicket <= ticket)
+      return false;
+   return mQueue.empty() || mQueue.front().ticket > ticket;
+}
+
+wxString BlockFileWriter::TakeFailure()
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   wxString result;
+   result.swap(mFailure);
+   return result;
+}
+
+size_t BlockFileWriter::GetCapacity() const
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mCapacity;
+}
+
+void BlockFileWriter::UpdatePrefs()
+{
+   const auto capacity = GetCapacityPref();
+   const auto sync = GetSyncPref();
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mCapacity = capacity;
+   mSync = sync;
+}
+
+auto BlockFileWriter::GetStatistics() const -> Statistics
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mStatistics;
+}
+
+void BlockFileWriter::ResetStatistics()
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mStatistics = {};
+}
+
+void BlockFileWriter::Run()
+{
+   std::vector< Entry > batch;
+   std::vector< wxString > written;
+
+   std::unique_lock< std::mutex > lock{ mMutex };
+   while (true) {
+      mAvailable.wait(lock, [this]{ return mStopping || !mQueue.empty(); });
+      if (mQueue.empty())
+         // Stopping
+         break;
+
+      // Take everything, so that one pass of syncing covers it all
+      batch.assign(mQueue.begin(), mQueue.end());
+      mQueue.clear();
+      mBusy = true;
+      mBatchTicket = batch.front().ticket;
+      const bool sync = mSync;
+      lock.unlock();
+
+      size_t failures = 0, batchBytes = 0;
+      double longest = 0;
+      wxString failure;
+      for (auto &entry : batch) {
+         batchBytes += entry.bytes;
+         // A block discarded before it was written need not be written
+         if (auto pFile = entry.pFile.lock()) {
+            const auto start = std::chrono::steady_clock::now();
+            if (pFile->WritePending())
+               written.push_back(pFile->GetFileName().name.GetFullPath());
+            else {
+               ++failures;
+               failure = pFile->GetFileName().name.GetFullPath();
+            }
+            const std::chrono::duration< double > elapsed =
+               std::chrono::steady_clock::now() - start;
+            longest = std::max(longest, elapsed.count());
+         }
+         // Any destruction of the block (and its file) happens here too
+      }
+      batch.clear();
+
+      if (sync)
+         for (const auto &path : written)
+            SyncFile(path);
+      written.clear();
+
+      lock.lock();
+      mQueuedBytes -= batchBytes;
+      mBusy = false;
+      ++mStatistics.batches;
+      mStatistics.failures += failures;
+      mStatistics.longestWriteSeconds =
+         std::max(mStatistics.longestWriteSeconds, longest);
+      if (!failure.empty())
+         mFailure = failure;
+      mDrained.notify_all();
+   }
+}
@@ -0,0 +1,108 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockFileWriter.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_FILE_WRITER__
+#define __AUDACITY_BLOCK_FILE_WRITER__
+
+#include "MemoryX.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <wx/string.h>
+
+class SimpleBlockFile;
+
+// Process-wide thread that writes the files of SimpleBlockFiles created
+// during recording, so that the audio thread does not wait for the disk.
+// The queue is bounded in bytes; when it is full, Submit() writes on the
+// calling thread instead, as if there were no writer.
+class BlockFileWriter {
+ public:
+   static BlockFileWriter &Get();
+
+   struct Statistics {
+      size_t blocksQueued{}, blocksWrittenInline{};
+      size_t batches{}, failures{};
+      size_t peakQueuedBytes{};
+      double longestWriteSeconds{};
+   };
+
+   BlockFileWriter(size_t capacityBytes, bool sync);
+   ~BlockFileWriter();
+
+   BlockFileWriter(const BlockFileWriter&) PROHIBITED;
+   BlockFileWriter &operator= (const BlockFileWriter&) PROHIBITED;
+
+   // The file must have IsWritePending().
+   // Throws FileException if it must write inline, and that fails.
+   void Submit(const std::shared_ptr< SimpleBlockFile > &pFile);
+
+   // Wait until all submitted files are written, or failed
+   void Flush();
+
+   // Each Submit() takes the next ticket.  For the auto-save journal, which
+   // must not name a file before it is written and synced:  the ticket of
+   // the last file submitted, and whether the files of it and of all
+   // earlier tickets are written (or failed).
+   using Ticket = unsigned long long;
+   Ticket GetLastTicket() const;
+   bool IsDone(Ticket ticket) const;
+
+   // Name of a file the thread failed to write since the last call, or
+   // empty.  The data of such a file remain in memory; see
+   // DirManager::WriteCacheToDisk().
+   wxString TakeFailure();
+
+   size_t GetCapacity() const;
+
+   // Call on the main thread, as before recording, because wxConfig is
+   // not thread safe
+   void UpdatePrefs();
+
+   Statistics GetStatistics() const;
+   void ResetStatistics();
+
+   // Reads the preference, in megabytes
+   static size_t GetCapacityPref();
+   // Whether to sync each batch of files to the device
+   static bool GetSyncPref();
+
+ private:
+   void Run();
+   void WriteInline(SimpleBlockFile &file);
+
+   struct Entry {
+      std::weak_ptr< SimpleBlockFile > pFile;
+      size_t bytes;
+      Ticket ticket;
+   };
+
+   mutable std::mutex mMutex;
+   std::condition_variable mAvailable, mDrained;
+   std::deque< Entry > mQueue;
+   // Including those of the batch being written
+   size_t mQueuedBytes{ 0 };
+   size_t mCapacity;
+   bool mSync;
+   bool mBusy{ false };
+   Ticket mLastTicket{ 0 };
+   // The first ticket of the batch being written, while mBusy
+   Ticket mBatchTicket{ 0 };
+   bool mStopping{ false };
+   Statistics mStatistics;
+   wxString mFailure;
+
+   // Started by the first Submit()
+   std::thread mThread;
+};
+
+#endif
@@ -0,0 +1,165 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockSampleCache.cpp
+
+*******************************************************************//**
+
+\class BlockSampleCache
+\brief Keeps decoded float samples of recently used BlockFiles in memory.
+
+  Each WaveTrackCache lives only as long as one playback, drawing or effect
+  pass, so a second pass over the same region used to read all of the block
+  files again.  Sequence::Read consults this cache, which is shared by all
+  tracks and projects, for every request in float format.
+
+  The cache is bounded by the preference /Directories/SampleCacheSize,
+  in megabytes.  Zero disables it.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "BlockSampleCache.h"
+
+#include "BlockFile.h"
+#include "Prefs.h"
+
+BlockSampleCache &BlockSampleCache::Get()
+{
+   static BlockSampleCache theCache{ GetCapacityPref() };
+   return theCache;
+}
+
+size_t BlockSampleCache::GetCapacityPref()
+{
+   const long megabytes =
+      gPrefs ? gPrefs->Read(wxT("/Directories/SampleCacheSize"), 128L) : 0;
+   return size_t(std::max(0L, megabytes)) << 20;
+}
+
+BlockSampleCache::BlockSampleCache(size_t capacityBytes)
+   : mCapacity{ capacityBytes }
+{
+}
+
+BlockSampleCache::~BlockSampleCache()
+{
+}
+
+auto BlockSampleCache::Fetch(const BlockFile &block) -> SamplesPtr
+{
+   const auto len = block.GetLength();
+   const auto bytes = len * sizeof(float);
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      if (len == 0 || bytes > mCapacity)
+         return {};
+
+      auto iter = mIndex.find(&block);
+      if (iter != mIndex.end()) {
+         ++mHits;
+         // Move to the front
+         mList.splice(mList.begin(), mList, iter->second);
+         return iter->second->pSamples;
+      }
+      ++mMisses;
+   }
+
+   if (!block.IsDataAvailable())
+      return {};
+
+   // Read without holding the lock
+   auto pSamples = std::make_shared< Floats >(len);
+   size_t result = 0;
+   try {
+      result = block.ReadData(
+         (samplePtr)pSamples->get(), floatSample, 0, len, false);
+   }
+   catch (...) {
+      return {};
+   }
+   if (result != len)
+      // Let the caller repeat the read and report the failure
+      return {};
+
+   std::lock_guard< std::mutex > lock{ mMutex };
+   auto iter = mIndex.find(&block);
+   if (iter != mIndex.end()) {
+      // Another thread won the race
+      mList.splice(mList.begin(), mList, iter->second);
+      return iter->second->pSamples;
+   }
+   if (bytes > mCapacity)
+      // Capacity changed meanwhile
+      return pSamples;
+
+   mList.push_front({ &block, pSamples, bytes });
+   mIndex[&block] = mList.begin();
+   mBytes += bytes;
+   Trim();
+   return pSamples;
+}
+
+void BlockSampleCache::Invalidate(const BlockFile *pBlock)
+{
+   SamplesPtr pSamples;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      auto iter = mIndex.find(pBlock);
+      if (iter == mIndex.end())
+         return;
+      // Free the memory outside the lock
+      pSamples = std::move(iter->second->pSamples);
+      mBytes -= iter->second->bytes;
+      mList.erase(iter->second);
+      mIndex.erase(iter);
+   }
+}
+
+void BlockSampleCache::Clear()
+{
+   List list;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      list.swap(mList);
+      mIndex.clear();
+      mBytes = 0;
+   }
+}
+
+size_t BlockSampleCache::GetCapacity() const
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mCapacity;
+}
+
+void BlockSampleCache::SetCapacity(size_t capacityBytes)
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mCapacity = capacityBytes;
+   Trim();
+}
+
+auto BlockSampleCache::GetStatistics() const -> Statistics
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return { mHits, mMisses, mList.size(), mBytes };
+}
+
+void BlockSampleCache::ResetStatistics()
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mHits = mMisses = 0;
+}
+
+// Call with mMutex held
+void BlockSampleCache::Trim()
+{
+   while (mBytes > mCapacity && !mList.empty()) {
+      auto &entry = mList.back();
+      mBytes -= entry.bytes;
+      mIndex.erase(entry.pBlock);
+      mList.pop_back();
+   }
+}
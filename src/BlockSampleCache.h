@@ -0,0 +1,83 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BlockSampleCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_SAMPLE_CACHE__
+#define __AUDACITY_BLOCK_SAMPLE_CACHE__
+
+#include "SampleFormat.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+class BlockFile;
+
+// Process-wide, size-bounded, least-recently-used cache of the complete
+// contents of block files, decoded to float.
+// BlockFiles are immutable, so entries never become stale; they are
+// removed only when the BlockFile is destroyed or the cache is full.
+class BlockSampleCache {
+ public:
+   static BlockSampleCache &Get();
+
+   // Shared so that an entry remains usable after it is evicted
+   using SamplesPtr = std::shared_ptr< const Floats >;
+
+   struct Statistics {
+      unsigned long long hits{}, misses{};
+      size_t blocks{}, bytes{};
+   };
+
+   explicit BlockSampleCache(size_t capacityBytes);
+   ~BlockSampleCache();
+
+   BlockSampleCache(const BlockSampleCache&) PROHIBITED;
+   BlockSampleCache &operator= (const BlockSampleCache&) PROHIBITED;
+
+   // Returns all GetLength() samples of the block, reading them if they
+   // are not yet cached.
+   // Returns null if the data are not yet available (as for on-demand
+   // blocks), cannot be read completely, or don't fit.  The caller should
+   // then read from the block in the usual way.
+   // Does not throw.
+   SamplesPtr Fetch(const BlockFile &block);
+
+   // Call when a BlockFile is destroyed
+   void Invalidate(const BlockFile *pBlock);
+
+   void Clear();
+
+   size_t GetCapacity() const;
+   void SetCapacity(size_t capacityBytes);
+
+   Statistics GetStatistics() const;
+   void ResetStatistics();
+
+   // Reads the preference, in megabytes
+   static size_t GetCapacityPref();
+
+ private:
+   void Trim();
+
+   struct Entry {
+      const BlockFile *pBlock;
+      SamplesPtr pSamples;
+      size_t bytes;
+   };
+   using List = std::list< Entry >;
+
+   mutable std::mutex mMutex;
+   // Most recently used at the front
+   List mList;
+   std::unordered_map< const BlockFile*, List::iterator > mIndex;
+   size_t mCapacity;
+   size_t mBytes{ 0 };
+   unsigned long long mHits{ 0 }, mMisses{ 0 };
+};
+
+#endif
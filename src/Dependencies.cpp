@@ -72,19 +72,17 @@ using AliasedFileHash = std::unordered_map<wxString, AliasedFile*>;
 using ReplacedBlockFileHash = std::unordered_map<BlockFile *, BlockFilePtr>;
 using BoolBlockFileHash = std::unordered_map<BlockFile *, bool>;
 
-// Given a project, returns a single array of all SeqBlocks
-// in the current set of tracks.  Enumerating that array allows
-// you to process all block files in the current set.
-static void GetAllSeqBlocks(AudacityProject *project,
-                            BlockPtrArray *outBlocks)
+using SequenceArray = std::vector<Sequence*>;
+
+// Given a project, returns a single array of all Sequences
+// in the current set of tracks.  Enumerating the blocks of those
+// allows you to process all block files in the current set.
+static void GetAllSequences(AudacityProject *project,
+                            SequenceArray *outSequences)
 {
    for (auto waveTrack : TrackList::Get( *project ).Any< WaveTrack >()) {
-      for(const auto &clip : waveTrack->GetAllClips()) {
-         Sequence *sequence = clip->GetSequence();
-         BlockArray &blocks = sequence->GetBlockArray();
-         for (size_t i = 0; i < blocks.size(); i++)
-            outBlocks->push_back(&blocks[i]);
-      }
+      for(const auto &clip : waveTrack->GetAllClips())
+         outSequences->push_back(clip->GetSequence());
    }
 }
 
@@ -93,16 +91,18 @@ static void GetAllSeqBlocks(AudacityProject *project,
 // tracks and replace each aliased block file with its replacement.
 // Note that this code respects reference-counting and thus the
 // process of making a project self-contained is actually undoable.
-static void ReplaceBlockFiles(BlockPtrArray &blocks,
+static void ReplaceBlockFiles(const SequenceArray &sequences,
                               ReplacedBlockFileHash &hash)
 // NOFAIL-GUARANTEE
 {
-   for (const auto &pBlock : blocks) {
-      auto &f = pBlock->f;
-      const auto src = &*f;
-      if (hash.count( src ) > 0) {
-         const auto &dst = hash[src];
-         f = dst;
+   for (const auto sequence : sequences) {
+      auto &blocks = sequence->GetBlockArray();
+      for (size_t i = 0, nn = blocks.size(); i < nn; ++i) {
+         const auto src = &*blocks[i].f;
+         if (hash.count( src ) > 0) {
+            const auto &dst = hash[src];
+            blocks.SetFile(i, dst);
+         }
       }
    }
 }
@@ -112,14 +112,15 @@ void FindDependencies(AudacityProject *project,
 {
    sampleFormat format = QualityPrefs::SampleFormatChoice();
 
-   BlockPtrArray blocks;
-   GetAllSeqBlocks(project, &blocks);
+   SequenceArray sequences;
+   GetAllSequences(project, &sequences);
 
    AliasedFileHash aliasedFileHash;
    BoolBlockFileHash blockFileHash;
 
-   for (const auto &blockFile : blocks) {
-      const auto &f = blockFile->f;
+   for (const Sequence *sequence : sequences)
+   for (const auto &block : sequence->GetBlockArray()) {
+      const auto &f = block.f;
       if (f->IsAlias() && (blockFileHash.count( &*f ) == 0))
       {
          // f is an alias block we have not yet counted.
@@ -183,14 +184,15 @@ static void RemoveDependencies(AudacityProject *project,
       aliasedFileHash[fileNameStr] = &aliasedFile;
    }
 
-   BlockPtrArray blocks;
-   GetAllSeqBlocks(project, &blocks);
+   SequenceArray sequences;
+   GetAllSequences(project, &sequences);
 
    const sampleFormat format = QualityPrefs::SampleFormatChoice();
    ReplacedBlockFileHash blockFileHash;
    wxLongLong completedBytes = 0;
-   for (const auto blockFile : blocks) {
-      const auto &f = blockFile->f;
+   for (const Sequence *sequence : sequences)
+   for (const auto &block : sequence->GetBlockArray()) {
+      const auto &f = block.f;
       if (f->IsAlias() && (blockFileHash.count( &*f ) == 0))
       {
          // f is an alias block we have not yet processed.
@@ -235,7 +237,7 @@ static void RemoveDependencies(AudacityProject *project,
    // to go with each AliasBlockFile that we wanted to migrate.
    // However, that didn't actually change any references to these
    // blockfiles in the Sequences, so we do that next...
-   ReplaceBlockFiles(blocks, blockFileHash);
+   ReplaceBlockFiles(sequences, blockFileHash);
 }
 
 //
@@ -85,11 +85,17 @@
 #include <sys/stat.h>
 #endif
 
+#include "BlockContainer.h"
 #include "BlockFile.h"
+#include "BlockFileWriter.h"
+#include "FileException.h"
 #include "FileNames.h"
 #include "InconsistencyException.h"
+#include "MappedFile.h"
 #include "Prefs.h"
 #include "Project.h"
+#include "blockfile/PackedBlockFile.h"
+#include "blockfile/SimpleBlockFile.h"
 #include "widgets/Warning.h"
 #include "widgets/AudacityMessageBox.h"
 #include "widgets/ProgressDialog.h"
@@ -392,7 +398,7 @@ DirManager::DirManager()
 {
    wxLogDebug(wxT("DirManager: Created new instance."));
 
-   mLastBlockFileDestructionCount = BlockFile::gBlockFileDestructionCount;
+   mLastBlockFileDestructionCount = BlockFile::gBlockFileDestructionCount.load();
 
    // Seed the random number generator.
    // this need not be strictly uniform or random, but it should give
@@ -418,6 +424,9 @@ DirManager::DirManager()
 
    mMaxSamples = ~size_t(0);
 
+   mPackedBlockFiles =
+      gPrefs->ReadBool(wxT("/Directories/PackedBlockFiles"), false);
+
    // toplevel pool hash is fully populated to begin
    {
       // We can bypass the accessor function while initializing
@@ -574,6 +583,9 @@ struct DirManager::ProjectSetter::Impl
    // Remember old path to be cleaned up in case of successful move
    FilePath oldFull{ dirManager.projFull };
    FilePaths newPaths;
+   // Likewise for the containers of packed blocks
+   std::vector< std::shared_ptr< BlockContainer > > containers;
+   FilePaths newContainerPaths;
    size_t trueTotal{ 0 };
    bool moving{ true };
 
@@ -674,12 +686,18 @@ DirManager::ProjectSetter::Impl::Impl(
       will not be deleted in Commit().
    */
 
+   containers = dirManager.GetBlockContainers();
+
    moving = moving && ! std::any_of(
       dirManager.mBlockFileHash.begin(), dirManager.mBlockFileHash.end(),
       []( const BlockHash::value_type &pair ){
          auto b = pair.second.lock();
          return b && b->IsLocked();
       }
+   ) && ! std::any_of( containers.begin(), containers.end(),
+      []( const std::shared_ptr< BlockContainer > &pContainer ){
+         return pContainer->IsLocked();
+      }
    );
 
    trueTotal = 0;
@@ -708,6 +726,19 @@ DirManager::ProjectSetter::Impl::Impl(
          }
          newPaths.push_back( newPath );
       }
+
+      // One file for many blocks, so this is quick
+      for (const auto &pContainer : containers) {
+         const auto oldPath = pContainer->GetPath();
+         const auto newPath = dirManager.projFull + wxFILE_SEP_PATH +
+            wxFileName{ oldPath }.GetFullName();
+         if (newPath != oldPath &&
+             !(link && FileNames::HardLinkFile( oldPath, newPath )) &&
+             !FileNames::CopyFile( oldPath, newPath ))
+            return;
+         newContainerPaths.push_back( newPath );
+         ++trueTotal;
+      }
    }
 
    ok = true;
@@ -752,8 +783,11 @@ void DirManager::ProjectSetter::Impl::Commit()
          if (moving || !b->IsLocked()) {
             auto result = b->GetFileName();
             auto oldPath = result.name.GetFullPath();
-            if (!oldPath.empty())
+            if (!oldPath.empty()) {
+               // Windows won't remove a file that is still mapped
+               GetMappedFiles().Release( oldPath );
                wxRemoveFile( oldPath );
+            }
          }
 
          if (ii < size)
@@ -764,6 +798,19 @@ void DirManager::ProjectSetter::Impl::Commit()
       ++ii;
    }
 
+   for (size_t jj = 0; jj < containers.size(); ++jj) {
+      auto &pContainer = containers[jj];
+      const auto oldPath = pContainer->GetPath();
+      if (oldPath == newContainerPaths[jj])
+         continue;
+      // As for block files, keep the old file if some block is locked
+      const bool remove = moving || !pContainer->IsLocked();
+      // Closes the file first, so that Windows can remove it
+      pContainer->SetPath( newContainerPaths[jj] );
+      if (remove)
+         wxRemoveFile( oldPath );
+   }
+
    // Some subtlety; SetProject is used both to move a temp project
    // into a permanent home as well as just set up path variables when
    // loading a project; in this latter case, the movement code does
@@ -998,7 +1045,7 @@ auto DirManager::GetBalanceInfo() -> BalanceInfo &
    // see whether any block files have disappeared,
    // and if so update
 
-   auto count = BlockFile::gBlockFileDestructionCount;
+   auto count = BlockFile::gBlockFileDestructionCount.load();
    if ( mLastBlockFileDestructionCount != count ) {
       auto it = mBlockFileHash.begin(), end = mBlockFileHash.end();
       while (it != end)
@@ -1091,6 +1138,7 @@ void DirManager::BalanceInfoDel(const wxString &file)
 
 // only determines appropriate filename and subdir balance; does not
 // perform maintainence
+// Call with mBlockFileHashMutex locked.
 wxFileNameWrapper DirManager::MakeBlockFileName()
 {
    auto &balanceInfo = GetBalanceInfo();
@@ -1185,7 +1233,8 @@ wxFileNameWrapper DirManager::MakeBlockFileName()
 
       baseFileName.Printf(wxT("e%02x%02x%03x"),topnum,midnum,filenum);
 
-      if (!ContainsBlockFile(baseFileName)) {
+      if (!ContainsBlockFileLocked(baseFileName) &&
+          !mPendingBlockFileNames.count(baseFileName)) {
          // not in the hash, good.
          if (!this->AssignFile(ret, baseFileName, true))
          {
@@ -1209,9 +1258,22 @@ wxFileNameWrapper DirManager::MakeBlockFileName()
 
 BlockFilePtr DirManager::NewBlockFile( const BlockFileFactory &factory )
 {
-   wxFileNameWrapper filePath{ MakeBlockFileName() };
+   wxFileNameWrapper filePath;
+   {
+      std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
+      filePath = MakeBlockFileName();
+      mPendingBlockFileNames.insert( filePath.GetName() );
+   }
    const wxString fileName{ filePath.GetName() };
+   auto cleanup = finally( [&] {
+      std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
+      mPendingBlockFileNames.erase( fileName );
+   } );
+
+   // The factory may write the file, so let other threads make theirs
    auto newBlockFile = factory( std::move(filePath) );
+
+   std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
    mBlockFileHash[fileName] = newBlockFile;
    auto &aliasName = newBlockFile->GetExternalFileName();
    if ( aliasName.IsOk() )
@@ -1221,11 +1283,178 @@ BlockFilePtr DirManager::NewBlockFile( const BlockFileFactory &factory )
    return newBlockFile;
 }
 
+BlockFilePtr DirManager::NewSampleBlockFile(
+   samplePtr sampleData, size_t sampleLen, sampleFormat format,
+   bool allowDeferredWrite)
+{
+   // Recording keeps to SimpleBlockFiles, which BlockFileWriter writes
+   // on its own thread, and which the auto-save journal of the recording
+   // can name before they are written
+   if (mPackedBlockFiles && !allowDeferredWrite) {
+      std::shared_ptr< BlockContainer > pContainer;
+      {
+         std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+         if (!mAppendContainer) {
+            const auto path = MakeBlockContainerPath();
+            mAppendContainer = BlockContainer::Open(path);
+            if (!mAppendContainer)
+               throw FileException{ FileException::Cause::Open, path };
+            mBlockContainers[ wxFileName{ path }.GetFullName() ] =
+               mAppendContainer;
+         }
+         pContainer = mAppendContainer;
+      }
+      return make_blockfile<PackedBlockFile>(
+         *pContainer, sampleData, sampleLen, format);
+   }
+
+   auto pFile = NewBlockFile( [&]( wxFileNameWrapper filePath ) {
+      return make_blockfile<SimpleBlockFile>(
+         std::move(filePath), sampleData, sampleLen, format,
+         allowDeferredWrite);
+   } );
+   if (allowDeferredWrite) {
+      auto pSimple = std::static_pointer_cast< SimpleBlockFile >( pFile );
+      if (pSimple->IsWritePending())
+         // Leave the disk to the writer thread
+         BlockFileWriter::Get().Submit( pSimple );
+   }
+   return pFile;
+}
+
+// Names are blocks0.aupk, blocks1.aupk, ... in the data directory.
+// Call with mBlockContainersMutex locked.
+FilePath DirManager::MakeBlockContainerPath()
+{
+   const auto dir = GetDataFilesDir();
+   if (!wxDirExists(dir))
+      wxFileName::Mkdir(dir, 0777, wxPATH_MKDIR_FULL);
+
+   for (int ii = 0;; ++ii) {
+      const auto name = wxString::Format(
+         wxT("blocks%d.%s"), ii, BlockContainer::Extension);
+      const auto path = dir + wxFILE_SEP_PATH + name;
+      if (mBlockContainers.find(name) == mBlockContainers.end() &&
+          !wxFileExists(path))
+         return path;
+   }
+}
+
+std::shared_ptr< BlockContainer >
+DirManager::GetBlockContainer(const wxString &name)
+{
+   if (name.empty())
+      return {};
+
+   std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+   auto &wContainer = mBlockContainers[name];
+   if (auto pContainer = wContainer.lock())
+      return pContainer;
+
+   const auto path = GetDataFilesDir() + wxFILE_SEP_PATH + name;
+   if (!wxFileExists(path)) {
+      mBlockContainers.erase(name);
+      return {};
+   }
+
+   auto pContainer = BlockContainer::Open(path);
+   wContainer = pContainer;
+   // Append NEW blocks to the last container of the project, rather than
+   // leave a new one for each session of editing
+   const auto generation = []( const wxString &containerName ){
+      long result = -1;
+      containerName.BeforeFirst(wxT('.')).Mid(6).ToLong(&result);
+      return result;
+   };
+   if (pContainer && mPackedBlockFiles &&
+       (!mAppendContainer ||
+        generation(wxFileName{ mAppendContainer->GetPath() }.GetFullName())
+           < generation(name)))
+      mAppendContainer = pContainer;
+   return pContainer;
+}
+
+void DirManager::AddMissingPackedBlockFile(
+   const wxString &containerName, long long offset, const BlockFilePtr &b)
+{
+   std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+   // The colon keeps the keys apart from the names in mBlockFileHash
+   mMissingPackedBlockFiles[
+      wxString::Format(wxT("%s:%lld"), containerName, offset) ] = b;
+}
+
+bool DirManager::OwnsBlockContainer(const BlockContainer &container)
+{
+   std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+   const auto iter =
+      mBlockContainers.find( wxFileName{ container.GetPath() }.GetFullName() );
+   return iter != mBlockContainers.end() &&
+      iter->second.lock().get() == &container;
+}
+
+std::vector< std::shared_ptr< BlockContainer > >
+DirManager::GetBlockContainers()
+{
+   std::vector< std::shared_ptr< BlockContainer > > result;
+   std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+   for (auto iter = mBlockContainers.begin();
+        iter != mBlockContainers.end();) {
+      if (auto pContainer = iter->second.lock()) {
+         result.push_back(pContainer);
+         ++iter;
+      }
+      else
+         iter = mBlockContainers.erase(iter);
+   }
+   return result;
+}
+
+void DirManager::CompactBlockContainers()
+{
+   // Percentage of garbage in a container that is worth a copy
+   const long threshold = std::max(1L,
+      gPrefs->Read(wxT("/Directories/PackedCompactThreshold"), 50L));
+
+   for (const auto &pContainer : GetBlockContainers()) {
+      const auto size = pContainer->GetFileSize();
+      const auto garbage = size - pContainer->GetLiveBytes();
+      if (garbage <= 0 || garbage * 100 < size * threshold)
+         continue;
+
+      FilePath newPath;
+      {
+         std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+         newPath = MakeBlockContainerPath();
+      }
+      auto pNew = pContainer->Compact(newPath);
+
+      // The project file last saved may still name the old container
+      pContainer->Retain();
+
+      std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+      mBlockContainers[ wxFileName{ newPath }.GetFullName() ] = pNew;
+      mBlockContainers.erase(
+         wxFileName{ pContainer->GetPath() }.GetFullName() );
+      if (mAppendContainer == pContainer)
+         mAppendContainer = pNew;
+      mCompactedContainers.push_back(pContainer);
+   }
+}
+
+void DirManager::CommitCompaction()
+{
+   std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+   for (const auto &pContainer : mCompactedContainers)
+      pContainer->Discard();
+   mCompactedContainers.clear();
+}
+
 bool DirManager::ContainsBlockFile(const BlockFile *b) const
 {
    if (!b)
       return false;
    auto result = b->GetFileName();
+   std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
    BlockHash::const_iterator it = mBlockFileHash.find(result.name.GetName());
    if (it == mBlockFileHash.end())
       return false;
@@ -1234,6 +1463,13 @@ bool DirManager::ContainsBlockFile(const BlockFile *b) const
 }
 
 bool DirManager::ContainsBlockFile(const wxString &filepath) const
+{
+   std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
+   return ContainsBlockFileLocked(filepath);
+}
+
+// Call with mBlockFileHashMutex locked.
+bool DirManager::ContainsBlockFileLocked(const wxString &filepath) const
 {
    // check what the hash returns in case the blockfile is from a different project
    BlockHash::const_iterator it = mBlockFileHash.find(filepath);
@@ -1250,6 +1486,19 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
    if (!b)
       THROW_INCONSISTENCY_EXCEPTION;
 
+   // A packed block of another project must not stay in that project's
+   // container, which this project does not save or move
+   if (auto pPacked = dynamic_cast< PackedBlockFile* >( &*b )) {
+      const auto &pExtent = pPacked->GetExtent();
+      if (!OwnsBlockContainer( *pExtent->GetLocation().pContainer )) {
+         const auto format = pExtent->GetFormat();
+         const auto len = b->GetLength();
+         SampleBuffer buffer( len, format );
+         b->ReadData( buffer.ptr(), format, 0, len );
+         return NewSampleBlockFile( buffer.ptr(), len, format );
+      }
+   }
+
    auto result = b->GetFileName();
    const auto &fn = result.name;
 
@@ -1259,8 +1508,10 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
       //but it's something to watch out for.
       //
       // LLL: Except for silent block files which have uninitialized filename.
-      if (fn.IsOk())
+      if (fn.IsOk()) {
+         std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
          mBlockFileHash[fn.GetName()] = b;
+      }
       return b;
    }
 
@@ -1272,9 +1523,20 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
       b2 = b->Copy(wxFileNameWrapper{});
    else
    {
-      wxFileNameWrapper newFile{ MakeBlockFileName() };
+      wxFileNameWrapper newFile;
+      {
+         std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
+         newFile = MakeBlockFileName();
+         // Reserve the name until the copy is in the hash, so that no other
+         // thread gets it meanwhile
+         mPendingBlockFileNames.insert( newFile.GetName() );
+      }
       const wxString newName{newFile.GetName()};
       const wxString newPath{ newFile.GetFullPath() };
+      auto cleanup = finally( [&] {
+         std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
+         mPendingBlockFileNames.erase( newName );
+      } );
 
       // We assume that the NEW file should have the same extension
       // as the existing file
@@ -1296,6 +1558,7 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
 
       b2 = b->Copy(std::move(newFile));
 
+      std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
       mBlockFileHash[newName] = b2;
       aliasList.push_back(newPath);
    }
@@ -1370,6 +1633,7 @@ bool DirManager::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
    //
 
    wxString name = target->GetFileName().name.GetName();
+   std::lock_guard< std::mutex > lock{ mBlockFileHashMutex };
    auto &wRetrieved = mBlockFileHash[name];
    BlockFilePtr retrieved = wRetrieved.lock();
    if (retrieved) {
@@ -1680,6 +1944,20 @@ void DirManager::FindMissingAUs(
       }
       ++iter;
    }
+
+   // Packed blocks have no file names of their own, but those of missing
+   // or short containers were remembered while loading
+   BlockHash missingPacked;
+   {
+      std::lock_guard< std::mutex > lock{ mBlockContainersMutex };
+      missingPacked.swap(mMissingPackedBlockFiles);
+   }
+   for (const auto &pair : missingPacked) {
+      if (auto b = pair.second.lock()) {
+         missingAUHash[pair.first] = b;
+         wxLogWarning(_("Missing data block in container: '%s'"), pair.first);
+      }
+   }
 }
 
 // Find .au and .auf files that are not in the project.
@@ -1702,6 +1980,7 @@ void DirManager::FindOrphanBlockFiles(
       if ((mBlockFileHash.find(basename) == mBlockFileHash.end()) && // is orphan
             // Consider only Audacity data files.
             // Specifically, ignore <branding> JPG and <import> OGG ("Save Compressed Copy").
+            // Containers of packed blocks are not checked either.
             (ext.IsSameAs(wxT("au"), false) ||
                ext.IsSameAs(wxT("auf"), false)))
       {
@@ -1799,6 +2078,18 @@ void DirManager::FillBlockfilesCache()
 #endif // DEPRECATED_AUDIO_CACHE
 }
 
+// static
+MappedFileCache &DirManager::GetMappedFiles()
+{
+   // Each mapping of a full sized block costs about 1 MB of address space
+   // but no file handle
+   static MappedFileCache theCache{
+      (size_t)std::max(1L,
+         gPrefs->Read(wxT("/Directories/MappedBlockFiles"), 64L))
+   };
+   return theCache;
+}
+
 void DirManager::WriteCacheToDisk()
 {
    BlockHash::iterator iter;
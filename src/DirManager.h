@@ -16,14 +16,19 @@
 
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "ClientData.h"
 
 class wxFileNameWrapper;
 class AudacityProject;
 class BlockArray;
+class BlockContainer;
 class BlockFile;
+class MappedFileCache;
 class ProgressDialog;
 
 using DirHash = std::unordered_map<int, int>;
@@ -107,6 +112,7 @@ class PROFILE_DLL_API DirManager final
    size_t NumBlockFiles() const { return mBlockFileHash.size(); }
 
    static void SetTempDir(const wxString &_temp) { globaltemp = _temp; }
+   static const wxString &GetTempDir() { return globaltemp; }
 
    class ProjectSetter
    {
@@ -142,6 +148,35 @@ class PROFILE_DLL_API DirManager final
    using BlockFileFactory = std::function< BlockFilePtr( wxFileNameWrapper ) >;
    BlockFilePtr NewBlockFile( const BlockFileFactory &factory );
 
+   // Make a block of the given samples:  an extent of a BlockContainer,
+   // if packed storage is on and the write need not be deferred, else a
+   // SimpleBlockFile, maybe queued for BlockFileWriter.
+   // May throw FileException.
+   BlockFilePtr NewSampleBlockFile(
+      samplePtr sampleData, size_t sampleLen, sampleFormat format,
+      bool allowDeferredWrite = false);
+
+   // Whether NewSampleBlockFile() packs blocks; initially the preference
+   // /Directories/PackedBlockFiles
+   bool GetPackedBlockFiles() const { return mPackedBlockFiles; }
+   void SetPackedBlockFiles(bool packed) { mPackedBlockFiles = packed; }
+
+   // Find or open a container in the data directory, by file name.
+   // Returns null if there is no such file.
+   std::shared_ptr< BlockContainer > GetBlockContainer(const wxString &name);
+   // Remember a block loaded from the project file whose container was
+   // missing or too short, for FindMissingAUs()
+   void AddMissingPackedBlockFile(
+      const wxString &containerName, long long offset, const BlockFilePtr &b);
+
+   // Copy what is still used of each container with too much garbage
+   // to a NEW container.  Call before writing the project file.
+   // May throw FileException; containers already compacted stay so.
+   void CompactBlockContainers();
+   // Remove the containers emptied by CompactBlockContainers(), once the
+   // project file no longer names them
+   void CommitCompaction();
+
    /// Returns true if the blockfile pointed to by b is contained by the DirManager
    bool ContainsBlockFile(const BlockFile *b) const;
    /// Check for existing using filename using complete filename
@@ -149,7 +184,8 @@ class PROFILE_DLL_API DirManager final
 
    // Adds one to the reference count of the block file,
    // UNLESS it is "locked", then it makes a NEW copy of
-   // the BlockFile.
+   // the BlockFile.  A packed block of another project is copied into
+   // this one's storage, locked or not.
    // May throw an exception in case of disk space exhaustion, otherwise
    // returns non-null.
    BlockFilePtr CopyBlockFile(const BlockFilePtr &b);
@@ -234,12 +270,41 @@ class PROFILE_DLL_API DirManager final
    // A no-fail operation that does not throw
    void FillBlockfilesCache();
 
+   // Bounded collection of memory mappings of block files, shared by all
+   // projects.  Files must be released from it before they are rewritten,
+   // moved or removed.
+   static MappedFileCache &GetMappedFiles();
+
  private:
 
    wxFileNameWrapper MakeBlockFileName();
+   bool ContainsBlockFileLocked(const wxString &filepath) const;
    wxFileNameWrapper MakeBlockFilePath(const wxString &value);
 
    BlockHash mBlockFileHash; // repository for blockfiles
+   // Names given out by MakeBlockFileName() whose files are still being made
+   std::unordered_set< wxString > mPendingBlockFileNames;
+   // Guards the above, the balance info and aliasList, because effects may
+   // make blocks on several threads at once
+   mutable std::mutex mBlockFileHashMutex;
+
+   std::vector< std::shared_ptr< BlockContainer > > GetBlockContainers();
+   // Whether the container is one of this project's
+   bool OwnsBlockContainer(const BlockContainer &container);
+   FilePath MakeBlockContainerPath();
+
+   // Open containers, by file name
+   std::unordered_map< wxString, std::weak_ptr< BlockContainer > >
+      mBlockContainers;
+   // Where NewSampleBlockFile() appends
+   std::shared_ptr< BlockContainer > mAppendContainer;
+   // Kept until the saved project no longer refers to them
+   std::vector< std::shared_ptr< BlockContainer > > mCompactedContainers;
+   // From AddMissingPackedBlockFile(), until FindMissingAUs()
+   BlockHash mMissingPackedBlockFiles;
+   // Guards the above, because blocks may be made on other threads
+   std::mutex mBlockContainersMutex;
+   bool mPackedBlockFiles;
 
    // Hashes for management of the sub-directory tree of _data
    struct BalanceInfo
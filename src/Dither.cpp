@@ -63,7 +63,10 @@ const int Dither::BUF_SIZE = 8;
 // Lipshitz's minimally audible FIR
 const float Dither::SHAPED_BS[] = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
 
-// This is supposed to produce white noise and no dc
+// This is supposed to produce white noise and no dc.
+// Rectangle and triangle dither draw from DitherNoise instead, which the
+// vector code shares; shaped dither, which has no vector form, still
+// uses this.
 #define DITHER_NOISE (rand() / (float)RAND_MAX - 0.5f)
 
 // The following is a rather ugly, but fast implementation
@@ -213,6 +216,12 @@ Dither::Dither()
     Reset();
 }
 
+Dither::Dither(unsigned seed)
+    : mNoise{ seed }
+{
+    Reset();
+}
+
 void Dither::Reset()
 {
     mTriangleState = 0;
@@ -301,6 +310,10 @@ void Dither::Apply(enum DitherType ditherType,
         // No clipping should be necessary.
         float* d = (float*)dest;
 
+        if (destStride == 1 && sourceStride == 1 &&
+            ApplyVectorized(ditherType, source, sourceFormat, dest, destFormat, len))
+            return;
+
         if (sourceFormat == int16Sample)
         {
             short* s = (short*)source;
@@ -326,6 +339,10 @@ void Dither::Apply(enum DitherType ditherType,
     } else
     {
         // We must do dithering
+        if (destStride == 1 && sourceStride == 1 &&
+            ApplyVectorized(ditherType, source, sourceFormat, dest, destFormat, len))
+            return;
+
         switch (ditherType)
         {
         case DitherType::none:
@@ -348,6 +365,37 @@ void Dither::Apply(enum DitherType ditherType,
     }
 }
 
+bool Dither::ApplyVectorized(DitherType ditherType,
+                             const samplePtr source, sampleFormat sourceFormat,
+                             samplePtr dest, sampleFormat destFormat,
+                             unsigned int len)
+{
+    if (destFormat == floatSample)
+    {
+        if (sourceFormat == int16Sample)
+            return DitherKernels::Int16ToFloat((const short*)source, (float*)dest, len);
+        if (sourceFormat == int24Sample)
+            return DitherKernels::Int24ToFloat((const int*)source, (float*)dest, len);
+        return false;
+    }
+
+    if (ditherType == DitherType::shaped)
+        return false;
+    if (ditherType == DitherType::triangle)
+        Reset(); // reset dither filter for this NEW conversion
+
+    if (sourceFormat == int24Sample && destFormat == int16Sample)
+        return DitherKernels::Int24ToInt16(ditherType, mNoise, mTriangleState,
+            (const int*)source, (short*)dest, len);
+    if (sourceFormat == floatSample && destFormat == int16Sample)
+        return DitherKernels::FloatToInt16(ditherType, mNoise, mTriangleState,
+            (const float*)source, (short*)dest, len);
+    if (sourceFormat == floatSample && destFormat == int24Sample)
+        return DitherKernels::FloatToInt24(ditherType, mNoise, mTriangleState,
+            (const float*)source, (int*)dest, len);
+    return false;
+}
+
 // Dither implementations
 
 // No dither, just return sample
@@ -359,13 +407,13 @@ inline float Dither::NoDither(float sample)
 // Rectangle dithering, apply one-step noise
 inline float Dither::RectangleDither(float sample)
 {
-    return sample - DITHER_NOISE;
+    return sample - mNoise.Next();
 }
 
 // Triangle dither - high pass filtered
 inline float Dither::TriangleDither(float sample)
 {
-    float r = DITHER_NOISE;
+    float r = mNoise.Next();
     float result = sample + r - mTriangleState;
     mTriangleState = r;
 
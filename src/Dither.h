@@ -11,6 +11,7 @@
 #define __AUDACITY_DITHER_H__
 
 #include "audacity/Types.h" // for samplePtr
+#include "DitherKernels.h"
 
 template< typename Enum > class EnumSetting;
 
@@ -29,6 +30,8 @@ public:
 
     /// Default constructor
     Dither();
+    /// Draw the same noise as any other Dither with this seed
+    explicit Dither(unsigned seed);
 
     /// Reset state of the dither.
     void Reset();
@@ -45,6 +48,12 @@ public:
                unsigned int destStride = 1);
 
 private:
+    // Try the vector code for unit strides
+    bool ApplyVectorized(DitherType ditherType,
+                         const samplePtr source, sampleFormat sourceFormat,
+                         samplePtr dest, sampleFormat destFormat,
+                         unsigned int len);
+
     // Dither methods
     float NoDither(float sample);
     float RectangleDither(float sample);
@@ -60,6 +69,7 @@ private:
     int mPhase;
     float mTriangleState;
     float mBuffer[8 /* = BUF_SIZE */];
+    DitherNoise mNoise;
 };
 
 #endif /* __AUDACITY_DITHER_H__ */
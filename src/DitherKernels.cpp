@@ -0,0 +1,644 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  DitherKernels.cpp
+
+*******************************************************************//**
+
+\class DitherNoise
+\brief A fast source of dither noise, which vector code can use too.
+
+  It replaces rand(), which was called for every sample, is not
+  vectorizable, and is shared with everything else in the program.
+
+*//****************************************************************//**
+
+\namespace DitherKernels
+\brief SSE2 and AVX2 versions of the sample format conversions.
+
+  SSE2 is used whenever the compiler targets it, which it always does for
+  x86-64.  AVX2 is compiled with a function attribute instead of a global
+  flag, and chosen at run time only if the processor and the operating
+  system support it.  Other processors use the scalar code in Dither.cpp.
+
+  Vector and scalar code perform the same floating point operations in
+  the same order, and round in the same way, so the results are
+  identical.  The one difference is that a NaN input becomes zero (as in
+  shaped dither) rather than whatever lrintf() made of it.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "DitherKernels.h"
+
+#include "Dither.h"
+
+// Erik de Castro Lopo's header file that
+// makes sure that we have lrint and lrintf
+// (Note: this file should be included first)
+#include "float_cast.h"
+
+#include <atomic>
+#include <string.h>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #define DITHER_KERNELS_SSE2
+   #include <emmintrin.h>
+
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && \
+       (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define DITHER_KERNELS_AVX2
+      #include <immintrin.h>
+      #if defined(_MSC_VER)
+         #include <intrin.h>
+         #define AVX2_TARGET
+      #else
+         #include <cpuid.h>
+         #define AVX2_TARGET __attribute__((target("avx2")))
+      #endif
+   #endif
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+uint32_t NextInstanceSeed()
+{
+   static std::atomic< uint32_t > sInstances{ 0 };
+   return 0x9E3779B9u * (1 + sInstances++);
+}
+}
+
+DitherNoise::DitherNoise()
+   : DitherNoise{ NextInstanceSeed() }
+{
+}
+
+DitherNoise::DitherNoise(uint32_t seed)
+{
+   for (auto &lane : mLanes) {
+      // A good integer hash spreads out the consecutive seeds
+      seed += 0x9E3779B9u;
+      uint32_t x = seed;
+      x ^= x >> 16;
+      x *= 0x7FEB352Du;
+      x ^= x >> 15;
+      x *= 0x846CA68Bu;
+      x ^= x >> 16;
+      // Zero is a fixed point of xorshift
+      lane = x ? x : 1;
+   }
+}
+
+void DitherNoise::Refill()
+{
+   for (size_t ii = 0; ii < Lanes; ++ii) {
+      auto x = mLanes[ii];
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      mLanes[ii] = x;
+      mBlock[ii] = ToFloat(x);
+   }
+   mIndex = 0;
+}
+
+float DitherNoise::ToFloat(uint32_t state)
+{
+   // Make a float in [1, 2), then shift it
+   const uint32_t bits = (state >> 9) | 0x3F800000u;
+   float result;
+   memcpy(&result, &bits, sizeof(result));
+   return result - 1.5f;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using DitherKernels::InstructionSet;
+
+// The three conversions that dither.  Each supplies the scaling of a
+// source sample to the destination range, and the storing of rounded
+// values, in scalar and vector forms.
+
+inline float ClipUnit(float sample)
+{
+   // NaN fails both comparisons
+   return sample > 1.0f ? 1.0f : sample < -1.0f ? -1.0f : sample == sample ? sample : 0.0f;
+}
+
+struct FloatToInt16Format {
+   using Source = float;
+   using Dest = short;
+   static float Lo() { return -32768.0f; }
+   static float Hi() { return 32767.0f; }
+   static float Load(const float *src) { return ClipUnit(*src) * 32768.0f; }
+};
+
+struct FloatToInt24Format {
+   using Source = float;
+   using Dest = int;
+   static float Lo() { return -8388608.0f; }
+   static float Hi() { return 8388607.0f; }
+   static float Load(const float *src) { return ClipUnit(*src) * 8388608.0f; }
+};
+
+struct Int24ToInt16Format {
+   using Source = int;
+   using Dest = short;
+   static float Lo() { return -32768.0f; }
+   static float Hi() { return 32767.0f; }
+   // Same as dividing by 2^23 and multiplying by 2^15; all exact
+   static float Load(const int *src) { return *src / 256.0f; }
+};
+
+template< typename Format >
+void DitherScalar(DitherType type, DitherNoise &noise, float &triangleState,
+   const typename Format::Source *src, typename Format::Dest *dst, size_t len)
+{
+   for (size_t ii = 0; ii < len; ++ii) {
+      auto sample = Format::Load(src + ii);
+      if (type == DitherType::rectangle)
+         sample = sample - noise.Next();
+      else if (type == DitherType::triangle) {
+         const auto r = noise.Next();
+         sample = sample + r - triangleState;
+         triangleState = r;
+      }
+      const int x = lrintf(sample);
+      dst[ii] = x > Format::Hi() ? (int)Format::Hi()
+         : x < Format::Lo() ? (int)Format::Lo()
+         : x;
+   }
+}
+
+#ifdef DITHER_KERNELS_SSE2
+
+namespace SSE2 {
+
+inline __m128i XorShift(__m128i x)
+{
+   x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+   x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+   return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+inline __m128 ToFloat(__m128i x)
+{
+   const auto bits =
+      _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3F800000));
+   return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.5f));
+}
+
+inline __m128 ClipUnit(__m128 x)
+{
+   // Zero NaNs, then clip; max and min return their second operands
+   // when comparisons fail
+   x = _mm_and_ps(x, _mm_cmpord_ps(x, x));
+   return _mm_max_ps(_mm_set1_ps(-1.0f), _mm_min_ps(_mm_set1_ps(1.0f), x));
+}
+
+inline __m128i Round(__m128 x, __m128 lo, __m128 hi)
+{
+   // Clipping before rounding gives the same result as clipping after,
+   // because the bounds are integers.  Rounding uses the current mode,
+   // like lrintf.
+   return _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(hi, x), lo));
+}
+
+inline __m128 Load(const float *src, float scale)
+{
+   return _mm_mul_ps(ClipUnit(_mm_loadu_ps(src)), _mm_set1_ps(scale));
+}
+
+inline __m128 Load(const int *src)
+{
+   return _mm_mul_ps(
+      _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+      _mm_set1_ps(1.0f / 256.0f));
+}
+
+// Load eight samples
+inline void Load8(const float *src, short *, __m128 &a, __m128 &b)
+{
+   a = Load(src, 32768.0f), b = Load(src + 4, 32768.0f);
+}
+
+inline void Load8(const float *src, int *, __m128 &a, __m128 &b)
+{
+   a = Load(src, 8388608.0f), b = Load(src + 4, 8388608.0f);
+}
+
+inline void Load8(const int *src, short *, __m128 &a, __m128 &b)
+{
+   a = Load(src), b = Load(src + 4);
+}
+
+inline void Store8(short *dst, __m128i a, __m128i b)
+{
+   // Values are already within range, so saturation doesn't change them
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(a, b));
+}
+
+inline void Store8(int *dst, __m128i a, __m128i b)
+{
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), a);
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4), b);
+}
+
+// Whole blocks of DitherNoise::Lanes samples
+template< typename Format >
+void Dither(DitherType type, DitherNoise &noise, float &triangleState,
+   const typename Format::Source *src, typename Format::Dest *dst,
+   size_t nBlocks)
+{
+   const auto lanes = reinterpret_cast<__m128i*>(noise.GetLanes());
+   auto stateA = _mm_loadu_si128(lanes), stateB = _mm_loadu_si128(lanes + 1);
+   // The previous noise value, in the lowest element
+   auto previous = _mm_set_ss(triangleState);
+   const auto lo = _mm_set1_ps(Format::Lo()), hi = _mm_set1_ps(Format::Hi());
+
+   for (size_t ii = 0; ii < nBlocks; ++ii, src += 8, dst += 8) {
+      __m128 a, b;
+      Load8(src, dst, a, b);
+      if (type != DitherType::none) {
+         stateA = XorShift(stateA), stateB = XorShift(stateB);
+         const auto rA = ToFloat(stateA), rB = ToFloat(stateB);
+         if (type == DitherType::rectangle)
+            a = _mm_sub_ps(a, rA), b = _mm_sub_ps(b, rB);
+         else {
+            // Shift the noise up one element to pair each sample with the
+            // noise of its predecessor
+            const auto iA = _mm_castps_si128(rA), iB = _mm_castps_si128(rB);
+            const auto pA = _mm_or_ps(
+               _mm_castsi128_ps(_mm_slli_si128(iA, 4)), previous);
+            const auto pB = _mm_castsi128_ps(_mm_or_si128(
+               _mm_slli_si128(iB, 4), _mm_srli_si128(iA, 12)));
+            previous = _mm_castsi128_ps(_mm_srli_si128(iB, 12));
+            a = _mm_sub_ps(_mm_add_ps(a, rA), pA);
+            b = _mm_sub_ps(_mm_add_ps(b, rB), pB);
+         }
+      }
+      Store8(dst, Round(a, lo, hi), Round(b, lo, hi));
+   }
+
+   _mm_storeu_si128(lanes, stateA), _mm_storeu_si128(lanes + 1, stateB);
+   triangleState = _mm_cvtss_f32(previous);
+}
+
+void Int16ToFloat(const short *src, float *dst, size_t nBlocks)
+{
+   const auto scale = _mm_set1_ps(1.0f / 32768.0f);
+   for (size_t ii = 0; ii < nBlocks; ++ii, src += 8, dst += 8) {
+      const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+      // Sign-extend by unpacking into the high halves, then shifting
+      const auto a = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+      const auto b = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+      _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+      _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+   }
+}
+
+void Int24ToFloat(const int *src, float *dst, size_t nBlocks)
+{
+   const auto scale = _mm_set1_ps(1.0f / 8388608.0f);
+   for (size_t ii = 0; ii < nBlocks; ++ii, src += 8, dst += 8) {
+      const auto p = reinterpret_cast<const __m128i*>(src);
+      _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(p)), scale));
+      _mm_storeu_ps(dst + 4,
+         _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(p + 1)), scale));
+   }
+}
+
+} // namespace SSE2
+
+#endif
+
+#ifdef DITHER_KERNELS_AVX2
+
+// Every function here needs the target attribute, including the inline ones,
+// or the compiler refuses to inline the intrinsics into them.
+namespace AVX2 {
+
+AVX2_TARGET inline __m256i XorShift(__m256i x)
+{
+   x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+   x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+   return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+
+AVX2_TARGET inline __m256 ToFloat(__m256i x)
+{
+   const auto bits = _mm256_or_si256(
+      _mm256_srli_epi32(x, 9), _mm256_set1_epi32(0x3F800000));
+   return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.5f));
+}
+
+AVX2_TARGET inline __m256 ClipUnit(__m256 x)
+{
+   x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+   return _mm256_max_ps(
+      _mm256_set1_ps(-1.0f), _mm256_min_ps(_mm256_set1_ps(1.0f), x));
+}
+
+AVX2_TARGET inline __m256i Round(__m256 x, __m256 lo, __m256 hi)
+{
+   return _mm256_cvtps_epi32(_mm256_max_ps(_mm256_min_ps(hi, x), lo));
+}
+
+AVX2_TARGET inline __m256 Load8(const float *src, short *)
+{
+   return _mm256_mul_ps(
+      ClipUnit(_mm256_loadu_ps(src)), _mm256_set1_ps(32768.0f));
+}
+
+AVX2_TARGET inline __m256 Load8(const float *src, int *)
+{
+   return _mm256_mul_ps(
+      ClipUnit(_mm256_loadu_ps(src)), _mm256_set1_ps(8388608.0f));
+}
+
+AVX2_TARGET inline __m256 Load8(const int *src, short *)
+{
+   return _mm256_mul_ps(_mm256_cvtepi32_ps(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src))),
+      _mm256_set1_ps(1.0f / 256.0f));
+}
+
+AVX2_TARGET inline void Store8(short *dst, __m256i x)
+{
+   // Pack the two 128 bit halves, because _mm256_packs_epi32 would
+   // interleave them
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(
+      _mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+}
+
+AVX2_TARGET inline void Store8(int *dst, __m256i x)
+{
+   _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), x);
+}
+
+template< typename Format >
+AVX2_TARGET void Dither(DitherType type, DitherNoise &noise,
+   float &triangleState,
+   const typename Format::Source *src, typename Format::Dest *dst,
+   size_t nBlocks)
+{
+   const auto lanes = reinterpret_cast<__m256i*>(noise.GetLanes());
+   auto state = _mm256_loadu_si256(lanes);
+   // The previous noise value, in every element
+   auto previous = _mm256_set1_ps(triangleState);
+   const auto rotate = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+   const auto last = _mm256_set1_epi32(7);
+   const auto lo = _mm256_set1_ps(Format::Lo());
+   const auto hi = _mm256_set1_ps(Format::Hi());
+
+   for (size_t ii = 0; ii < nBlocks; ++ii, src += 8, dst += 8) {
+      auto x = Load8(src, dst);
+      if (type != DitherType::none) {
+         state = XorShift(state);
+         const auto r = ToFloat(state);
+         if (type == DitherType::rectangle)
+            x = _mm256_sub_ps(x, r);
+         else {
+            // Pair each sample with the noise of its predecessor
+            const auto p = _mm256_blend_ps(
+               _mm256_permutevar8x32_ps(r, rotate), previous, 1);
+            previous = _mm256_permutevar8x32_ps(r, last);
+            x = _mm256_sub_ps(_mm256_add_ps(x, r), p);
+         }
+      }
+      Store8(dst, Round(x, lo, hi));
+   }
+
+   _mm256_storeu_si256(lanes, state);
+   triangleState = _mm256_cvtss_f32(previous);
+   // Avoid the penalty for mixing with SSE code compiled without VEX
+   _mm256_zeroupper();
+}
+
+AVX2_TARGET void Int16ToFloat(const short *src, float *dst, size_t nBlocks)
+{
+   const auto scale = _mm256_set1_ps(1.0f / 32768.0f);
+   for (size_t ii = 0; ii < nBlocks; ++ii, src += 8, dst += 8) {
+      const auto x = _mm256_cvtepi16_epi32(
+         _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+      _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+   }
+   _mm256_zeroupper();
+}
+
+AVX2_TARGET void Int24ToFloat(const int *src, float *dst, size_t nBlocks)
+{
+   const auto scale = _mm256_set1_ps(1.0f / 8388608.0f);
+   for (size_t ii = 0; ii < nBlocks; ++ii, src += 8, dst += 8) {
+      const auto x =
+         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+      _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+   }
+   _mm256_zeroupper();
+}
+
+} // namespace AVX2
+
+bool CpuHasAVX2()
+{
+#if defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return false;
+   __cpuid(info, 1);
+   const unsigned ecx = info[2];
+#else
+   unsigned eax, ebx, ecx, edx;
+   if (__get_cpuid_max(0, nullptr) < 7)
+      return false;
+   __cpuid(1, eax, ebx, ecx, edx);
+#endif
+
+   // The processor must have AVX, and the operating system must save the
+   // YMM registers on context switches
+   const unsigned osxsave = 1u << 27, avx = 1u << 28;
+   if ((ecx & (osxsave | avx)) != (osxsave | avx))
+      return false;
+
+#if defined(_MSC_VER)
+   if ((_xgetbv(0) & 6) != 6)
+      return false;
+   __cpuidex(info, 7, 0);
+   const unsigned ebx7 = info[1];
+#else
+   unsigned xcr0, xcr0High;
+   __asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0High) : "c" (0));
+   if ((xcr0 & 6) != 6)
+      return false;
+   __cpuid_count(7, 0, eax, ebx, ecx, edx);
+   const unsigned ebx7 = ebx;
+#endif
+   return (ebx7 & (1u << 5)) != 0;
+}
+
+#endif
+
+InstructionSet DetectInstructionSet()
+{
+#if defined(DITHER_KERNELS_AVX2)
+   if (CpuHasAVX2())
+      return InstructionSet::AVX2;
+#endif
+#if defined(DITHER_KERNELS_SSE2)
+   return InstructionSet::SSE2;
+#else
+   return InstructionSet::Scalar;
+#endif
+}
+
+std::atomic< InstructionSet > &CurrentInstructionSet()
+{
+   static std::atomic< InstructionSet > current{
+      DitherKernels::Available() };
+   return current;
+}
+
+template< typename Format >
+bool ConvertDithered(DitherType type, DitherNoise &noise, float &triangleState,
+   const typename Format::Source *src, typename Format::Dest *dst, size_t len)
+{
+   if (type != DitherType::none &&
+       type != DitherType::rectangle &&
+       type != DitherType::triangle)
+      return false;
+
+   const auto set = CurrentInstructionSet().load(std::memory_order_relaxed);
+   if (set == InstructionSet::Scalar)
+      return false;
+
+   // Vector code starts at the beginning of a block of noise
+   size_t head = 0;
+   if (type != DitherType::none)
+      while (head < len && !noise.AtBlockStart())
+         ++head;
+   DitherScalar< Format >(type, noise, triangleState, src, dst, head);
+   src += head, dst += head, len -= head;
+
+   const auto nBlocks = len / DitherNoise::Lanes;
+#if defined(DITHER_KERNELS_AVX2)
+   if (set == InstructionSet::AVX2)
+      AVX2::Dither< Format >(type, noise, triangleState, src, dst, nBlocks);
+   else
+#endif
+#if defined(DITHER_KERNELS_SSE2)
+      SSE2::Dither< Format >(type, noise, triangleState, src, dst, nBlocks);
+#endif
+
+   const auto done = nBlocks * DitherNoise::Lanes;
+   DitherScalar< Format >(type, noise, triangleState,
+      src + done, dst + done, len - done);
+   return true;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace DitherKernels {
+
+InstructionSet Available()
+{
+   static const auto available = DetectInstructionSet();
+   return available;
+}
+
+InstructionSet Get()
+{
+   return CurrentInstructionSet().load(std::memory_order_relaxed);
+}
+
+void Set(InstructionSet set)
+{
+   if (set > Available())
+      set = Available();
+   CurrentInstructionSet().store(set, std::memory_order_relaxed);
+}
+
+const char *GetName(InstructionSet set)
+{
+   switch (set) {
+      case InstructionSet::SSE2:
+         return "SSE2";
+      case InstructionSet::AVX2:
+         return "AVX2";
+      default:
+         return "scalar";
+   }
+}
+
+bool FloatToInt16(DitherType type, DitherNoise &noise, float &triangleState,
+   const float *src, short *dst, size_t len)
+{
+   return ConvertDithered< FloatToInt16Format >(
+      type, noise, triangleState, src, dst, len);
+}
+
+bool FloatToInt24(DitherType type, DitherNoise &noise, float &triangleState,
+   const float *src, int *dst, size_t len)
+{
+   return ConvertDithered< FloatToInt24Format >(
+      type, noise, triangleState, src, dst, len);
+}
+
+bool Int24ToInt16(DitherType type, DitherNoise &noise, float &triangleState,
+   const int *src, short *dst, size_t len)
+{
+   return ConvertDithered< Int24ToInt16Format >(
+      type, noise, triangleState, src, dst, len);
+}
+
+bool Int16ToFloat(const short *src, float *dst, size_t len)
+{
+   const auto set = Get();
+   if (set == InstructionSet::Scalar)
+      return false;
+
+   const auto nBlocks = len / 8;
+#if defined(DITHER_KERNELS_AVX2)
+   if (set == InstructionSet::AVX2)
+      AVX2::Int16ToFloat(src, dst, nBlocks);
+   else
+#endif
+#if defined(DITHER_KERNELS_SSE2)
+      SSE2::Int16ToFloat(src, dst, nBlocks);
+#endif
+
+   for (auto ii = nBlocks * 8; ii < len; ++ii)
+      dst[ii] = src[ii] / 32768.0f;
+   return true;
+}
+
+bool Int24ToFloat(const int *src, float *dst, size_t len)
+{
+   const auto set = Get();
+   if (set == InstructionSet::Scalar)
+      return false;
+
+   const auto nBlocks = len / 8;
+#if defined(DITHER_KERNELS_AVX2)
+   if (set == InstructionSet::AVX2)
+      AVX2::Int24ToFloat(src, dst, nBlocks);
+   else
+#endif
+#if defined(DITHER_KERNELS_SSE2)
+      SSE2::Int24ToFloat(src, dst, nBlocks);
+#endif
+
+   for (auto ii = nBlocks * 8; ii < len; ++ii)
+      dst[ii] = src[ii] / 8388608.0f;
+   return true;
+}
+
+} // namespace DitherKernels
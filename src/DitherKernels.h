@@ -0,0 +1,90 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  DitherKernels.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_DITHER_KERNELS__
+#define __AUDACITY_DITHER_KERNELS__
+
+#include <cstddef>
+#include <cstdint>
+
+enum DitherType : unsigned;
+
+/// Uniform noise in [-0.5, 0.5) for rectangle and triangle dither.
+/// Eight interleaved xorshift32 generators each supply every eighth
+/// value, so that vector code can make a block of eight at once, yet scalar
+/// and vector code draw the same sequence.
+class DitherNoise
+{
+public:
+   static constexpr size_t Lanes = 8;
+
+   /// Each instance gets a different seed
+   DitherNoise();
+   /// Instances with equal seeds draw the same sequence
+   explicit DitherNoise(uint32_t seed);
+
+   float Next()
+   {
+      if (mIndex == Lanes)
+         Refill();
+      return mBlock[mIndex++];
+   }
+
+   /// True when the next value begins a block of Lanes values
+   bool AtBlockStart() const { return mIndex == Lanes; }
+
+   /// Advance all generators and compute the next block of values
+   void Refill();
+
+   /// The generator states; vector code may advance them, in step, when
+   /// AtBlockStart() is true
+   uint32_t *GetLanes() { return mLanes; }
+
+   /// Map the high 23 bits of a state to [-0.5, 0.5)
+   static float ToFloat(uint32_t state);
+
+private:
+   uint32_t mLanes[Lanes];
+   float mBlock[Lanes];
+   size_t mIndex{ Lanes };
+};
+
+/// Vector implementations of the conversions done by Dither::Apply,
+/// for buffers with unit stride.  They give the same results as the
+/// scalar loops in Dither.cpp, sample for sample, when drawing the same
+/// noise.  Shaped dither feeds back each rounding error into the next
+/// sample, so it has no vector form and is not done here.
+namespace DitherKernels
+{
+   enum class InstructionSet { Scalar, SSE2, AVX2 };
+
+   /// The best instruction set this machine supports
+   InstructionSet Available();
+
+   /// The instruction set in use, Available() unless overridden
+   InstructionSet Get();
+   /// For benchmarks and tests; limited to what is Available()
+   void Set(InstructionSet set);
+
+   const char *GetName(InstructionSet set);
+
+   /// Return false, having done nothing, if there is no vector code for
+   /// the dither type or the instruction set in use.
+   /// triangleState is the noise value of the previous sample
+   bool FloatToInt16(DitherType type, DitherNoise &noise, float &triangleState,
+      const float *src, short *dst, size_t len);
+   bool FloatToInt24(DitherType type, DitherNoise &noise, float &triangleState,
+      const float *src, int *dst, size_t len);
+   bool Int24ToInt16(DitherType type, DitherNoise &noise, float &triangleState,
+      const int *src, short *dst, size_t len);
+
+   bool Int16ToFloat(const short *src, float *dst, size_t len);
+   bool Int24ToFloat(const int *src, float *dst, size_t len);
+}
+
+#endif
@@ -0,0 +1,168 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MappedFile.cpp
+
+*******************************************************************//**
+
+\class MappedFile
+\brief A read-only memory mapping of an entire file.
+
+  The file descriptor is closed as soon as the view exists, so an open
+  MappedFile costs address space but no file handle.
+
+*//****************************************************************//**
+
+\class MappedFileCache
+\brief A bounded LRU of MappedFile objects, so that repeated reads of the
+same block files need not re-open and re-map them.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <wx/file.h>
+#include <wx/log.h>
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+MappedFile::MappedFile(const wxString &path)
+{
+   wxLogNull noLog;
+
+   wxFile file;
+   // Use wxFile to open, as elsewhere, because it copes with Unicode names
+   if (!wxFile::Exists(path) || !file.Open(path))
+      return;
+
+   const auto length = file.Length();
+   if (length <= 0 ||
+       (unsigned long long)length > std::numeric_limits<size_t>::max())
+      return;
+   const auto size = static_cast<size_t>(length);
+
+#if defined(__WXMSW__)
+   auto hFile = reinterpret_cast<HANDLE>(_get_osfhandle(file.fd()));
+   if (hFile == INVALID_HANDLE_VALUE)
+      return;
+   auto hMapping =
+      CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if (!hMapping)
+      return;
+   auto view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, size);
+   // The view keeps its own reference to the mapping object
+   CloseHandle(hMapping);
+   if (!view)
+      return;
+#else
+   auto view = mmap(nullptr, size, PROT_READ, MAP_SHARED, file.fd(), 0);
+   if (view == MAP_FAILED)
+      return;
+   // Block files are read from start to end, mostly
+   madvise(view, size, MADV_SEQUENTIAL);
+#endif
+
+   mData = static_cast<const char *>(view);
+   mSize = size;
+}
+
+MappedFile::~MappedFile()
+{
+   if (!mData)
+      return;
+#if defined(__WXMSW__)
+   UnmapViewOfFile(mData);
+#else
+   munmap(const_cast<char *>(mData), mSize);
+#endif
+}
+
+MappedFileCache::MappedFileCache(size_t maxFiles)
+   : mMaxFiles{ std::max<size_t>(1, maxFiles) }
+{
+}
+
+MappedFileCache::~MappedFileCache()
+{
+}
+
+MappedFilePtr MappedFileCache::Acquire(const wxString &path)
+{
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      auto iter = mIndex.find(path);
+      if (iter != mIndex.end()) {
+         // Move to the front
+         mList.splice(mList.begin(), mList, iter->second);
+         return iter->second->second;
+      }
+   }
+
+   // Do the system calls without holding the lock
+   auto pFile = std::make_shared< const MappedFile >(path);
+   if (!pFile->IsOk())
+      return {};
+
+   std::lock_guard< std::mutex > lock{ mMutex };
+   auto iter = mIndex.find(path);
+   if (iter != mIndex.end()) {
+      // Another thread won the race; use its mapping
+      mList.splice(mList.begin(), mList, iter->second);
+      return iter->second->second;
+   }
+   mList.emplace_front(path, pFile);
+   mIndex[path] = mList.begin();
+   Trim();
+   return pFile;
+}
+
+void MappedFileCache::Release(const wxString &path)
+{
+   MappedFilePtr pFile;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      auto iter = mIndex.find(path);
+      if (iter == mIndex.end())
+         return;
+      // Unmap outside the lock
+      pFile = std::move(iter->second->second);
+      mList.erase(iter->second);
+      mIndex.erase(iter);
+   }
+}
+
+void MappedFileCache::Clear()
+{
+   List list;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      list.swap(mList);
+      mIndex.clear();
+   }
+}
+
+void MappedFileCache::SetMaxFiles(size_t maxFiles)
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mMaxFiles = std::max<size_t>(1, maxFiles);
+   Trim();
+}
+
+// Call with mMutex held
+void MappedFileCache::Trim()
+{
+   while (mList.size() > mMaxFiles) {
+      mIndex.erase(mList.back().first);
+      mList.pop_back();
+   }
+}
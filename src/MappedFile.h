@@ -0,0 +1,77 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MappedFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_MAPPED_FILE__
+#define __AUDACITY_MAPPED_FILE__
+
+#include "MemoryX.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <wx/string.h>
+
+class MappedFile {
+ public:
+   // Map the whole file read-only.  Check IsOk() afterward.
+   explicit MappedFile(const wxString &path);
+   ~MappedFile();
+
+   MappedFile(const MappedFile&) PROHIBITED;
+   MappedFile &operator= (const MappedFile&) PROHIBITED;
+
+   bool IsOk() const { return mData != nullptr; }
+
+   const char *GetData() const { return mData; }
+   size_t GetSize() const { return mSize; }
+
+ private:
+   const char *mData{};
+   size_t mSize{};
+};
+
+using MappedFilePtr = std::shared_ptr< const MappedFile >;
+
+// A bounded, thread-safe, least-recently-used collection of open mappings,
+// keyed by full path.  Mappings handed out stay valid while the caller holds
+// the pointer, even if the cache evicts them meanwhile.
+class MappedFileCache {
+ public:
+   explicit MappedFileCache(size_t maxFiles);
+   ~MappedFileCache();
+
+   MappedFileCache(const MappedFileCache&) PROHIBITED;
+   MappedFileCache &operator= (const MappedFileCache&) PROHIBITED;
+
+   // Returns null if the file can't be mapped
+   MappedFilePtr Acquire(const wxString &path);
+
+   // Forget any mapping of the path.  Must be done before the file is
+   // rewritten, renamed or removed.
+   void Release(const wxString &path);
+
+   void Clear();
+
+   size_t GetMaxFiles() const { return mMaxFiles; }
+   void SetMaxFiles(size_t maxFiles);
+
+ private:
+   void Trim();
+
+   using Entry = std::pair< wxString, MappedFilePtr >;
+   using List = std::list< Entry >;
+
+   std::mutex mMutex;
+   // Most recently used at the front
+   List mList;
+   std::unordered_map< wxString, List::iterator > mIndex;
+   size_t mMaxFiles;
+};
+
+#endif
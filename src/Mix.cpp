@@ -287,6 +287,7 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
       mTemp[c].Allocate(mInterleavedBufferSize, floatSample);
    }
    mFloatBuffer = Floats{ mInterleavedBufferSize };
+   mDithers.resize(mNumChannels);
 
    // But cut the queue into blocks of this finer size
    // for variable rate resampling.  Each block is resampled at some
@@ -671,7 +672,8 @@ size_t Mixer::Process(size_t maxToProcess)
    }
    if(mInterleaved) {
       for(size_t c=0; c<mNumChannels; c++) {
-         CopySamples(mTemp[0].ptr() + (c * SAMPLE_SIZE(floatSample)),
+         CopySamples(mDithers[c],
+            mTemp[0].ptr() + (c * SAMPLE_SIZE(floatSample)),
             floatSample,
             mBuffer[0].ptr() + (c * SAMPLE_SIZE(mFormat)),
             mFormat,
@@ -683,7 +685,8 @@ size_t Mixer::Process(size_t maxToProcess)
    }
    else {
       for(size_t c=0; c<mNumBuffers; c++) {
-         CopySamples(mTemp[c].ptr(),
+         CopySamples(mDithers[c],
+            mTemp[c].ptr(),
             floatSample,
             mBuffer[c].ptr(),
             mFormat,
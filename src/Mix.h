@@ -20,6 +20,7 @@
 #ifndef __AUDACITY_MIX__
 #define __AUDACITY_MIX__
 
+#include "Dither.h"
 #include "SampleFormat.h"
 #include <vector>
 
@@ -191,6 +192,8 @@ class AUDACITY_DLL_API Mixer {
    sampleFormat     mFormat;
    bool             mInterleaved;
    ArrayOf<SampleBuffer> mBuffer, mTemp;
+   // Dither state of each output channel, kept between calls of Process()
+   std::vector<Dither> mDithers;
    Floats           mFloatBuffer;
    double           mRate;
    double           mSpeed;
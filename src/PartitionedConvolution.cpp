@@ -0,0 +1,206 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PartitionedConvolution.cpp
+
+*******************************************************************//**
+
+\class PartitionedConvolution
+\brief Convolves with a long FIR filter by overlap-save, with the filter
+cut into partitions.
+
+  A filter of M taps is cut into P partitions of K taps.  Each block of B
+  input samples is transformed once, with the samples before it, at size
+  N >= B + K - 1, and its spectrum kept for P blocks.  The output block is
+  the last B samples of the inverse transform of the sum of each kept
+  spectrum times the spectrum of the matching partition.
+
+  The kept spectra must lie whole partitions apart, so either B = K, which
+  keeps the transforms small and the latency low however long the filter,
+  or P = 1 and B = N - M + 1, which is plain overlap-save, and better for
+  short filters where latency does not matter.  The constructor estimates
+  the cost of each choice of N.
+
+*//*******************************************************************/
+
+#include "PartitionedConvolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <wx/debug.h>
+
+namespace {
+
+// Estimated time per output sample, for transforms of fftSize that each
+// give blockSize samples, and nPartitions multiply-adds of each spectrum.
+// The weights are rough fits to timings by tests/ConvolutionBenchmark.
+double Cost( size_t fftSize, size_t blockSize, size_t nPartitions )
+{
+   const double transforms = 2 * fftSize * std::log2( (double)fftSize );
+   const double products = 4 * fftSize * (double)nPartitions;
+   const double copies = 4 * fftSize;
+   return (transforms + products + copies) / blockSize;
+}
+
+}
+
+PartitionedConvolution::PartitionedConvolution(
+   size_t maxTaps, size_t maxBlockSize )
+   : mMaxTaps{ std::max< size_t >( 1, maxTaps ) }
+{
+   const auto M = mMaxTaps;
+   maxBlockSize = std::max< size_t >( 64, maxBlockSize );
+   double bestCost = HUGE_VAL;
+   for (size_t N = 128; N <= 2 * std::max( maxBlockSize, M ); N *= 2)
+   {
+      // Uniform partitions as long as the blocks
+      if (N / 2 <= maxBlockSize)
+      {
+         const auto K = N / 2;
+         const auto P = (M + K - 1) / K;
+         const auto cost = Cost( N, K, P );
+         if (cost < bestCost)
+         {
+            bestCost = cost;
+            mFFTSize = N;
+            mBlockSize = mPartitionSize = K;
+            mnPartitions = P;
+         }
+      }
+      // One partition, and blocks as long as the transform allows
+      if (M < N)
+      {
+         const auto B = std::min( N - M + 1, maxBlockSize );
+         const auto cost = Cost( N, B, 1 );
+         if (cost < bestCost)
+         {
+            bestCost = cost;
+            mFFTSize = N;
+            mBlockSize = B;
+            mPartitionSize = M;
+            mnPartitions = 1;
+         }
+      }
+   }
+
+   hFFT = GetFFT( mFFTSize );
+   mFilterSpectra.reinit( mnPartitions * mFFTSize, true );
+   mInputSpectra.reinit( mnPartitions * mFFTSize );
+   mInput.reinit( mFFTSize );
+   mSum.reinit( mFFTSize );
+   mTime.reinit( mFFTSize );
+   mInFifo.reinit( mBlockSize );
+   mOutFifo.reinit( mBlockSize );
+   Reset();
+}
+
+PartitionedConvolution::~PartitionedConvolution()
+{
+}
+
+void PartitionedConvolution::SetFilter( const float *taps, size_t nTaps )
+{
+   wxASSERT( nTaps <= mMaxTaps );
+   nTaps = std::min( nTaps, mMaxTaps );
+
+   const auto K = mPartitionSize;
+   const auto N = mFFTSize;
+
+   mFilterLength = nTaps;
+   for (size_t pp = 0; pp < mnPartitions; ++pp)
+   {
+      // Each partition is padded with zeroes to the transform size
+      float *spectrum = &mFilterSpectra[pp * N];
+      const auto first = std::min( nTaps, pp * K );
+      const auto count = std::min( nTaps - first, K );
+      std::copy( taps + first, taps + first + count, spectrum );
+      std::fill( spectrum + count, spectrum + N, 0.0f );
+      RealFFTf( spectrum, hFFT.get() );
+   }
+
+   Reset();
+}
+
+void PartitionedConvolution::Reset()
+{
+   const auto N = mFFTSize;
+   std::fill( mInputSpectra.get(),
+      mInputSpectra.get() + mnPartitions * N, 0.0f );
+   std::fill( mInput.get(), mInput.get() + N, 0.0f );
+   std::fill( mInFifo.get(), mInFifo.get() + mBlockSize, 0.0f );
+   std::fill( mOutFifo.get(), mOutFifo.get() + mBlockSize, 0.0f );
+   mNewest = 0;
+   mFifoPos = 0;
+}
+
+void PartitionedConvolution::ProcessBlock( const float *in, float *out )
+{
+   const auto B = mBlockSize;
+   const auto N = mFFTSize;
+   const auto P = mnPartitions;
+
+   // Slide the new block in after the samples before it
+   memmove( mInput.get(), mInput.get() + B, (N - B) * sizeof(float) );
+   memcpy( mInput.get() + N - B, in, B * sizeof(float) );
+
+   // The oldest spectrum makes way for the newest
+   mNewest = (mNewest + P - 1) % P;
+   float *newest = &mInputSpectra[mNewest * N];
+   memcpy( newest, mInput.get(), N * sizeof(float) );
+   RealFFTf( newest, hFFT.get() );
+
+   // Both spectra are in the same order, so bins match by position.
+   // DC and Fs/2 are real and share the first pair.
+   float *sum = mSum.get();
+   std::fill( sum, sum + N, 0.0f );
+   for (size_t pp = 0; pp < P; ++pp)
+   {
+      const float *x = &mInputSpectra[((mNewest + pp) % P) * N];
+      const float *h = &mFilterSpectra[pp * N];
+      sum[0] += x[0] * h[0];
+      sum[1] += x[1] * h[1];
+      for (size_t jj = 2; jj < N; jj += 2)
+      {
+         sum[jj    ] += x[jj] * h[jj    ] - x[jj + 1] * h[jj + 1];
+         sum[jj + 1] += x[jj] * h[jj + 1] + x[jj + 1] * h[jj    ];
+      }
+   }
+
+   // InverseRealFFTf() wants the bins in natural order
+   float *natural = mTime.get();
+   natural[0] = sum[0];
+   natural[1] = sum[1];
+   for (size_t ii = 1; ii < N / 2; ++ii)
+   {
+      natural[2 * ii    ] = sum[hFFT->BitReversed[ii]    ];
+      natural[2 * ii + 1] = sum[hFFT->BitReversed[ii] + 1];
+   }
+   InverseRealFFTf( natural, hFFT.get() );
+   ReorderToTime( hFFT.get(), natural, sum );
+
+   // The start wrapped around; the last B samples are the output
+   memcpy( out, sum + N - B, B * sizeof(float) );
+}
+
+void PartitionedConvolution::Process( const float *in, float *out, size_t len )
+{
+   while (len > 0)
+   {
+      const auto count = std::min( len, mBlockSize - mFifoPos );
+      memcpy( mInFifo.get() + mFifoPos, in, count * sizeof(float) );
+      memcpy( out, mOutFifo.get() + mFifoPos, count * sizeof(float) );
+      mFifoPos += count;
+      in += count;
+      out += count;
+      len -= count;
+
+      if (mFifoPos == mBlockSize)
+      {
+         ProcessBlock( mInFifo.get(), mOutFifo.get() );
+         mFifoPos = 0;
+      }
+   }
+}
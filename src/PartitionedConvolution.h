@@ -0,0 +1,79 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PartitionedConvolution.h
+
+  Filters audio by a long FIR filter, split into partitions of equal
+  length that are convolved in the frequency domain.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PARTITIONED_CONVOLUTION__
+#define __AUDACITY_PARTITIONED_CONVOLUTION__
+
+#include "Audacity.h"
+
+#include "RealFFTf.h"
+#include "SampleFormat.h"
+
+class PartitionedConvolution final
+{
+public:
+   // Sizes are chosen for filters of up to maxTaps.  The block size, which
+   // is the latency of Process(), is no more than maxBlockSize.
+   explicit PartitionedConvolution(
+      size_t maxTaps, size_t maxBlockSize = 65536 );
+   ~PartitionedConvolution();
+
+   PartitionedConvolution( const PartitionedConvolution& ) PROHIBITED;
+   PartitionedConvolution &operator= ( const PartitionedConvolution& ) PROHIBITED;
+
+   size_t GetBlockSize() const { return mBlockSize; }
+   size_t GetPartitionSize() const { return mPartitionSize; }
+   size_t GetFFTSize() const { return mFFTSize; }
+   size_t GetFilterLength() const { return mFilterLength; }
+
+   // Replace the filter, of no more than maxTaps, and forget past input
+   void SetFilter( const float *taps, size_t nTaps );
+
+   // Forget past input, as if it were all zeroes
+   void Reset();
+
+   // Filter exactly GetBlockSize() samples, with no delay.  in and out may
+   // be the same.
+   void ProcessBlock( const float *in, float *out );
+
+   // Filter any number of samples.  Output lags input by GetLatency().
+   void Process( const float *in, float *out, size_t len );
+   size_t GetLatency() const { return mBlockSize; }
+
+private:
+   size_t mBlockSize;
+   size_t mPartitionSize;
+   size_t mFFTSize;
+   size_t mMaxTaps;
+   size_t mFilterLength{ 0 };
+   size_t mnPartitions;
+
+   HFFT hFFT;
+
+   // Spectra of the partitions of the filter, and of as many past blocks
+   // of input, in the bit-reversed order that RealFFTf() leaves them
+   Floats mFilterSpectra;
+   Floats mInputSpectra;
+   // Index of the newest spectrum in mInputSpectra
+   size_t mNewest{ 0 };
+
+   // The last mFFTSize samples of input
+   Floats mInput;
+   Floats mSum;
+   Floats mTime;
+
+   // Partial blocks for Process()
+   Floats mInFifo;
+   Floats mOutFifo;
+   size_t mFifoPos{ 0 };
+};
+
+#endif
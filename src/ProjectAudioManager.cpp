@@ -14,10 +14,12 @@ Paul Licameli split from ProjectManager.cpp
 #include "Experimental.h"
 
 #include <wx/frame.h>
+#include <wx/log.h>
 #include <wx/statusbr.h>
 
 #include "AudioIO.h"
 #include "AutoRecovery.h"
+#include "BlockFileWriter.h"
 #include "CommonCommandFlags.h"
 #include "DirManager.h"
 #include "LabelTrack.h"
@@ -871,9 +873,22 @@ You are saving directly to a slow external storage device\n\
          history.PushState(XO("Recorded Audio"), XO("Record"));
    }
 
-   // Write all cached files to disk, if any
+   // Let the writer thread finish, then write all cached files, and any
+   // it failed to write, to disk
+   auto &writer = BlockFileWriter::Get();
+   writer.Flush();
    dirManager.WriteCacheToDisk();
 
+   const auto stats = writer.GetStatistics();
+   if (stats.blocksQueued + stats.blocksWrittenInline > 0)
+      wxLogMessage(
+         wxT("Recording block writer: %lld queued, %lld written during capture because the queue was full, %lld failed, peak queue %.1f MB, longest write %.1f ms"),
+         (long long) stats.blocksQueued,
+         (long long) stats.blocksWrittenInline,
+         (long long) stats.failures,
+         stats.peakQueuedBytes / 1048576.0,
+         stats.longestWriteSeconds * 1000.0);
+
    // Now we auto-save again to get the project to a "normal" state again.
    projectFileIO.AutoSave();
 }
@@ -567,8 +567,18 @@ private:
    T mValExit;
 };
 
+static bool sAutoSaveEnabled = true;
+
+void ProjectFileIO::SetAutoSaveEnabled( bool enabled )
+{
+   sAutoSaveEnabled = enabled;
+}
+
 void ProjectFileIO::AutoSave()
 {
+   if (!sAutoSaveEnabled)
+      return;
+
    auto &project = mProject;
    auto &window = GetProjectFrame( project );
    //    SonifyBeginAutoSave(); // part of RBD's r10680 stuff now backed out
@@ -49,6 +49,10 @@ public:
    void AutoSave();
    void DeleteCurrentAutoSaveFile();
 
+   // A batch worker's projects are thrown away, so it writes no auto-save
+   // files, which another Audacity would offer to recover
+   static void SetAutoSaveEnabled( bool enabled );
+
    bool IsRecovered() const { return mIsRecovered; }
    void SetIsRecovered( bool value ) { mIsRecovered = value; }
    bool IsLoadedFromAup() const { return mbLoadedFromAup; }
@@ -489,6 +489,16 @@ bool ProjectFileManager::DoSave (const bool fromSaveAs,
          return false;
    }
 
+   if (!fromSaveAs) {
+      // Reclaim the space of blocks no longer used, in packed storage,
+      // before the .aup names the containers.  This is not needed for
+      // the save to succeed, so ignore failure.
+      GuardedCall( [&] { dirManager.CompactBlockContainers(); },
+         MakeSimpleGuard(),
+         [](void*){}
+      );
+   }
+
    // Write the .aup now, before DirManager::SetProject,
    // because it's easier to clean up the effects of successful write of .aup
    // followed by failed SetProject, than the other way about.
@@ -563,6 +573,10 @@ bool ProjectFileManager::DoSave (const bool fromSaveAs,
       pSetter->Commit();
    }
 
+   if (!fromSaveAs)
+      // The .aup no longer names the containers that were compacted
+      dirManager.CommitCompaction();
+
    if ( !bWantSaveCopy )
    {
       // Now that we have saved the file, we can DELETE the auto-saved version
@@ -1556,10 +1570,11 @@ ProjectFileManager::AddImportedTracks(const FilePath &fileName,
          // Check if NEW track contains aliased blockfiles and if yes,
          // remember this to show a warning later
          if(WaveClip* clip = wt->GetClipByIndex(0)) {
-            BlockArray &blocks = clip->GetSequence()->GetBlockArray();
+            const Sequence *sequence = clip->GetSequence();
+            const auto &blocks = sequence->GetBlockArray();
             if (blocks.size())
             {
-               SeqBlock& block = blocks[0];
+               const SeqBlock block = blocks[0];
                if (block.f->IsAlias())
                   SetImportedDependencies( true );
             }
@@ -523,7 +523,7 @@ void InitProjectWindow( ProjectWindow &window )
 #endif
 }
 
-AudacityProject *ProjectManager::New()
+AudacityProject *ProjectManager::New( bool show )
 {
    wxRect wndRect;
    bool bMaximized = false;
@@ -590,7 +590,8 @@ AudacityProject *ProjectManager::New()
    
    ModuleManager::Get().Dispatch(ProjectInitialized);
    
-   window.Show(true);
+   if (show)
+      window.Show(true);
    
    return p;
 }
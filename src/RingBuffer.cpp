@@ -83,7 +83,8 @@ size_t RingBuffer::Put(samplePtr buffer, sampleFormat format,
    while ( samplesToCopy ) {
       auto block = std::min( samplesToCopy, mBufferSize - pos );
 
-      CopySamples(src, format,
+      CopySamples(mPutDither,
+                  src, format,
                   mBuffer.ptr() + pos * SAMPLE_SIZE(mFormat), mFormat,
                   block);
 
@@ -165,7 +166,8 @@ size_t RingBuffer::Get(samplePtr buffer, sampleFormat format,
    while(samplesToCopy) {
       auto block = std::min( samplesToCopy, mBufferSize - start );
 
-      CopySamples(mBuffer.ptr() + start * SAMPLE_SIZE(mFormat), mFormat,
+      CopySamples(mGetDither,
+                  mBuffer.ptr() + start * SAMPLE_SIZE(mFormat), mFormat,
                   dest, format,
                   block);
 
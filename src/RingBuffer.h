@@ -11,6 +11,7 @@
 #ifndef __AUDACITY_RING_BUFFER__
 #define __AUDACITY_RING_BUFFER__
 
+#include "Dither.h"
 #include "SampleFormat.h"
 #include <atomic>
 
@@ -56,6 +57,11 @@ class RingBuffer {
 
    sampleFormat  mFormat;
    SampleBuffer  mBuffer;
+
+   // Dither state of the writer and of the reader, each touched by its
+   // own thread only
+   Dither        mPutDither;
+   Dither        mGetDither;
 };
 
 #endif /*  __AUDACITY_RING_BUFFER__ */
@@ -48,7 +48,6 @@
 
 static DitherType gLowQualityDither = DitherType::none;
 static DitherType gHighQualityDither = DitherType::none;
-static Dither gDitherAlgorithm;
 
 void InitDitherers()
 {
@@ -106,7 +105,20 @@ void CopySamples(samplePtr src, sampleFormat srcFormat,
                  unsigned int srcStride /* = 1 */,
                  unsigned int dstStride /* = 1 */)
 {
-   gDitherAlgorithm.Apply(
+   Dither dither;
+   CopySamples(dither, src, srcFormat, dst, dstFormat, len,
+      highQuality, srcStride, dstStride);
+}
+
+void CopySamples(Dither &dither,
+                 samplePtr src, sampleFormat srcFormat,
+                 samplePtr dst, sampleFormat dstFormat,
+                 unsigned int len,
+                 bool highQuality, /* = true */
+                 unsigned int srcStride /* = 1 */,
+                 unsigned int dstStride /* = 1 */)
+{
+   dither.Apply(
       highQuality ? gHighQualityDither : gLowQualityDither,
       src, srcFormat, dst, dstFormat, len, srcStride, dstStride);
 }
@@ -117,7 +129,9 @@ void CopySamplesNoDither(samplePtr src, sampleFormat srcFormat,
                  unsigned int srcStride /* = 1 */,
                  unsigned int dstStride /* = 1 */)
 {
-   gDitherAlgorithm.Apply(
+   // No dither, so no state to keep
+   Dither dither;
+   dither.Apply(
       DitherType::none,
       src, srcFormat, dst, dstFormat, len, srcStride, dstStride);
 }
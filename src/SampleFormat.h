@@ -124,12 +124,25 @@ private:
 // Copying, Converting and Clearing Samples
 //
 
+class Dither;
+
+// Dithers with a Dither of its own, starting afresh, so use the next
+// function for conversions that continue a stream
 void      CopySamples(samplePtr src, sampleFormat srcFormat,
                       samplePtr dst, sampleFormat dstFormat,
                       unsigned int len, bool highQuality=true,
                       unsigned int srcStride=1,
                       unsigned int dstStride=1);
 
+// Dithers with the state that dither keeps from the previous calls, so
+// that results depend only on what was copied with it before
+void      CopySamples(Dither &dither,
+                      samplePtr src, sampleFormat srcFormat,
+                      samplePtr dst, sampleFormat dstFormat,
+                      unsigned int len, bool highQuality=true,
+                      unsigned int srcStride=1,
+                      unsigned int dstStride=1);
+
 void      CopySamplesNoDither(samplePtr src, sampleFormat srcFormat,
                       samplePtr dst, sampleFormat dstFormat,
                       unsigned int len,
@@ -0,0 +1,124 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  Semaphore.cpp
+
+*******************************************************************//**
+
+\class Semaphore
+\brief A counting semaphore with a lock-free fast path.
+
+  The count is kept in an atomic integer.  The system semaphore is used
+  only to block and wake threads, so Post() is a single atomic increment
+  unless some thread waits.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "Semaphore.h"
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#elif !defined(__WXMAC__)
+#include <errno.h>
+#include <time.h>
+#endif
+
+Semaphore::Semaphore(int initialCount)
+   : mCount{ initialCount }
+{
+#if defined(__WXMSW__)
+   mHandle = CreateSemaphore(nullptr, 0, MAXLONG, nullptr);
+#elif defined(__WXMAC__)
+   mSemaphore = dispatch_semaphore_create(0);
+#else
+   sem_init(&mSemaphore, 0, 0);
+#endif
+}
+
+Semaphore::~Semaphore()
+{
+#if defined(__WXMSW__)
+   CloseHandle(mHandle);
+#elif defined(__WXMAC__)
+   dispatch_release(mSemaphore);
+#else
+   sem_destroy(&mSemaphore);
+#endif
+}
+
+void Semaphore::Post()
+{
+   if (mCount.fetch_add(1, std::memory_order_release) < 0)
+      // Some thread is blocked, or about to block
+      SystemPost();
+}
+
+void Semaphore::Wait()
+{
+   if (mCount.fetch_sub(1, std::memory_order_acquire) > 0)
+      return;
+   SystemWait(-1);
+}
+
+bool Semaphore::WaitFor(std::chrono::milliseconds timeout)
+{
+   if (mCount.fetch_sub(1, std::memory_order_acquire) > 0)
+      return true;
+   if (SystemWait(timeout.count()))
+      return true;
+
+   // Timed out.  Take back the decrement, unless a Post() has already
+   // counted us as a waiter; then its system post is sure to arrive.
+   auto count = mCount.load(std::memory_order_relaxed);
+   while (count < 0)
+      if (mCount.compare_exchange_weak(count, count + 1,
+            std::memory_order_relaxed, std::memory_order_relaxed))
+         return false;
+   SystemWait(-1);
+   return true;
+}
+
+bool Semaphore::SystemWait(long timeoutMs)
+{
+#if defined(__WXMSW__)
+   return WAIT_OBJECT_0 == WaitForSingleObject(
+      mHandle, timeoutMs < 0 ? INFINITE : DWORD(timeoutMs));
+#elif defined(__WXMAC__)
+   return 0 == dispatch_semaphore_wait(mSemaphore, timeoutMs < 0
+      ? DISPATCH_TIME_FOREVER
+      : dispatch_time(DISPATCH_TIME_NOW, timeoutMs * NSEC_PER_MSEC));
+#else
+   if (timeoutMs < 0) {
+      while (sem_wait(&mSemaphore) != 0)
+         if (errno != EINTR)
+            return false;
+      return true;
+   }
+
+   timespec deadline;
+   clock_gettime(CLOCK_REALTIME, &deadline);
+   deadline.tv_sec += timeoutMs / 1000;
+   deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+   if (deadline.tv_nsec >= 1000000000L) {
+      ++deadline.tv_sec;
+      deadline.tv_nsec -= 1000000000L;
+   }
+   while (sem_timedwait(&mSemaphore, &deadline) != 0)
+      if (errno != EINTR)
+         return false;
+   return true;
+#endif
+}
+
+void Semaphore::SystemPost()
+{
+#if defined(__WXMSW__)
+   ReleaseSemaphore(mHandle, 1, nullptr);
+#elif defined(__WXMAC__)
+   dispatch_semaphore_signal(mSemaphore);
+#else
+   sem_post(&mSemaphore);
+#endif
+}
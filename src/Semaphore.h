@@ -0,0 +1,58 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  Semaphore.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SEMAPHORE__
+#define __AUDACITY_SEMAPHORE__
+
+#include "MemoryX.h"
+
+#include <atomic>
+#include <chrono>
+
+#if defined(__WXMAC__)
+#include <dispatch/dispatch.h>
+#elif !defined(__WXMSW__)
+#include <semaphore.h>
+#endif
+
+// A counting semaphore whose Post() takes no lock and makes a system call
+// only when a thread is actually waiting, so that it may be called from
+// the PortAudio callback.  wxSemaphore is built on a mutex and condition
+// variable on some platforms and is not suitable there.
+class Semaphore {
+ public:
+   explicit Semaphore(int initialCount = 0);
+   ~Semaphore();
+
+   Semaphore(const Semaphore&) PROHIBITED;
+   Semaphore &operator= (const Semaphore&) PROHIBITED;
+
+   void Post();
+
+   void Wait();
+   // Returns false if the timeout expired first
+   bool WaitFor(std::chrono::milliseconds timeout);
+
+ private:
+   // A negative timeout waits indefinitely
+   bool SystemWait(long timeoutMs);
+   void SystemPost();
+
+   // Negative when threads are blocked in the system semaphore
+   std::atomic< int > mCount;
+
+#if defined(__WXMSW__)
+   void *mHandle;
+#elif defined(__WXMAC__)
+   dispatch_semaphore_t mSemaphore;
+#else
+   sem_t mSemaphore;
+#endif
+};
+
+#endif
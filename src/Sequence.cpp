@@ -40,6 +40,7 @@
 #include <wx/ffile.h>
 #include <wx/log.h>
 
+#include "BlockSampleCache.h"
 #include "DirManager.h"
 
 #include "blockfile/SilentBlockFile.h"
@@ -88,24 +89,24 @@ size_t Sequence::GetIdealBlockSize() const
 
 bool Sequence::Lock()
 {
-   for (unsigned int i = 0; i < mBlock.size(); i++)
-      mBlock[i].f->Lock();
+   for (const auto &block : mBlock)
+      block.f->Lock();
 
    return true;
 }
 
 bool Sequence::CloseLock()
 {
-   for (unsigned int i = 0; i < mBlock.size(); i++)
-      mBlock[i].f->CloseLock();
+   for (const auto &block : mBlock)
+      block.f->CloseLock();
 
    return true;
 }
 
 bool Sequence::Unlock()
 {
-   for (unsigned int i = 0; i < mBlock.size(); i++)
-      mBlock[i].f->Unlock();
+   for (const auto &block : mBlock)
+      block.f->Unlock();
 
    return true;
 }
@@ -183,10 +184,6 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format)
    } );
 
    BlockArray newBlockArray;
-   // Use the ratio of old to NEW mMaxSamples to make a reasonable guess
-   // at allocation.
-   newBlockArray.reserve
-      (1 + mBlock.size() * ((float)oldMaxSamples / (float)mMaxSamples));
 
    {
       size_t oldSize = oldMaxSamples;
@@ -194,16 +191,16 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format)
       size_t newSize = oldMaxSamples;
       SampleBuffer bufferNew(newSize, format);
 
-      for (size_t i = 0, nn = mBlock.size(); i < nn; i++)
+      for (const auto &oldSeqBlock : mBlock)
       {
-         SeqBlock &oldSeqBlock = mBlock[i];
          const auto &oldBlockFile = oldSeqBlock.f;
          const auto len = oldBlockFile->GetLength();
          ensureSampleBufferSize(bufferOld, oldFormat, oldSize, len);
          Read(bufferOld.ptr(), oldFormat, oldSeqBlock, 0, len, true);
 
          ensureSampleBufferSize(bufferNew, format, newSize, len);
-         CopySamples(bufferOld.ptr(), oldFormat, bufferNew.ptr(), format, len);
+         CopySamples(mDither,
+            bufferOld.ptr(), oldFormat, bufferNew.ptr(), format, len);
 
          // Note this fix for http://bugzilla.audacityteam.org/show_bug.cgi?id=451,
          // using Blockify, allows (len < mMinSamples).
@@ -215,9 +212,8 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format)
          //    from the old blocks... Oh no!
 
          // Using Blockify will handle the cases where len > the NEW mMaxSamples. Previous code did not.
-         const auto blockstart = oldSeqBlock.start;
          Blockify(*mDirManager, mMaxSamples, mSampleFormat,
-                  newBlockArray, blockstart, bufferNew.ptr(), len);
+                  newBlockArray, bufferNew.ptr(), len);
       }
    }
 
@@ -226,7 +222,8 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format)
 
    // Commit the changes to block file array
    CommitChangesIfConsistent
-      (newBlockArray, mNumSamples, wxT("Sequence::ConvertToSampleFormat()"));
+      (newBlockArray, mNumSamples, wxT("Sequence::ConvertToSampleFormat()"),
+       0);
 
    // Commit the other changes
    bSuccess = true;
@@ -257,13 +254,12 @@ std::pair<float, float> Sequence::GetMinMax(
    // this is very fast because we have the min/max of every entire block
    // already in memory.
 
-   for (unsigned b = block0 + 1; b < block1; ++b) {
-      auto results = mBlock[b].f->GetMinMaxRMS(mayThrow);
-
-      if (results.min < min)
-         min = results.min;
-      if (results.max > max)
-         max = results.max;
+   // Groups of blocks have their own summaries, so that this is faster
+   // still for long regions.
+   {
+      double sumsq = 0.0;
+      sampleCount length = 0;
+      AccumulateBlocks(block0 + 1, block1, min, max, sumsq, length, mayThrow);
    }
 
    // Now we take the first and last blocks into account, noting that the
@@ -332,15 +328,9 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
    // First calculate the rms of the blocks in the middle of this region;
    // this is very fast because we have the rms of every entire block
    // already in memory.
-   for (unsigned b = block0 + 1; b < block1; b++) {
-      const SeqBlock &theBlock = mBlock[b];
-      const auto &theFile = theBlock.f;
-      auto results = theFile->GetMinMaxRMS(mayThrow);
-
-      const auto fileLen = theFile->GetLength();
-      const auto blockRMS = results.RMS;
-      sumsq += blockRMS * blockRMS * fileLen;
-      length += fileLen;
+   {
+      float min = FLT_MAX, max = -FLT_MAX;
+      AccumulateBlocks(block0 + 1, block1, min, max, sumsq, length, mayThrow);
    }
 
    // Now we take the first and last blocks into account, noting that the
@@ -383,6 +373,62 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
    return sqrt(sumsq / length.as_double() );
 }
 
+double Sequence::GetSum(sampleCount start, sampleCount len, bool mayThrow) const
+{
+   if (len == 0 || mBlock.size() == 0)
+      return 0.0;
+
+   unsigned int block0 = FindBlock(start);
+   unsigned int block1 = FindBlock(start + len - 1);
+
+   // The blocks in the middle of the region have their sums, or the groups
+   // of them do
+   double sum = AccumulateSums(block0 + 1, block1, mayThrow);
+
+   // The first and last blocks may be only partly in the region
+   {
+      const SeqBlock &theBlock = mBlock[block0];
+      const auto &theFile = theBlock.f;
+      // start lies within theBlock
+      auto s0 = ( start - theBlock.start ).as_size_t();
+      const auto maxl0 =
+         (theBlock.start + theFile->GetLength() - start).as_size_t();
+      const auto l0 = limitSampleBufferSize( maxl0, len );
+
+      if (s0 == 0 && l0 == theFile->GetLength())
+         sum += theFile->GetSum(mayThrow);
+      else
+         sum += theFile->GetSum(s0, l0, mayThrow);
+   }
+
+   if (block1 > block0) {
+      const SeqBlock &theBlock = mBlock[block1];
+      const auto &theFile = theBlock.f;
+
+      // start + len - 1 lies within theBlock
+      const auto l0 = ( start + len - theBlock.start ).as_size_t();
+
+      if (l0 == theFile->GetLength())
+         sum += theFile->GetSum(mayThrow);
+      else
+         sum += theFile->GetSum(0, l0, mayThrow);
+   }
+
+   return sum;
+}
+
+std::unique_ptr<Sequence> Sequence::Snapshot() const
+{
+   // Block files are never changed once made, but replaced, so sharing
+   // them is safe
+   auto dest = std::make_unique<Sequence>(mDirManager, mSampleFormat);
+   dest->mBlock = mBlock;
+   dest->mNumSamples = mNumSamples;
+   dest->mMinSamples = mMinSamples;
+   dest->mMaxSamples = mMaxSamples;
+   return dest;
+}
+
 std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
 {
    auto dest = std::make_unique<Sequence>(mDirManager, mSampleFormat);
@@ -400,8 +446,6 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
    wxUnusedVar(numBlocks);
    wxASSERT(b0 <= b1);
 
-   dest->mBlock.reserve(b1 - b0 + 1);
-
    auto bufferSize = mMaxSamples;
    SampleBuffer buffer(bufferSize, mSampleFormat);
 
@@ -425,9 +469,10 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
       --b0;
 
    // If there are blocks in the middle, copy the blockfiles directly
-   for (int bb = b0 + 1; bb < b1; ++bb)
-      AppendBlock(*dest->mDirManager, dest->mBlock, dest->mNumSamples, mBlock[bb]);
-      // Increase ref count or duplicate file
+   if (b0 + 1 < b1)
+      AppendBlocks(*dest->mDirManager, dest->mBlock, dest->mNumSamples,
+                   *mDirManager, mBlock, b0 + 1, b1);
+      // Share, or increase ref counts or duplicate files
 
    // Do the last block
    if (b1 > b0) {
@@ -463,10 +508,8 @@ namespace {
                                     sampleFormat format,
                                     bool allowDeferredWrite = false)
    {
-      return dm.NewBlockFile( [&]( wxFileNameWrapper filePath ) {
-         return make_blockfile<SimpleBlockFile>(
-            std::move(filePath), sampleData, sampleLen, format, allowDeferredWrite);
-      } );
+      return dm.NewSampleBlockFile(
+         sampleData, sampleLen, format, allowDeferredWrite);
    }
 }
 
@@ -522,21 +565,21 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
       // Build and swap a copy so there is a strong exception safety guarantee
       BlockArray newBlock{ mBlock };
       sampleCount samples = mNumSamples;
-      for (unsigned int i = 0; i < srcNumBlocks; i++)
-         // AppendBlock may throw for limited disk space, if pasting from
-         // one project into another.
-         AppendBlock(*mDirManager, newBlock, samples, srcBlock[i]);
-         // Increase ref count or duplicate file
+      // AppendBlocks may throw for limited disk space, if pasting from
+      // one project into another.
+      AppendBlocks(*mDirManager, newBlock, samples,
+                   *src->mDirManager, srcBlock, 0, srcNumBlocks);
+      // Share, or increase ref counts or duplicate files
 
       CommitChangesIfConsistent
-         (newBlock, samples, wxT("Paste branch one"));
+         (newBlock, samples, wxT("Paste branch one"), numBlocks);
       return;
    }
 
    const int b = (s == mNumSamples) ? mBlock.size() - 1 : FindBlock(s);
    wxASSERT((b >= 0) && (b < (int)numBlocks));
-   SeqBlock *const pBlock = &mBlock[b];
-   const auto length = pBlock->f->GetLength();
+   const SeqBlock block = mBlock[b];
+   const auto length = block.f->GetLength();
    const auto largerBlockLen = addedLen + length;
    // PRL: when insertion point is the first sample of a block,
    // and the following test fails, perhaps we could test
@@ -545,7 +588,6 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
       // Special case: we can fit all of the NEW samples inside of
       // one block!
 
-      SeqBlock &block = *pBlock;
       // largerBlockLen is not more than mMaxSamples...
       SampleBuffer buffer(largerBlockLen.as_size_t(), mSampleFormat);
 
@@ -566,14 +608,12 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
             buffer.ptr(), largerBlockLen.as_size_t(), mSampleFormat);
 
       // Don't make a duplicate array.  We can still give STRONG-GUARANTEE
-      // if we modify only one block in place.
+      // if we modify only one block in place.  The starts of the later
+      // blocks follow.
+      mBlock.SetFile(b, file);
 
       // use NOFAIL-GUARANTEE in remaining steps
-      block.f = file;
-
-      for (unsigned int i = b + 1; i < numBlocks; i++)
-         mBlock[i].start += addedLen;
-
+      InvalidateSummaryGroup(b);
       mNumSamples += addedLen;
 
       // This consistency check won't throw, it asserts.
@@ -586,16 +626,13 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
    // it's simplest to just lump all the data together
    // into one big block along with the split block,
    // then resplit it all
-   BlockArray newBlock;
-   newBlock.reserve(numBlocks + srcNumBlocks + 2);
-   newBlock.insert(newBlock.end(), mBlock.begin(), mBlock.begin() + b);
+   BlockArray newBlock = mBlock.Slice(0, b);
 
-   SeqBlock &splitBlock = mBlock[b];
+   const SeqBlock &splitBlock = block;
    auto splitLen = splitBlock.f->GetLength();
    // s lies within splitBlock
    auto splitPoint = ( s - splitBlock.start ).as_size_t();
 
-   unsigned int i;
    if (srcNumBlocks <= 4) {
 
       // addedLen is at most four times maximum block size
@@ -612,7 +649,7 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
            splitLen - splitPoint, true);
 
       Blockify(*mDirManager, mMaxSamples, mSampleFormat,
-               newBlock, splitBlock.start, sumBuffer.ptr(), sum);
+               newBlock, sumBuffer.ptr(), sum);
    } else {
 
       // The final case is that we're inserting at least five blocks.
@@ -639,14 +676,11 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
          mSampleFormat, 0, srcFirstTwoLen, true);
 
       Blockify(*mDirManager, mMaxSamples, mSampleFormat,
-               newBlock, splitBlock.start, sampleBuffer.ptr(), leftLen);
+               newBlock, sampleBuffer.ptr(), leftLen);
 
-      for (i = 2; i < srcNumBlocks - 2; i++) {
-         const SeqBlock &block = srcBlock[i];
-         auto file = mDirManager->CopyBlockFile(block.f);
-         // We can assume file is not null
-         newBlock.push_back(SeqBlock(file, block.start + s));
-      }
+      auto samples = newBlock.GetNumSamples();
+      AppendBlocks(*mDirManager, newBlock, samples,
+                   *src->mDirManager, srcBlock, 2, srcNumBlocks - 2);
 
       auto lastStart = penultimate.start;
       src->Get(srcNumBlocks - 2, sampleBuffer.ptr(), mSampleFormat,
@@ -655,16 +689,15 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
            splitBlock, splitPoint, rightSplit, true);
 
       Blockify(*mDirManager, mMaxSamples, mSampleFormat,
-               newBlock, s + lastStart, sampleBuffer.ptr(), rightLen);
+               newBlock, sampleBuffer.ptr(), rightLen);
    }
 
-   // Copy remaining blocks to NEW block array and
+   // Share remaining blocks with the NEW block array and
    // swap the NEW block array in for the old
-   for (i = b + 1; i < numBlocks; i++)
-      newBlock.push_back(mBlock[i].Plus(addedLen));
+   newBlock.Append(mBlock.Slice(b + 1, numBlocks));
 
    CommitChangesIfConsistent
-      (newBlock, mNumSamples + addedLen, wxT("Paste branch three"));
+      (newBlock, mNumSamples + addedLen, wxT("Paste branch three"), b);
 }
 
 void Sequence::SetSilence(sampleCount s0, sampleCount len)
@@ -694,24 +727,19 @@ void Sequence::InsertSilence(sampleCount s0, sampleCount len)
 
    sampleCount pos = 0;
 
-   // Could nBlocks overflow a size_t?  Not very likely.  You need perhaps
-   // 2 ^ 52 samples which is over 3000 years at 44.1 kHz.
-   auto nBlocks = (len + idealSamples - 1) / idealSamples;
-   sTrack.mBlock.reserve(nBlocks.as_size_t());
-
    BlockFilePtr silentFile {};
    if (len >= idealSamples)
       silentFile = make_blockfile<SilentBlockFile>(idealSamples);
    while (len >= idealSamples) {
-      sTrack.mBlock.push_back(SeqBlock(silentFile, pos));
+      sTrack.mBlock.push_back(silentFile);
 
       pos += idealSamples;
       len -= idealSamples;
    }
    if (len != 0) {
-      sTrack.mBlock.push_back(SeqBlock(
+      sTrack.mBlock.push_back(
          // len is not more than idealSamples:
-         make_blockfile<SilentBlockFile>( len.as_size_t() ), pos));
+         make_blockfile<SilentBlockFile>( len.as_size_t() ));
       pos += len;
    }
 
@@ -729,19 +757,60 @@ void Sequence::AppendBlock
    if (Overflows((mNumSamples.as_double()) + ((double)b.f->GetLength())))
       THROW_INCONSISTENCY_EXCEPTION;
 
-   SeqBlock newBlock(
-      mDirManager.CopyBlockFile(b.f), // Bump ref count if not locked, else copy
-      mNumSamples
-   );
-   // We can assume newBlock.f is not null
+   // Bump ref count if not locked, else copy
+   auto file = mDirManager.CopyBlockFile(b.f);
+   // We can assume file is not null
 
-   mBlock.push_back(newBlock);
-   mNumSamples += newBlock.f->GetLength();
+   mBlock.push_back(file);
+   mNumSamples += file->GetLength();
 
    // Don't do a consistency check here because this
    // function gets called in an inner loop.
 }
 
+void Sequence::AppendBlocks
+   (DirManager &dirManager,
+    BlockArray &blocks, sampleCount &numSamples,
+    const DirManager &srcDirManager, const BlockArray &src,
+    size_t b0, size_t b1)
+{
+   const auto slice = src.Slice(b0, b1);
+   if (Overflows(numSamples.as_double() + slice.GetNumSamples().as_double()))
+      THROW_INCONSISTENCY_EXCEPTION;
+
+   // Within one project, CopyBlockFile() would only return each unlocked
+   // block again, so share runs of those as subtrees, in logarithmic time.
+   // Copy the others, as of saved projects, and append them all at once.
+   const bool sameProject = (&dirManager == &srcDirManager);
+   std::vector< BlockFilePtr > copies;
+   size_t runStart = b0, index = b0;
+   const auto flush = [&]{
+      if (!copies.empty()) {
+         blocks.Append(copies);
+         for (const auto &file : copies)
+            numSamples += file->GetLength();
+         copies.clear();
+      }
+      if (runStart < index) {
+         const auto run = src.Slice(runStart, index);
+         blocks.Append(run);
+         numSamples += run.GetNumSamples();
+      }
+   };
+   for (const auto &block : slice) {
+      if (sameProject && !block.f->IsLocked()) {
+         ++index;
+         continue;
+      }
+      if (runStart < index)
+         flush();
+      // We can assume the copy is not null
+      copies.push_back(dirManager.CopyBlockFile(block.f));
+      runStart = ++index;
+   }
+   flush();
+}
+
 sampleCount Sequence::GetBlockStart(sampleCount position) const
 {
    int b = FindBlock(position);
@@ -829,10 +898,10 @@ bool Sequence::HandleXMLTag(const wxChar *tag, const wxChar **attrs)
          }
       } // while
 
-      mBlock.push_back(wb);
-      auto index = mBlock.size() - 1;
+      mLoadingBlocks.push_back(wb);
+      auto index = mLoadingBlocks.size() - 1;
       mDirManager->SetLoadingTarget(
-         [this, index] () -> BlockFilePtr& { return mBlock[index].f; } );
+         [this, index] () -> BlockFilePtr& { return mLoadingBlocks[index].f; } );
 
       return true;
    }
@@ -919,13 +988,13 @@ void Sequence::HandleXMLEndTag(const wxChar *tag)
 
    // Make sure that the sequence is valid.
    // First, replace missing blockfiles with SilentBlockFiles
-   for (unsigned b = 0, nn = mBlock.size(); b < nn; b++) {
-      SeqBlock &block = mBlock[b];
+   for (unsigned b = 0, nn = mLoadingBlocks.size(); b < nn; b++) {
+      SeqBlock &block = mLoadingBlocks[b];
       if (!block.f) {
          sampleCount len;
 
          if (b < nn - 1)
-            len = mBlock[b+1].start - block.start;
+            len = mLoadingBlocks[b+1].start - block.start;
          else
             len = mNumSamples - block.start;
 
@@ -950,8 +1019,7 @@ void Sequence::HandleXMLEndTag(const wxChar *tag)
 
    // Next, make sure that start times and lengths are consistent
    sampleCount numSamples = 0;
-   for (unsigned b = 0, nn = mBlock.size(); b < nn;  b++) {
-      SeqBlock &block = mBlock[b];
+   for (auto &block : mLoadingBlocks) {
       if (block.start != numSamples) {
          wxString sFileAndExtension = block.f->GetFileName().name.GetFullName();
          if (sFileAndExtension.empty())
@@ -980,6 +1048,14 @@ void Sequence::HandleXMLEndTag(const wxChar *tag)
       mNumSamples = numSamples;
       mErrorOpening = true;
    }
+
+   // Now put them in the tree
+   BlockArray blocks;
+   for (const auto &block : mLoadingBlocks)
+      blocks.push_back(block.f);
+   mBlock.swap(blocks);
+   InvalidateSummaryGroups(0);
+   std::vector<SeqBlock>{}.swap(mLoadingBlocks);
 }
 
 XMLTagHandler *Sequence::HandleXMLChild(const wxChar *tag)
@@ -996,17 +1072,13 @@ XMLTagHandler *Sequence::HandleXMLChild(const wxChar *tag)
 void Sequence::WriteXML(XMLWriter &xmlFile) const
 // may throw
 {
-   unsigned int b;
-
    xmlFile.StartTag(wxT("sequence"));
 
    xmlFile.WriteAttr(wxT("maxsamples"), mMaxSamples);
    xmlFile.WriteAttr(wxT("sampleformat"), (size_t)mSampleFormat);
    xmlFile.WriteAttr(wxT("numsamples"), mNumSamples.as_long_long() );
 
-   for (b = 0; b < mBlock.size(); b++) {
-      const SeqBlock &bb = mBlock[b];
-
+   for (const auto &bb : mBlock) {
       // See http://bugzilla.audacityteam.org/show_bug.cgi?id=451.
       // Also, don't check against mMaxSamples for AliasBlockFiles, because if you convert sample format,
       // mMaxSample gets changed to match the format, but the number of samples in the aliased file
@@ -1044,49 +1116,141 @@ int Sequence::FindBlock(sampleCount pos) const
 {
    wxASSERT(pos >= 0 && pos < mNumSamples);
 
-   if (pos == 0)
-      return 0;
+   return mBlock.FindBlock(pos);
+}
 
-   int numBlocks = mBlock.size();
+void Sequence::InvalidateSummaryGroups(size_t fromBlock)
+{
+   std::lock_guard<std::mutex> lock{ mSummaryGroupsMutex };
+   const auto nGroups = fromBlock / SummaryGroupBlocks;
+   if (mSummaryGroups.size() > nGroups)
+      mSummaryGroups.resize(nGroups);
+}
 
-   size_t lo = 0, hi = numBlocks, guess;
-   sampleCount loSamples = 0, hiSamples = mNumSamples;
-
-   while (true) {
-      //this is not a binary search, but a
-      //dictionary search where we guess something smarter than the binary division
-      //of the unsearched area, since samples are usually proportional to block file number.
-      const double frac = (pos - loSamples).as_double() /
-         (hiSamples - loSamples).as_double();
-      guess = std::min(hi - 1, lo + size_t(frac * (hi - lo)));
-      const SeqBlock &block = mBlock[guess];
-
-      wxASSERT(block.f->GetLength() > 0);
-      wxASSERT(lo <= guess && guess < hi && lo < hi);
-
-      if (pos < block.start) {
-         wxASSERT(lo != guess);
-         hi = guess;
-         hiSamples = block.start;
-      }
-      else {
-         const sampleCount nextStart = block.start + block.f->GetLength();
-         if (pos < nextStart)
-            break;
-         else {
-            wxASSERT(guess < hi - 1);
-            lo = guess + 1;
-            loSamples = nextStart;
+void Sequence::InvalidateSummaryGroup(size_t block)
+{
+   std::lock_guard<std::mutex> lock{ mSummaryGroupsMutex };
+   const auto group = block / SummaryGroupBlocks;
+   if (group < mSummaryGroups.size())
+      mSummaryGroups[group].valid = mSummaryGroups[group].hasSum = false;
+}
+
+bool Sequence::AccumulateBlocks(unsigned b0, unsigned b1,
+   float &min, float &max, double &sumsq, sampleCount &length,
+   bool mayThrow) const
+{
+   bool available = true;
+   if (b0 >= b1)
+      return available;
+
+   std::lock_guard<std::mutex> lock{ mSummaryGroupsMutex };
+   const size_t nBlocks = mBlock.size();
+   const auto nGroups = (nBlocks + SummaryGroupBlocks - 1) / SummaryGroupBlocks;
+   if (mSummaryGroups.size() < nGroups)
+      mSummaryGroups.resize(nGroups,
+         SummaryGroup{ 0.f, 0.f, 0.0, false, 0.0, false });
+
+   for (unsigned b = b0; b < b1;) {
+      const auto groupEnd = b + SummaryGroupBlocks;
+      if (b % SummaryGroupBlocks == 0 && groupEnd <= b1) {
+         // A whole group is wanted
+         auto &group = mSummaryGroups[b / SummaryGroupBlocks];
+         if (!group.valid) {
+            // Compute it, but only if every block has its summary;
+            // else try again next time
+            SummaryGroup result{ FLT_MAX, -FLT_MAX, 0.0, true, 0.0, false };
+            for (auto bb = b; result.valid && bb < groupEnd; ++bb) {
+               const auto &file = mBlock[bb].f;
+               if (!file->IsSummaryAvailable())
+                  result.valid = false;
+               else {
+                  auto results = file->GetMinMaxRMS(mayThrow);
+                  result.min = std::min(result.min, results.min);
+                  result.max = std::max(result.max, results.max);
+                  result.sumsq += (double)results.RMS * results.RMS *
+                     file->GetLength();
+               }
+            }
+            if (result.valid) {
+               result.sum = group.sum;
+               result.hasSum = group.hasSum;
+               group = result;
+            }
+         }
+         if (group.valid) {
+            min = std::min(min, group.min);
+            max = std::max(max, group.max);
+            sumsq += group.sumsq;
+            const auto &last = mBlock[groupEnd - 1];
+            length += last.start + last.f->GetLength() - mBlock[b].start;
+            b = groupEnd;
+            continue;
          }
       }
+
+      // Use the summary of one block
+      const auto &file = mBlock[b].f;
+      if (!file->IsSummaryAvailable())
+         available = false;
+      auto results = file->GetMinMaxRMS(mayThrow);
+      min = std::min(min, results.min);
+      max = std::max(max, results.max);
+      const auto fileLen = file->GetLength();
+      sumsq += (double)results.RMS * results.RMS * fileLen;
+      length += fileLen;
+      ++b;
    }
 
-   const int rval = guess;
-   wxASSERT(rval >= 0 && rval < numBlocks &&
-            pos >= mBlock[rval].start &&
-            pos < mBlock[rval].start + mBlock[rval].f->GetLength());
+   return available;
+}
+
+double Sequence::AccumulateSums(unsigned b0, unsigned b1, bool mayThrow) const
+{
+   double sum = 0.0;
+   if (b0 >= b1)
+      return sum;
+
+   std::lock_guard<std::mutex> lock{ mSummaryGroupsMutex };
+   const size_t nBlocks = mBlock.size();
+   const auto nGroups = (nBlocks + SummaryGroupBlocks - 1) / SummaryGroupBlocks;
+   if (mSummaryGroups.size() < nGroups)
+      mSummaryGroups.resize(nGroups,
+         SummaryGroup{ 0.f, 0.f, 0.0, false, 0.0, false });
+
+   for (unsigned b = b0; b < b1;) {
+      const auto groupEnd = b + SummaryGroupBlocks;
+      if (b % SummaryGroupBlocks == 0 && groupEnd <= b1) {
+         // A whole group is wanted
+         auto &group = mSummaryGroups[b / SummaryGroupBlocks];
+         if (group.hasSum) {
+            sum += group.sum;
+            b = groupEnd;
+            continue;
+         }
 
-   return rval;
+         // Keep the sum of the group only if every block could give it
+         double groupSum = 0.0;
+         bool available = true;
+         for (auto bb = b; bb < groupEnd; ++bb) {
+            const auto &file = mBlock[bb].f;
+            if (!file->IsDataAvailable())
+               available = false;
+            groupSum += file->GetSum(mayThrow);
+         }
+         if (available) {
+            group.sum = groupSum;
+            group.hasSum = true;
+         }
+         sum += groupSum;
+         b = groupEnd;
+         continue;
+      }
+
+      sum += mBlock[b].f->GetSum(mayThrow);
+      ++b;
+   }
+
+   return sum;
 }
 
 //static
@@ -1098,6 +1262,16 @@ bool Sequence::Read(samplePtr buffer, sampleFormat format,
 
    wxASSERT(blockRelativeStart + len <= f->GetLength());
 
+   // Float requests, as for playback, drawing and effects, are served from
+   // the shared cache when possible
+   if (format == floatSample) {
+      if (auto pSamples = BlockSampleCache::Get().Fetch(*f)) {
+         memcpy(buffer, pSamples->get() + blockRelativeStart,
+                len * sizeof(float));
+         return true;
+      }
+   }
+
    // Either throws, or of !mayThrow, tells how many were really read
    auto result = f->ReadData(buffer, format, blockRelativeStart, len, mayThrow);
 
@@ -1171,8 +1345,8 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
    }
 
    int b = FindBlock(start);
-   BlockArray newBlock;
-   std::copy( mBlock.begin(), mBlock.begin() + b, std::back_inserter(newBlock) );
+   const auto unchanged = b;
+   BlockArray newBlock = mBlock.Slice(0, b);
 
    while (len > 0
       // Redundant termination condition,
@@ -1181,8 +1355,8 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
       // that cause the loop to make no progress because blen == 0
       && b < (int)size
    ) {
-      newBlock.push_back( mBlock[b] );
-      SeqBlock &block = newBlock.back();
+      const SeqBlock block = mBlock[b];
+      BlockFilePtr file;
       // start is within block
       const auto bstart = ( start - block.start ).as_size_t();
       const auto fileLength = block.f->GetLength();
@@ -1212,7 +1386,7 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
       {
          // To do: remove the extra movement.
          // Note: we ensured temp can hold fileLength.  blen is not more
-         CopySamples(buffer, format, temp.ptr(), mSampleFormat, blen);
+         CopySamples(mDither, buffer, format, temp.ptr(), mSampleFormat, blen);
          useBuffer = temp.ptr();
       }
 
@@ -1232,17 +1406,18 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
          else
             ClearSamples(scratch.ptr(), mSampleFormat, bstart, blen);
 
-         block.f = NewSimpleBlockFile( *mDirManager,
+         file = NewSimpleBlockFile( *mDirManager,
             scratch.ptr(), fileLength, mSampleFormat);
       }
       else {
          // Avoid reading the disk when the replacement is total
          if (useBuffer)
-            block.f = NewSimpleBlockFile( *mDirManager,
+            file = NewSimpleBlockFile( *mDirManager,
                useBuffer, fileLength, mSampleFormat);
          else
-            block.f = make_blockfile<SilentBlockFile>(fileLength);
+            file = make_blockfile<SilentBlockFile>(fileLength);
       }
+      newBlock.push_back( file );
 
       // blen might be zero for inconsistent Sequence...
       if( buffer )
@@ -1255,9 +1430,10 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
       b++;
    }
 
-   std::copy( mBlock.begin() + b, mBlock.end(), std::back_inserter(newBlock) );
+   newBlock.Append( mBlock.Slice( b, size ) );
 
-   CommitChangesIfConsistent( newBlock, mNumSamples, wxT("SetSamples") );
+   CommitChangesIfConsistent(
+      newBlock, mNumSamples, wxT("SetSamples"), unchanged );
 }
 
 namespace {
@@ -1317,6 +1493,15 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
    // ... unless the mNumSamples ceiling applies, and then there are other defenses
    const auto s1 =
       std::min(mNumSamples, std::max(1 + where[len - 1], where[len]));
+
+   if ((s1 - s0).as_double() / len >= mMaxSamples) {
+      // Columns are wider than blocks.  Rather than read the 64K summary
+      // of each block, summarize each column from the in-memory summaries
+      // of whole blocks and groups of blocks.
+      GetWaveDisplayFromSummaries(min, max, rms, bl, len, where, s0, s1);
+      return true;
+   }
+
    Floats temp{ mMaxSamples };
 
    decltype(len) pixel = 0;
@@ -1510,6 +1695,101 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
    return true;
 }
 
+void Sequence::GetWaveDisplayFromSummaries(float *min, float *max, float *rms,
+   int* bl, size_t len, const sampleCount *where,
+   sampleCount s0, sampleCount s1) const
+{
+   // Enough for the 256 summary of a block, or for fewer than 256 samples
+   Floats temp{ std::max<size_t>(256, 3 * (mMaxSamples / 256 + 1)) };
+
+   for (size_t pixel = 0; pixel < len; ++pixel) {
+      // The column covers samples from where[pixel] up to but excluding
+      // where[pixel + 1]; give each column at least one sample
+      const auto from = std::min(s1 - 1, std::max(s0, where[pixel]));
+      const auto to = (pixel + 1 == len)
+         ? s1
+         : std::max(from + 1, std::min(s1, where[pixel + 1]));
+
+      float theMin = FLT_MAX, theMax = -FLT_MAX;
+      double sumsq = 0.0;
+      sampleCount length = 0;
+      bool available = true;
+
+      // Summarize samples of block b from first up to but excluding last,
+      // using the finest summary that reads not more than 256 triples
+      auto summarizePart = [&](unsigned b, sampleCount first, sampleCount last) {
+         const SeqBlock &seqBlock = mBlock[b];
+         // first and last are in the block
+         const auto relStart = (first - seqBlock.start).as_size_t();
+         const auto partLen = (last - first).as_size_t();
+         const int divisor =
+              (partLen >= 65536) ? 65536
+            : (partLen >= 256) ? 256
+            : 1;
+         const size_t startPosition = relStart / divisor;
+         const size_t num =
+            1 + (relStart + partLen - 1) / divisor - startPosition;
+         switch (divisor) {
+         default:
+         case 1:
+            Read((samplePtr)temp.get(), floatSample, seqBlock,
+               relStart, partLen, false);
+            break;
+         case 256:
+         case 65536:
+            if (!seqBlock.f->IsSummaryAvailable()) {
+               available = false;
+               return;
+            }
+            if (divisor == 256)
+               seqBlock.f->Read256(temp.get(), startPosition, num);
+            else
+               seqBlock.f->Read64K(temp.get(), startPosition, num);
+            break;
+         }
+         MinMaxSumsq values(temp.get(), num, divisor);
+         theMin = std::min(theMin, values.min);
+         theMax = std::max(theMax, values.max);
+         // Each triple stands for about partLen / num samples
+         sumsq += (divisor == 1)
+            ? values.sumsq
+            : (double)values.sumsq * partLen / num;
+         length += partLen;
+      };
+
+      const unsigned b0 = FindBlock(from);
+      const unsigned b1 = FindBlock(to - 1);
+      // Whole blocks from wb0 up to but excluding wb1
+      auto wb0 = b0, wb1 = b1 + 1;
+      {
+         const SeqBlock &block = mBlock[b0];
+         if (from > block.start) {
+            summarizePart(b0,
+               from, std::min(to, block.start + block.f->GetLength()));
+            wb0 = b0 + 1;
+         }
+      }
+      if (b1 >= wb0) {
+         const SeqBlock &block = mBlock[b1];
+         if (to < block.start + block.f->GetLength()) {
+            summarizePart(b1, std::max(from, block.start), to);
+            wb1 = b1;
+         }
+      }
+      if (wb0 < wb1 &&
+          !AccumulateBlocks(wb0, wb1, theMin, theMax, sumsq, length, false))
+         available = false;
+
+      if (theMin > theMax)
+         // Nothing was summarized
+         theMin = theMax = 0;
+      min[pixel] = theMin;
+      max[pixel] = theMax;
+      rms[pixel] = (length > 0) ? sqrt(sumsq / length.as_double()) : 0;
+      bl[pixel] = available ? (int)b0 : -1 - (int)b0;
+   }
+}
+
 size_t Sequence::GetIdealAppendLen() const
 {
    int numBlocks = mBlock.size();
@@ -1541,21 +1821,21 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
 
    // If the last block is not full, we need to add samples to it
    int numBlocks = mBlock.size();
-   SeqBlock *pLastBlock;
-   decltype(pLastBlock->f->GetLength()) length;
+   SeqBlock lastBlock;
+   size_t length;
    size_t bufferSize = mMaxSamples;
    SampleBuffer buffer2(bufferSize, mSampleFormat);
    bool replaceLast = false;
    if (numBlocks > 0 &&
        (length =
-        (pLastBlock = &mBlock.back())->f->GetLength()) < mMinSamples) {
+        (lastBlock = mBlock.back()).f->GetLength()) < mMinSamples) {
       // Enlarge a sub-minimum block at the end
-      const SeqBlock &lastBlock = *pLastBlock;
       const auto addLen = std::min(mMaxSamples - length, len);
 
       Read(buffer2.ptr(), mSampleFormat, lastBlock, 0, length, true);
 
-      CopySamples(buffer,
+      CopySamples(mDither,
+                  buffer,
                   format,
                   buffer2.ptr() + length * SAMPLE_SIZE(mSampleFormat),
                   mSampleFormat,
@@ -1563,20 +1843,18 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
 
       const auto newLastBlockLen = length + addLen;
 
-      SeqBlock newLastBlock(
+      auto newLastFile =
          NewSimpleBlockFile( *mDirManager,
             buffer2.ptr(), newLastBlockLen, mSampleFormat,
             blockFileLog != NULL
-         ),
-         lastBlock.start
-      );
+         );
 
       if (blockFileLog)
          // shouldn't throw, because XMLWriter is not XMLFileWriter
-         static_cast< SimpleBlockFile * >( &*newLastBlock.f )
+         static_cast< SimpleBlockFile * >( &*newLastFile )
             ->SaveXML( *blockFileLog );
 
-      newBlock.push_back( newLastBlock );
+      newBlock.push_back( newLastFile );
 
       len -= addLen;
       newNumSamples += addLen;
@@ -1594,7 +1872,8 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
             buffer, addedLen, mSampleFormat, blockFileLog != NULL);
       }
       else {
-         CopySamples(buffer, format, buffer2.ptr(), mSampleFormat, addedLen);
+         CopySamples(mDither,
+            buffer, format, buffer2.ptr(), mSampleFormat, addedLen);
          pFile = NewSimpleBlockFile( *mDirManager,
             buffer2.ptr(), addedLen, mSampleFormat, blockFileLog != NULL);
       }
@@ -1603,7 +1882,7 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
          // shouldn't throw, because XMLWriter is not XMLFileWriter
          static_cast< SimpleBlockFile * >( &*pFile )->SaveXML( *blockFileLog );
 
-      newBlock.push_back(SeqBlock(pFile, newNumSamples));
+      newBlock.push_back(pFile);
 
       buffer += addedLen * SAMPLE_SIZE(format);
       newNumSamples += addedLen;
@@ -1623,24 +1902,19 @@ void Sequence::Append(samplePtr buffer, sampleFormat format,
 
 void Sequence::Blockify
    (DirManager &mDirManager, size_t mMaxSamples, sampleFormat mSampleFormat,
-    BlockArray &list, sampleCount start, samplePtr buffer, size_t len)
+    BlockArray &list, samplePtr buffer, size_t len)
 {
    if (len <= 0)
       return;
    auto num = (len + (mMaxSamples - 1)) / mMaxSamples;
-   list.reserve(list.size() + num);
 
    for (decltype(num) i = 0; i < num; i++) {
-      SeqBlock b;
-
       const auto offset = i * len / num;
-      b.start = start + offset;
       int newLen = ((i + 1) * len / num) - offset;
       samplePtr bufStart = buffer + (offset * SAMPLE_SIZE(mSampleFormat));
 
-      b.f = NewSimpleBlockFile( mDirManager, bufStart, newLen, mSampleFormat );
-
-      list.push_back(b);
+      list.push_back(
+         NewSimpleBlockFile( mDirManager, bufStart, newLen, mSampleFormat ) );
    }
 }
 
@@ -1665,8 +1939,8 @@ void Sequence::Delete(sampleCount start, sampleCount len)
 
    auto sampleSize = SAMPLE_SIZE(mSampleFormat);
 
-   SeqBlock *pBlock;
-   decltype(pBlock->f->GetLength()) length;
+   SeqBlock block;
+   size_t length;
 
    // One buffer for reuse in various branches here
    SampleBuffer scratch;
@@ -1677,8 +1951,8 @@ void Sequence::Delete(sampleCount start, sampleCount len)
    // block and the resulting length is not too small, perform the
    // deletion within this block:
    if (b0 == b1 &&
-       (length = (pBlock = &mBlock[b0])->f->GetLength()) - len >= mMinSamples) {
-      SeqBlock &b = *pBlock;
+       (length = (block = mBlock[b0]).f->GetLength()) - len >= mMinSamples) {
+      const SeqBlock &b = block;
       // start is within block
       auto pos = ( start - b.start ).as_size_t();
 
@@ -1703,15 +1977,13 @@ void Sequence::Delete(sampleCount start, sampleCount len)
           NewSimpleBlockFile( *mDirManager, scratch.ptr(), newLen, mSampleFormat );
 
       // Don't make a duplicate array.  We can still give STRONG-GUARANTEE
-      // if we modify only one block in place.
+      // if we modify only one block in place.  The starts of the later
+      // blocks follow.
+      mBlock.SetFile(b0, newFile);
 
       // use NOFAIL-GUARANTEE in remaining steps
 
-      b.f = newFile;
-
-      for (unsigned int j = b0 + 1; j < numBlocks; j++)
-         mBlock[j].start -= len;
-
+      InvalidateSummaryGroup(b0);
       mNumSamples -= len;
 
       // This consistency check won't throw, it asserts.
@@ -1720,21 +1992,16 @@ void Sequence::Delete(sampleCount start, sampleCount len)
       return;
    }
 
-   // Create a NEW array of blocks
-   BlockArray newBlock;
-   newBlock.reserve(numBlocks - (b1 - b0) + 2);
-
-   // Copy the blocks before the deletion point over to
-   // the NEW array
-   newBlock.insert(newBlock.end(), mBlock.begin(), mBlock.begin() + b0);
-   unsigned int i;
+   // Create a NEW array of blocks, sharing the blocks before the
+   // deletion point
+   BlockArray newBlock = mBlock.Slice(0, b0);
 
    // First grab the samples in block b0 before the deletion point
    // into preBuffer.  If this is enough samples for its own block,
    // or if this would be the first block in the array, write it out.
    // Otherwise combine it with the previous block (splitting them
    // 50/50 if necessary).
-   const SeqBlock &preBlock = mBlock[b0];
+   const SeqBlock preBlock = mBlock[b0];
    // start is within preBlock
    auto preBufferLen = ( start - preBlock.start ).as_size_t();
    if (preBufferLen) {
@@ -1746,9 +2013,9 @@ void Sequence::Delete(sampleCount start, sampleCount len)
          auto pFile =
             NewSimpleBlockFile( *mDirManager, scratch.ptr(), preBufferLen, mSampleFormat );
 
-         newBlock.push_back(SeqBlock(pFile, preBlock.start));
+         newBlock.push_back(pFile);
       } else {
-         const SeqBlock &prepreBlock = mBlock[b0 - 1];
+         const SeqBlock prepreBlock = mBlock[b0 - 1];
          const auto prepreLen = prepreBlock.f->GetLength();
          const auto sum = prepreLen + preBufferLen;
 
@@ -1763,7 +2030,7 @@ void Sequence::Delete(sampleCount start, sampleCount len)
 
          newBlock.pop_back();
          Blockify(*mDirManager, mMaxSamples, mSampleFormat,
-                  newBlock, prepreBlock.start, scratch.ptr(), sum);
+                  newBlock, scratch.ptr(), sum);
       }
    }
    else {
@@ -1776,7 +2043,7 @@ void Sequence::Delete(sampleCount start, sampleCount len)
    // for its own block, or if this would be the last block in
    // the array, write it out.  Otherwise combine it with the
    // subsequent block (splitting them 50/50 if necessary).
-   const SeqBlock &postBlock = mBlock[b1];
+   const SeqBlock postBlock = mBlock[b1];
    // start + len - 1 lies within postBlock
    const auto postBufferLen = (
        (postBlock.start + postBlock.f->GetLength()) - (start + len)
@@ -1792,9 +2059,9 @@ void Sequence::Delete(sampleCount start, sampleCount len)
          auto file =
             NewSimpleBlockFile( *mDirManager, scratch.ptr(), postBufferLen, mSampleFormat );
 
-         newBlock.push_back(SeqBlock(file, start));
+         newBlock.push_back(file);
       } else {
-         SeqBlock &postpostBlock = mBlock[b1 + 1];
+         const SeqBlock postpostBlock = mBlock[b1 + 1];
          const auto postpostLen = postpostBlock.f->GetLength();
          const auto sum = postpostLen + postBufferLen;
 
@@ -1808,7 +2075,7 @@ void Sequence::Delete(sampleCount start, sampleCount len)
               postpostBlock, 0, postpostLen, true);
 
          Blockify(*mDirManager, mMaxSamples, mSampleFormat,
-                  newBlock, start, scratch.ptr(), sum);
+                  newBlock, scratch.ptr(), sum);
          b1++;
       }
    }
@@ -1817,21 +2084,21 @@ void Sequence::Delete(sampleCount start, sampleCount len)
       // right on the end of a block.
    }
 
-   // Copy the remaining blocks over from the old array
-   for (i = b1 + 1; i < numBlocks; i++)
-      newBlock.push_back(mBlock[i].Plus(-len));
+   // Share the remaining blocks of the old array
+   newBlock.Append(mBlock.Slice(b1 + 1, numBlocks));
 
    CommitChangesIfConsistent
-      (newBlock, mNumSamples - len, wxT("Delete - branch two"));
+      (newBlock, mNumSamples - len, wxT("Delete - branch two"),
+       b0 > 0 ? b0 - 1 : 0);
 }
 
 void Sequence::ConsistencyCheck(const wxChar *whereStr, bool mayThrow) const
 {
-   ConsistencyCheck(mBlock, mMaxSamples, 0, mNumSamples, whereStr, mayThrow);
+   ConsistencyCheck(mBlock, mMaxSamples, mNumSamples, whereStr, mayThrow);
 }
 
 void Sequence::ConsistencyCheck
-   (const BlockArray &mBlock, size_t maxSamples, size_t from,
+   (const BlockArray &mBlock, size_t maxSamples,
     sampleCount mNumSamples, const wxChar *whereStr,
     bool WXUNUSED(mayThrow))
 {
@@ -1840,28 +2107,11 @@ void Sequence::ConsistencyCheck
    // gives a little more discrimination
    InconsistencyException ex;
 
-   unsigned int numBlocks = mBlock.size();
-
-   unsigned int i;
-   sampleCount pos = from < numBlocks ? mBlock[from].start : mNumSamples;
-   if ( from == 0 && pos != 0 )
+   // The starts of blocks are always contiguous, and BlockArray keeps
+   // the totals, so no loop is needed
+   if (mBlock.GetMaxBlockLength() > maxSamples)
       ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
-
-   for (i = from; !bError && i < numBlocks; i++) {
-      const SeqBlock &seqBlock = mBlock[i];
-      if (pos != seqBlock.start)
-         ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
-
-      if ( seqBlock.f ) {
-         const auto length = seqBlock.f->GetLength();
-         if (length > maxSamples)
-            ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
-         pos += length;
-      }
-      else
-         ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
-   }
-   if ( !bError && pos != mNumSamples )
+   else if (mBlock.GetNumSamples() != mNumSamples)
       ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
 
    if ( bError )
@@ -1883,13 +2133,18 @@ void Sequence::ConsistencyCheck
 }
 
 void Sequence::CommitChangesIfConsistent
-   (BlockArray &newBlock, sampleCount numSamples, const wxChar *whereStr)
+   (BlockArray &newBlock, sampleCount numSamples, const wxChar *whereStr,
+    size_t unchanged)
 {
-   ConsistencyCheck( newBlock, mMaxSamples, 0, numSamples, whereStr ); // may throw
+   ConsistencyCheck( newBlock, mMaxSamples, numSamples, whereStr ); // may throw
 
    // now commit
    // use NOFAIL-GUARANTEE
 
+   // The blocks before the first changed one, typically most of them,
+   // keep the summaries of their groups
+   InvalidateSummaryGroups(unchanged);
+
    mBlock.swap(newBlock);
    mNumSamples = numSamples;
 }
@@ -1904,47 +2159,32 @@ void Sequence::AppendBlocksIfConsistent
    if (additionalBlocks.empty())
       return;
 
-   bool tmpValid = false;
-   SeqBlock tmp;
+   // Copying is constant time
+   BlockArray newBlock{ mBlock };
+   if ( replaceLast && ! newBlock.empty() )
+      newBlock.pop_back();
 
-   if ( replaceLast && ! mBlock.empty() ) {
-      tmp = mBlock.back(), tmpValid = true;
-      mBlock.pop_back();
-   }
-
-   auto prevSize = mBlock.size();
-
-   bool consistent = false;
-   auto cleanup = finally( [&] {
-      if ( !consistent ) {
-         mBlock.resize( prevSize );
-         if ( tmpValid )
-            mBlock.push_back( tmp );
-      }
-   } );
+   auto prevSize = newBlock.size();
 
-   std::copy( additionalBlocks.begin(), additionalBlocks.end(),
-              std::back_inserter( mBlock ) );
+   newBlock.Append( additionalBlocks );
 
-   // Check consistency only of the blocks that were added,
-   // avoiding quadratic time for repeated checking of repeating appends
-   ConsistencyCheck( mBlock, mMaxSamples, prevSize, numSamples, whereStr ); // may throw
+   ConsistencyCheck( newBlock, mMaxSamples, numSamples, whereStr ); // may throw
 
    // now commit
    // use NOFAIL-GUARANTEE
 
+   InvalidateSummaryGroups(prevSize);
+   mBlock.swap(newBlock);
    mNumSamples = numSamples;
-   consistent = true;
 }
 
 void Sequence::DebugPrintf
    (const BlockArray &mBlock, sampleCount mNumSamples, wxString *dest)
 {
-   unsigned int i;
+   unsigned int i = 0;
    decltype(mNumSamples) pos = 0;
 
-   for (i = 0; i < mBlock.size(); i++) {
-      const SeqBlock &seqBlock = mBlock[i];
+   for (const auto &seqBlock : mBlock) {
       *dest += wxString::Format
          (wxT("   Block %3u: start %8lld, len %8lld, refs %ld, "),
           i,
@@ -1964,6 +2204,7 @@ void Sequence::DebugPrintf
 
       if (seqBlock.f)
          pos += seqBlock.f->GetLength();
+      ++i;
    }
    if (pos != mNumSamples)
       *dest += wxString::Format
@@ -1988,13 +2229,12 @@ void Sequence::AppendBlockFile( const BlockFileFactory &factory, size_t len )
    if (Overflows((mNumSamples.as_double()) + ((double)len)))
       THROW_INCONSISTENCY_EXCEPTION;
 
-   SeqBlock newBlock(
+   auto newFile =
       mDirManager->NewBlockFile( [&]( wxFileNameWrapper filePath ){
          return factory( std::move( filePath ), len );
-      } ),
-      mNumSamples
-   );
-   mBlock.push_back(newBlock);
+      } );
+   mBlock.push_back(newFile);
+   InvalidateSummaryGroups(mBlock.size() - 1);
    mNumSamples += len;
 }
 
@@ -2002,7 +2242,8 @@ void Sequence::AppendBlockFile(const BlockFilePtr &blockFile)
 {
    // We assume blockFile has the correct ref count already
 
-   mBlock.push_back(SeqBlock(blockFile, mNumSamples));
+   mBlock.push_back(blockFile);
+   InvalidateSummaryGroups(mBlock.size() - 1);
    mNumSamples += blockFile->GetLength();
 
    // PRL:  I hoisted the intended consistency check out of the inner loop
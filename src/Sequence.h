@@ -11,44 +11,20 @@
 #ifndef __AUDACITY_SEQUENCE__
 #define __AUDACITY_SEQUENCE__
 
+#include <mutex>
 #include <vector>
 
+#include "BlockArray.h"
+#include "Dither.h"
 #include "SampleFormat.h"
 #include "xml/XMLTagHandler.h"
 #include "ondemand/ODTaskThread.h"
 
 #include "audacity/Types.h"
 
-class BlockFile;
-using BlockFilePtr = std::shared_ptr<BlockFile>;
-
 class DirManager;
 class wxFileNameWrapper;
 
-// This is an internal data structure!  For advanced use only.
-class SeqBlock {
- public:
-   BlockFilePtr f;
-   ///the sample in the global wavetrack that this block starts at.
-   sampleCount start;
-
-   SeqBlock()
-      : f{}, start(0)
-   {}
-
-   SeqBlock(const BlockFilePtr &f_, sampleCount start_)
-      : f(f_), start(start_)
-   {}
-
-   // Construct a SeqBlock with changed start, same file
-   SeqBlock Plus(sampleCount delta) const
-   {
-      return SeqBlock(f, start + delta);
-   }
-};
-class BlockArray : public std::vector<SeqBlock> {};
-using BlockPtrArray = std::vector<SeqBlock*>; // non-owning pointers
-
 class PROFILE_DLL_API Sequence final : public XMLTagHandler{
  public:
 
@@ -102,6 +78,9 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
 
    // Return non-null, or else throw!
    std::unique_ptr<Sequence> Copy(sampleCount s0, sampleCount s1) const;
+   // A sequence sharing the same blocks, which later edits of this one
+   // don't change, for reading on another thread.  Copies no sample data.
+   std::unique_ptr<Sequence> Snapshot() const;
    void Paste(sampleCount s0, const Sequence *src);
 
    size_t GetIdealAppendLen() const;
@@ -161,6 +140,9 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    // Return true iff there is a change
    bool ConvertToSampleFormat(sampleFormat format);
 
+   // For conversions of samples written to this sequence, as by WaveClip
+   Dither &GetDither() { return mDither; }
+
    //
    // Retrieving summary info
    //
@@ -168,6 +150,7 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    std::pair<float, float> GetMinMax(
       sampleCount start, sampleCount len, bool mayThrow) const;
    float GetRMS(sampleCount start, sampleCount len, bool mayThrow) const;
+   double GetSum(sampleCount start, sampleCount len, bool mayThrow) const;
 
    //
    // Getting block size and alignment information
@@ -186,7 +169,9 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    // you're doing!
    //
 
-   BlockArray &GetBlockArray() { return mBlock; }
+   // The caller may replace blocks, so the summaries of groups of blocks
+   // are discarded
+   BlockArray &GetBlockArray() { InvalidateSummaryGroups(0); return mBlock; }
    const BlockArray &GetBlockArray() const { return mBlock; }
 
    ///
@@ -225,6 +210,10 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    BlockArray    mBlock;
    sampleFormat  mSampleFormat;
 
+   // Blocks as read from the project file, with the starts it gives,
+   // until the end tag
+   std::vector<SeqBlock> mLoadingBlocks;
+
    // Not size_t!  May need to be large:
    sampleCount   mNumSamples{ 0 };
 
@@ -233,6 +222,31 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
 
    bool          mErrorOpening{ false };
 
+   // Every sequence starts with the same seed, so that the samples written
+   // depend only on what was written before, not on the thread that writes
+   Dither mDither{ 0 };
+
+   // A coarser level of summary above the 256 and 64K summaries of each
+   // block:  min, max, sum and sum of squares of each run of SummaryGroupBlocks
+   // consecutive blocks (4M samples of float blocks).  Computed as needed
+   // from the in-memory summaries of the blocks, and discarded from the
+   // first changed block onward when blocks are replaced, inserted or
+   // removed.  Changes of block starts alone do not affect them.
+   struct SummaryGroup {
+      float min;
+      float max;
+      double sumsq;
+      bool valid;
+      // The sum is kept apart, because blocks may have to read their data
+      // to give it, and only some callers want it
+      double sum;
+      bool hasSum;
+   };
+   static const size_t SummaryGroupBlocks = 16;
+   mutable std::vector<SummaryGroup> mSummaryGroups;
+   // Const methods fill in mSummaryGroups, perhaps on several threads
+   mutable std::mutex mSummaryGroupsMutex;
+
    ///To block the Delete() method against the ODCalcSummaryTask::Update() method
    ODLock   mDeleteUpdateMutex;
 
@@ -242,10 +256,40 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
 
    int FindBlock(sampleCount pos) const;
 
+   // Discard summaries of groups containing blocks from the given index on
+   void InvalidateSummaryGroups(size_t fromBlock);
+   // Discard the summary of the group containing one replaced block
+   void InvalidateSummaryGroup(size_t block);
+
+   // Accumulate min, max, sum of squares and length of the whole blocks
+   // b0 up to but excluding b1, using the summaries of groups where
+   // possible.  Returns false if some block did not have its summary yet.
+   bool AccumulateBlocks(unsigned b0, unsigned b1,
+      float &min, float &max, double &sumsq, sampleCount &length,
+      bool mayThrow) const;
+
+   // Accumulate the sum of the samples of the whole blocks b0 up to but
+   // excluding b1, using the sums of groups where possible
+   double AccumulateSums(unsigned b0, unsigned b1, bool mayThrow) const;
+
+   // GetWaveDisplay() when columns are wider than blocks
+   void GetWaveDisplayFromSummaries(float *min, float *max, float *rms,
+      int* bl, size_t len, const sampleCount *where,
+      sampleCount s0, sampleCount s1) const;
+
    static void AppendBlock
       (DirManager &dirManager,
        BlockArray &blocks, sampleCount &numSamples, const SeqBlock &b);
 
+   // Append blocks b0 up to but excluding b1 of src, which belong to
+   // srcDirManager.  Runs of blocks that DirManager::CopyBlockFile() would
+   // not copy are shared; the others are copied, and appended together.
+   static void AppendBlocks
+      (DirManager &dirManager,
+       BlockArray &blocks, sampleCount &numSamples,
+       const DirManager &srcDirManager, const BlockArray &src,
+       size_t b0, size_t b1);
+
    static bool Read(samplePtr buffer, sampleFormat format,
              const SeqBlock &b,
              size_t blockRelativeStart, size_t len, bool mayThrow);
@@ -255,7 +299,7 @@ class PROFILE_DLL_API Sequence final : public XMLTagHandler{
    // CommitChangesIfConsistent later.
    static void Blockify
       (DirManager &dirManager, size_t maxSamples, sampleFormat format,
-       BlockArray &list, sampleCount start, samplePtr buffer, size_t len);
+       BlockArray &list, samplePtr buffer, size_t len);
 
    bool Get(int b, samplePtr buffer, sampleFormat format,
       sampleCount start, size_t len, bool mayThrow) const;
@@ -276,8 +320,9 @@ public:
       (const BlockArray &block, sampleCount numSamples, wxString *dest);
 
 private:
+   // Takes constant time, as BlockArray keeps the starts consistent
    static void ConsistencyCheck
-      (const BlockArray &block, size_t maxSamples, size_t from,
+      (const BlockArray &block, size_t maxSamples,
        sampleCount numSamples, const wxChar *whereStr,
        bool mayThrow = true);
 
@@ -285,8 +330,10 @@ private:
    // They either throw because final consistency check fails, or swap the
    // changed contents into place.
 
+   // newBlock has the same blocks as mBlock before index unchanged
    void CommitChangesIfConsistent
-      (BlockArray &newBlock, sampleCount numSamples, const wxChar *whereStr);
+      (BlockArray &newBlock, sampleCount numSamples, const wxChar *whereStr,
+       size_t unchanged);
 
    void AppendBlocksIfConsistent
       (BlockArray &additionalBlocks, bool replaceLast,
@@ -0,0 +1,187 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrogramEngine.cpp
+
+*******************************************************************//**
+
+\class SpectrogramEngine
+\brief Computes the columns of spectrograms on a few std::threads, while
+drawing goes on.
+
+  A clip in spectrogram view submits a job for the columns its cache
+  lacks, and draws a placeholder for those not yet done.  The workers all
+  take columns from the newest job, and the engine posts
+  EVT_SPECTROGRAM_UPDATE so that the track panel draws again.  When the
+  zoom or the clip changes, the clip cancels its job before it changes
+  the cache.
+
+*//*******************************************************************/
+
+#include "SpectrogramEngine.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <wx/app.h>
+
+#include "WorkerPool.h"
+
+wxDEFINE_EVENT(EVT_SPECTROGRAM_UPDATE, wxCommandEvent);
+
+namespace {
+// Least time between updates posted as columns are done
+const long long UpdateIntervalMs = 100;
+}
+
+SpectrogramEngine::Job::Job(std::vector<size_t> columns, size_t batchSize)
+   : mColumns{ std::move(columns) }
+   , mBatchSize{ std::max<size_t>(1, batchSize) }
+{
+}
+
+SpectrogramEngine::Job::~Job()
+{
+}
+
+SpectrogramEngine &SpectrogramEngine::Get()
+{
+   static SpectrogramEngine engine;
+   return engine;
+}
+
+SpectrogramEngine::SpectrogramEngine()
+{
+   // Leave one processor for drawing
+   const auto nThreads =
+      std::max<size_t>(1, WorkerPool::GetHardwareConcurrency() - 1);
+   for (size_t ii = 0; ii < nThreads; ++ii)
+      mThreads.emplace_back([this]{ Run(); });
+}
+
+SpectrogramEngine::~SpectrogramEngine()
+{
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      mStopping = true;
+      for (auto &pJob : mJobs)
+         pJob->mCancelled = true;
+   }
+   mCondition.notify_all();
+   for (auto &thread : mThreads)
+      thread.join();
+}
+
+void SpectrogramEngine::Submit(const std::shared_ptr<Job> &pJob)
+{
+   if (!pJob || pJob->IsFinished())
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      mJobs.push_front(pJob);
+   }
+   mCondition.notify_all();
+}
+
+void SpectrogramEngine::Cancel(Job &job)
+{
+   job.mCancelled = true;
+
+   std::unique_lock<std::mutex> lock{ mMutex };
+   auto end = mJobs.end();
+   auto found = std::find_if(mJobs.begin(), end,
+      [&](const std::shared_ptr<Job> &pJob){ return pJob.get() == &job; });
+   if (found != end)
+      mJobs.erase(found);
+
+   // Wait for columns already started
+   mCondition.wait(lock, [&]{ return job.mnBusy == 0; });
+}
+
+std::vector<size_t> SpectrogramEngine::CoarseToFine(
+   const std::vector<size_t> &columns)
+{
+   std::vector<size_t> result;
+   result.reserve(columns.size());
+   const size_t coarsest = 64;
+   for (size_t stride = coarsest; stride >= 1; stride /= 2)
+      for (auto column : columns)
+         if (column % stride == 0 &&
+             (stride == coarsest || column % (2 * stride) != 0))
+            result.push_back(column);
+   return result;
+}
+
+void SpectrogramEngine::Run()
+{
+   // Belongs to this thread, and is reused for each batch of columns
+   std::vector<float> scratch;
+
+   std::unique_lock<std::mutex> lock{ mMutex };
+   while (true)
+   {
+      mCondition.wait(lock, [this]{ return mStopping || !mJobs.empty(); });
+      if (mStopping)
+         return;
+
+      // All workers help with the newest job
+      auto pJob = mJobs.front();
+      auto &job = *pJob;
+      ++job.mnBusy;
+      lock.unlock();
+
+      bool finished = false;
+      while (!job.mCancelled)
+      {
+         const auto size = job.mColumns.size();
+         const auto first = job.mNext.fetch_add(job.mBatchSize);
+         if (first >= size)
+         {
+            finished = true;
+            break;
+         }
+         const auto nColumns = std::min(job.mBatchSize, size - first);
+         job.Compute(&job.mColumns[first], nColumns, scratch);
+         if ((job.mDone += nColumns) == size)
+            PostUpdate(true);
+         else
+            PostUpdate(false);
+      }
+
+      lock.lock();
+      if (finished)
+      {
+         auto end = mJobs.end();
+         auto found = std::find(mJobs.begin(), end, pJob);
+         if (found != end)
+            mJobs.erase(found);
+      }
+
+      // Whoever submitted the job keeps it until Cancel() returns, so this
+      // is never the last reference, and the job is destroyed on the
+      // thread that made it
+      pJob.reset();
+      --job.mnBusy;
+      mCondition.notify_all();
+   }
+}
+
+void SpectrogramEngine::PostUpdate(bool force)
+{
+   using namespace std::chrono;
+   const long long now = duration_cast<milliseconds>(
+      steady_clock::now().time_since_epoch()).count();
+   auto last = mLastPost.load();
+   if (!force && now - last < UpdateIntervalMs)
+      return;
+   if (!mLastPost.compare_exchange_strong(last, now) && !force)
+      return;
+
+   if (wxTheApp)
+   {
+      wxCommandEvent event( EVT_SPECTROGRAM_UPDATE );
+      wxTheApp->AddPendingEvent(event);
+   }
+}
@@ -0,0 +1,97 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrogramEngine.h
+
+  Computes the columns of spectrograms on threads of its own, so that
+  drawing can show what is ready and need not wait for the rest.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SPECTROGRAM_ENGINE__
+#define __AUDACITY_SPECTROGRAM_ENGINE__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <wx/event.h> // to declare custom event types
+
+// This event is posted to the application, now and then as columns are
+// done, and when a job is finished
+wxDECLARE_EXPORTED_EVENT(AUDACITY_DLL_API,
+                         EVT_SPECTROGRAM_UPDATE, wxCommandEvent);
+
+class AUDACITY_DLL_API SpectrogramEngine final
+{
+public:
+   // Columns of one spectrogram, computed in the order given
+   class AUDACITY_DLL_API Job /* not final */
+   {
+   public:
+      // Workers take up to batchSize columns at a time
+      explicit Job(std::vector<size_t> columns, size_t batchSize = 1);
+      virtual ~Job();
+
+      Job(const Job&) PROHIBITED;
+      Job &operator= (const Job&) PROHIBITED;
+
+      // Called on worker threads, on several at once for different columns,
+      // with no more than the batch size of columns in each call.
+      // scratch belongs to the calling thread, and may be resized.
+      virtual void Compute(const size_t *columns, size_t nColumns,
+         std::vector<float> &scratch) = 0;
+
+      bool IsFinished() const { return mDone == mColumns.size(); }
+
+   private:
+      friend SpectrogramEngine;
+
+      const std::vector<size_t> mColumns;
+      const size_t mBatchSize;
+      std::atomic<size_t> mNext{ 0 };
+      std::atomic<size_t> mDone{ 0 };
+      std::atomic<bool> mCancelled{ false };
+      // Workers computing columns of this job; guarded by the engine's mutex
+      size_t mnBusy{ 0 };
+   };
+
+   static SpectrogramEngine &Get();
+
+   // Newer jobs are done before older ones, as likelier to be on screen.
+   // Whoever submits a job must Cancel() it before destroying what it
+   // computes into.
+   void Submit(const std::shared_ptr<Job> &pJob);
+
+   // Computes no more columns of the job, and returns when none is being
+   // computed.  Harmless for a job already finished.
+   void Cancel(Job &job);
+
+   // Columns in the order that fills a view soonest:  every 64th column,
+   // then those halfway between, and so on
+   static std::vector<size_t> CoarseToFine(const std::vector<size_t> &columns);
+
+private:
+   SpectrogramEngine();
+   ~SpectrogramEngine();
+
+   void Run();
+   void PostUpdate(bool force);
+
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+   std::deque< std::shared_ptr<Job> > mJobs;
+   bool mStopping{ false };
+   std::atomic<long long> mLastPost{ 0 };
+
+   std::vector< std::thread > mThreads;
+};
+
+#endif
@@ -0,0 +1,533 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrogramTileCache.cpp
+
+*******************************************************************//**
+
+\class SpectrogramTileCache
+\brief Keeps columns of spectrograms, by block, in memory and on disk.
+
+  The spectrum cache of a clip is thrown away whenever the zoom changes,
+  and with the clip when the project closes.  When samples per pixel are
+  at least MinHop, columns are instead computed at multiples of a power of
+  two samples from the start of each block, no more than half a pixel from
+  where they belong, and kept here, so that they can be used again at any
+  zoom with the same spacing, and after the project is opened again.
+
+  A tile is named for its block, the spectrogram settings, the spacing and
+  its place in the block, and kept in the folder "spectrogram" of the
+  project's data directory.  Tiles of projects not yet saved are kept only
+  in memory, because their temporary directories are not cleaned of
+  other files.  Names of block files may be used again for
+  other data after a block is deleted, so tiles also record the length and
+  the summary of their block, and are ignored if those differ.
+
+  The cache is bounded by the preference /Directories/SpectrogramCacheSize,
+  in megabytes, for the files of each project.  Zero disables it.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "SpectrogramTileCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include "BlockArray.h"
+#include "BlockFile.h"
+#include "Prefs.h"
+#include "blockfile/PackedBlockFile.h"
+#include "prefs/SpectrogramSettings.h"
+
+namespace {
+
+// Tiles kept in memory, whether or not they are on disk too
+const size_t MemoryCapacity = 64 << 20;
+
+const char Magic[8] = { 'A', 'U', 'D', 'S', 'P', 'T', '0', '1' };
+
+struct FileHeader {
+   char magic[8];
+   unsigned long long blockLen;
+   float min, max, rms;
+   unsigned int nBins;
+   unsigned int first, last;
+};
+
+}
+
+struct SpectrogramTileCache::Tile {
+   FilePath directory;
+   wxString name;
+
+   // Identify the data of the block
+   size_t blockLen;
+   float min, max, rms;
+
+   size_t nBins;
+   // Only columns from first up to last lie within the block
+   size_t first, last;
+   // Columns from first, and which of them are computed;
+   // guarded by the mutex of the cache until complete
+   std::vector< float > values;
+   std::vector< bool > have;
+   size_t nHave{ 0 };
+   bool complete{ false };
+
+   bool Matches(const Layout::Block &block) const
+   {
+      return blockLen == block.len &&
+         min == block.min && max == block.max && rms == block.rms;
+   }
+   size_t GetBytes() const { return values.size() * sizeof(float); }
+   FilePath GetPath() const
+      { return directory + wxFILE_SEP_PATH + name; }
+
+   bool Read();
+   bool Write() const;
+};
+
+bool SpectrogramTileCache::Tile::Read()
+{
+   wxFFile file;
+   {
+      wxLogNull logNo;
+      if (!file.Open(GetPath(), wxT("rb")))
+         return false;
+   }
+
+   FileHeader header;
+   if (file.Read(&header, sizeof(header)) != sizeof(header) ||
+       memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+       header.blockLen != blockLen ||
+       header.min != min || header.max != max || header.rms != rms ||
+       header.nBins != nBins ||
+       header.first != first || header.last != last)
+      return false;
+
+   const auto bytes = GetBytes();
+   if (file.Read(values.data(), bytes) != bytes)
+      return false;
+
+   std::fill(have.begin(), have.end(), true);
+   nHave = have.size();
+   complete = true;
+   return true;
+}
+
+bool SpectrogramTileCache::Tile::Write() const
+{
+   wxLogNull logNo;
+   if (!wxFileName::DirExists(directory) &&
+       !wxFileName::Mkdir(directory, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+      return false;
+
+   FileHeader header;
+   memcpy(header.magic, Magic, sizeof(Magic));
+   header.blockLen = blockLen;
+   header.min = min, header.max = max, header.rms = rms;
+   header.nBins = nBins;
+   header.first = first, header.last = last;
+
+   // Write another file and rename it, so that no tile is ever read half
+   // written
+   const auto path = GetPath();
+   const auto temp = path + wxT(".tmp");
+   {
+      wxFFile file;
+      if (!file.Open(temp, wxT("wb")))
+         return false;
+      const auto bytes = GetBytes();
+      if (file.Write(&header, sizeof(header)) != sizeof(header) ||
+          file.Write(values.data(), bytes) != bytes ||
+          !file.Close()) {
+         file.Close();
+         wxRemoveFile(temp);
+         return false;
+      }
+   }
+   if (!wxRenameFile(temp, path)) {
+      wxRemoveFile(temp);
+      return false;
+   }
+   return true;
+}
+
+// The tile files of one directory, most recently used first
+struct SpectrogramTileCache::Directory {
+   struct File {
+      wxString name;
+      size_t bytes;
+   };
+   using List = std::list< File >;
+   FilePath path;
+   List files;
+   std::unordered_map< wxString, List::iterator > index;
+   size_t bytes{ 0 };
+};
+
+SpectrogramTileCache &SpectrogramTileCache::Get()
+{
+   static SpectrogramTileCache theCache{ GetDiskCapacityPref() };
+   return theCache;
+}
+
+size_t SpectrogramTileCache::GetDiskCapacityPref()
+{
+   const long megabytes = gPrefs
+      ? gPrefs->Read(wxT("/Directories/SpectrogramCacheSize"), 512L)
+      : 0;
+   return size_t(std::max(0L, megabytes)) << 20;
+}
+
+SpectrogramTileCache::SpectrogramTileCache(size_t diskCapacityBytes)
+   : mDiskCapacity{ diskCapacityBytes }
+{
+}
+
+SpectrogramTileCache::~SpectrogramTileCache()
+{
+}
+
+size_t SpectrogramTileCache::GetDiskCapacity() const
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   return mDiskCapacity;
+}
+
+void SpectrogramTileCache::SetDiskCapacity(size_t capacityBytes)
+{
+   std::lock_guard< std::mutex > lock{ mMutex };
+   mDiskCapacity = capacityBytes;
+   for (auto &pair : mDirectories)
+      TrimDisk(*pair.second);
+}
+
+void SpectrogramTileCache::Clear()
+{
+   std::list< TilePtr > tiles;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      tiles.swap(mTiles);
+      mIndex.clear();
+      mBytes = 0;
+   }
+}
+
+auto SpectrogramTileCache::Layout::Make(
+   const BlockArray &blocks, sampleCount start, sampleCount end,
+   const SpectrogramSettings &settings, double samplesPerPixel,
+   const FilePath &dataDir) -> std::shared_ptr< const Layout >
+{
+   if (settings.algorithm == SpectrogramSettings::algReassignment ||
+       Get().GetDiskCapacity() == 0)
+      return {};
+
+   size_t hop = 1;
+   while (hop * 2 <= samplesPerPixel)
+      hop *= 2;
+   if (hop < MinHop)
+      return {};
+
+   const auto numSamples = blocks.GetNumSamples();
+   if (blocks.empty() || end < 0 || start >= numSamples)
+      return {};
+   start = std::max< sampleCount >(0, start);
+
+   auto pLayout = std::shared_ptr< Layout >{ safenew Layout };
+   auto &layout = *pLayout;
+   if (!dataDir.empty())
+      layout.mDirectory = dataDir + wxFILE_SEP_PATH + wxT("spectrogram");
+   layout.mHop = hop;
+   layout.mWindowSize = settings.WindowSize();
+   layout.mnBins = settings.NBins();
+   layout.mSuffix = wxString::Format(wxT("w%lu_z%lu_t%d_a%d_h%lu"),
+      (unsigned long)settings.WindowSize(),
+      (unsigned long)settings.ZeroPaddingFactor(),
+      settings.windowType, (int)settings.algorithm,
+      (unsigned long)hop);
+
+   for (auto ii = blocks.FindBlock(start), nn = blocks.size(); ii < nn; ++ii) {
+      const auto seqBlock = blocks[ii];
+      if (seqBlock.start > end)
+         break;
+      const auto &f = seqBlock.f;
+      if (!f->IsDataAvailable() || !f->IsSummaryAvailable() ||
+          f->GetLength() < layout.mWindowSize)
+         continue;
+
+      // Name the data:  packed blocks by their place in the container, and
+      // others by their files.  Silent blocks have no name and are skipped.
+      wxString name;
+      if (auto pPacked = dynamic_cast< const PackedBlockFile* >(f.get())) {
+         const auto location = pPacked->GetExtent()->GetLocation();
+         name = wxString::Format(wxT("%s_%lld"),
+            wxFileName{ location.pContainer->GetPath() }.GetName(),
+            (long long)location.offset);
+      }
+      else {
+         auto fileName = f->GetFileName();
+         if (!fileName.name.HasName())
+            continue;
+         name = fileName.name.GetName();
+      }
+
+      const auto summary = f->GetMinMaxRMS(false);
+      layout.mBlocks.push_back({ seqBlock.start, f->GetLength(), name,
+         summary.min, summary.max, summary.RMS });
+   }
+
+   if (layout.mBlocks.empty())
+      return {};
+   return pLayout;
+}
+
+bool SpectrogramTileCache::Layout::Find(
+   sampleCount center, Place &place) const
+{
+   // The last block starting at or before center
+   auto iter = std::upper_bound(mBlocks.begin(), mBlocks.end(), center,
+      [](sampleCount value, const Block &block){ return value < block.start; });
+   if (iter == mBlocks.begin())
+      return false;
+   const auto &block = *--iter;
+   const auto offset = (center - block.start).as_double();
+   if (offset >= block.len)
+      return false;
+
+   // The window must lie within the block
+   const auto column = (long long)floor(offset / mHop + 0.5);
+   const auto half = (long long)(mWindowSize >> 1);
+   const auto sample = column * (long long)mHop;
+   if (sample < half ||
+       sample - half + (long long)mWindowSize > (long long)block.len)
+      return false;
+
+   place.pTile = Get().Fetch(*this, block, column / TileColumns);
+   if (!place.pTile)
+      return false;
+   place.column = column % TileColumns;
+   place.center = block.start + sample;
+   return true;
+}
+
+bool SpectrogramTileCache::Layout::Load(
+   const Place &place, float *values) const
+{
+   auto &tile = *place.pTile;
+   const auto ii = place.column - tile.first;
+   {
+      std::lock_guard< std::mutex > lock{ Get().mMutex };
+      if (!tile.have[ii])
+         return false;
+   }
+   // Computed columns do not change
+   std::copy_n(&tile.values[ii * tile.nBins], tile.nBins, values);
+   return true;
+}
+
+void SpectrogramTileCache::Layout::Store(
+   const Place &place, const float *values) const
+{
+   auto &cache = Get();
+   auto &tile = *place.pTile;
+   const auto ii = place.column - tile.first;
+   {
+      std::lock_guard< std::mutex > lock{ cache.mMutex };
+      if (tile.have[ii])
+         return;
+      std::copy_n(values, tile.nBins, &tile.values[ii * tile.nBins]);
+      tile.have[ii] = true;
+      if (++tile.nHave < tile.have.size())
+         return;
+      tile.complete = true;
+   }
+   cache.Complete(place.pTile);
+}
+
+auto SpectrogramTileCache::Fetch(const Layout &layout,
+   const Layout::Block &block, size_t index) -> TilePtr
+{
+   auto pTile = std::make_shared< Tile >();
+   auto &tile = *pTile;
+   tile.directory = layout.mDirectory;
+   tile.name = wxString::Format(wxT("%s_%s_%lu.spt"),
+      block.name, layout.mSuffix, (unsigned long)index);
+   tile.blockLen = block.len;
+   tile.min = block.min, tile.max = block.max, tile.rms = block.rms;
+   tile.nBins = layout.mnBins;
+
+   // The columns whose windows lie within the block
+   const auto hop = layout.mHop;
+   const auto half = layout.mWindowSize >> 1;
+   const auto firstInBlock = (half + hop - 1) / hop;
+   const auto lastInBlock = (block.len - (layout.mWindowSize - half)) / hop + 1;
+   tile.first = std::max(index * TileColumns, firstInBlock) - index * TileColumns;
+   tile.last =
+      std::min((index + 1) * TileColumns, lastInBlock) - index * TileColumns;
+   if (tile.first >= tile.last)
+      return {};
+
+   const auto path = tile.GetPath();
+   bool onDisk = false;
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      auto iter = mIndex.find(path);
+      if (iter != mIndex.end()) {
+         auto &pFound = *iter->second;
+         if (pFound->Matches(block) && pFound->nBins == tile.nBins) {
+            mTiles.splice(mTiles.begin(), mTiles, iter->second);
+            return pFound;
+         }
+         mBytes -= pFound->GetBytes();
+         mTiles.erase(iter->second);
+         mIndex.erase(iter);
+      }
+      if (mDiskCapacity == 0)
+         return {};
+      if (!tile.directory.empty()) {
+         auto &directory = GetDirectory(tile.directory);
+         onDisk = directory.index.count(tile.name) > 0;
+      }
+   }
+
+   // Read without holding the lock
+   tile.values.resize((tile.last - tile.first) * tile.nBins);
+   tile.have.resize(tile.last - tile.first);
+   if (onDisk && tile.Read())
+      // Remember the use in later sessions
+      wxFileName{ path }.Touch();
+
+   std::lock_guard< std::mutex > lock{ mMutex };
+   auto iter = mIndex.find(path);
+   if (iter != mIndex.end() && (*iter->second)->Matches(block)) {
+      // Another thread won the race
+      mTiles.splice(mTiles.begin(), mTiles, iter->second);
+      return *iter->second;
+   }
+   if (iter != mIndex.end()) {
+      mBytes -= (*iter->second)->GetBytes();
+      mTiles.erase(iter->second);
+      mIndex.erase(iter);
+   }
+
+   if (onDisk) {
+      auto &directory = GetDirectory(tile.directory);
+      auto found = directory.index.find(tile.name);
+      if (found != directory.index.end()) {
+         if (tile.complete)
+            directory.files.splice(
+               directory.files.begin(), directory.files, found->second);
+         else {
+            // Stale or damaged; it will be written again when complete
+            directory.bytes -= found->second->bytes;
+            directory.files.erase(found->second);
+            directory.index.erase(found);
+            wxRemoveFile(path);
+         }
+      }
+   }
+
+   mTiles.push_front(pTile);
+   mIndex[path] = mTiles.begin();
+   mBytes += tile.GetBytes();
+   TrimMemory();
+   return pTile;
+}
+
+void SpectrogramTileCache::Complete(const TilePtr &pTile)
+{
+   // The values no longer change, so write without holding the lock
+   if (pTile->directory.empty() || !pTile->Write())
+      return;
+
+   std::lock_guard< std::mutex > lock{ mMutex };
+   auto &directory = GetDirectory(pTile->directory);
+   auto found = directory.index.find(pTile->name);
+   if (found != directory.index.end()) {
+      directory.bytes -= found->second->bytes;
+      directory.files.erase(found->second);
+      directory.index.erase(found);
+   }
+   const auto bytes = sizeof(FileHeader) + pTile->GetBytes();
+   directory.files.push_front({ pTile->name, bytes });
+   directory.index[pTile->name] = directory.files.begin();
+   directory.bytes += bytes;
+   TrimDisk(directory);
+}
+
+// Call with mMutex held
+auto SpectrogramTileCache::GetDirectory(const FilePath &path) -> Directory &
+{
+   auto &pDirectory = mDirectories[path];
+   if (pDirectory)
+      return *pDirectory;
+
+   pDirectory = std::make_unique< Directory >();
+   auto &directory = *pDirectory;
+   directory.path = path;
+
+   // Learn the files left by earlier sessions, newest first
+   struct Found {
+      wxString name;
+      size_t bytes;
+      time_t time;
+   };
+   std::vector< Found > found;
+   {
+      wxLogNull logNo;
+      wxDir dir;
+      wxString name;
+      if (wxDir::Exists(path) && dir.Open(path)) {
+         for (bool cont = dir.GetFirst(&name, wxT("*.spt"), wxDIR_FILES);
+              cont; cont = dir.GetNext(&name)) {
+            wxFileName fileName{ path, name };
+            const auto size = fileName.GetSize();
+            if (size == wxInvalidSize)
+               continue;
+            found.push_back({ name, (size_t)size.GetValue(),
+               fileName.GetModificationTime().GetTicks() });
+         }
+      }
+   }
+   std::sort(found.begin(), found.end(),
+      [](const Found &a, const Found &b){ return a.time > b.time; });
+
+   for (const auto &file : found) {
+      directory.files.push_back({ file.name, file.bytes });
+      directory.index[file.name] = --directory.files.end();
+      directory.bytes += file.bytes;
+   }
+   return directory;
+}
+
+// Call with mMutex held
+void SpectrogramTileCache::TrimMemory()
+{
+   while (mBytes > MemoryCapacity && mTiles.size() > 1) {
+      auto &pTile = mTiles.back();
+      mBytes -= pTile->GetBytes();
+      mIndex.erase(pTile->GetPath());
+      mTiles.pop_back();
+   }
+}
+
+// Call with mMutex held
+void SpectrogramTileCache::TrimDisk(Directory &directory)
+{
+   while (directory.bytes > mDiskCapacity && !directory.files.empty()) {
+      const auto &file = directory.files.back();
+      wxRemoveFile(directory.path + wxFILE_SEP_PATH + file.name);
+      directory.bytes -= file.bytes;
+      directory.index.erase(file.name);
+      directory.files.pop_back();
+   }
+}
@@ -0,0 +1,131 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrogramTileCache.h
+
+  Keeps columns of spectrograms, computed at fixed samples of each block,
+  in memory and in files in the project's data directory.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SPECTROGRAM_TILE_CACHE__
+#define __AUDACITY_SPECTROGRAM_TILE_CACHE__
+
+#include "SampleFormat.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class BlockArray;
+class SpectrogramSettings;
+
+// Process-wide, size-bounded, least-recently-used cache of tiles of
+// spectrogram columns.  A tile holds TileColumns columns of one block, a
+// power of two samples apart, for one window size, window type, zero
+// padding and algorithm, before any frequency gain.
+// A column is kept only if its window lies within the block, so that it
+// depends on nothing but the block, which never changes.  Tiles are written
+// to disk when all such columns are computed, and the files are removed,
+// least recently used first, when they exceed the preference
+// /Directories/SpectrogramCacheSize in each directory.
+class SpectrogramTileCache {
+   struct Tile;
+   using TilePtr = std::shared_ptr< Tile >;
+
+ public:
+   static SpectrogramTileCache &Get();
+
+   enum : size_t { TileColumns = 128 };
+
+   // Columns in tiles are no closer than this; when zoomed in further, all
+   // columns are computed anew
+   enum : size_t { MinHop = 16 };
+
+   // Where one column may be found
+   struct Place {
+      TilePtr pTile;
+      size_t column{ 0 };
+      // The sample, of the sequence, at the center of the window
+      sampleCount center{ 0 };
+   };
+
+   // The blocks of a sequence in one span of samples, for one zoom and one
+   // setting of the spectrogram.  Made on the main thread, then used on
+   // any thread.
+   class Layout {
+    public:
+      // Returns null if no column would be cached:  if the cache is
+      // disabled, the zoom is too close, or the algorithm is not one
+      // computed a column at a time.  With dataDir empty, tiles are kept
+      // in memory only.
+      static std::shared_ptr< const Layout > Make(
+         const BlockArray &blocks, sampleCount start, sampleCount end,
+         const SpectrogramSettings &settings, double samplesPerPixel,
+         const FilePath &dataDir);
+
+      // If a column near center may be cached, finds its place, and the
+      // sample the column should be centered at instead of center, within
+      // half a column.  Returns false if not.
+      bool Find(sampleCount center, Place &place) const;
+
+      // Gets NBins() values, if the column is in the cache
+      bool Load(const Place &place, float *values) const;
+      void Store(const Place &place, const float *values) const;
+
+    private:
+      struct Block {
+         sampleCount start;
+         size_t len;
+         wxString name;
+         float min, max, rms;
+      };
+      Layout() = default;
+      friend SpectrogramTileCache;
+
+      std::vector< Block > mBlocks;
+      FilePath mDirectory;
+      wxString mSuffix;
+      size_t mHop{ 0 };
+      size_t mWindowSize{ 0 };
+      size_t mnBins{ 0 };
+   };
+
+   explicit SpectrogramTileCache(size_t diskCapacityBytes);
+   ~SpectrogramTileCache();
+
+   SpectrogramTileCache(const SpectrogramTileCache&) PROHIBITED;
+   SpectrogramTileCache &operator= (const SpectrogramTileCache&) PROHIBITED;
+
+   size_t GetDiskCapacity() const;
+   void SetDiskCapacity(size_t capacityBytes);
+
+   // Forget the tiles in memory; files stay
+   void Clear();
+
+   // Reads the preference, in megabytes
+   static size_t GetDiskCapacityPref();
+
+ private:
+   // Finds the tile in memory or on disk, or makes an empty one
+   TilePtr Fetch(const Layout &layout, const Layout::Block &block,
+      size_t index);
+   void Complete(const TilePtr &pTile);
+
+   struct Directory;
+   Directory &GetDirectory(const FilePath &path);
+   void TrimMemory();
+   void TrimDisk(Directory &directory);
+
+   mutable std::mutex mMutex;
+   // Most recently used at the front, keyed by file path
+   std::list< TilePtr > mTiles;
+   std::unordered_map< FilePath, std::list< TilePtr >::iterator > mIndex;
+   size_t mBytes{ 0 };
+   size_t mDiskCapacity;
+   std::unordered_map< FilePath, std::unique_ptr< Directory > > mDirectories;
+};
+
+#endif
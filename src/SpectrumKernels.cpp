@@ -0,0 +1,479 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrumKernels.cpp
+
+*******************************************************************//**
+
+\namespace SpectrumKernels
+\brief Transforms several windows of samples at once, and colours rows
+of pixels, for spectrograms.
+
+  The windows are interleaved, so that value k of window j is lane j of
+  vector k, and then the butterflies and the massaging of RealFFTf() are
+  done on whole vectors, each with the same sine and cosine in every
+  lane.  This is the scheme of RealFFTf4x() in RealFFTf48x.cpp, which is
+  built only for the threaded SSE equalization, keeps tables of its own,
+  and has no AVX2 form.
+
+  Colours are looked up a vector of values at a time, and copied as
+  words that overlap by a byte, so that each row of the image is written
+  from start to end.  AVX2 gathers eight colours at once and packs them
+  into 24 bytes.
+
+  SSE2 is used whenever the compiler targets it, and AVX2 is compiled with
+  a function attribute and chosen at run time, as in DitherKernels.cpp.
+  Vector and scalar code perform the same floating point operations in
+  the same order, so the spectra are identical.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "SpectrumKernels.h"
+
+#include "DitherKernels.h"
+#include "RealFFTf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <math.h>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #define SPECTRUM_KERNELS_SSE2
+   #include <emmintrin.h>
+
+   #if defined(_MSC_VER) || defined(__clang__) || \
+      (defined(__GNUC__) && \
+       (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+      #define SPECTRUM_KERNELS_AVX2
+      #include <immintrin.h>
+      #if defined(_MSC_VER)
+         #define AVX2_TARGET
+      #else
+         #define AVX2_TARGET __attribute__((target("avx2")))
+      #endif
+   #endif
+#endif
+
+namespace {
+
+using SpectrumKernels::InstructionSet;
+
+inline float ToDB(float power)
+{
+   return power <= 0 ? -160.0f : (float)(10.0 * log10f(power));
+}
+
+std::atomic< InstructionSet > &CurrentInstructionSet()
+{
+   static std::atomic< InstructionSet > current{
+      SpectrumKernels::Available() };
+   return current;
+}
+
+size_t BatchSize(InstructionSet set)
+{
+   switch (set) {
+      case InstructionSet::AVX2:
+         return 8;
+      case InstructionSet::SSE2:
+         return 4;
+      default:
+         return 1;
+   }
+}
+
+// Vectors are aligned for the widest instruction set
+float *Align(float *scratch)
+{
+   const uintptr_t mask = 31;
+   return (float*)(((uintptr_t)scratch + mask) & ~mask);
+}
+
+// Windows the samples of each buffer into its lane of x, and zeroes the
+// padding and the lanes without buffers
+void Interleave(float *x, size_t lanes,
+   const float *const *buffers, size_t nWindows,
+   const float *window, size_t len, size_t fftLen)
+{
+   len = std::min(len, fftLen);
+   for (size_t jj = 0; jj < lanes; ++jj) {
+      float *lane = x + jj;
+      size_t kk = 0;
+      if (jj < nWindows) {
+         const float *const buffer = buffers[jj];
+         for (; kk < len; ++kk)
+            lane[kk * lanes] = buffer[kk] * window[kk];
+      }
+      for (; kk < fftLen; ++kk)
+         lane[kk * lanes] = 0;
+   }
+}
+
+// Powers of the transforms in the first nWindows lanes of x, bin by bin
+void StorePowers(const float *x, size_t lanes, size_t nWindows,
+   const FFTParam *hFFT, float *const *outs)
+{
+   // Handle the (real-only) DC
+   for (size_t jj = 0; jj < nWindows; ++jj)
+      outs[jj][0] = ToDB(x[jj] * x[jj]);
+   for (size_t ii = 1; ii < hFFT->Points; ++ii) {
+      const float *const re = x + hFFT->BitReversed[ii] * lanes;
+      const float *const im = re + lanes;
+      for (size_t jj = 0; jj < nWindows; ++jj)
+         outs[jj][ii] = ToDB(re[jj] * re[jj] + im[jj] * im[jj]);
+   }
+}
+
+// The gradient index of a value, as GetColorGradient() finds it
+inline int GradientIndex(float value, float scale)
+{
+   // NaN is taken as 1
+   return std::max(0.0f, std::min(1.0f, value)) * scale;
+}
+
+void ColorPixels(const float *values, size_t count,
+   const unsigned char (*gradient)[4], float scale, unsigned char *rgb)
+{
+   for (size_t ii = 0; ii < count; ++ii)
+      memcpy(rgb + 3 * ii, gradient[GradientIndex(values[ii], scale)], 3);
+}
+
+#ifdef SPECTRUM_KERNELS_SSE2
+
+namespace SSE2 {
+
+// RealFFTf() of the four windows in X
+void Transform(__m128 *X, const FFTParam *h)
+{
+   const __m128 two = _mm_set1_ps(2.0f);
+   const __m128 half = _mm_set1_ps(0.5f);
+   __m128 *const end1 = X + h->Points * 2;
+
+   auto ButterfliesPerGroup = h->Points / 2;
+   while (ButterfliesPerGroup > 0) {
+      __m128 *A = X;
+      __m128 *B = X + ButterfliesPerGroup * 2;
+      const float *sptr = h->SinTable.get();
+      while (A < end1) {
+         const __m128 sin = _mm_set1_ps(sptr[0]);
+         const __m128 cos = _mm_set1_ps(sptr[1]);
+         __m128 *const end2 = B;
+         while (A < end2) {
+            const __m128 v1 =
+               _mm_add_ps(_mm_mul_ps(B[0], cos), _mm_mul_ps(B[1], sin));
+            const __m128 v2 =
+               _mm_sub_ps(_mm_mul_ps(B[0], sin), _mm_mul_ps(B[1], cos));
+            B[0] = _mm_add_ps(A[0], v1);
+            A[0] = _mm_sub_ps(B[0], _mm_mul_ps(two, v1));
+            B[1] = _mm_sub_ps(A[1], v2);
+            A[1] = _mm_add_ps(B[1], _mm_mul_ps(two, v2));
+            A += 2;
+            B += 2;
+         }
+         A = B;
+         B += ButterfliesPerGroup * 2;
+         sptr += 2;
+      }
+      ButterfliesPerGroup >>= 1;
+   }
+
+   // Massage output to get the output for a real input sequence
+   const int *br1 = h->BitReversed.get() + 1;
+   const int *br2 = h->BitReversed.get() + h->Points - 1;
+   while (br1 < br2) {
+      const __m128 sin = _mm_set1_ps(h->SinTable[*br1]);
+      const __m128 cos = _mm_set1_ps(h->SinTable[*br1 + 1]);
+      __m128 *const A = X + *br1;
+      __m128 *const B = X + *br2;
+      const __m128 HRminus = _mm_sub_ps(A[0], B[0]);
+      const __m128 HRplus = _mm_add_ps(HRminus, _mm_mul_ps(B[0], two));
+      const __m128 HIminus = _mm_sub_ps(A[1], B[1]);
+      const __m128 HIplus = _mm_add_ps(HIminus, _mm_mul_ps(B[1], two));
+      const __m128 v1 =
+         _mm_sub_ps(_mm_mul_ps(sin, HRminus), _mm_mul_ps(cos, HIplus));
+      const __m128 v2 =
+         _mm_add_ps(_mm_mul_ps(cos, HRminus), _mm_mul_ps(sin, HIplus));
+      A[0] = _mm_mul_ps(_mm_add_ps(HRplus, v1), half);
+      B[0] = _mm_sub_ps(A[0], v1);
+      A[1] = _mm_mul_ps(_mm_add_ps(HIminus, v2), half);
+      B[1] = _mm_sub_ps(A[1], HIminus);
+      ++br1;
+      --br2;
+   }
+
+   // Handle the center bin (just need a conjugate)
+   __m128 *const center = X + *br1 + 1;
+   *center = _mm_xor_ps(*center, _mm_set1_ps(-0.0f));
+
+   // Put the Fs/2 value into the imaginary part of the DC bin
+   const __m128 v1 = _mm_sub_ps(X[0], X[1]);
+   X[0] = _mm_add_ps(X[0], X[1]);
+   X[1] = v1;
+}
+
+// Returns how many pixels were done; leaves at least one for scalar code,
+// which must not write beyond the row
+size_t ColorRow(const float *values, size_t count,
+   const unsigned char (*gradient)[4], float scale, unsigned char *rgb)
+{
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 scales = _mm_set1_ps(scale);
+   size_t ii = 0;
+   alignas(16) int32_t indices[4];
+   for (; ii + 5 <= count; ii += 4) {
+      // _mm_min_ps() gives the second operand for NaN, as std::min() does
+      const __m128 value = _mm_max_ps(zero,
+         _mm_min_ps(_mm_loadu_ps(values + ii), one));
+      _mm_store_si128((__m128i*)indices,
+         _mm_cvttps_epi32(_mm_mul_ps(value, scales)));
+      // Each word overwrites the unused byte of the one before
+      for (int jj = 0; jj < 4; ++jj)
+         memcpy(rgb + 3 * (ii + jj), gradient[indices[jj]], 4);
+   }
+   return ii;
+}
+
+} // namespace SSE2
+
+#endif
+
+#ifdef SPECTRUM_KERNELS_AVX2
+
+// Every function here needs the target attribute, or the compiler refuses
+// to inline the intrinsics into it.
+namespace AVX2 {
+
+// RealFFTf() of the eight windows in X
+AVX2_TARGET void Transform(__m256 *X, const FFTParam *h)
+{
+   const __m256 two = _mm256_set1_ps(2.0f);
+   const __m256 half = _mm256_set1_ps(0.5f);
+   __m256 *const end1 = X + h->Points * 2;
+
+   auto ButterfliesPerGroup = h->Points / 2;
+   while (ButterfliesPerGroup > 0) {
+      __m256 *A = X;
+      __m256 *B = X + ButterfliesPerGroup * 2;
+      const float *sptr = h->SinTable.get();
+      while (A < end1) {
+         const __m256 sin = _mm256_set1_ps(sptr[0]);
+         const __m256 cos = _mm256_set1_ps(sptr[1]);
+         __m256 *const end2 = B;
+         while (A < end2) {
+            const __m256 v1 = _mm256_add_ps(
+               _mm256_mul_ps(B[0], cos), _mm256_mul_ps(B[1], sin));
+            const __m256 v2 = _mm256_sub_ps(
+               _mm256_mul_ps(B[0], sin), _mm256_mul_ps(B[1], cos));
+            B[0] = _mm256_add_ps(A[0], v1);
+            A[0] = _mm256_sub_ps(B[0], _mm256_mul_ps(two, v1));
+            B[1] = _mm256_sub_ps(A[1], v2);
+            A[1] = _mm256_add_ps(B[1], _mm256_mul_ps(two, v2));
+            A += 2;
+            B += 2;
+         }
+         A = B;
+         B += ButterfliesPerGroup * 2;
+         sptr += 2;
+      }
+      ButterfliesPerGroup >>= 1;
+   }
+
+   // Massage output to get the output for a real input sequence
+   const int *br1 = h->BitReversed.get() + 1;
+   const int *br2 = h->BitReversed.get() + h->Points - 1;
+   while (br1 < br2) {
+      const __m256 sin = _mm256_set1_ps(h->SinTable[*br1]);
+      const __m256 cos = _mm256_set1_ps(h->SinTable[*br1 + 1]);
+      __m256 *const A = X + *br1;
+      __m256 *const B = X + *br2;
+      const __m256 HRminus = _mm256_sub_ps(A[0], B[0]);
+      const __m256 HRplus = _mm256_add_ps(HRminus, _mm256_mul_ps(B[0], two));
+      const __m256 HIminus = _mm256_sub_ps(A[1], B[1]);
+      const __m256 HIplus = _mm256_add_ps(HIminus, _mm256_mul_ps(B[1], two));
+      const __m256 v1 = _mm256_sub_ps(
+         _mm256_mul_ps(sin, HRminus), _mm256_mul_ps(cos, HIplus));
+      const __m256 v2 = _mm256_add_ps(
+         _mm256_mul_ps(cos, HRminus), _mm256_mul_ps(sin, HIplus));
+      A[0] = _mm256_mul_ps(_mm256_add_ps(HRplus, v1), half);
+      B[0] = _mm256_sub_ps(A[0], v1);
+      A[1] = _mm256_mul_ps(_mm256_add_ps(HIminus, v2), half);
+      B[1] = _mm256_sub_ps(A[1], HIminus);
+      ++br1;
+      --br2;
+   }
+
+   // Handle the center bin (just need a conjugate)
+   __m256 *const center = X + *br1 + 1;
+   *center = _mm256_xor_ps(*center, _mm256_set1_ps(-0.0f));
+
+   // Put the Fs/2 value into the imaginary part of the DC bin
+   const __m256 v1 = _mm256_sub_ps(X[0], X[1]);
+   X[0] = _mm256_add_ps(X[0], X[1]);
+   X[1] = v1;
+
+   _mm256_zeroupper();
+}
+
+// Returns how many pixels were done; leaves at least two for scalar code,
+// which must not write beyond the row
+AVX2_TARGET size_t ColorRow(const float *values, size_t count,
+   const unsigned char (*gradient)[4], float scale, unsigned char *rgb)
+{
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one = _mm256_set1_ps(1.0f);
+   const __m256 scales = _mm256_set1_ps(scale);
+   // Drops the unused bytes, leaving twelve at the start of each lane
+   const __m256i pack = _mm256_setr_epi8(
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+   size_t ii = 0;
+   for (; ii + 10 <= count; ii += 8) {
+      const __m256 value = _mm256_max_ps(zero,
+         _mm256_min_ps(_mm256_loadu_ps(values + ii), one));
+      const __m256i indices =
+         _mm256_cvttps_epi32(_mm256_mul_ps(value, scales));
+      const __m256i colors = _mm256_shuffle_epi8(
+         _mm256_i32gather_epi32((const int*)gradient, indices, 4), pack);
+      // 28 bytes are written, and the last four belong to the next pixels
+      unsigned char *const dst = rgb + 3 * ii;
+      _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(colors));
+      _mm_storeu_si128((__m128i*)(dst + 12),
+         _mm256_extracti128_si256(colors, 1));
+   }
+   _mm256_zeroupper();
+   return ii;
+}
+
+} // namespace AVX2
+
+#endif
+
+}
+
+namespace SpectrumKernels {
+
+InstructionSet Available()
+{
+   // This file is compiled for the same instruction sets as
+   // DitherKernels.cpp, which tests the processor
+   switch (DitherKernels::Available()) {
+      case DitherKernels::InstructionSet::AVX2:
+         return InstructionSet::AVX2;
+      case DitherKernels::InstructionSet::SSE2:
+         return InstructionSet::SSE2;
+      default:
+         return InstructionSet::Scalar;
+   }
+}
+
+InstructionSet Get()
+{
+   return CurrentInstructionSet().load(std::memory_order_relaxed);
+}
+
+void Set(InstructionSet set)
+{
+   if (set > Available())
+      set = Available();
+   CurrentInstructionSet().store(set, std::memory_order_relaxed);
+}
+
+const char *GetName(InstructionSet set)
+{
+   switch (set) {
+      case InstructionSet::SSE2:
+         return "SSE2";
+      case InstructionSet::AVX2:
+         return "AVX2";
+      default:
+         return "scalar";
+   }
+}
+
+size_t GetBatchSize()
+{
+   return BatchSize(Get());
+}
+
+size_t GetScratchSize(size_t fftLen)
+{
+   // Room to align the start
+   return MaxBatchSize * fftLen + 8;
+}
+
+void ComputeSpectrum(float *buffer, const FFTParam *hFFT,
+   const float *window, size_t len, float *out)
+{
+   size_t i;
+   if(len > hFFT->Points * 2)
+      len = hFFT->Points * 2;
+   for(i = 0; i < len; i++)
+      buffer[i] *= window[i];
+   for( ; i < (hFFT->Points * 2); i++)
+      buffer[i] = 0; // zero pad as needed
+   RealFFTf(buffer, hFFT);
+   // Handle the (real-only) DC
+   out[0] = ToDB(buffer[0] * buffer[0]);
+   for(i = 1; i < hFFT->Points; i++) {
+      const int index = hFFT->BitReversed[i];
+      const float re = buffer[index], im = buffer[index + 1];
+      out[i] = ToDB(re * re + im * im);
+   }
+}
+
+void ComputeSpectra(const float *const *buffers, size_t nWindows,
+   const FFTParam *hFFT, const float *window, size_t len,
+   float *const *outs, float *scratch)
+{
+   const auto fftLen = hFFT->Points * 2;
+   const auto set = Get();
+   if (set == InstructionSet::Scalar) {
+      for (size_t ii = 0; ii < nWindows; ++ii) {
+         const auto count = std::min(len, fftLen);
+         std::copy(buffers[ii], buffers[ii] + count, scratch);
+         ComputeSpectrum(scratch, hFFT, window, len, outs[ii]);
+      }
+      return;
+   }
+
+   const auto lanes = BatchSize(set);
+   float *const x = Align(scratch);
+   for (size_t first = 0; first < nWindows; first += lanes) {
+      const auto count = std::min(lanes, nWindows - first);
+      Interleave(x, lanes, buffers + first, count, window, len, fftLen);
+#if defined(SPECTRUM_KERNELS_AVX2)
+      if (set == InstructionSet::AVX2)
+         AVX2::Transform((__m256*)x, hFFT);
+      else
+#endif
+#if defined(SPECTRUM_KERNELS_SSE2)
+         SSE2::Transform((__m128*)x, hFFT);
+#endif
+      StorePowers(x, lanes, count, hFFT, outs + first);
+   }
+}
+
+void ColorRow(const float *values, size_t count,
+   const unsigned char (*gradient)[4], size_t steps, unsigned char *rgb)
+{
+   const float scale = steps - 1;
+   size_t done = 0;
+#if defined(SPECTRUM_KERNELS_AVX2)
+   if (Get() == InstructionSet::AVX2)
+      done = AVX2::ColorRow(values, count, gradient, scale, rgb);
+   else
+#endif
+#if defined(SPECTRUM_KERNELS_SSE2)
+   if (Get() == InstructionSet::SSE2)
+      done = SSE2::ColorRow(values, count, gradient, scale, rgb);
+#endif
+   ColorPixels(values + done, count - done, gradient, scale, rgb + 3 * done);
+}
+
+} // namespace SpectrumKernels
@@ -0,0 +1,64 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SpectrumKernels.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SPECTRUM_KERNELS__
+#define __AUDACITY_SPECTRUM_KERNELS__
+
+#include <cstddef>
+
+struct FFTParam;
+
+/// Power spectra in dB of windows of samples, and the colours of the
+/// pixels of spectrograms.  Vector code transforms several windows at once,
+/// one in each lane, and gives the same values as the scalar code, bin for
+/// bin, and the same colours, pixel for pixel.
+namespace SpectrumKernels
+{
+   enum class InstructionSet { Scalar, SSE2, AVX2 };
+
+   /// The best instruction set this machine supports
+   InstructionSet Available();
+
+   /// The instruction set in use, Available() unless overridden
+   InstructionSet Get();
+   /// For benchmarks and tests; limited to what is Available()
+   void Set(InstructionSet set);
+
+   const char *GetName(InstructionSet set);
+
+   enum : size_t { MaxBatchSize = 8 };
+
+   /// How many windows ComputeSpectra() transforms at once with the
+   /// instruction set in use:  8 for AVX2, 4 for SSE2, else 1
+   size_t GetBatchSize();
+
+   /// How many floats of scratch ComputeSpectra() needs, for a transform
+   /// of fftLen points
+   size_t GetScratchSize(size_t fftLen);
+
+   /// Multiplies len samples of buffer by window, pads with zeroes to the
+   /// length of the transform, and writes hFFT->Points powers in dB to out.
+   /// Mutates buffer.
+   void ComputeSpectrum(float *buffer, const FFTParam *hFFT,
+      const float *window, size_t len, float *out);
+
+   /// Does as ComputeSpectrum() for each of nWindows buffers, with its out,
+   /// a batch at a time, without mutating the buffers
+   void ComputeSpectra(const float *const *buffers, size_t nWindows,
+      const FFTParam *hFFT, const float *window, size_t len,
+      float *const *outs, float *scratch);
+
+   /// Colours count values, each in [0, 1], from a gradient of steps
+   /// colours of four bytes each, red, green, blue and one unused.  Writes
+   /// count triples of red, green and blue bytes to rgb, as in a row of a
+   /// wxImage.
+   void ColorRow(const float *values, size_t count,
+      const unsigned char (*gradient)[4], size_t steps, unsigned char *rgb);
+}
+
+#endif
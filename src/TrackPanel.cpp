@@ -72,6 +72,7 @@ is time to refresh some aspect of the screen.
 
 #include "Prefs.h"
 #include "RefreshCode.h"
+#include "SpectrogramEngine.h"
 #include "TrackArtist.h"
 #include "TrackPanelAx.h"
 #include "TrackPanelResizerCell.h"
@@ -308,6 +309,8 @@ TrackPanel::TrackPanel(wxWindow * parent, wxWindowID id,
 
    auto theProject = GetProject();
    wxTheApp->Bind(EVT_ODTASK_UPDATE, &TrackPanel::OnODTask, this);
+   wxTheApp->Bind(EVT_SPECTROGRAM_UPDATE,
+      &TrackPanel::OnSpectrogramUpdate, this);
    theProject->Bind(EVT_ODTASK_COMPLETE, &TrackPanel::OnODTask, this);
    theProject->Bind(
       EVT_PROJECT_SETTINGS_CHANGE, &TrackPanel::OnProjectSettingsChange, this);
@@ -482,6 +485,13 @@ void TrackPanel::OnODTask(wxCommandEvent & WXUNUSED(event))
    Refresh(false);
 }
 
+///Draws again the spectrograms, as more of their columns are computed in
+///the background.
+void TrackPanel::OnSpectrogramUpdate(wxCommandEvent & WXUNUSED(event))
+{
+   Refresh(false);
+}
+
 void TrackPanel::OnProjectSettingsChange( wxCommandEvent &event )
 {
    event.Skip();
@@ -28,7 +28,10 @@
 #include <vector>
 #include <wx/log.h>
 
+#include "DirManager.h"
 #include "Sequence.h"
+#include "SpectrogramEngine.h"
+#include "SpectrumKernels.h"
 #include "Spectrum.h"
 #include "Prefs.h"
 #include "Envelope.h"
@@ -264,35 +267,6 @@ protected:
 
 };
 
-static void ComputeSpectrumUsingRealFFTf
-   (float * __restrict buffer, const FFTParam *hFFT,
-    const float * __restrict window, size_t len, float * __restrict out)
-{
-   size_t i;
-   if(len > hFFT->Points * 2)
-      len = hFFT->Points * 2;
-   for(i = 0; i < len; i++)
-      buffer[i] *= window[i];
-   for( ; i < (hFFT->Points * 2); i++)
-      buffer[i] = 0; // zero pad as needed
-   RealFFTf(buffer, hFFT);
-   // Handle the (real-only) DC
-   float power = buffer[0] * buffer[0];
-   if(power <= 0)
-      out[0] = -160.0;
-   else
-      out[0] = 10.0 * log10f(power);
-   for(i = 1; i < hFFT->Points; i++) {
-      const int index = hFFT->BitReversed[i];
-      const float re = buffer[index], im = buffer[index + 1];
-      power = re * re + im * im;
-      if(power <= 0)
-         out[i] = -160.0;
-      else
-         out[i] = 10.0*log10f(power);
-   }
-}
-
 WaveClip::WaveClip(const std::shared_ptr<DirManager> &projDirManager,
                    sampleFormat format, int rate, int colourIndex)
 {
@@ -416,7 +390,8 @@ BlockArray* WaveClip::GetSequenceBlockArray()
 
 const BlockArray* WaveClip::GetSequenceBlockArray() const
 {
-   return &mSequence->GetBlockArray();
+   // The const overload, which keeps the sequence's summaries
+   return &static_cast< const Sequence& >( *mSequence ).GetBlockArray();
 }
 
 double WaveClip::GetStartTime() const
@@ -776,6 +751,24 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
 
 namespace {
 
+// Reads the clip through the track, which places it at offset
+SpecCache::SampleSource TrackSource(
+   WaveTrackCache &waveTrackCache, double offset, double rate)
+{
+   return [&waveTrackCache, offset, rate](
+      sampleCount start, size_t len, float *)
+   {
+      return (const float*)(waveTrackCache.Get(
+         floatSample, sampleCount(
+            floor(0.5 + start.as_double() + offset * rate)
+         ),
+         len,
+         // Don't throw in this drawing operation
+         false)
+      );
+   };
+}
+
 void ComputeSpectrogramGainFactors
    (size_t fftLen, double rate, int frequencyGain, std::vector<float> &gainFactors)
 {
@@ -819,16 +812,16 @@ bool SpecCache::Matches
       algorithm == settings.algorithm;
 }
 
-bool SpecCache::CalculateOneSpectrum
+float *SpecCache::GetWindow
    (const SpectrogramSettings &settings,
-    WaveTrackCache &waveTrackCache,
+    const SampleSource &source,
     const int xx, const sampleCount numSamples,
-    double offset, double rate, double pixelsPerSecond,
-    int lowerBoundX, int upperBoundX,
+    double rate, double pixelsPerSecond,
     const std::vector<float> &gainFactors,
-    float* __restrict scratch, float* __restrict out) const
+    float* __restrict scratch, float* __restrict out,
+    const SpectrogramTileCache::Layout *pTiles,
+    SpectrogramTileCache::Place &place) const
 {
-   bool result = false;
    const bool reassignment =
       (settings.algorithm == SpectrogramSettings::algReassignment);
    const size_t windowSizeSetting = settings.WindowSize();
@@ -854,9 +847,23 @@ bool SpecCache::CalculateOneSpectrum
       settings.algorithm == SpectrogramSettings::algPitchEAC;
    const size_t zeroPaddingFactorSetting = settings.ZeroPaddingFactor();
    const size_t padding = (windowSizeSetting * (zeroPaddingFactorSetting - 1)) / 2;
-   const size_t fftLen = windowSizeSetting * zeroPaddingFactorSetting;
    auto nBins = settings.NBins();
 
+   // A column that may be kept in tiles is centered at a fixed sample of
+   // its block, and may have been computed already
+   if (pTiles && !reassignment && xx >= 0 && xx < (int)len &&
+       pTiles->Find(from, place)) {
+      from = place.center;
+      float *const results = &out[nBins * xx];
+      if (pTiles->Load(place, results)) {
+         if (!gainFactors.empty()) {
+            for (size_t ii = 0; ii < nBins; ++ii)
+               results[ii] += gainFactors[ii];
+         }
+         return nullptr;
+      }
+   }
+
    if (from < 0 || from >= numSamples) {
       if (xx >= 0 && xx < (int)len) {
          // Pixel column is out of bounds of the clip!  Should not happen.
@@ -897,150 +904,259 @@ bool SpecCache::CalculateOneSpectrum
          }
 
          if (myLen > 0) {
-            useBuffer = (float*)(waveTrackCache.Get(
-               floatSample, sampleCount(
-                  floor(0.5 + from.as_double() + offset * rate)
-               ),
-               myLen,
-               // Don't throw in this drawing operation
-               false)
-            );
+            useBuffer = (float*)source(from, myLen, adj);
 
             if (copy) {
-               if (useBuffer)
-                  memcpy(adj, useBuffer, myLen * sizeof(float));
-               else
+               // The source may have read into adj already
+               if (!useBuffer)
                   memset(adj, 0, myLen * sizeof(float));
+               else if (useBuffer != adj)
+                  memcpy(adj, useBuffer, myLen * sizeof(float));
             }
          }
       }
 
-      if (copy || !useBuffer)
+      if (copy || !useBuffer) {
+         // The scratch is reused, by columns of other settings too, so its
+         // padding zones may hold anything, even NaN, which the window's
+         // zeroes would not cancel
+         if (padding > 0) {
+            const auto fftLen = windowSizeSetting * zeroPaddingFactorSetting;
+            std::fill(scratch, scratch + padding, 0.0f);
+            std::fill(
+               scratch + padding + windowSizeSetting, scratch + fftLen, 0.0f);
+         }
          useBuffer = scratch;
-
-      if (autocorrelation) {
-         // not reassignment, xx is surely within bounds.
-         wxASSERT(xx >= 0);
-         float *const results = &out[nBins * xx];
-         // This function does not mutate useBuffer
-         ComputeSpectrum(useBuffer, windowSizeSetting, windowSizeSetting,
-            rate, results,
-            autocorrelation, settings.windowType);
       }
-      else if (reassignment) {
-         static const double epsilon = 1e-16;
-         const auto hFFT = settings.hFFT.get();
 
-         float *const scratch2 = scratch + fftLen;
-         std::copy(scratch, scratch2, scratch2);
+      return useBuffer;
+   }
 
-         float *const scratch3 = scratch + 2 * fftLen;
-         std::copy(scratch, scratch2, scratch3);
+   return nullptr;
+}
 
-         {
-            const float *const window = settings.window.get();
-            for (size_t ii = 0; ii < fftLen; ++ii)
-               scratch[ii] *= window[ii];
-            RealFFTf(scratch, hFFT);
-         }
+bool SpecCache::CalculateOneSpectrum
+   (const SpectrogramSettings &settings,
+    const SampleSource &source,
+    const int xx, const sampleCount numSamples,
+    double rate, double pixelsPerSecond,
+    int lowerBoundX, int upperBoundX,
+    const std::vector<float> &gainFactors,
+    float* __restrict scratch, float* __restrict out,
+    const SpectrogramTileCache::Layout *pTiles) const
+{
+   bool result = false;
+   const bool reassignment =
+      (settings.algorithm == SpectrogramSettings::algReassignment);
+   const bool autocorrelation =
+      settings.algorithm == SpectrogramSettings::algPitchEAC;
+   const size_t windowSizeSetting = settings.WindowSize();
+   const size_t fftLen = windowSizeSetting * settings.ZeroPaddingFactor();
+   auto nBins = settings.NBins();
 
-         {
-            const float *const dWindow = settings.dWindow.get();
-            for (size_t ii = 0; ii < fftLen; ++ii)
-               scratch2[ii] *= dWindow[ii];
-            RealFFTf(scratch2, hFFT);
-         }
+   SpectrogramTileCache::Place place;
+   float *const useBuffer = GetWindow(settings, source, xx, numSamples,
+      rate, pixelsPerSecond, gainFactors, scratch, out, pTiles, place);
+   if (!useBuffer)
+      return result;
+
+   if (autocorrelation) {
+      // not reassignment, xx is surely within bounds.
+      wxASSERT(xx >= 0);
+      float *const results = &out[nBins * xx];
+      // This function does not mutate useBuffer
+      ComputeSpectrum(useBuffer, windowSizeSetting, windowSizeSetting,
+         rate, results,
+         autocorrelation, settings.windowType);
+      if (place.pTile)
+         pTiles->Store(place, results);
+   }
+   else if (reassignment) {
+      static const double epsilon = 1e-16;
+      const auto hFFT = settings.hFFT.get();
+
+      float *const scratch2 = scratch + fftLen;
+      std::copy(scratch, scratch2, scratch2);
+
+      float *const scratch3 = scratch + 2 * fftLen;
+      std::copy(scratch, scratch2, scratch3);
+
+      {
+         const float *const window = settings.window.get();
+         for (size_t ii = 0; ii < fftLen; ++ii)
+            scratch[ii] *= window[ii];
+         RealFFTf(scratch, hFFT);
+      }
+
+      {
+         const float *const dWindow = settings.dWindow.get();
+         for (size_t ii = 0; ii < fftLen; ++ii)
+            scratch2[ii] *= dWindow[ii];
+         RealFFTf(scratch2, hFFT);
+      }
 
+      {
+         const float *const tWindow = settings.tWindow.get();
+         for (size_t ii = 0; ii < fftLen; ++ii)
+            scratch3[ii] *= tWindow[ii];
+         RealFFTf(scratch3, hFFT);
+      }
+
+      for (size_t ii = 0; ii < hFFT->Points; ++ii) {
+         const int index = hFFT->BitReversed[ii];
+         const float
+            denomRe = scratch[index],
+            denomIm = ii == 0 ? 0 : scratch[index + 1];
+         const double power = denomRe * denomRe + denomIm * denomIm;
+         if (power < epsilon)
+            // Avoid dividing by near-zero below
+            continue;
+
+         double freqCorrection;
          {
-            const float *const tWindow = settings.tWindow.get();
-            for (size_t ii = 0; ii < fftLen; ++ii)
-               scratch3[ii] *= tWindow[ii];
-            RealFFTf(scratch3, hFFT);
+            const double multiplier = -(fftLen / (2.0f * M_PI));
+            const float
+               numRe = scratch2[index],
+               numIm = ii == 0 ? 0 : scratch2[index + 1];
+            // Find complex quotient --
+            // Which means, multiply numerator by conjugate of denominator,
+            // then divide by norm squared of denominator --
+            // Then just take its imaginary part.
+            const double
+               quotIm = (-numRe * denomIm + numIm * denomRe) / power;
+            // With appropriate multiplier, that becomes the correction of
+            // the frequency bin.
+            freqCorrection = multiplier * quotIm;
          }
 
-         for (size_t ii = 0; ii < hFFT->Points; ++ii) {
-            const int index = hFFT->BitReversed[ii];
-            const float
-               denomRe = scratch[index],
-               denomIm = ii == 0 ? 0 : scratch[index + 1];
-            const double power = denomRe * denomRe + denomIm * denomIm;
-            if (power < epsilon)
-               // Avoid dividing by near-zero below
-               continue;
-
-            double freqCorrection;
+         const int bin = (int)((int)ii + freqCorrection + 0.5f);
+         // Must check if correction takes bin out of bounds, above or below!
+         // bin is signed!
+         if (bin >= 0 && bin < (int)hFFT->Points) {
+            double timeCorrection;
             {
-               const double multiplier = -(fftLen / (2.0f * M_PI));
                const float
-                  numRe = scratch2[index],
-                  numIm = ii == 0 ? 0 : scratch2[index + 1];
-               // Find complex quotient --
-               // Which means, multiply numerator by conjugate of denominator,
-               // then divide by norm squared of denominator --
-               // Then just take its imaginary part.
-               const double
-                  quotIm = (-numRe * denomIm + numIm * denomRe) / power;
-               // With appropriate multiplier, that becomes the correction of
-               // the frequency bin.
-               freqCorrection = multiplier * quotIm;
+                  numRe = scratch3[index],
+                  numIm = ii == 0 ? 0 : scratch3[index + 1];
+               // Find another complex quotient --
+               // Then just take its real part.
+               // The result has sample interval as unit.
+               timeCorrection =
+                  (numRe * denomRe + numIm * denomIm) / power;
             }
 
-            const int bin = (int)((int)ii + freqCorrection + 0.5f);
-            // Must check if correction takes bin out of bounds, above or below!
-            // bin is signed!
-            if (bin >= 0 && bin < (int)hFFT->Points) {
-               double timeCorrection;
-               {
-                  const float
-                     numRe = scratch3[index],
-                     numIm = ii == 0 ? 0 : scratch3[index + 1];
-                  // Find another complex quotient --
-                  // Then just take its real part.
-                  // The result has sample interval as unit.
-                  timeCorrection =
-                     (numRe * denomRe + numIm * denomIm) / power;
-               }
-
-               int correctedX = (floor(0.5 + xx + timeCorrection * pixelsPerSecond / rate));
-               if (correctedX >= lowerBoundX && correctedX < upperBoundX)
-               {
-                  result = true;
+            int correctedX = (floor(0.5 + xx + timeCorrection * pixelsPerSecond / rate));
+            if (correctedX >= lowerBoundX && correctedX < upperBoundX)
+            {
+               result = true;
 
-                  // This is non-negative, because bin and correctedX are
-                  auto ind = (int)nBins * correctedX + bin;
+               // This is non-negative, because bin and correctedX are
+               auto ind = (int)nBins * correctedX + bin;
 #ifdef _OPENMP
-                  // This assignment can race if index reaches into another thread's bins.
-                  // The probability of a race very low, so this carries little overhead,
-                  // about 5% slower vs allowing it to race.
-                  #pragma omp atomic update
+               // This assignment can race if index reaches into another thread's bins.
+               // The probability of a race very low, so this carries little overhead,
+               // about 5% slower vs allowing it to race.
+               #pragma omp atomic update
 #endif
-                  out[ind] += power;
-               }
+               out[ind] += power;
             }
          }
       }
-      else {
-         // not reassignment, xx is surely within bounds.
-         wxASSERT(xx >= 0);
-         float *const results = &out[nBins * xx];
+   }
+   else {
+      // not reassignment, xx is surely within bounds.
+      wxASSERT(xx >= 0);
+      float *const results = &out[nBins * xx];
+
+      // Do the FFT.  Note that useBuffer is multiplied by the window, and
+      // GetWindow() zeroed the part of useBuffer in the padding zones.
+
+      // This function mutates useBuffer
+      SpectrumKernels::ComputeSpectrum
+         (useBuffer, settings.hFFT.get(), settings.window.get(), fftLen, results);
+      if (place.pTile)
+         pTiles->Store(place, results);
+      if (!gainFactors.empty()) {
+         // Apply a frequency-dependant gain factor
+         for (size_t ii = 0; ii < nBins; ++ii)
+            results[ii] += gainFactors[ii];
+      }
+   }
 
-         // Do the FFT.  Note that useBuffer is multiplied by the window,
-         // and the window is initialized with leading and trailing zeroes
-         // when there is padding.  Therefore we did not need to reinitialize
-         // the part of useBuffer in the padding zones.
+   return result;
+}
+
+void SpecCache::CalculateSpectra
+   (const SpectrogramSettings &settings,
+    const SampleSource &source,
+    const int *columns, size_t nColumns, const sampleCount numSamples,
+    double rate, double pixelsPerSecond,
+    const std::vector<float> &gainFactors,
+    std::vector<float> &scratch, float* __restrict out,
+    const SpectrogramTileCache::Layout *pTiles) const
+{
+   wxASSERT(settings.algorithm != SpectrogramSettings::algReassignment);
+   const size_t fftLen = settings.GetFFTLength();
+   const auto batchSize = SpectrumKernels::GetBatchSize();
+
+   if (settings.algorithm != SpectrogramSettings::algSTFT ||
+       batchSize == 1) {
+      // One column at a time
+      if (scratch.size() < fftLen)
+         scratch.resize(fftLen);
+      for (size_t ii = 0; ii < nColumns; ++ii)
+         CalculateOneSpectrum(settings, source, columns[ii], numSamples,
+            rate, pixelsPerSecond, 0, (int)len,
+            gainFactors, &scratch[0], out, pTiles);
+      return;
+   }
+
+   // Room for the windows of a batch, then for the kernel
+   const auto size =
+      batchSize * fftLen + SpectrumKernels::GetScratchSize(fftLen);
+   if (scratch.size() < size)
+      scratch.resize(size);
+   float *const kernelScratch = &scratch[batchSize * fftLen];
 
-         // This function mutates useBuffer
-         ComputeSpectrumUsingRealFFTf
-            (useBuffer, settings.hFFT.get(), settings.window.get(), fftLen, results);
+   const auto nBins = settings.NBins();
+   const float *windows[SpectrumKernels::MaxBatchSize];
+   float *results[SpectrumKernels::MaxBatchSize];
+   SpectrogramTileCache::Place places[SpectrumKernels::MaxBatchSize];
+   size_t nWindows = 0;
+
+   const auto transform = [&]{
+      SpectrumKernels::ComputeSpectra(windows, nWindows,
+         settings.hFFT.get(), settings.window.get(), fftLen,
+         results, kernelScratch);
+      for (size_t ii = 0; ii < nWindows; ++ii) {
+         if (places[ii].pTile)
+            pTiles->Store(places[ii], results[ii]);
          if (!gainFactors.empty()) {
             // Apply a frequency-dependant gain factor
-            for (size_t ii = 0; ii < nBins; ++ii)
-               results[ii] += gainFactors[ii];
+            for (size_t jj = 0; jj < nBins; ++jj)
+               results[ii][jj] += gainFactors[jj];
          }
       }
-   }
+      nWindows = 0;
+   };
 
-   return result;
+   for (size_t ii = 0; ii < nColumns; ++ii) {
+      const auto xx = columns[ii];
+      wxASSERT(xx >= 0 && xx < (int)len);
+      auto &place = places[nWindows];
+      place = {};
+      const auto window = GetWindow(settings, source, xx, numSamples,
+         rate, pixelsPerSecond, gainFactors,
+         &scratch[nWindows * fftLen], out, pTiles, place);
+      if (!window)
+         continue;
+      windows[nWindows] = window;
+      results[nWindows] = &out[nBins * xx];
+      if (++nWindows == batchSize)
+         transform();
+   }
+   if (nWindows > 0)
+      transform();
 }
 
 void SpecCache::Grow(size_t len_, const SpectrogramSettings& settings,
@@ -1056,6 +1172,14 @@ void SpecCache::Grow(size_t len_, const SpectrogramSettings& settings,
    // Sample counts corresponding to the columns, and to one past the end.
    where.resize(len_ + 1);
 
+   // Columns kept are as ready as they were.  Keep flags for the old
+   // columns too, until GetSpectrogram() has moved them.
+   const auto nFlags = std::max(len, len_);
+   auto newReady = std::make_unique< std::atomic<bool>[] >(nFlags);
+   for (size_t ii = 0; ii < nFlags; ++ii)
+      newReady[ii] = ready && ii < len && ready[ii].load();
+   ready = std::move(newReady);
+
    len = len_;
    algorithm = settings.algorithm;
    pps = pixelsPerSecond;
@@ -1070,7 +1194,8 @@ void SpecCache::Populate
    (const SpectrogramSettings &settings, WaveTrackCache &waveTrackCache,
     int copyBegin, int copyEnd, size_t numPixels,
     sampleCount numSamples,
-    double offset, double rate, double pixelsPerSecond)
+    double offset, double rate, double pixelsPerSecond,
+    const SpectrogramTileCache::Layout *pTiles)
 {
    const int &frequencyGainSetting = settings.frequencyGain;
    const size_t windowSizeSetting = settings.WindowSize();
@@ -1097,6 +1222,11 @@ void SpecCache::Populate
    if (!autocorrelation)
       ComputeSpectrogramGainFactors(fftLen, rate, frequencyGainSetting, gainFactors);
 
+   // Columns of other algorithms than reassignment are computed a batch at
+   // a time, so that several transforms are done at once
+   const int step =
+      reassignment ? 1 : (int)SpectrumKernels::GetBatchSize();
+
    // Loop over the ranges before and after the copied portion and compute anew.
    // One of the ranges may be empty.
    for (int jj = 0; jj < 2; ++jj) {
@@ -1122,27 +1252,40 @@ void SpecCache::Populate
 
       #pragma omp parallel for private(tls)
 #endif
-      for (auto xx = lowerBoundX; xx < upperBoundX; ++xx)
+      for (auto xx = lowerBoundX; xx < upperBoundX; xx += step)
       {
 #ifdef _OPENMP
          tls.init(waveTrackCache, scratchSize);
          WaveTrackCache& cache = *tls.cache;
-         float* buffer = &tls.scratch[0];
+         std::vector<float> &buffer = tls.scratch;
 #else
          WaveTrackCache& cache = waveTrackCache;
-         float* buffer = &scratch[0];
+         std::vector<float> &buffer = scratch;
 #endif
-         CalculateOneSpectrum(
-            settings, cache, xx, numSamples,
-            offset, rate, pixelsPerSecond,
-            lowerBoundX, upperBoundX,
-            gainFactors, buffer, &freq[0]);
+         if (reassignment)
+            CalculateOneSpectrum(
+               settings, TrackSource(cache, offset, rate), xx, numSamples,
+               rate, pixelsPerSecond,
+               lowerBoundX, upperBoundX,
+               gainFactors, &buffer[0], &freq[0], pTiles);
+         else {
+            int columns[SpectrumKernels::MaxBatchSize];
+            const auto nColumns = std::min(step, upperBoundX - xx);
+            for (int ii = 0; ii < nColumns; ++ii)
+               columns[ii] = xx + ii;
+            CalculateSpectra(
+               settings, TrackSource(cache, offset, rate),
+               columns, nColumns, numSamples,
+               rate, pixelsPerSecond,
+               gainFactors, buffer, &freq[0], pTiles);
+         }
       }
 
       if (reassignment) {
          // Need to look beyond the edges of the range to accumulate more
          // time reassignments.
          // I'm not sure what's a good stopping criterion?
+         const auto source = TrackSource(waveTrackCache, offset, rate);
          auto xx = lowerBoundX;
          const double pixelsPerSample = pixelsPerSecond / rate;
          const int limit = std::min((int)(0.5 + fftLen * pixelsPerSample), 100);
@@ -1150,8 +1293,8 @@ void SpecCache::Populate
          {
             const bool result =
                CalculateOneSpectrum(
-                  settings, waveTrackCache, --xx, numSamples,
-                  offset, rate, pixelsPerSecond,
+                  settings, source, --xx, numSamples,
+                  rate, pixelsPerSecond,
                   lowerBoundX, upperBoundX,
                   gainFactors, &scratch[0], &freq[0]);
             if (!result)
@@ -1163,8 +1306,8 @@ void SpecCache::Populate
          {
             const bool result =
                CalculateOneSpectrum(
-                  settings, waveTrackCache, xx++, numSamples,
-                  offset, rate, pixelsPerSecond,
+                  settings, source, xx++, numSamples,
+                  rate, pixelsPerSecond,
                   lowerBoundX, upperBoundX,
                   gainFactors, &scratch[0], &freq[0]);
             if (!result)
@@ -1192,18 +1335,127 @@ void SpecCache::Populate
             }
          }
       }
+
+      for (auto xx = lowerBoundX; xx < upperBoundX; ++xx)
+         ready[xx] = true;
    }
 }
 
+/// Computes columns of a SpecCache on the threads of SpectrogramEngine,
+/// reading a copy of the clip's sequence that later edits can't change
+class SpecCacheJob final : public SpectrogramEngine::Job
+{
+public:
+   SpecCacheJob(SpecCache &cache, std::vector<size_t> columns,
+      const SpectrogramSettings &settings,
+      std::unique_ptr<Sequence> samples, double rate, double pixelsPerSecond,
+      const std::shared_ptr<const SpectrogramTileCache::Layout> &pTiles)
+      : Job{ std::move(columns), SpectrumKernels::GetBatchSize() }
+      , mCache{ cache }
+      , mSettings{ settings }
+      , mSamples{ std::move(samples) }
+      , mNumSamples{ mSamples->GetNumSamples() }
+      , mRate{ rate }
+      , mPixelsPerSecond{ pixelsPerSecond }
+      , mpTiles{ pTiles }
+   {
+      // The workers share the window and FFT tables, so make them now
+      mSettings.CacheWindows();
+      if (mSettings.algorithm != SpectrogramSettings::algPitchEAC)
+         ComputeSpectrogramGainFactors(mSettings.GetFFTLength(), mRate,
+            mSettings.frequencyGain, mGainFactors);
+   }
+
+   void Compute(const size_t *columns, size_t nColumns,
+      std::vector<float> &scratch) override
+   {
+      wxASSERT(nColumns <= SpectrumKernels::MaxBatchSize);
+      int xxs[SpectrumKernels::MaxBatchSize];
+      nColumns = std::min<size_t>(nColumns, SpectrumKernels::MaxBatchSize);
+      std::copy(columns, columns + nColumns, xxs);
+      const auto source = [this](
+         sampleCount start, size_t len, float *buffer) -> const float *
+      {
+         // Don't throw on a worker thread
+         return mSamples->Get(
+            (samplePtr)buffer, floatSample, start, len, false)
+            ? buffer : nullptr;
+      };
+      mCache.CalculateSpectra(mSettings, source, xxs, nColumns, mNumSamples,
+         mRate, mPixelsPerSecond,
+         mGainFactors, scratch, &mCache.freq[0], mpTiles.get());
+      for (size_t ii = 0; ii < nColumns; ++ii)
+         mCache.ready[columns[ii]].store(true);
+   }
+
+private:
+   SpecCache &mCache;
+   SpectrogramSettings mSettings;
+   const std::unique_ptr<Sequence> mSamples;
+   const sampleCount mNumSamples;
+   const double mRate;
+   const double mPixelsPerSecond;
+   const std::shared_ptr<const SpectrogramTileCache::Layout> mpTiles;
+   std::vector<float> mGainFactors;
+};
+
+SpecCache::~SpecCache()
+{
+   CancelJob();
+}
+
+void SpecCache::CancelJob()
+{
+   if (job) {
+      SpectrogramEngine::Get().Cancel(*job);
+      job.reset();
+   }
+}
+
+void SpecCache::StartJob(const SpectrogramSettings &settings,
+   std::unique_ptr<Sequence> samples, double rate, double pixelsPerSecond,
+   const std::shared_ptr<const SpectrogramTileCache::Layout> &pTiles)
+{
+   CancelJob();
+
+   std::vector<size_t> columns;
+   for (size_t xx = 0; xx < len; ++xx)
+      if (!ready[xx])
+         columns.push_back(xx);
+   if (columns.empty())
+      return;
+
+   job = std::make_shared<SpecCacheJob>(*this,
+      SpectrogramEngine::CoarseToFine(columns),
+      settings, std::move(samples), rate, pixelsPerSecond, pTiles);
+   SpectrogramEngine::Get().Submit(job);
+}
+
+void SpecCache::GetReady(std::vector<bool> &result) const
+{
+   result.clear();
+   for (size_t xx = 0; xx < len; ++xx)
+      if (!ready[xx]) {
+         result.resize(len);
+         for (size_t yy = 0; yy < len; ++yy)
+            result[yy] = ready[yy];
+         break;
+      }
+}
+
 bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
                               const float *& spectrogram,
                               const sampleCount *& where,
                               size_t numPixels,
-                              double t0, double pixelsPerSecond) const
+                              double t0, double pixelsPerSecond,
+                              std::vector<bool> *pReady) const
 {
    const WaveTrack *const track = waveTrackCache.GetTrack().get();
    const SpectrogramSettings &settings = track->GetSpectrogramSettings();
 
+   if (pReady)
+      pReady->clear();
+
    bool match =
       mSpecCache &&
       mSpecCache->len > 0 &&
@@ -1216,9 +1468,24 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
       spectrogram = &mSpecCache->freq[0];
       where = &mSpecCache->where[0];
 
+      if (pReady) {
+         // Columns may have come in from the job since the last call
+         mSpecCache->GetReady(*pReady);
+         return !pReady->empty();
+      }
+
       return false;  //hit cache completely
    }
 
+   // Other threads must not write into the cache while it changes
+   if (mSpecCache)
+      mSpecCache->CancelJob();
+
+   // Reassignment spreads each column over its neighbours, so it can't be
+   // done a column at a time
+   const bool async = pReady &&
+      settings.algorithm != SpectrogramSettings::algReassignment;
+
    // Caching is not implemented for reassignment, unless for
    // a complete hit, because of the complications of time reassignment
    if (settings.algorithm == SpectrogramSettings::algReassignment)
@@ -1254,6 +1521,15 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
       copyEnd = std::min((int)numPixels, std::max(0,
          (int)mSpecCache->len - oldX0
       ));
+
+      // Populate() can't fill gaps that a cancelled job left among the
+      // columns to copy
+      if (!async)
+         for (auto xx = copyBegin; xx < copyEnd; ++xx)
+            if (!mSpecCache->ready[xx + oldX0]) {
+               copyBegin = copyEnd = 0;
+               break;
+            }
    }
 
    // Resize the cache, keep the contents unchanged.
@@ -1269,8 +1545,22 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
       memmove(&mSpecCache->freq[nBins * copyBegin],
                &mSpecCache->freq[nBins * (copyBegin + oldX0)],
                nBins * (copyEnd - copyBegin) * sizeof(float));
+
+      // The flags go with the columns, in the same direction
+      auto &ready = mSpecCache->ready;
+      if (oldX0 > 0)
+         for (auto xx = copyBegin; xx < copyEnd; ++xx)
+            ready[xx] = ready[xx + oldX0].load();
+      else
+         for (auto xx = copyEnd; xx-- > copyBegin;)
+            ready[xx] = ready[xx + oldX0].load();
    }
 
+   // The rest must be computed anew
+   for (int xx = 0; xx < (int)numPixels; ++xx)
+      if (xx < copyBegin || xx >= copyEnd)
+         mSpecCache->ready[xx] = false;
+
    // Reassignment accumulates, so it needs a zeroed buffer
    if (settings.algorithm == SpectrogramSettings::algReassignment)
    {
@@ -1294,14 +1584,30 @@ bool WaveClip::GetSpectrogram(WaveTrackCache &waveTrackCache,
    fillWhere(mSpecCache->where, numPixels, 0.5, correction,
       t0, mRate, samplesPerPixel);
 
-   mSpecCache->Populate
-      (settings, waveTrackCache, copyBegin, copyEnd, numPixels,
-       mSequence->GetNumSamples(),
-       mOffset, mRate, pixelsPerSecond);
+   // Columns kept from this or earlier sessions, at the same spacing.
+   // Only saved projects keep them on disk.
+   const Sequence &sequence = *mSequence;
+   const auto &pDirManager = mSequence->GetDirManager();
+   const auto pTiles = SpectrogramTileCache::Layout::Make(
+      sequence.GetBlockArray(),
+      mSpecCache->where[0], mSpecCache->where[numPixels],
+      settings, samplesPerPixel,
+      pDirManager ? pDirManager->GetProjectDataDir() : FilePath{});
+
+   if (async)
+      mSpecCache->StartJob
+         (settings, mSequence->Snapshot(), mRate, pixelsPerSecond, pTiles);
+   else
+      mSpecCache->Populate
+         (settings, waveTrackCache, copyBegin, copyEnd, numPixels,
+          mSequence->GetNumSamples(),
+          mOffset, mRate, pixelsPerSecond, pTiles.get());
 
    mSpecCache->dirty = mDirty;
    spectrogram = &mSpecCache->freq[0];
    where = &mSpecCache->where[0];
+   if (pReady)
+      mSpecCache->GetReady(*pReady);
 
    return true;
 }
@@ -1348,6 +1654,25 @@ float WaveClip::GetRMS(double t0, double t1, bool mayThrow) const
    return mSequence->GetRMS(s0, s1-s0, mayThrow);
 }
 
+double WaveClip::GetSum(double t0, double t1, bool mayThrow) const
+{
+   if (t0 > t1) {
+      if (mayThrow)
+         THROW_INCONSISTENCY_EXCEPTION;
+      return 0.0;
+   }
+
+   if (t0 == t1)
+      return 0.0;
+
+   sampleCount s0, s1;
+
+   TimeToSamplesClip(t0, &s0);
+   TimeToSamplesClip(t1, &s1);
+
+   return mSequence->GetSum(s0, s1-s0, mayThrow);
+}
+
 void WaveClip::ConvertToSampleFormat(sampleFormat format)
 {
    // Note:  it is not necessary to do this recursively to cutlines.
@@ -1435,7 +1760,8 @@ void WaveClip::Append(samplePtr buffer, sampleFormat format,
       wxASSERT(mAppendBufferLen <= maxBlockSize);
       auto toCopy = std::min(len, maxBlockSize - mAppendBufferLen);
 
-      CopySamples(buffer, format,
+      CopySamples(mSequence->GetDither(),
+                  buffer, format,
                   mAppendBuffer.ptr() + mAppendBufferLen * SAMPLE_SIZE(seqFormat),
                   seqFormat,
                   toCopy,
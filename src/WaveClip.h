@@ -15,6 +15,7 @@
 #include "Audacity.h"
 
 #include "SampleFormat.h"
+#include "SpectrogramTileCache.h"
 #include "ondemand/ODTaskThread.h"
 #include "xml/XMLTagHandler.h"
 
@@ -22,6 +23,8 @@
 
 #include <wx/longlong.h>
 
+#include <atomic>
+#include <functional>
 #include <vector>
 
 class BlockArray;
@@ -32,6 +35,7 @@ class Envelope;
 class ProgressDialog;
 class Sequence;
 class SpectrogramSettings;
+class SpecCacheJob;
 class WaveCache;
 class WaveTrackCache;
 class wxFileNameWrapper;
@@ -50,34 +54,63 @@ public:
    {
    }
 
-   ~SpecCache()
-   {
-   }
+   // Cancels the job, if any
+   ~SpecCache();
 
    bool Matches(int dirty_, double pixelsPerSecond,
       const SpectrogramSettings &settings, double rate) const;
 
+   // Gives len samples of the clip from start, perhaps in buffer, which is
+   // long enough; null if they can't be had
+   using SampleSource = std::function<
+      const float *(sampleCount start, size_t len, float *buffer) >;
+
    // Calculate one column of the spectrum
    bool CalculateOneSpectrum
       (const SpectrogramSettings &settings,
-       WaveTrackCache &waveTrackCache,
+       const SampleSource &source,
        const int xx, sampleCount numSamples,
-       double offset, double rate, double pixelsPerSecond,
+       double rate, double pixelsPerSecond,
        int lowerBoundX, int upperBoundX,
        const std::vector<float> &gainFactors,
        float* __restrict scratch,
-       float* __restrict out) const;
+       float* __restrict out,
+       const SpectrogramTileCache::Layout *pTiles = nullptr) const;
+
+   // Calculate the given columns, which must be within bounds, for any
+   // algorithm but reassignment.  Short-time Fourier transforms are done
+   // several at once.  scratch may be resized.
+   void CalculateSpectra
+      (const SpectrogramSettings &settings,
+       const SampleSource &source,
+       const int *columns, size_t nColumns, sampleCount numSamples,
+       double rate, double pixelsPerSecond,
+       const std::vector<float> &gainFactors,
+       std::vector<float> &scratch,
+       float* __restrict out,
+       const SpectrogramTileCache::Layout *pTiles = nullptr) const;
 
    // Grow the cache while preserving the (possibly now invalid!) contents
    void Grow(size_t len_, const SpectrogramSettings& settings,
                double pixelsPerSecond, double start_);
 
+   // Stop computing columns on other threads.  Must be done before the
+   // cache changes.
+   void CancelJob();
+   // Computes, on other threads, the columns not ready
+   void StartJob(const SpectrogramSettings &settings,
+      std::unique_ptr<Sequence> samples, double rate, double pixelsPerSecond,
+      const std::shared_ptr<const SpectrogramTileCache::Layout> &pTiles);
+   // Which columns are ready, if any is not; else empty
+   void GetReady(std::vector<bool> &result) const;
+
    // Calculate the dirty columns at the begin and end of the cache
    void Populate
       (const SpectrogramSettings &settings, WaveTrackCache &waveTrackCache,
        int copyBegin, int copyEnd, size_t numPixels,
        sampleCount numSamples,
-       double offset, double rate, double pixelsPerSecond);
+       double offset, double rate, double pixelsPerSecond,
+       const SpectrogramTileCache::Layout *pTiles = nullptr);
 
    size_t       len { 0 }; // counts pixels, not samples
    int          algorithm;
@@ -89,8 +122,29 @@ public:
    int          frequencyGain;
    std::vector<float> freq;
    std::vector<sampleCount> where;
+   // Whether each column of freq is computed.  While a job is running, other
+   // threads write the columns not ready, and then mark them.
+   std::unique_ptr< std::atomic<bool>[] > ready;
 
    int          dirty;
+
+private:
+   // Finds the window of samples for column xx, and its place in the
+   // tiles, if any.  Returns null if the column is done already, from the
+   // tiles or as zeroes, or is out of bounds of the clip; else scratch, or
+   // the source's buffer when no copy was needed.
+   float *GetWindow
+      (const SpectrogramSettings &settings,
+       const SampleSource &source,
+       const int xx, sampleCount numSamples,
+       double rate, double pixelsPerSecond,
+       const std::vector<float> &gainFactors,
+       float* __restrict scratch,
+       float* __restrict out,
+       const SpectrogramTileCache::Layout *pTiles,
+       SpectrogramTileCache::Place &place) const;
+
+   std::shared_ptr<SpecCacheJob> job;
 };
 
 class SpecPxCache {
@@ -106,6 +160,7 @@ public:
    }
 
    size_t  len;
+   // Values of pixels in [0, 1], row by row from the lowest frequency
    Floats values;
    bool         valid;
 
@@ -114,6 +169,24 @@ public:
    int gain;
    int minFreq;
    int maxFreq;
+
+   // Which bins of a column each row of pixels shows, for one height,
+   // frequency scale, algorithm, transform size and rate.  Kept when the
+   // values are computed again.
+   struct Rows {
+      int height{ -1 };
+      int scaleType{ -1 };
+      int algorithm{ -1 };
+      size_t nBins{ 0 };
+      double rate{ 0 };
+      float minFreq{ -1 };
+      float maxFreq{ -1 };
+      // Fractional bins at the bottom of each row, and at the top of the last
+      std::vector<float> bins;
+      // Row yy shows the greatest of bins first[yy] up to limit[yy]
+      std::vector<int> first;
+      std::vector<int> limit;
+   } rows;
 };
 
 class WaveClip;
@@ -253,19 +326,26 @@ public:
     * has changed, like when member functions SetSamples() etc. are called. */
    void MarkChanged() // NOFAIL-GUARANTEE
       { mDirty++; }
+   // Counts the calls of MarkChanged()
+   int GetDirty() const { return mDirty; }
 
    /** Getting high-level data for screen display and clipping
     * calculations and Contrast */
    bool GetWaveDisplay(WaveDisplay &display,
                        double t0, double pixelsPerSecond, bool &isLoadingOD) const;
+   // If pReady is not null, columns may be left to SpectrogramEngine, and
+   // *pReady tells which are computed, or is empty if all are.  Returns true
+   // if any columns changed since the last call.
    bool GetSpectrogram(WaveTrackCache &cache,
                        const float *& spectrogram,
                        const sampleCount *& where,
                        size_t numPixels,
-                       double t0, double pixelsPerSecond) const;
+                       double t0, double pixelsPerSecond,
+                       std::vector<bool> *pReady = nullptr) const;
    std::pair<float, float> GetMinMax(
       double t0, double t1, bool mayThrow = true) const;
    float GetRMS(double t0, double t1, bool mayThrow = true) const;
+   double GetSum(double t0, double t1, bool mayThrow = true) const;
 
    // Set/clear/get rectangle that this WaveClip fills on screen. This is
    // called by TrackArtist while actually drawing the tracks and clips.
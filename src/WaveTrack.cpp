@@ -1850,6 +1850,37 @@ float WaveTrack::GetRMS(double t0, double t1, bool mayThrow) const
    return length > 0 ? sqrt(sumsq / length.as_double()) : 0.0;
 }
 
+double WaveTrack::GetMean(double t0, double t1, bool mayThrow) const
+{
+   if (t0 > t1) {
+      if (mayThrow)
+         THROW_INCONSISTENCY_EXCEPTION;
+      return 0.0;
+   }
+
+   if (t0 == t1)
+      return 0.0;
+
+   double sum = 0.0;
+   sampleCount length = 0;
+
+   for (const auto &clip: mClips)
+   {
+      // As in GetRMS()
+      if (t1 >= clip->GetStartTime() && t0 <= clip->GetEndTime())
+      {
+         sampleCount clipStart, clipEnd;
+
+         sum += clip->GetSum(t0, t1, mayThrow);
+
+         clip->TimeToSamplesClip(wxMax(t0, clip->GetStartTime()), &clipStart);
+         clip->TimeToSamplesClip(wxMin(t1, clip->GetEndTime()), &clipEnd);
+         length += (clipEnd - clipStart);
+      }
+   }
+   return length > 0 ? sum / length.as_double() : 0.0;
+}
+
 bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
                     sampleCount start, size_t len, fillFormat fill,
                     bool mayThrow, sampleCount * pNumCopied) const
@@ -250,6 +250,9 @@ private:
       double t0, double t1, bool mayThrow = true) const;
    // May assume precondition: t0 <= t1
    float GetRMS(double t0, double t1, bool mayThrow = true) const;
+   // Mean of the samples in clips, for the DC offset; gaps don't count
+   // May assume precondition: t0 <= t1
+   double GetMean(double t0, double t1, bool mayThrow = true) const;
 
    //
    // MM: We now have more than one sequence and envelope per track, so
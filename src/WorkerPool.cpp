@@ -0,0 +1,124 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WorkerPool.cpp
+
+*******************************************************************//**
+
+\class WorkerPool
+\brief A small pool of std::threads for data-parallel work that must
+finish before the caller continues.
+
+  The caller takes part in the work too, so a pool of n workers keeps
+  n + 1 threads busy.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+size_t WorkerPool::GetHardwareConcurrency()
+{
+   // May be zero if unknown
+   return std::max(1u, std::thread::hardware_concurrency());
+}
+
+WorkerPool::WorkerPool(size_t nWorkers)
+{
+   mThreads.reserve(nWorkers);
+   for (size_t ii = 0; ii < nWorkers; ++ii)
+      mThreads.emplace_back([this]{ Run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      mStopping = true;
+   }
+   mCondition.notify_all();
+   for (auto &thread : mThreads)
+      thread.join();
+}
+
+void WorkerPool::ParallelFor(
+   size_t count, const std::function< void(size_t) > &fn)
+{
+   const auto nHelpers =
+      std::min(mThreads.size(), count > 0 ? count - 1 : 0);
+   if (nHelpers == 0) {
+      for (size_t ii = 0; ii < count; ++ii)
+         fn(ii);
+      return;
+   }
+
+   // Lives on this stack frame, so we must not return until every helper
+   // has stopped touching it.
+   struct Job {
+      std::atomic< size_t > next{ 0 };
+      std::mutex mutex;
+      std::condition_variable finished;
+      size_t nRunning;
+      std::exception_ptr pException;
+   } job;
+   job.nRunning = nHelpers;
+
+   const auto work = [&job, &fn, count]{
+      for (size_t ii; (ii = job.next++) < count;) {
+         try {
+            fn(ii);
+         }
+         catch (...) {
+            std::lock_guard< std::mutex > lock{ job.mutex };
+            if (!job.pException)
+               job.pException = std::current_exception();
+         }
+      }
+   };
+
+   for (size_t ii = 0; ii < nHelpers; ++ii)
+      Enqueue([&job, &work]{
+         work();
+         std::lock_guard< std::mutex > lock{ job.mutex };
+         if (--job.nRunning == 0)
+            job.finished.notify_one();
+      });
+
+   work();
+
+   std::unique_lock< std::mutex > lock{ job.mutex };
+   job.finished.wait(lock, [&job]{ return job.nRunning == 0; });
+   if (job.pException)
+      std::rethrow_exception(job.pException);
+}
+
+void WorkerPool::Enqueue(Task task)
+{
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      mTasks.push_back(std::move(task));
+   }
+   mCondition.notify_one();
+}
+
+void WorkerPool::Run()
+{
+   while (true) {
+      Task task;
+      {
+         std::unique_lock< std::mutex > lock{ mMutex };
+         mCondition.wait(lock, [this]{ return mStopping || !mTasks.empty(); });
+         if (mTasks.empty())
+            // Stopping, and nothing left to do
+            return;
+         task = std::move(mTasks.front());
+         mTasks.pop_front();
+      }
+      task();
+   }
+}
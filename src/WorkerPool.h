@@ -0,0 +1,61 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  WorkerPool.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_WORKER_POOL__
+#define __AUDACITY_WORKER_POOL__
+
+#include "MemoryX.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that run submitted work in parallel with the
+// thread that owns the pool.
+class WorkerPool {
+ public:
+   // The number of threads to use when a preference says "automatic"
+   static size_t GetHardwareConcurrency();
+
+   // Starts nWorkers threads.  Zero is allowed; then all work is done by
+   // the calling thread.
+   explicit WorkerPool(size_t nWorkers);
+   // Finishes any queued work, then joins the threads
+   ~WorkerPool();
+
+   WorkerPool(const WorkerPool&) PROHIBITED;
+   WorkerPool &operator= (const WorkerPool&) PROHIBITED;
+
+   size_t GetWorkerCount() const { return mThreads.size(); }
+
+   // Calls fn(0) ... fn(count - 1), each once, in unspecified order, on the
+   // workers and on the calling thread, and returns when all calls are
+   // complete.
+   // If any call throws, the others still run, and then one of the
+   // exceptions is rethrown.
+   // Must not be called from a worker of the same pool.
+   void ParallelFor(size_t count, const std::function< void(size_t) > &fn);
+
+ private:
+   using Task = std::function< void() >;
+
+   void Enqueue(Task task);
+   void Run();
+
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+   std::deque< Task > mTasks;
+   bool mStopping{ false };
+
+   std::vector< std::thread > mThreads;
+};
+
+#endif
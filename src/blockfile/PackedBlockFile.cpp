@@ -0,0 +1,299 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockFile.cpp
+
+*******************************************************************//**
+
+\class PackedBlockFile
+\brief A BlockFile stored as an extent of a BlockContainer.
+
+  The project file names the container, which must be in the _data
+  folder, and the offset of the extent.  Blocks copied while locked, as
+  by the undo history or Save As, share the extent, because it is never
+  rewritten.  DirManager::CopyBlockFile() copies the samples instead when
+  the block belongs to another project's container.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "PackedBlockFile.h"
+
+#include "../DirManager.h"
+#include "../FileException.h"
+#include "../Internat.h"
+#include "../xml/XMLTagHandler.h"
+#include "../xml/XMLWriter.h"
+
+#include <wx/filename.h>
+
+PackedBlockFile::PackedBlockFile(BlockContainer &container,
+                                 samplePtr sampleData, size_t sampleLen,
+                                 sampleFormat format):
+   BlockFile{ wxFileNameWrapper{}, sampleLen }
+{
+   // Also computes min, max and RMS
+   ArrayOf<char> cleanup;
+   auto summaryData =
+      BlockFile::CalcSummary(sampleData, sampleLen, format, cleanup);
+   mpExtent = container.Append(format, sampleLen,
+      summaryData, mSummaryInfo.totalSummaryBytes, sampleData);
+}
+
+PackedBlockFile::PackedBlockFile(const BlockExtentPtr &pExtent,
+                                 float min, float max, float rms):
+   BlockFile{ wxFileNameWrapper{}, pExtent->GetSamples() },
+   mpExtent{ pExtent }
+{
+   mMin = min;
+   mMax = max;
+   mRMS = rms;
+}
+
+PackedBlockFile::~PackedBlockFile()
+{
+   if (mLocks > 0) {
+      // As a locked BlockFile keeps its file, keep the container
+      mpExtent->Retain();
+      while (mLocks-- > 0)
+         mpExtent->Unlock();
+   }
+}
+
+void PackedBlockFile::Lock()
+{
+   BlockFile::Lock();
+   ++mLocks;
+   mpExtent->Lock();
+}
+
+void PackedBlockFile::Unlock()
+{
+   BlockFile::Unlock();
+   --mLocks;
+   mpExtent->Unlock();
+}
+
+bool PackedBlockFile::ReadSummary(ArrayOf<char> &data)
+{
+   data.reinit( mSummaryInfo.totalSummaryBytes );
+   return BlockContainer::ReadSummary(*mpExtent, data.get());
+}
+
+size_t PackedBlockFile::ReadData(samplePtr data, sampleFormat format,
+                              size_t start, size_t len, bool mayThrow) const
+{
+   const auto storedFormat = mpExtent->GetFormat();
+   size_t framesRead;
+   if (format == storedFormat)
+      framesRead = BlockContainer::ReadSamples(*mpExtent, data, start, len);
+   else {
+      SampleBuffer buffer(len, storedFormat);
+      framesRead =
+         BlockContainer::ReadSamples(*mpExtent, buffer.ptr(), start, len);
+      CopySamples(buffer.ptr(), storedFormat, data, format, framesRead);
+   }
+
+   if ( framesRead < len ) {
+      if (mayThrow)
+         throw FileException{ FileException::Cause::Read,
+            wxFileName{ mpExtent->GetLocation().pContainer->GetPath() } };
+      ClearSamples(data, format, framesRead, len - framesRead);
+   }
+
+   return framesRead;
+}
+
+void PackedBlockFile::SaveXML(XMLWriter &xmlFile)
+// may throw
+{
+   const auto location = mpExtent->GetLocation();
+
+   xmlFile.StartTag(wxT("packedblockfile"));
+
+   xmlFile.WriteAttr(wxT("container"),
+      wxFileName{ location.pContainer->GetPath() }.GetFullName());
+   xmlFile.WriteAttr(wxT("offset"), (long long)location.offset);
+   xmlFile.WriteAttr(wxT("len"), mLen);
+   xmlFile.WriteAttr(wxT("format"), (int)mpExtent->GetFormat());
+   xmlFile.WriteAttr(wxT("min"), mMin);
+   xmlFile.WriteAttr(wxT("max"), mMax);
+   xmlFile.WriteAttr(wxT("rms"), mRMS);
+
+   xmlFile.EndTag(wxT("packedblockfile"));
+}
+
+namespace {
+// Stands for a PackedBlockFile whose container is missing or too short,
+// until the user chooses in ProjectFSCK() what to do about it.  It reads
+// as silence and saves the attributes it was loaded from, so that the
+// extent can still be found if the container is restored, unless it was
+// recovered, which makes it permanently silent.
+class MissingPackedBlockFile final : public BlockFile {
+ public:
+   MissingPackedBlockFile(const wxString &containerName, long long offset,
+                          size_t sampleLen, sampleFormat format,
+                          float min, float max, float rms)
+      : BlockFile{ wxFileNameWrapper{}, sampleLen }
+      , mContainerName{ containerName }
+      , mOffset{ offset }
+      , mFormat{ format }
+   {
+      mMin = min;
+      mMax = max;
+      mRMS = rms;
+   }
+
+   bool ReadSummary(ArrayOf<char> &data) override
+   {
+      data.reinit( mSummaryInfo.totalSummaryBytes );
+      memset(data.get(), 0, mSummaryInfo.totalSummaryBytes);
+      // Don't keep reporting the missing container
+      mSilentLog = TRUE;
+      return mRecovered;
+   }
+
+   size_t ReadData(samplePtr data, sampleFormat format,
+                   size_t start, size_t len, bool mayThrow) const override
+   {
+      if (mRecovered) {
+         ClearSamples(data, format, 0, len);
+         return len;
+      }
+      if (mayThrow)
+         throw FileException{ FileException::Cause::Read,
+            wxFileName{ mContainerName } };
+      ClearSamples(data, format, 0, len);
+      return 0;
+   }
+
+   BlockFilePtr Copy(wxFileNameWrapper &&) override
+   {
+      auto result = make_blockfile<MissingPackedBlockFile>(
+         mContainerName, mOffset, mLen, mFormat, mMin, mMax, mRMS);
+      result->mRecovered = mRecovered;
+      return result;
+   }
+
+   void SaveXML(XMLWriter &xmlFile) override
+   // may throw
+   {
+      if (mRecovered) {
+         xmlFile.StartTag(wxT("silentblockfile"));
+         xmlFile.WriteAttr(wxT("len"), mLen);
+         xmlFile.EndTag(wxT("silentblockfile"));
+         return;
+      }
+
+      xmlFile.StartTag(wxT("packedblockfile"));
+
+      xmlFile.WriteAttr(wxT("container"), mContainerName);
+      xmlFile.WriteAttr(wxT("offset"), mOffset);
+      xmlFile.WriteAttr(wxT("len"), mLen);
+      xmlFile.WriteAttr(wxT("format"), (int)mFormat);
+      xmlFile.WriteAttr(wxT("min"), mMin);
+      xmlFile.WriteAttr(wxT("max"), mMax);
+      xmlFile.WriteAttr(wxT("rms"), mRMS);
+
+      xmlFile.EndTag(wxT("packedblockfile"));
+   }
+
+   DiskByteCount GetSpaceUsage() const override { return 0; }
+
+   // Replace with silence for good
+   void Recover() override
+   {
+      mRecovered = true;
+      mMin = mMax = mRMS = 0.0f;
+   }
+
+ private:
+   const wxString mContainerName;
+   const long long mOffset;
+   const sampleFormat mFormat;
+   bool mRecovered{ false };
+};
+}
+
+// BuildFromXML methods should always return a BlockFile, not NULL,
+// even if the result is flawed (e.g., refers to nonexistent file),
+// as testing will be done in ProjectFSCK().
+/// static
+BlockFilePtr PackedBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
+{
+   wxString containerName;
+   wxLongLong_t offset = -1;
+   size_t len = 0;
+   sampleFormat format = floatSample;
+   float min = 0.0f, max = 0.0f, rms = 0.0f;
+   double dblValue;
+   long nValue;
+
+   while(*attrs)
+   {
+      const wxChar *attr =  *attrs++;
+      const wxChar *value = *attrs++;
+      if (!value)
+         break;
+
+      const wxString strValue = value;
+      if (!wxStricmp(attr, wxT("container")) &&
+          XMLValueChecker::IsGoodFileString(strValue))
+         containerName = strValue;
+      else if (!wxStrcmp(attr, wxT("offset")) &&
+               XMLValueChecker::IsGoodInt64(strValue))
+         strValue.ToLongLong(&offset);
+      else if (!wxStrcmp(attr, wxT("len")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               nValue > 0)
+         len = nValue;
+      else if (!wxStrcmp(attr, wxT("format")) &&
+               XMLValueChecker::IsGoodInt(strValue) && strValue.ToLong(&nValue) &&
+               XMLValueChecker::IsValidSampleFormat(nValue))
+         format = (sampleFormat)nValue;
+      else if (XMLValueChecker::IsGoodString(strValue) && Internat::CompatibleToDouble(strValue, &dblValue))
+      {  // double parameters
+         if (!wxStricmp(attr, wxT("min")))
+            min = dblValue;
+         else if (!wxStricmp(attr, wxT("max")))
+            max = dblValue;
+         else if (!wxStricmp(attr, wxT("rms")) && (dblValue >= 0.0))
+            rms = dblValue;
+      }
+   }
+
+   BlockExtentPtr pExtent;
+   if (auto pContainer = dm.GetBlockContainer(containerName))
+      pExtent = pContainer->GetExtent(offset, format, len);
+
+   if (!pExtent) {
+      // The container is missing or too short.  Keep the length of the
+      // track, as a missing .au file would, and let ProjectFSCK() ask
+      // the user what to do.
+      auto result = make_blockfile<MissingPackedBlockFile>(
+         containerName, offset, len, format, min, max, rms);
+      dm.AddMissingPackedBlockFile(containerName, offset, result);
+      return result;
+   }
+
+   return make_blockfile<PackedBlockFile>(pExtent, min, max, rms);
+}
+
+/// Create a copy of this BlockFile
+BlockFilePtr PackedBlockFile::Copy(wxFileNameWrapper &&)
+{
+   return make_blockfile<PackedBlockFile>(mpExtent, mMin, mMax, mRMS);
+}
+
+auto PackedBlockFile::GetSpaceUsage() const -> DiskByteCount
+{
+   return mpExtent->GetBytes();
+}
+
+static DirManager::RegisteredBlockFileDeserializer sRegistration {
+   "packedblockfile",
+   []( DirManager &dm, const wxChar **attrs ){
+      return PackedBlockFile::BuildFromXML( dm, attrs );
+   }
+};
@@ -0,0 +1,64 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  PackedBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PACKED_BLOCKFILE__
+#define __AUDACITY_PACKED_BLOCKFILE__
+
+#include "../BlockFile.h"
+#include "../BlockContainer.h"
+
+class DirManager;
+
+/// A BlockFile whose summary and samples are an extent of a BlockContainer,
+/// shared with other blocks, rather than a file of its own.
+/// Like SilentBlockFile, it has no file name, so DirManager does not hash
+/// it, and the destructor of BlockFile removes nothing.
+class PackedBlockFile final : public BlockFile {
+ public:
+
+   // Constructor / Destructor
+
+   /// Append summary and sample data to the container
+   PackedBlockFile(BlockContainer &container,
+                   samplePtr sampleData, size_t sampleLen,
+                   sampleFormat format);
+   /// Refer to data already in a container
+   PackedBlockFile(const BlockExtentPtr &pExtent,
+                   float min, float max, float rms);
+
+   virtual ~PackedBlockFile();
+
+   // Reading
+
+   /// Read the summary section of the extent
+   bool ReadSummary(ArrayOf<char> &data) override;
+   /// Read the data section of the extent
+   size_t ReadData(samplePtr data, sampleFormat format,
+                        size_t start, size_t len, bool mayThrow) const override;
+
+   /// Create a NEW block file sharing the extent; the file name is ignored
+   BlockFilePtr Copy(wxFileNameWrapper &&newFileName) override;
+   /// Write an XML representation of this file
+   void SaveXML(XMLWriter &xmlFile) override;
+   DiskByteCount GetSpaceUsage() const override;
+   void Recover() override { };
+
+   void Lock() override;
+   void Unlock() override;
+
+   const BlockExtentPtr &GetExtent() const { return mpExtent; }
+
+   static BlockFilePtr BuildFromXML(DirManager &dm, const wxChar **attrs);
+
+ private:
+   BlockExtentPtr mpExtent;
+   // This block's share of the extent's lock count
+   int mLocks{ 0 };
+};
+
+#endif
@@ -48,6 +48,11 @@ default is to disable caching.
   manual auto recovery, because the files are never written physically to
   disk).
 
+* Background writing: If caching is disabled and allowDeferredWrite is
+  enabled, the constructor holds the data in memory instead of writing
+  them, and the caller submits the file to BlockFileWriter, whose thread
+  writes it soon after.  Reads are served from memory until then.
+
 *//****************************************************************//**
 
 \class auHeader
@@ -66,7 +71,9 @@ to get its definition, rather than rolling our own.
 #include <wx/utils.h>
 #include <wx/log.h>
 
+#include "../BlockFileWriter.h"
 #include "../DirManager.h"
+#include "../MappedFile.h"
 #include "../Prefs.h"
 
 #include "../FileFormats.h"
@@ -112,7 +119,24 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&baseFileName,
 
    bool useCache = GetCache() && (!bypassCache);
 
-   if (!(allowDeferredWrite && useCache) && !bypassCache)
+   if (allowDeferredWrite && !useCache && !bypassCache &&
+       BlockFileWriter::Get().GetCapacity() > 0)
+   {
+      auto pending = std::make_shared< SimpleBlockFilePending >();
+      pending->format = format;
+      const auto sampleDataSize = sampleLen * SAMPLE_SIZE(format);
+      pending->sampleData.reinit(sampleDataSize);
+      memcpy(pending->sampleData.get(), sampleData, sampleDataSize);
+      // Also computes min, max and RMS now, as the write would
+      ArrayOf<char> cleanup;
+      void* summaryData = BlockFile::CalcSummary(sampleData, sampleLen,
+                                                format, cleanup);
+      pending->summaryData.reinit(mSummaryInfo.totalSummaryBytes);
+      memcpy(pending->summaryData.get(), summaryData,
+             mSummaryInfo.totalSummaryBytes);
+      mPending = std::move(pending);
+   }
+   else if (!(allowDeferredWrite && useCache) && !bypassCache)
    {
       bool bSuccess = WriteSimpleBlockFile(sampleData, sampleLen, format, NULL);
       if (!bSuccess)
@@ -157,6 +181,9 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&existingFile, size_t len,
 
 SimpleBlockFile::~SimpleBlockFile()
 {
+   // Drop any mapping before the base class destructor removes the file
+   if (mFileName.HasName())
+      DirManager::GetMappedFiles().Release(mFileName.GetFullPath());
 }
 
 bool SimpleBlockFile::WriteSimpleBlockFile(
@@ -165,6 +192,8 @@ bool SimpleBlockFile::WriteSimpleBlockFile(
     sampleFormat format,
     void* summaryData)
 {
+   DirManager::GetMappedFiles().Release(mFileName.GetFullPath());
+
    wxFFile file(mFileName.GetFullPath(), wxT("wb"));
    if( !file.IsOpened() ){
       // Can't do anything else.
@@ -276,6 +305,9 @@ void SimpleBlockFile::FillCache()
    if (mCache.active)
       return; // cache is already filled
 
+   if (IsWritePending())
+      return; // the file is not yet written
+
    // Check sample format
    wxFFile file(mFileName.GetFullPath(), wxT("rb"));
    if (!file.IsOpened())
@@ -344,7 +376,11 @@ void SimpleBlockFile::FillCache()
 bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
 {
    data.reinit( mSummaryInfo.totalSummaryBytes );
-   if (mCache.active) {
+   if (auto pending = std::atomic_load(&mPending)) {
+      memcpy(data.get(), pending->summaryData.get(), mSummaryInfo.totalSummaryBytes);
+      return true;
+   }
+   else if (mCache.active) {
       //wxLogDebug("SimpleBlockFile::ReadSummary(): Summary is already in cache.");
       memcpy(data.get(), mCache.summaryData.get(), mSummaryInfo.totalSummaryBytes);
       return true;
@@ -383,8 +419,147 @@ bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
    }
 }
 
-/// Read the data portion of the block file using libsndfile.  Convert it
-/// to the given format if it is not already.
+namespace {
+
+// Unpack 24 bit samples, stored in three bytes of native byte order, into
+// sign-extended ints
+inline int UnpackInt24(const unsigned char *p)
+{
+#if wxBYTE_ORDER == wxBIG_ENDIAN
+   const unsigned value =
+      (unsigned(p[0]) << 24) | (unsigned(p[1]) << 16) | (unsigned(p[2]) << 8);
+#else
+   const unsigned value =
+      (unsigned(p[2]) << 24) | (unsigned(p[1]) << 16) | (unsigned(p[0]) << 8);
+#endif
+   return int(value) >> 8;
+}
+
+// These loops have no dependencies between iterations and no branches, so
+// that the compiler can vectorize them.  They write directly into the
+// caller's buffer without intermediate copies.
+
+void ConvertInt16Samples(const short *src, sampleFormat format,
+                         samplePtr dst, size_t len)
+{
+   switch (format) {
+      case int16Sample:
+         memcpy(dst, src, len * sizeof(short));
+         break;
+      case int24Sample: {
+         auto d = (int *)dst;
+         for (size_t ii = 0; ii < len; ++ii)
+            d[ii] = int(src[ii]) << 8;
+         break;
+      }
+      case floatSample:
+      default: {
+         auto d = (float *)dst;
+         const float scale = 1.0f / (1 << 15);
+         for (size_t ii = 0; ii < len; ++ii)
+            d[ii] = src[ii] * scale;
+         break;
+      }
+   }
+}
+
+void ConvertInt24Samples(const unsigned char *src, sampleFormat format,
+                         samplePtr dst, size_t len)
+{
+   switch (format) {
+      case int24Sample: {
+         auto d = (int *)dst;
+         for (size_t ii = 0; ii < len; ++ii)
+            d[ii] = UnpackInt24(src + 3 * ii);
+         break;
+      }
+      case floatSample: {
+         auto d = (float *)dst;
+         const float scale = 1.0f / (1 << 23);
+         for (size_t ii = 0; ii < len; ++ii)
+            d[ii] = UnpackInt24(src + 3 * ii) * scale;
+         break;
+      }
+      case int16Sample:
+      default: {
+         // Narrowing needs dither
+         SampleBuffer buffer(len, int24Sample);
+         ConvertInt24Samples(src, int24Sample, buffer.ptr(), len);
+         CopySamples(buffer.ptr(), int24Sample, dst, format, len);
+         break;
+      }
+   }
+}
+
+}
+
+/// Read the data portion of the block file from a memory mapping of it,
+/// converting to the given format if it is not already.
+/// Returns false, and does nothing, if the file needs the more general
+/// treatment of libsndfile, as when it is not in native byte order.
+///
+/// @param framesRead Receives the number of samples that the file really
+///                   holds in the requested range
+bool SimpleBlockFile::ReadMappedData(const MappedFile &file,
+   samplePtr data, sampleFormat format, size_t start, size_t len,
+   size_t &framesRead)
+{
+   auHeader header;
+   if (file.GetSize() < sizeof(header))
+      return false;
+   memcpy(&header, file.GetData(), sizeof(header));
+
+   if (header.magic != 0x2e736e64 ||
+       header.channels != 1 ||
+       header.dataOffset < sizeof(header) ||
+       header.dataOffset > file.GetSize())
+      return false;
+
+   sampleFormat fileFormat;
+   switch (header.encoding) {
+      case AU_SAMPLE_FORMAT_16:
+         fileFormat = int16Sample;
+         break;
+      case AU_SAMPLE_FORMAT_24:
+         fileFormat = int24Sample;
+         break;
+      case AU_SAMPLE_FORMAT_FLOAT:
+         fileFormat = floatSample;
+         break;
+      default:
+         return false;
+   }
+
+   const auto sampleSize = SAMPLE_SIZE_DISK(fileFormat);
+   const size_t available =
+      (file.GetSize() - header.dataOffset) / sampleSize;
+   framesRead = std::min(len, std::max(start, available) - start);
+   if (framesRead == 0)
+      return true;
+
+   const char *src = file.GetData() + header.dataOffset + start * sampleSize;
+   switch (fileFormat) {
+      case int16Sample:
+         ConvertInt16Samples((const short *)src, format, data, framesRead);
+         break;
+      case int24Sample:
+         ConvertInt24Samples(
+            (const unsigned char *)src, format, data, framesRead);
+         break;
+      case floatSample:
+      default:
+         // Float data are served straight from the page cache; only
+         // narrowing requires conversion
+         CopySamples((samplePtr)src, floatSample, data, format, framesRead);
+         break;
+   }
+
+   return true;
+}
+
+/// Read the data portion of the block file, from a memory mapping of it if
+/// possible, else using libsndfile.  Convert it to the given format if it is
+/// not already.
 ///
 /// @param data   The buffer where the data will be stored
 /// @param format The format the data will be stored in
@@ -393,15 +568,18 @@ bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
 size_t SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
                         size_t start, size_t len, bool mayThrow) const
 {
-   if (mCache.active)
+   const auto pending = std::atomic_load(&mPending);
+   if (pending || mCache.active)
    {
       //wxLogDebug("SimpleBlockFile::ReadData(): Data are already in cache.");
 
+      const auto &sampleData =
+         pending ? pending->sampleData : mCache.sampleData;
+      const auto cacheFormat = pending ? pending->format : mCache.format;
       auto framesRead = std::min(len, std::max(start, mLen) - start);
       CopySamples(
-         (samplePtr)(mCache.sampleData.get() +
-            start * SAMPLE_SIZE(mCache.format)),
-         mCache.format, data, format, framesRead);
+         (samplePtr)(sampleData.get() + start * SAMPLE_SIZE(cacheFormat)),
+         cacheFormat, data, format, framesRead);
 
       if ( framesRead < len ) {
          if (mayThrow)
@@ -412,9 +590,25 @@ size_t SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
 
       return framesRead;
    }
-   else
-      return CommonReadData( mayThrow,
-         mFileName, mSilentLog, nullptr, 0, 0, data, format, start, len);
+
+   // Try the memory mapping first, and let libsndfile deal with anything
+   // unusual
+   if (auto pFile =
+          DirManager::GetMappedFiles().Acquire(mFileName.GetFullPath())) {
+      size_t framesRead = 0;
+      if (ReadMappedData(*pFile, data, format, start, len, framesRead)) {
+         mSilentLog = false;
+         if ( framesRead < len ) {
+            if (mayThrow)
+               throw FileException{ FileException::Cause::Read, mFileName };
+            ClearSamples(data, format, framesRead, len - framesRead);
+         }
+         return framesRead;
+      }
+   }
+
+   return CommonReadData( mayThrow,
+      mFileName, mSilentLog, nullptr, 0, 0, data, format, start, len);
 }
 
 void SimpleBlockFile::SaveXML(XMLWriter &xmlFile)
@@ -427,6 +621,9 @@ void SimpleBlockFile::SaveXML(XMLWriter &xmlFile)
    xmlFile.WriteAttr(wxT("min"), mMin);
    xmlFile.WriteAttr(wxT("max"), mMax);
    xmlFile.WriteAttr(wxT("rms"), mRMS);
+   // Optional; older projects have no sums, and older versions ignore them
+   if (mHasSum)
+      xmlFile.WriteAttr(wxT("sum"), mSum.load());
 
    xmlFile.EndTag(wxT("simpleblockfile"));
 }
@@ -439,6 +636,8 @@ BlockFilePtr SimpleBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
 {
    wxFileNameWrapper fileName;
    float min = 0.0f, max = 0.0f, rms = 0.0f;
+   double sum = 0.0;
+   bool hasSum = false;
    size_t len = 0;
    double dblValue;
    long nValue;
@@ -472,11 +671,18 @@ BlockFilePtr SimpleBlockFile::BuildFromXML(DirManager &dm, const wxChar **attrs)
             max = dblValue;
          else if (!wxStricmp(attr, wxT("rms")) && (dblValue >= 0.0))
             rms = dblValue;
+         else if (!wxStricmp(attr, wxT("sum")))
+            sum = dblValue, hasSum = true;
       }
    }
 
-   return make_blockfile<SimpleBlockFile>
+   auto result = make_blockfile<SimpleBlockFile>
       (std::move(fileName), len, min, max, rms);
+   if (hasSum) {
+      result->mSum = sum;
+      result->mHasSum = true;
+   }
+   return result;
 }
 
 /// Create a copy of this BlockFile, but using a different disk file.
@@ -486,6 +692,10 @@ BlockFilePtr SimpleBlockFile::Copy(wxFileNameWrapper &&newFileName)
 {
    auto newBlockFile = make_blockfile<SimpleBlockFile>
       (std::move(newFileName), mLen, mMin, mMax, mRMS);
+   if (mHasSum) {
+      newBlockFile->mSum = mSum.load();
+      newBlockFile->mHasSum = true;
+   }
 
    return newBlockFile;
 }
@@ -549,6 +759,8 @@ auto SimpleBlockFile::GetSpaceUsage() const -> DiskByteCount
 }
 
 void SimpleBlockFile::Recover(){
+   DirManager::GetMappedFiles().Release(mFileName.GetFullPath());
+
    wxFFile file(mFileName.GetFullPath(), wxT("wb"));
 
    if( !file.IsOpened() ){
@@ -578,6 +790,11 @@ void SimpleBlockFile::Recover(){
 
 void SimpleBlockFile::WriteCacheToDisk()
 {
+   if (IsWritePending()) {
+      WritePending();
+      return;
+   }
+
    if (!GetNeedWriteCacheToDisk())
       return;
 
@@ -588,7 +805,35 @@ void SimpleBlockFile::WriteCacheToDisk()
 
 bool SimpleBlockFile::GetNeedWriteCacheToDisk()
 {
-   return mCache.active && mCache.needWrite;
+   return (mCache.active && mCache.needWrite) || IsWritePending();
+}
+
+bool SimpleBlockFile::IsWritePending() const
+{
+   return std::atomic_load(&mPending) != nullptr;
+}
+
+size_t SimpleBlockFile::GetPendingBytes() const
+{
+   const auto pending = std::atomic_load(&mPending);
+   return pending ? mLen * SAMPLE_SIZE(pending->format) : 0;
+}
+
+bool SimpleBlockFile::WritePending()
+{
+   const auto pending = std::atomic_load(&mPending);
+   if (!pending)
+      return true;
+
+   if (!WriteSimpleBlockFile(pending->sampleData.get(), mLen, pending->format,
+                             pending->summaryData.get()))
+      return false;
+
+   // Readers that already hold the pointer finish with the memory; later
+   // ones read the file
+   std::atomic_store(&mPending,
+      std::shared_ptr< const SimpleBlockFilePending >{});
+   return true;
 }
 
 bool SimpleBlockFile::GetCache()
@@ -14,6 +14,7 @@
 #include "../BlockFile.h"
 
 class DirManager;
+class MappedFile;
 
 struct SimpleBlockFileCache {
    bool active;
@@ -24,6 +25,12 @@ struct SimpleBlockFileCache {
    SimpleBlockFileCache() {}
 };
 
+// Data of a NEW block file that are not yet on disk; see BlockFileWriter
+struct SimpleBlockFilePending {
+   sampleFormat format;
+   ArrayOf<char> sampleData, summaryData;
+};
+
 // The AU formats we care about
 enum {
    AU_SAMPLE_FORMAT_16 = 3,
@@ -82,6 +89,15 @@ class PROFILE_DLL_API SimpleBlockFile /* not final */ : public BlockFile {
 
    void FillCache() /* noexcept */ override;
 
+   /// True while data given to the constructor wait for BlockFileWriter
+   bool IsWritePending() const;
+   /// Memory held until then
+   size_t GetPendingBytes() const;
+   /// Write the pending data, if any, and release them.  Returns false,
+   /// keeping the data, if the write fails.  Only one thread at a time may
+   /// call this.
+   bool WritePending();
+
  protected:
 
    bool WriteSimpleBlockFile(samplePtr sampleData, size_t sampleLen,
@@ -89,8 +105,16 @@ class PROFILE_DLL_API SimpleBlockFile /* not final */ : public BlockFile {
    static bool GetCache();
    void ReadIntoCache();
 
+   static bool ReadMappedData(const MappedFile &file,
+      samplePtr data, sampleFormat format, size_t start, size_t len,
+      size_t &framesRead);
+
    SimpleBlockFileCache mCache;
 
+   // Accessed only with std::atomic_load and std::atomic_store, because
+   // the writer thread releases it while other threads read
+   std::shared_ptr< const SimpleBlockFilePending > mPending;
+
  private:
    mutable sampleFormat mFormat; // may be found lazily
 };
@@ -184,6 +184,11 @@ bool EffectAmplify::LoadFactoryDefaults()
 
 // Effect implementation
 
+bool EffectAmplify::SupportsChaining()
+{
+   return true;
+}
+
 bool EffectAmplify::Init()
 {
    mPeak = 0.0;
@@ -53,6 +53,7 @@ public:
 
    // Effect implementation
 
+   bool SupportsChaining() override;
    bool Init() override;
    void Preview(bool dryOnly) override;
    void PopulateOrExchange(ShuttleGui & S) override;
@@ -134,6 +134,11 @@ unsigned EffectBassTreble::GetAudioOutCount()
    return 1;
 }
 
+bool EffectBassTreble::SupportsParallelInstances()
+{
+   return true;
+}
+
 bool EffectBassTreble::ProcessInitialize(sampleCount WXUNUSED(totalLen), ChannelNames WXUNUSED(chanMap))
 {
    InstanceInit(mMaster, mSampleRate);
@@ -221,6 +226,11 @@ bool EffectBassTreble::CheckWhetherSkipEffect()
 
 // Effect implementation
 
+bool EffectBassTreble::SupportsChaining()
+{
+   return true;
+}
+
 void EffectBassTreble::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
@@ -359,6 +359,11 @@ bool EffectDistortion::LoadFactoryPreset(int id)
 
 // Effect implementation
 
+bool EffectDistortion::SupportsChaining()
+{
+   return true;
+}
+
 void EffectDistortion::PopulateOrExchange(ShuttleGui & S)
 {
    S.AddSpace(0, 5);
@@ -93,6 +93,7 @@ public:
 
    // Effect implementation
 
+   bool SupportsChaining() override;
    void PopulateOrExchange(ShuttleGui & S) override;
    bool TransferDataToWindow() override;
    bool TransferDataFromWindow() override;
@@ -10,6 +10,59 @@ Max Maisel
 
 #include "EBUR128.h"
 
+#include <algorithm>
+
+namespace {
+
+// Weight len samples by the cascade of two Biquads, and store (or add) the
+// squares of the results.  This does what Biquad::ProcessOne() does, with
+// the same rounding, but keeps the state in locals for the whole run.
+void WeightAndSquare(Biquad *filters, const float *in, double *out,
+                     size_t len, bool add)
+{
+   Biquad &hsf = filters[0];
+   Biquad &hpf = filters[1];
+   const double hb0 = hsf.fNumerCoeffs[Biquad::B0],
+      hb1 = hsf.fNumerCoeffs[Biquad::B1], hb2 = hsf.fNumerCoeffs[Biquad::B2],
+      ha1 = hsf.fDenomCoeffs[Biquad::A1], ha2 = hsf.fDenomCoeffs[Biquad::A2];
+   const double pb0 = hpf.fNumerCoeffs[Biquad::B0],
+      pb1 = hpf.fNumerCoeffs[Biquad::B1], pb2 = hpf.fNumerCoeffs[Biquad::B2],
+      pa1 = hpf.fDenomCoeffs[Biquad::A1], pa2 = hpf.fDenomCoeffs[Biquad::A2];
+   double hIn1 = hsf.fPrevIn, hIn2 = hsf.fPrevPrevIn,
+      hOut1 = hsf.fPrevOut, hOut2 = hsf.fPrevPrevOut;
+   double pIn1 = hpf.fPrevIn, pIn2 = hpf.fPrevPrevIn,
+      pOut1 = hpf.fPrevOut, pOut2 = hpf.fPrevPrevOut;
+
+   for(size_t i = 0; i < len; ++i)
+   {
+      const double x = in[i];
+      const double h = x * hb0 + hIn1 * hb1 + hIn2 * hb2
+         - hOut1 * ha1 - hOut2 * ha2;
+      hIn2 = hIn1; hIn1 = x;
+      hOut2 = hOut1; hOut1 = h;
+
+      // ProcessOne() returns float
+      const double y = float(h);
+      const double p = y * pb0 + pIn1 * pb1 + pIn2 * pb2
+         - pOut1 * pa1 - pOut2 * pa2;
+      pIn2 = pIn1; pIn1 = y;
+      pOut2 = pOut1; pOut1 = p;
+
+      const double value = float(p);
+      if(add)
+         out[i] += value * value;
+      else
+         out[i] = value * value;
+   }
+
+   hsf.fPrevIn = hIn1; hsf.fPrevPrevIn = hIn2;
+   hsf.fPrevOut = hOut1; hsf.fPrevPrevOut = hOut2;
+   hpf.fPrevIn = pIn1; hpf.fPrevPrevIn = pIn2;
+   hpf.fPrevOut = pOut1; hpf.fPrevPrevOut = pOut2;
+}
+
+}
+
 EBUR128::EBUR128(double rate, size_t channels)
    : mChannelCount(channels)
    , mRate(rate)
@@ -28,6 +81,7 @@ void EBUR128::Initialize()
    mSampleCount = 0;
    mBlockRingPos = 0;
    mBlockRingSize = 0;
+   mLastBlockValue = 0;
    memset(mLoudnessHist.get(), 0, HIST_BIN_COUNT*sizeof(long int));
    for(size_t channel = 0; channel < mChannelCount; ++channel)
    {
@@ -102,8 +156,37 @@ void EBUR128::ProcessSampleFromChannel(float x_in, size_t channel)
 
 void EBUR128::NextSample()
 {
-   ++mBlockRingPos;
-   ++mBlockRingSize;
+   AdvanceSamples(1);
+}
+
+void EBUR128::ProcessBuffers(const float *const *chans, size_t n)
+{
+   size_t done = 0;
+   while(done < n)
+   {
+      // Go no further than the next 100 ms step or the end of the ring,
+      // where NextSample() would do more than count
+      size_t len = std::min(n - done,
+         mBlockOverlap - mBlockRingPos % mBlockOverlap);
+      len = std::min(len, mBlockSize - mBlockRingPos);
+
+      for(size_t channel = 0; channel < mChannelCount; ++channel)
+         // Add the power of additional channels to the power of first channel.
+         WeightAndSquare(mWeightingFilter[channel].get(),
+            chans[channel] + done, &mBlockRingBuffer[mBlockRingPos], len,
+            channel > 0);
+
+      AdvanceSamples(len);
+      done += len;
+   }
+}
+
+/// Count n samples, none of which but the last may complete a 100 ms step
+/// or the ring.
+void EBUR128::AdvanceSamples(size_t n)
+{
+   mBlockRingPos += n;
+   mBlockRingSize += n;
 
    if(mBlockRingPos % mBlockOverlap == 0)
    {
@@ -114,7 +197,7 @@ void EBUR128::NextSample()
    // Close the ring.
    if(mBlockRingPos == mBlockSize)
       mBlockRingPos = 0;
-   ++mSampleCount;
+   mSampleCount += n;
 }
 
 double EBUR128::IntegrativeLoudness()
@@ -184,7 +267,8 @@ void EBUR128::AddBlockToHistogram(size_t validLen)
    // without -0.691 + 10*(...) to safe computing power. This is
    // possible because these constant cancel out anyway during the
    // following processing steps.
-   blockVal = log10(blockVal/double(validLen));
+   mLastBlockValue = blockVal/double(validLen);
+   blockVal = log10(mLastBlockValue);
    // log(blockVal) is within ]-inf, 1]
    idx = round((blockVal - GAMMA_A) * double(HIST_BIN_COUNT) / -GAMMA_A - 1);
 
@@ -28,13 +28,22 @@ public:
    void Initialize();
    void ProcessSampleFromChannel(float x_in, size_t channel);
    void NextSample();
+   /// Process n samples of each channel; the same as calling
+   /// ProcessSampleFromChannel() for each channel and then NextSample(),
+   /// n times, but much faster.
+   void ProcessBuffers(const float *const *chans, size_t n);
    double IntegrativeLoudness();
+   /// Loudness of the last complete 400 ms block, on the same scale as
+   /// IntegrativeLoudness(); 0 until there is one.
+   double MomentaryLoudness() const
+      { return 0.8529037031 * mLastBlockValue; }
    inline double IntegrativeLoudnessToLUFS(double loudness)
       { return 10 * log10(loudness); }
 
 private:
    void HistogramSums(size_t start_idx, double& sum_v, long int& sum_c);
    void AddBlockToHistogram(size_t validLen);
+   void AdvanceSamples(size_t n);
 
    static const size_t HIST_BIN_COUNT = 65536;
    /// EBU R128 absolute threshold
@@ -48,6 +57,8 @@ private:
    size_t mBlockOverlap;
    size_t mChannelCount;
    double mRate;
+   /// Mean square of the last block added to the histogram
+   double mLastBlockValue;
 
    /// This is be an array of arrays of the type
    /// mWeightingFilter[CHANNEL][FILTER] with
@@ -91,6 +91,11 @@ unsigned EffectEcho::GetAudioOutCount()
    return 1;
 }
 
+bool EffectEcho::SupportsParallelInstances()
+{
+   return true;
+}
+
 bool EffectEcho::ProcessInitialize(sampleCount WXUNUSED(totalLen), ChannelNames WXUNUSED(chanMap))
 {
    if (delay == 0.0)
@@ -167,6 +172,13 @@ bool EffectEcho::SetAutomationParameters(CommandParameters & parms)
    return true;
 }
 
+// Effect implementation
+
+bool EffectEcho::SupportsChaining()
+{
+   return true;
+}
+
 void EffectEcho::PopulateOrExchange(ShuttleGui & S)
 {
    S.AddSpace(0, 5);
@@ -38,12 +38,20 @@
 #include "../wxFileNameWrapper.h"
 #include "../widgets/ProgressDialog.h"
 #include "../ondemand/ODManager.h"
+#include "../WorkerPool.h"
+#include "LoadEffects.h"
 #include "../tracks/playabletrack/wavetrack/ui/WaveTrackView.h"
 #include "../tracks/playabletrack/wavetrack/ui/WaveTrackViewConstants.h"
 #include "../widgets/NumericTextCtrl.h"
 #include "../widgets/AudacityMessageBox.h"
 #include "../widgets/ErrorDialog.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 // Effect application counter
@@ -68,6 +76,69 @@ Effect::VetoDialogHook &GetVetoDialogHook()
    return sHook;
 }
 
+// Does the track reads and writes of Effect::ProcessTrack on another thread,
+// one at a time in the order posted, so that the disk works while the effect
+// computes.  The tracks are then touched by this thread only.
+class TrackIOThread
+{
+public:
+   TrackIOThread()
+      : mThread{ [this]{ Run(); } }
+   {}
+
+   // Finishes what was posted, then joins the thread
+   ~TrackIOThread()
+   {
+      {
+         std::lock_guard< std::mutex > lock{ mMutex };
+         mStopping = true;
+      }
+      mCondition.notify_one();
+      mThread.join();
+   }
+
+   TrackIOThread(const TrackIOThread&) PROHIBITED;
+   TrackIOThread &operator= (const TrackIOThread&) PROHIBITED;
+
+   // The future rethrows any exception of the action
+   std::future< void > Post(std::function< void() > action)
+   {
+      std::packaged_task< void() > task{ std::move(action) };
+      auto result = task.get_future();
+      {
+         std::lock_guard< std::mutex > lock{ mMutex };
+         mTasks.push_back(std::move(task));
+      }
+      mCondition.notify_one();
+      return result;
+   }
+
+private:
+   void Run()
+   {
+      while (true) {
+         std::packaged_task< void() > task;
+         {
+            std::unique_lock< std::mutex > lock{ mMutex };
+            mCondition.wait(lock, [this]{ return mStopping || !mTasks.empty(); });
+            if (mTasks.empty())
+               return;
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+         }
+         task();
+      }
+   }
+
+   std::mutex mMutex;
+   std::condition_variable mCondition;
+   std::deque< std::packaged_task< void() > > mTasks;
+   bool mStopping{ false };
+
+   // Last, so that it starts after the other members are constructed
+   std::thread mThread;
+};
+
 }
 
 auto Effect::SetVetoDialogHook( VetoDialogHook hook )
@@ -281,6 +352,13 @@ unsigned Effect::GetAudioOutCount()
    return 0;
 }
 
+bool Effect::SupportsParallelInstances()
+{
+   // Built-in effects override this.  Instances of plug-in clients are not
+   // made by MakeParallelInstance(), so their answer is not asked.
+   return false;
+}
+
 int Effect::GetMidiInCount()
 {
    if (mClient)
@@ -1363,7 +1441,12 @@ bool Effect::ProcessPass()
    mBlockSize = 0;
 
    int count = 0;
-   bool clear = false;
+
+   // If the effect allows, gather the groups first, then do them all at once
+   const bool parallel = GetType() == EffectTypeProcess &&
+      SupportsParallelInstances() &&
+      WorkerPool::GetHardwareConcurrency() > 1;
+   std::vector< TrackGroup > groups;
 
    const bool multichannel = mNumAudioIn > 1;
    auto range = multichannel
@@ -1414,7 +1497,6 @@ bool Effect::ProcessPass()
             if (mNumChannels == 2) {
                // TODO: more-than-two-channels
                right = channel;
-               clear = false;
                if (!isGenerator)
                   GetSamples(right, &rightStart, &len);
 
@@ -1423,67 +1505,18 @@ bool Effect::ProcessPass()
             }
          }
 
-         // Let the client know the sample rate
-         SetSampleRate(left->GetRate());
-
-         // Get the block size the client wants to use
-         auto max = left->GetMaxBlockSize() * 2;
-         mBlockSize = SetBlockSize(max);
-
-         // Calculate the buffer size to be at least the max rounded up to the clients
-         // selected block size.
-         const auto prevBufferSize = mBufferSize;
-         mBufferSize = ((max + (mBlockSize - 1)) / mBlockSize) * mBlockSize;
-
-         // If the buffer size has changed, then (re)allocate the buffers
-         if (prevBufferSize != mBufferSize)
-         {
-            // Always create the number of input buffers the client expects even if we don't have
-            // the same number of channels.
-            inBufPos.reinit( mNumAudioIn );
-            inBuffer.reinit( mNumAudioIn, mBufferSize );
-
-            // We won't be using more than the first 2 buffers, so clear the rest (if any)
-            for (size_t i = 2; i < mNumAudioIn; i++)
-            {
-               for (size_t j = 0; j < mBufferSize; j++)
-               {
-                  inBuffer[i][j] = 0.0;
-               }
-            }
-
-            // Always create the number of output buffers the client expects even if we don't have
-            // the same number of channels.
-            outBufPos.reinit( mNumAudioOut );
-            // Output buffers get an extra mBlockSize worth to give extra room if
-            // the plugin adds latency
-            outBuffer.reinit( mNumAudioOut, mBufferSize + mBlockSize );
-         }
-
-         // (Re)Set the input buffer positions
-         for (size_t i = 0; i < mNumAudioIn; i++)
-         {
-            inBufPos[i] = inBuffer[i].get();
-         }
-
-         // (Re)Set the output buffer positions
-         for (size_t i = 0; i < mNumAudioOut; i++)
-         {
-            outBufPos[i] = outBuffer[i].get();
-         }
-
-         // Clear unused input buffers
-         if (!right && !clear && mNumAudioIn > 1)
+         if (parallel)
          {
-            for (size_t j = 0; j < mBufferSize; j++)
-            {
-               inBuffer[1][j] = 0.0;
-            }
-            clear = true;
+            TrackGroup group{ count, {}, left, right,
+               leftStart, rightStart, len, mNumChannels };
+            std::copy(map, map + 3, group.map);
+            groups.push_back(group);
+            count++;
+            return;
          }
 
          // Go process the track(s)
-         bGoodResult = ProcessTrack(
+         bGoodResult = ProcessTrackGroup(
             count, map, left, right, leftStart, rightStart, len,
             inBuffer, outBuffer, inBufPos, outBufPos);
          if (!bGoodResult)
@@ -1497,6 +1530,22 @@ bool Effect::ProcessPass()
       }
    );
 
+   if (bGoodResult && !groups.empty())
+   {
+      if (groups.size() > 1)
+         bGoodResult = ProcessTrackGroupsInParallel(groups);
+      else
+      {
+         auto &group = groups[0];
+         mNumChannels = group.numChannels;
+         mSampleCnt = group.len;
+         bGoodResult = ProcessTrackGroup(
+            group.count, group.map, group.left, group.right,
+            group.leftStart, group.rightStart, group.len,
+            inBuffer, outBuffer, inBufPos, outBufPos);
+      }
+   }
+
    if (bGoodResult && GetType() == EffectTypeGenerate)
    {
       mT1 = mT0 + mDuration;
@@ -1505,6 +1554,226 @@ bool Effect::ProcessPass()
    return bGoodResult;
 }
 
+bool Effect::ProcessTrackGroup(int count,
+                               ChannelNames map,
+                               WaveTrack *left,
+                               WaveTrack *right,
+                               sampleCount leftStart,
+                               sampleCount rightStart,
+                               sampleCount len,
+                               FloatBuffers &inBuffer,
+                               FloatBuffers &outBuffer,
+                               ArrayOf< float * > &inBufPos,
+                               ArrayOf< float *> &outBufPos)
+{
+   // Let the client know the sample rate
+   SetSampleRate(left->GetRate());
+
+   // Get the block size the client wants to use
+   auto max = left->GetMaxBlockSize() * 2;
+   mBlockSize = SetBlockSize(max);
+
+   // Calculate the buffer size to be at least the max rounded up to the clients
+   // selected block size.
+   const auto prevBufferSize = mBufferSize;
+   mBufferSize = ((max + (mBlockSize - 1)) / mBlockSize) * mBlockSize;
+
+   // If the buffer size has changed, then (re)allocate the buffers
+   if (prevBufferSize != mBufferSize || !inBuffer)
+   {
+      // Always create the number of input buffers the client expects even if we don't have
+      // the same number of channels.
+      inBufPos.reinit( mNumAudioIn );
+      inBuffer.reinit( mNumAudioIn, mBufferSize );
+
+      // We won't be using more than the first 2 buffers, so clear the rest (if any)
+      for (size_t i = 2; i < mNumAudioIn; i++)
+      {
+         for (size_t j = 0; j < mBufferSize; j++)
+         {
+            inBuffer[i][j] = 0.0;
+         }
+      }
+
+      // Always create the number of output buffers the client expects even if we don't have
+      // the same number of channels.
+      outBufPos.reinit( mNumAudioOut );
+      // Output buffers get an extra mBlockSize worth to give extra room if
+      // the plugin adds latency
+      outBuffer.reinit( mNumAudioOut, mBufferSize + mBlockSize );
+   }
+
+   // (Re)Set the input buffer positions
+   for (size_t i = 0; i < mNumAudioIn; i++)
+   {
+      inBufPos[i] = inBuffer[i].get();
+   }
+
+   // (Re)Set the output buffer positions
+   for (size_t i = 0; i < mNumAudioOut; i++)
+   {
+      outBufPos[i] = outBuffer[i].get();
+   }
+
+   // Clear unused input buffers
+   if (!right && mNumAudioIn > 1)
+   {
+      for (size_t j = 0; j < mBufferSize; j++)
+      {
+         inBuffer[1][j] = 0.0;
+      }
+   }
+
+   // Go process the track(s)
+   return ProcessTrack(
+      count, map, left, right, leftStart, rightStart, len,
+      inBuffer, outBuffer, inBufPos, outBufPos);
+}
+
+bool Effect::ProcessTrackGroupsInParallel(
+   std::vector< TrackGroup > &groups)
+{
+   // Make the instances here, on the main thread
+   std::vector< std::unique_ptr< Effect > > instances;
+   wxString parms;
+   if (GetAutomationParameters(parms))
+   {
+      for (auto &group : groups)
+      {
+         auto instance = MakeParallelInstance(parms);
+         if (!instance)
+         {
+            instances.clear();
+            break;
+         }
+         instance->mNumAudioIn = mNumAudioIn;
+         instance->mNumAudioOut = mNumAudioOut;
+         instance->mNumChannels = group.numChannels;
+         instance->mSampleCnt = group.len;
+         instance->mProjectRate = mProjectRate;
+         instance->mFactory = mFactory;
+         instance->mT0 = mT0;
+         instance->mT1 = mT1;
+         instance->mDuration = mDuration;
+         instance->mPass = mPass;
+         instance->mIsPreview = mIsPreview;
+         instances.push_back(std::move(instance));
+      }
+   }
+
+   if (instances.empty())
+   {
+      // Do them one after another after all
+      FloatBuffers inBuffer, outBuffer;
+      ArrayOf<float *> inBufPos, outBufPos;
+      for (auto &group : groups)
+      {
+         mNumChannels = group.numChannels;
+         mSampleCnt = group.len;
+         if (!ProcessTrackGroup(
+            group.count, group.map, group.left, group.right,
+            group.leftStart, group.rightStart, group.len,
+            inBuffer, outBuffer, inBufPos, outBufPos))
+            return false;
+      }
+      return true;
+   }
+
+   const auto nGroups = groups.size();
+   std::atomic< bool > cancelled{ false };
+   std::vector< ParallelProgress > progress(nGroups);
+   for (size_t ii = 0; ii < nGroups; ++ii)
+   {
+      progress[ii].pCancelled = &cancelled;
+      instances[ii]->mpParallelProgress = &progress[ii];
+   }
+
+   // Each group writes only its own tracks, so the result does not depend
+   // on the order in which the threads finish
+   std::vector< char > results(nGroups, 0);
+   const bool finished = RunWithProgress(nGroups,
+      [&](size_t ii) {
+         auto &group = groups[ii];
+         FloatBuffers inBuffer, outBuffer;
+         ArrayOf<float *> inBufPos, outBufPos;
+         results[ii] = instances[ii]->ProcessTrackGroup(
+            group.count, group.map, group.left, group.right,
+            group.leftStart, group.rightStart, group.len,
+            inBuffer, outBuffer, inBufPos, outBufPos);
+         progress[ii].fraction = 1.0;
+      },
+      [&] {
+         double total = 0;
+         for (const auto &groupProgress : progress)
+            total += groupProgress.fraction;
+         return total / nGroups;
+      },
+      cancelled);
+
+   return finished && std::all_of(results.begin(), results.end(),
+      [](char result){ return result != 0; });
+}
+
+bool Effect::RunWithProgress(size_t count,
+   const std::function< void(size_t) > &fn,
+   const std::function< double() > &getFraction,
+   std::atomic< bool > &cancelled)
+{
+   std::exception_ptr pException;
+   std::atomic< bool > done{ false };
+   WorkerPool pool{
+      std::min(count, WorkerPool::GetHardwareConcurrency()) - 1 };
+
+   // The main thread stays free to show progress, so another thread takes
+   // part in the work in its place
+   std::thread driver{ [&] {
+      try
+      {
+         pool.ParallelFor(count, fn);
+      }
+      catch (...)
+      {
+         pException = std::current_exception();
+      }
+      done = true;
+   } };
+   auto cleanup = finally( [&] {
+      // Stop the other threads promptly if progress display throws
+      if (driver.joinable())
+      {
+         cancelled = true;
+         driver.join();
+      }
+   } );
+
+   while (!done)
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      if (TotalProgress(getFraction()))
+         cancelled = true;
+   }
+
+   driver.join();
+   if (pException)
+      std::rethrow_exception(pException);
+
+   return !cancelled;
+}
+
+std::unique_ptr< Effect > Effect::MakeParallelInstance(const wxString &parms)
+{
+   // Only built-in effects, which are their own clients, are made here
+   if (mClient)
+      return nullptr;
+
+   auto result = BuiltinEffectsModule::NewInstance(GetSymbol());
+   if (!result ||
+       !result->Startup(nullptr) ||
+       !result->SetAutomationParameters(parms))
+      return nullptr;
+   return result;
+}
+
 bool Effect::ProcessTrack(int count,
                           ChannelNames map,
                           WaveTrack *left,
@@ -1590,6 +1859,60 @@ bool Effect::ProcessTrack(int count,
          genRight = mFactory->NewWaveTrack(right->GetSampleFormat(), right->GetRate());
    }
 
+   // The next chunk of input is read into readBuffer while the effect
+   // processes inBuffer, and the last full chunk of output is written from
+   // writeBuffer while the effect fills outBuffer; the buffers then swap.
+   FloatBuffers readBuffer, writeBuffer;
+   if (len > 0)
+      readBuffer.reinit(right ? 2u : 1u, mBufferSize);
+   if (isProcessor || isGenerator)
+      writeBuffer.reinit(chans, mBufferSize + mBlockSize);
+   std::future< void > pendingRead, pendingWrite;
+
+   // Declared after all that the posted actions use, so that it is destroyed,
+   // finishing them, first
+   TrackIOThread io;
+
+   const auto postRead = [&](
+      sampleCount leftPos, sampleCount rightPos, size_t cnt )
+   {
+      const auto pLeft = readBuffer[0].get();
+      const auto pRight = right ? readBuffer[1].get() : nullptr;
+      pendingRead = io.Post( [=] {
+         left->Get((samplePtr) pLeft, floatSample, leftPos, cnt);
+         if (right)
+            right->Get((samplePtr) pRight, floatSample, rightPos, cnt);
+      } );
+   };
+
+   const auto postWrite = [&](
+      sampleCount leftPos, sampleCount rightPos, size_t cnt )
+   {
+      // The previous write must finish before its buffers are reused; this
+      // also rethrows its exceptions
+      if (pendingWrite.valid())
+         pendingWrite.get();
+      for (size_t i = 0; i < chans; i++)
+         outBuffer[i].swap(writeBuffer[i]);
+
+      const auto pLeft = writeBuffer[0].get();
+      const auto pRight = writeBuffer[chans >= 2 ? 1 : 0].get();
+      pendingWrite = io.Post( [=] {
+         if (isProcessor)
+         {
+            left->Set((samplePtr) pLeft, floatSample, leftPos, cnt);
+            if (right)
+               right->Set((samplePtr) pRight, floatSample, rightPos, cnt);
+         }
+         else
+         {
+            genLeft->Append((samplePtr) pLeft, floatSample, cnt);
+            if (genRight)
+               genRight->Append((samplePtr) pRight, floatSample, cnt);
+         }
+      } );
+   };
+
    // Call the effect until we run out of input or delayed samples
    while (inputRemaining != 0 || delayRemaining != 0)
    {
@@ -1603,13 +1926,23 @@ bool Effect::ProcessTrack(int count,
             inputBufferCnt =
                limitSampleBufferSize( mBufferSize, inputRemaining );
 
-            // Fill the input buffers
-            left->Get((samplePtr) inBuffer[0].get(), floatSample, inLeftPos, inputBufferCnt);
+            // Fill the input buffers, from the read ahead if there is one,
+            // else read the first chunk now
+            if (!pendingRead.valid())
+               postRead(inLeftPos, inRightPos, inputBufferCnt);
+            pendingRead.get();
+            inBuffer[0].swap(readBuffer[0]);
             if (right)
             {
-               right->Get((samplePtr) inBuffer[1].get(), floatSample, inRightPos, inputBufferCnt);
+               inBuffer[1].swap(readBuffer[1]);
             }
 
+            // Read the next chunk while this one is processed
+            if (inputRemaining > inputBufferCnt)
+               postRead(inLeftPos + inputBufferCnt, inRightPos + inputBufferCnt,
+                  limitSampleBufferSize(
+                     mBufferSize, inputRemaining - inputBufferCnt ) );
+
             // Reset the input buffer positions
             for (size_t i = 0; i < mNumChannels; i++)
             {
@@ -1760,30 +2093,9 @@ bool Effect::ProcessTrack(int count,
       // Output buffers have filled
       else
       {
-         if (isProcessor)
-         {
-            // Write them out
-            left->Set((samplePtr) outBuffer[0].get(), floatSample, outLeftPos, outputBufferCnt);
-            if (right)
-            {
-               if (chans >= 2)
-               {
-                  right->Set((samplePtr) outBuffer[1].get(), floatSample, outRightPos, outputBufferCnt);
-               }
-               else
-               {
-                  right->Set((samplePtr) outBuffer[0].get(), floatSample, outRightPos, outputBufferCnt);
-               }
-            }
-         }
-         else if (isGenerator)
-         {
-            genLeft->Append((samplePtr) outBuffer[0].get(), floatSample, outputBufferCnt);
-            if (genRight)
-            {
-               genRight->Append((samplePtr) outBuffer[1].get(), floatSample, outputBufferCnt);
-            }
-         }
+         // Write them out, while the effect goes on
+         if (isProcessor || isGenerator)
+            postWrite(outLeftPos, outRightPos, outputBufferCnt);
 
          // Reset the output buffer positions
          for (size_t i = 0; i < chans; i++)
@@ -1820,32 +2132,12 @@ bool Effect::ProcessTrack(int count,
    }
 
    // Put any remaining output
-   if (rc && outputBufferCnt)
-   {
-      if (isProcessor)
-      {
-         left->Set((samplePtr) outBuffer[0].get(), floatSample, outLeftPos, outputBufferCnt);
-         if (right)
-         {
-            if (chans >= 2)
-            {
-               right->Set((samplePtr) outBuffer[1].get(), floatSample, outRightPos, outputBufferCnt);
-            }
-            else
-            {
-               right->Set((samplePtr) outBuffer[0].get(), floatSample, outRightPos, outputBufferCnt);
-            }
-         }
-      }
-      else if (isGenerator)
-      {
-         genLeft->Append((samplePtr) outBuffer[0].get(), floatSample, outputBufferCnt);
-         if (genRight)
-         {
-            genRight->Append((samplePtr) outBuffer[1].get(), floatSample, outputBufferCnt);
-         }
-      }
-   }
+   if (rc && outputBufferCnt && (isProcessor || isGenerator))
+      postWrite(outLeftPos, outRightPos, outputBufferCnt);
+
+   // Wait for the writes, rethrowing any exception
+   if (rc && pendingWrite.valid())
+      pendingWrite.get();
 
    if (rc && isGenerator)
    {
@@ -1998,6 +2290,12 @@ void Effect::IncludeNotSelectedPreviewTracks(bool includeNotSelected)
 
 bool Effect::TotalProgress(double frac, const TranslatableString &msg)
 {
+   if (mpParallelProgress)
+   {
+      mpParallelProgress->fraction = frac;
+      return *mpParallelProgress->pCancelled;
+   }
+
    auto updateResult = (mProgress ?
       mProgress->Update(frac, msg) :
       ProgressResult::Success);
@@ -2006,6 +2304,10 @@ bool Effect::TotalProgress(double frac, const TranslatableString &msg)
 
 bool Effect::TrackProgress(int whichTrack, double frac, const TranslatableString &msg)
 {
+   if (mpParallelProgress)
+      // The instance processes just the one track
+      return TotalProgress(frac, msg);
+
    auto updateResult = (mProgress ?
       mProgress->Update(whichTrack + frac, (double) mNumTracks, msg) :
       ProgressResult::Success);
@@ -2014,6 +2316,9 @@ bool Effect::TrackProgress(int whichTrack, double frac, const TranslatableString
 
 bool Effect::TrackGroupProgress(int whichGroup, double frac, const TranslatableString &msg)
 {
+   if (mpParallelProgress)
+      return TotalProgress(frac, msg);
+
    auto updateResult = (mProgress ?
       mProgress->Update(whichGroup + frac, (double) mNumGroups, msg) :
       ProgressResult::Success);
@@ -2285,6 +2590,13 @@ bool Effect::IsHidden()
    return false;
 }
 
+bool Effect::SupportsChaining()
+{
+   // Plug-in clients are processed by Effect::Process(), one block at a time.
+   // Built-in effects that are also processed that way override this.
+   return mClient && GetType() == EffectTypeProcess;
+}
+
 void Effect::Preview(bool dryOnly)
 {
    if (mNumTracks == 0) { // nothing to preview
@@ -16,6 +16,7 @@
 
 #include "../Experimental.h"
 
+#include <atomic>
 #include <functional>
 #include <set>
 
@@ -114,6 +115,7 @@ class AUDACITY_DLL_API Effect /* not final */ : public wxEvtHandler,
    
    unsigned GetAudioInCount() override;
    unsigned GetAudioOutCount() override;
+   bool SupportsParallelInstances() override;
 
    int GetMidiInCount() override;
    int GetMidiOutCount() override;
@@ -264,6 +266,10 @@ class AUDACITY_DLL_API Effect /* not final */ : public wxEvtHandler,
 
    virtual bool IsHidden();
 
+   // Whether the effect does all of its work in ProcessBlock(), in one pass,
+   // so that an EffectChain may apply it together with other effects
+   virtual bool SupportsChaining();
+
    // Nonvirtual
    // Display a message box, using effect's (translated) name as the prefix
    // for the title.
@@ -338,6 +344,15 @@ protected:
    // (when doing stereo groups at a time)
    bool TrackGroupProgress(int whichGroup, double frac, const TranslatableString & = {});
 
+   // Calls fn(0) ... fn(count - 1) on a pool of threads, while this thread
+   // passes getFraction() to TotalProgress() every 50 ms.  fn should stop
+   // early when cancelled becomes true, as it does when the user cancels.
+   // Rethrows what fn throws.  Returns false if cancelled.
+   bool RunWithProgress(size_t count,
+      const std::function< void(size_t) > &fn,
+      const std::function< double() > &getFraction,
+      std::atomic< bool > &cancelled);
+
    int GetNumWaveTracks() { return mNumTracks; }
    int GetNumWaveGroups() { return mNumGroups; }
 
@@ -480,6 +495,38 @@ protected:
  private:
    void CountWaveTracks();
 
+   // A selected track, or group of channels, as ProcessPass finds it
+   struct TrackGroup {
+      int count;
+      ChannelName map[3];
+      WaveTrack *left;
+      WaveTrack *right;
+      sampleCount leftStart;
+      sampleCount rightStart;
+      sampleCount len;
+      unsigned numChannels;
+   };
+
+   // Sets the rate and buffer sizes for the group, then calls ProcessTrack
+   bool ProcessTrackGroup(int count,
+                          ChannelNames map,
+                          WaveTrack *left,
+                          WaveTrack *right,
+                          sampleCount leftStart,
+                          sampleCount rightStart,
+                          sampleCount len,
+                          FloatBuffers &inBuffer,
+                          FloatBuffers &outBuffer,
+                          ArrayOf< float * > &inBufPos,
+                          ArrayOf< float *> &outBufPos);
+
+   // Each group gets its own instance of the effect, and the instances
+   // run on a pool of threads, while this thread shows their progress
+   bool ProcessTrackGroupsInParallel(std::vector< TrackGroup > &groups);
+
+   // Another instance with the given automation parameters, or null
+   std::unique_ptr< Effect > MakeParallelInstance(const wxString &parms);
+
    // Driver for client effects
    bool ProcessTrack(int count,
                      ChannelNames map,
@@ -529,6 +576,14 @@ private:
    size_t mBlockSize;
    unsigned mNumChannels;
 
+   // Where an instance made by MakeParallelInstance reports progress,
+   // instead of to a dialog
+   struct ParallelProgress {
+      std::atomic< double > fraction{ 0.0 };
+      const std::atomic< bool > *pCancelled{};
+   };
+   ParallelProgress *mpParallelProgress{};
+
 public:
    const static wxString kUserPresetIdent;
    const static wxString kFactoryPresetIdent;
@@ -536,6 +591,7 @@ public:
    const static wxString kFactoryDefaultsIdent;
 
    friend class EffectUIHost;
+   friend class EffectChain;
 };
 
 // FIXME:
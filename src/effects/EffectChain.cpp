@@ -0,0 +1,210 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  EffectChain.cpp
+
+*******************************************************************//**
+
+\class EffectChain
+\brief An Effect that passes each block of samples through several other
+effects in turn.
+
+  Applying effects one by one copies the tracks and writes all of the
+  audio for each of them.  When the effects do all their work in
+  ProcessBlock(), a macro can instead apply them together with one
+  EffectChain, reading and writing the tracks once.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "EffectChain.h"
+
+#include "../InconsistencyException.h"
+
+#include <algorithm>
+
+#include <wx/intl.h>
+
+const ComponentInterfaceSymbol EffectChain::Symbol
+{ XO("Apply Macro") };
+
+EffectChain::EffectChain( std::vector< Effect* > effects )
+   : mEffects{ std::move( effects ) }
+{
+   wxASSERT( CanChain( mEffects ) );
+}
+
+EffectChain::~EffectChain()
+{
+}
+
+bool EffectChain::CanChain( const std::vector< Effect* > &effects )
+{
+   if (effects.empty())
+      return false;
+
+   const auto nChannels = effects[0]->GetAudioInCount();
+   return nChannels > 0 &&
+      std::all_of( effects.begin(), effects.end(), [&]( Effect *effect ){
+         return effect->SupportsChaining() &&
+            effect->GetAudioInCount() == nChannels &&
+            effect->GetAudioOutCount() == nChannels;
+      } );
+}
+
+// ComponentInterface implementation
+
+ComponentInterfaceSymbol EffectChain::GetSymbol()
+{
+   return Symbol;
+}
+
+TranslatableString EffectChain::GetDescription()
+{
+   return XO("Applies several effects in one pass");
+}
+
+// EffectDefinitionInterface implementation
+
+EffectType EffectChain::GetType()
+{
+   return EffectTypeProcess;
+}
+
+bool EffectChain::IsInteractive()
+{
+   return false;
+}
+
+// EffectClientInterface implementation
+
+unsigned EffectChain::GetAudioInCount()
+{
+   return mEffects.front()->GetAudioInCount();
+}
+
+unsigned EffectChain::GetAudioOutCount()
+{
+   return mEffects.back()->GetAudioOutCount();
+}
+
+void EffectChain::SetSampleRate(double rate)
+{
+   Effect::SetSampleRate(rate);
+   for (auto effect : mEffects)
+      effect->SetSampleRate(rate);
+}
+
+size_t EffectChain::SetBlockSize(size_t maxBlockSize)
+{
+   // Each effect may only lower the size that the ones before it chose
+   auto blockSize = maxBlockSize;
+   for (auto effect : mEffects)
+      blockSize = std::min( blockSize, effect->SetBlockSize(blockSize) );
+   Effect::SetBlockSize(blockSize);
+
+   const auto nChannels = GetAudioOutCount();
+   for (size_t ii = 0; ii < 2; ++ii)
+   {
+      mBuffers[ii].reinit( nChannels, blockSize );
+      mBufferPtrs[ii].reinit( nChannels );
+      for (size_t jj = 0; jj < nChannels; ++jj)
+         mBufferPtrs[ii][jj] = mBuffers[ii][jj].get();
+   }
+   mInPtrs.reinit( nChannels );
+   mOutPtrs.reinit( nChannels );
+
+   return blockSize;
+}
+
+sampleCount EffectChain::GetLatency()
+{
+   // Delays of effects in series add
+   sampleCount latency = 0;
+   for (auto effect : mEffects)
+      latency += effect->GetLatency();
+   return latency;
+}
+
+bool EffectChain::ProcessInitialize(sampleCount totalLen, ChannelNames chanMap)
+{
+   mInitialized = 0;
+   for (auto effect : mEffects)
+   {
+      // As ProcessPass() would set them for each effect alone
+      effect->mSampleCnt = totalLen;
+      effect->mNumChannels = mNumChannels;
+      if (!effect->ProcessInitialize(totalLen, chanMap))
+      {
+         ProcessFinalize();
+         return false;
+      }
+      ++mInitialized;
+   }
+   return true;
+}
+
+bool EffectChain::ProcessFinalize()
+{
+   bool result = true;
+   for (size_t ii = 0; ii < mInitialized; ++ii)
+      result = mEffects[ii]->ProcessFinalize() && result;
+   mInitialized = 0;
+   return result;
+}
+
+size_t EffectChain::ProcessBlock(float **inBlock, float **outBlock, size_t blockLen)
+{
+   const auto nEffects = mEffects.size();
+   const auto nChannels = GetAudioOutCount();
+   float **input = inBlock;
+   for (size_t ii = 0; ii < nEffects; ++ii)
+   {
+      // Alternate between the two buffers, and write the last into outBlock
+      float **output = (ii + 1 == nEffects)
+         ? outBlock
+         : mBufferPtrs[ii % 2].get();
+      auto processed = mEffects[ii]->ProcessBlock(input, output, blockLen);
+
+      // The next effect needs the whole block, so give an effect that
+      // processed less the rest of it
+      while (processed < blockLen)
+      {
+         for (size_t jj = 0; jj < nChannels; ++jj)
+         {
+            mInPtrs[jj] = input[jj] + processed;
+            mOutPtrs[jj] = output[jj] + processed;
+         }
+         const auto more = mEffects[ii]->ProcessBlock(
+            mInPtrs.get(), mOutPtrs.get(), blockLen - processed);
+         if (more == 0)
+            // No progress; don't pass the garbage in the buffer along
+            THROW_INCONSISTENCY_EXCEPTION;
+         processed += std::min(more, blockLen - processed);
+      }
+
+      input = output;
+   }
+   return blockLen;
+}
+
+// Effect implementation
+
+bool EffectChain::Init()
+{
+   // Give each effect what DoEffect() would have given it
+   for (auto effect : mEffects)
+   {
+      effect->mProjectRate = mProjectRate;
+      effect->mFactory = mFactory;
+      effect->mTracks = mTracks;
+      effect->mT0 = mT0;
+      effect->mT1 = mT1;
+      effect->mDuration = mDuration;
+      effect->CountWaveTracks();
+      if (!effect->Init())
+         return false;
+   }
+   return true;
+}
@@ -0,0 +1,70 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  EffectChain.h
+
+  Applies several effects, one after another, in one pass over the
+  selected audio.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_EFFECT_CHAIN__
+#define __AUDACITY_EFFECT_CHAIN__
+
+#include "Effect.h"
+
+#include <vector>
+
+class EffectChain final : public Effect
+{
+public:
+   static const ComponentInterfaceSymbol Symbol;
+
+   // The effects must already have their settings, and must all allow
+   // chaining with the same numbers of inputs and outputs
+   explicit EffectChain( std::vector< Effect* > effects );
+   virtual ~EffectChain();
+
+   // Whether the effects may be applied together by an EffectChain
+   static bool CanChain( const std::vector< Effect* > &effects );
+
+   // ComponentInterface implementation
+
+   ComponentInterfaceSymbol GetSymbol() override;
+   TranslatableString GetDescription() override;
+
+   // EffectDefinitionInterface implementation
+
+   EffectType GetType() override;
+   bool IsInteractive() override;
+
+   // EffectClientInterface implementation
+
+   unsigned GetAudioInCount() override;
+   unsigned GetAudioOutCount() override;
+   void SetSampleRate(double rate) override;
+   size_t SetBlockSize(size_t maxBlockSize) override;
+   sampleCount GetLatency() override;
+   bool ProcessInitialize(sampleCount totalLen, ChannelNames chanMap = NULL) override;
+   bool ProcessFinalize() override;
+   size_t ProcessBlock(float **inBlock, float **outBlock, size_t blockLen) override;
+
+   // Effect implementation
+
+   bool Init() override;
+
+private:
+   std::vector< Effect* > mEffects;
+
+   // Outputs of each effect but the last, which are inputs of the next
+   FloatBuffers mBuffers[2];
+   ArrayOf< float* > mBufferPtrs[2];
+   // Into the buffers, past what an effect already processed of a block
+   ArrayOf< float* > mInPtrs, mOutPtrs;
+
+   // How many effects were initialized for the current track
+   size_t mInitialized{ 0 };
+};
+
+#endif
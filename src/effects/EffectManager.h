@@ -119,9 +119,9 @@ private:
       void operator () (EffectManager *p) const
          { if(p) p->SetBatchProcessing(mID, false); }
    };
+public:
    using BatchProcessingScope =
       std::unique_ptr< EffectManager, UnsetBatchProcessing >;
-public:
    // RAII for the function above
    BatchProcessingScope SetBatchProcessing(const PluginID &ID)
    {
@@ -295,6 +295,28 @@ void EffectRack::OnTimer(wxTimerEvent & WXUNUSED(evt))
       mLatency->Refresh();
       mLastLatency = latency;
    }
+
+   // Show, for each effect, how much of the time that each buffer lasts it
+   // takes
+   auto &rem = RealtimeEffectManager::Get();
+   const auto budget = rem.GetRealtimeBudget();
+   for (const auto &load : rem.GetRealtimeLoads())
+   {
+      auto iter = std::find(mEffects.begin(), mEffects.end(), load.effect);
+      if (iter == mEffects.end())
+         continue;
+      auto text = FindWindowById(ID_NAME + (iter - mEffects.begin()));
+      if (!text)
+         continue;
+
+      wxString tip = _("Name of the effect");
+      if (budget > 0)
+         tip += wxString::Format(
+            _("\nTime per buffer: %.2f ms, at most %.2f ms, of %.2f ms"),
+            load.seconds * 1000, load.peakSeconds * 1000, budget * 1000);
+      if (text->GetToolTipText() != tip)
+         text->SetToolTip(tip);
+   }
 }
 
 void EffectRack::OnApply(wxCommandEvent & WXUNUSED(evt))
@@ -97,6 +97,7 @@
 #include "../EnvelopeEditor.h"
 #include "../widgets/ErrorDialog.h"
 #include "../FFT.h"
+#include "../PartitionedConvolution.h"
 #include "../Prefs.h"
 #include "../Project.h"
 #include "../TrackArtist.h"
@@ -1283,28 +1284,24 @@ bool EffectEqualization::ProcessOne(int count, WaveTrack * t,
    // create a NEW WaveTrack to hold all of the output, including 'tails' each end
    auto output = mFactory->NewWaveTrack(floatSample, t->GetRate());
 
-   wxASSERT(mM - 1 < windowSize);
-   size_t L = windowSize - (mM - 1);   //Process L samples at a go
+   // Chooses the transform size, and for long filters, partitions
+   PartitionedConvolution convolution{ mM };
+   convolution.SetFilter( mFilterTaps.get(), mM );
+   const auto B = convolution.GetBlockSize();   //Process B samples at a go
+
    auto s = start;
    auto idealBlockLen = t->GetMaxBlockSize() * 4;
-   if (idealBlockLen % L != 0)
-      idealBlockLen += (L - (idealBlockLen % L));
+   if (idealBlockLen % B != 0)
+      idealBlockLen += (B - (idealBlockLen % B));
 
    Floats buffer{ idealBlockLen };
 
-   Floats window1{ windowSize };
-   Floats window2{ windowSize };
-   float *thisWindow = window1.get();
-   float *lastWindow = window2.get();
-
    auto originalLen = len;
-
-   for(size_t i = 0; i < windowSize; i++)
-      lastWindow[i] = 0;
+   // The output is longer by the 'tail' of mM-1 samples
+   auto remaining = originalLen + (mM - 1);
 
    TrackProgress(count, 0.);
    bool bLoopSuccess = true;
-   size_t wcopy = 0;
    int offset = (mM - 1) / 2;
 
    while (len != 0)
@@ -1313,26 +1310,20 @@ bool EffectEqualization::ProcessOne(int count, WaveTrack * t,
 
       t->Get((samplePtr)buffer.get(), floatSample, s, block);
 
-      for(size_t i = 0; i < block; i += L)   //go through block in lumps of length L
-      {
-         wcopy = std::min <size_t> (L, block - i);
-         for(size_t j = 0; j < wcopy; j++)
-            thisWindow[j] = buffer[i+j];   //copy the L (or remaining) samples
-         for(auto j = wcopy; j < windowSize; j++)
-            thisWindow[j] = 0;   //this includes the padding
-
-         Filter(windowSize, thisWindow);
+      // Only the last block can be short; pad it to a whole number of lumps,
+      // whose output is the start of the tail
+      auto padded = block;
+      if (padded % B != 0)
+         padded += (B - (padded % B));
+      for(auto i = block; i < padded; i++)
+         buffer[i] = 0;
 
-         // Overlap - Add
-         for(size_t j = 0; (j < mM - 1) && (j < wcopy); j++)
-            buffer[i+j] = thisWindow[j] + lastWindow[L + j];
-         for(size_t j = mM - 1; j < wcopy; j++)
-            buffer[i+j] = thisWindow[j];
+      for(size_t i = 0; i < padded; i += B)   //go through block in lumps of length B
+         convolution.ProcessBlock(&buffer[i], &buffer[i]);
 
-         std::swap( thisWindow, lastWindow );
-      }  //next i, lump of this block
-
-      output->Append((samplePtr)buffer.get(), floatSample, block);
+      auto toAppend = limitSampleBufferSize( padded, remaining );
+      output->Append((samplePtr)buffer.get(), floatSample, toAppend);
+      remaining -= toAppend;
       len -= block;
       s += block;
 
@@ -1346,22 +1337,16 @@ bool EffectEqualization::ProcessOne(int count, WaveTrack * t,
 
    if(bLoopSuccess)
    {
-      // mM-1 samples of 'tail' left in lastWindow, get them now
-      if(wcopy < (mM - 1)) {
-         // Still have some overlap left to process
-         // (note that lastWindow and thisWindow have been exchanged at this point
-         //  so that 'thisWindow' is really the window prior to 'lastWindow')
-         size_t j = 0;
-         for(; j < mM - 1 - wcopy; j++)
-            buffer[j] = lastWindow[wcopy + j] + thisWindow[L + wcopy + j];
-         // And fill in the remainder after the overlap
-         for( ; j < mM - 1; j++)
-            buffer[j] = lastWindow[wcopy + j];
-      } else {
-         for(size_t j = 0; j < mM - 1; j++)
-            buffer[j] = lastWindow[wcopy + j];
-      }
-      output->Append((samplePtr)buffer.get(), floatSample, mM - 1);
+      // Whatever is left of the 'tail' comes from feeding zeroes
+      while (remaining != 0)
+      {
+         for(size_t i = 0; i < B; i++)
+            buffer[i] = 0;
+         convolution.ProcessBlock(buffer.get(), buffer.get());
+         auto toAppend = limitSampleBufferSize( B, remaining );
+         output->Append((samplePtr)buffer.get(), floatSample, toAppend);
+         remaining -= toAppend;
+      }
       output->Flush();
 
       // now move the appropriate bit of the output back to the track
@@ -1532,6 +1517,10 @@ bool EffectEqualization::CalcFilter()
       outr[i]=0.;
    }
 
+   // ProcessOne() convolves with these directly
+   mFilterTaps.reinit(mM);
+   std::copy(outr.get(), outr.get() + mM, mFilterTaps.get());
+
    //Back to the frequency domain so we can use it
    RealFFT(mWindowSize, outr.get(), mFilterFuncR.get(), mFilterFuncI.get());
 
@@ -209,6 +209,7 @@ private:
    int mOptions;
    HFFT hFFT;
    Floats mFFTBuffer, mFilterFuncR, mFilterFuncI;
+   Floats mFilterTaps;
    size_t mM;
    wxString mCurveName;
    bool mLin;
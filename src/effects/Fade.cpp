@@ -112,3 +112,10 @@ size_t EffectFade::ProcessBlock(float **inBlock, float **outBlock, size_t blockL
 
    return blockLen;
 }
+
+// Effect implementation
+
+bool EffectFade::SupportsChaining()
+{
+   return true;
+}
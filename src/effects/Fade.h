@@ -36,6 +36,10 @@ public:
    bool ProcessInitialize(sampleCount totalLen, ChannelNames chanMap = NULL) override;
    size_t ProcessBlock(float **inBlock, float **outBlock, size_t blockLen) override;
 
+   // Effect implementation
+
+   bool SupportsChaining() override;
+
 private:
    // EffectFade implementation
 
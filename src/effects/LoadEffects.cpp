@@ -212,6 +212,15 @@ void BuiltinEffectsModule::DeleteInstance(ComponentInterface *instance)
    };
 }
 
+std::unique_ptr<Effect> BuiltinEffectsModule::NewInstance(
+   const ComponentInterfaceSymbol &name)
+{
+   for ( const auto &entry : Entry::Registry() )
+      if ( entry.name == name.Internal() )
+         return entry.factory();
+   return nullptr;
+}
+
 // ============================================================================
 // BuiltinEffectsModule implementation
 // ============================================================================
@@ -69,6 +69,11 @@ public:
    ComponentInterface *CreateInstance(const PluginPath & path) override;
    void DeleteInstance(ComponentInterface *instance) override;
 
+   // Make another built-in effect of the given name, as for processing
+   // tracks in parallel.  Returns null if there is none.
+   static std::unique_ptr<Effect> NewInstance(
+      const ComponentInterfaceSymbol &name);
+
 private:
    // BuiltinEffectModule implementation
 
@@ -33,6 +33,10 @@
   applied (depending on the advanced window types setting), and then
   the output signal is then pieced together using overlap/add.
 
+  The forward and inverse FFTs of a batch of windows are done on several
+  threads at once.  Only the choice of gains, which looks at the windows
+  before and after, goes one window at a time.
+
 *//****************************************************************//**
 */
 
@@ -49,6 +53,7 @@
 #include "../widgets/HelpSystem.h"
 #include "../Prefs.h"
 #include "../RealFFTf.h"
+#include "../WorkerPool.h"
 
 #include "../WaveTrack.h"
 #include "../widgets/AudacityMessageBox.h"
@@ -278,14 +283,21 @@ private:
                    int count, WaveTrack *track,
                    sampleCount start, sampleCount len);
 
+   struct Slot;
+
    void StartNewTrack();
    void ProcessSamples(Statistics &statistics,
       WaveTrack *outputTrack, size_t len, float *buffer);
-   void FillFirstHistoryWindow();
-   void ApplyFreqSmoothing(FloatVector &gains);
+   void ProcessWindows(Statistics &statistics,
+      WaveTrack *outputTrack, size_t nWindows);
+   void FlushWindows(Statistics &statistics, WaveTrack *outputTrack);
+   void FillHistoryWindow(Slot &slot, const float *samples);
+   void ApplyFreqSmoothing(FloatVector &gains, FloatVector &scratch);
    void GatherStatistics(Statistics &statistics);
    inline bool Classify(const Statistics &statistics, int band);
-   void ReduceNoise(const Statistics &statistics, WaveTrack *outputTrack);
+   void ReduceNoise(const Statistics &statistics, Slot &slot);
+   void InvertWindow(Slot &slot);
+   void OverlapAdd(const Slot &slot, WaveTrack *outputTrack);
    void RotateHistoryWindows();
    void FinishTrackStatistics(Statistics &statistics);
    void FinishTrack(Statistics &statistics, WaveTrack *outputTrack);
@@ -299,15 +311,12 @@ private:
    const size_t mWindowSize;
    // These have that size:
    HFFT     hFFT;
-   FloatVector mFFTBuffer;
-   FloatVector mInWaveBuffer;
    FloatVector mOutOverlapBuffer;
    // These have that size, or 0:
    FloatVector mInWindow;
    FloatVector mOutWindow;
 
    const size_t mSpectrumSize;
-   FloatVector mFreqSmoothingScratch;
    const size_t mFreqSmoothingBins;
    // When spectral selection limits the affected band:
    int mBinLow;  // inclusive lower bound
@@ -333,6 +342,13 @@ private:
    unsigned  mCenter;
    unsigned  mHistoryLen;
 
+   // Windows are transformed in batches of this many, in parallel; only
+   // the choice of gains must go in order
+   const size_t mBatchSize;
+   WorkerPool mPool;
+   // Holds the samples of a batch of overlapping windows
+   FloatVector mInWaveBuffer;
+
    struct Record
    {
       Record(size_t spectrumSize)
@@ -349,6 +365,26 @@ private:
       FloatVector mImagFFTs;
    };
    std::vector<std::unique_ptr<Record>> mQueue;
+
+   // For each window of a batch
+   struct Slot
+   {
+      Slot(size_t windowSize, size_t spectrumSize)
+         : mRecord(std::make_unique<Record>(spectrumSize))
+         , mFFTBuffer(windowSize)
+         , mScratch(spectrumSize)
+      {
+      }
+
+      // Before the gains are chosen, the new record, which then goes into
+      // the queue; after, the record leaving the queue, if it is output
+      std::unique_ptr<Record> mRecord;
+      FloatVector mFFTBuffer;
+      FloatVector mScratch;
+      bool mSynthesize{ false };
+      bool mAppend{ false };
+   };
+   std::vector<Slot> mSlots;
 };
 
 /****************************************************************//**
@@ -714,7 +750,8 @@ bool EffectNoiseReduction::Worker::Process
    return true;
 }
 
-void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
+void EffectNoiseReduction::Worker::ApplyFreqSmoothing
+(FloatVector &gains, FloatVector &scratch)
 {
    // Given an array of gain mutipliers, average them
    // GEOMETRICALLY.  Don't multiply and take nth root --
@@ -724,7 +761,7 @@ void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
       return;
 
    {
-      float *pScratch = &mFreqSmoothingScratch[0];
+      float *pScratch = &scratch[0];
       std::fill(pScratch, pScratch + mSpectrumSize, 0.0f);
    }
 
@@ -736,13 +773,13 @@ void EffectNoiseReduction::Worker::ApplyFreqSmoothing(FloatVector &gains)
       const int j0 = std::max(0, ii - (int)mFreqSmoothingBins);
       const int j1 = std::min(mSpectrumSize - 1, ii + mFreqSmoothingBins);
       for(int jj = j0; jj <= j1; ++jj) {
-         mFreqSmoothingScratch[ii] += gains[jj];
+         scratch[ii] += gains[jj];
       }
-      mFreqSmoothingScratch[ii] /= (j1 - j0 + 1);
+      scratch[ii] /= (j1 - j0 + 1);
    }
 
    for (size_t ii = 0; ii < mSpectrumSize; ++ii)
-      gains[ii] = exp(mFreqSmoothingScratch[ii]);
+      gains[ii] = exp(scratch[ii]);
 }
 
 EffectNoiseReduction::Worker::Worker
@@ -757,14 +794,11 @@ EffectNoiseReduction::Worker::Worker
 
 , mWindowSize(settings.WindowSize())
 , hFFT(GetFFT(mWindowSize))
-, mFFTBuffer(mWindowSize)
-, mInWaveBuffer(mWindowSize)
 , mOutOverlapBuffer(mWindowSize)
 , mInWindow()
 , mOutWindow()
 
 , mSpectrumSize(1 + mWindowSize / 2)
-, mFreqSmoothingScratch(mSpectrumSize)
 , mFreqSmoothingBins((int)(settings.mFreqSmoothingBands))
 , mBinLow(0)
 , mBinHigh(mSpectrumSize)
@@ -780,6 +814,10 @@ EffectNoiseReduction::Worker::Worker
 , mInSampleCount(0)
 , mOutStepCount(0)
 , mInWavePos(0)
+
+, mBatchSize(std::min<size_t>(64, 4 * WorkerPool::GetHardwareConcurrency()))
+, mPool(WorkerPool::GetHardwareConcurrency() - 1)
+, mInWaveBuffer(mWindowSize + (mBatchSize - 1) * mStepSize)
 {
 #ifdef EXPERIMENTAL_SPECTRAL_EDITING
    {
@@ -826,6 +864,10 @@ EffectNoiseReduction::Worker::Worker
    for (unsigned ii = 0; ii < mHistoryLen; ++ii)
       mQueue[ii] = std::make_unique<Record>(mSpectrumSize);
 
+   mSlots.reserve(mBatchSize);
+   for (size_t ii = 0; ii < mBatchSize; ++ii)
+      mSlots.emplace_back(mWindowSize, mSpectrumSize);
+
    // Create windows
 
    const double constantTerm =
@@ -914,7 +956,7 @@ void EffectNoiseReduction::Worker::StartNewTrack()
    std::fill(pFill, pFill + mWindowSize, 0.0f);
 
    pFill = &mInWaveBuffer[0];
-   std::fill(pFill, pFill + mWindowSize, 0.0f);
+   std::fill(pFill, pFill + mInWaveBuffer.size(), 0.0f);
 
    if (mDoProfile)
    {
@@ -943,40 +985,78 @@ void EffectNoiseReduction::Worker::ProcessSamples
  size_t len, float *buffer)
 {
    while (len && mOutStepCount * mStepSize < mInSampleCount) {
-      auto avail = std::min(len, mWindowSize - mInWavePos);
+      auto avail = std::min(len, mInWaveBuffer.size() - mInWavePos);
       memmove(&mInWaveBuffer[mInWavePos], buffer, avail * sizeof(float));
       buffer += avail;
       len -= avail;
       mInWavePos += avail;
 
-      if (mInWavePos == (int)mWindowSize) {
-         FillFirstHistoryWindow();
-         if (mDoProfile)
-            GatherStatistics(statistics);
-         else
-            ReduceNoise(statistics, outputTrack);
-         ++mOutStepCount;
-         RotateHistoryWindows();
-
-         // Rotate for overlap-add
-         memmove(&mInWaveBuffer[0], &mInWaveBuffer[mStepSize],
-            (mWindowSize - mStepSize) * sizeof(float));
-         mInWavePos -= mStepSize;
-      }
+      if (mInWavePos == (int)mInWaveBuffer.size())
+         ProcessWindows(statistics, outputTrack, mBatchSize);
    }
 }
 
-void EffectNoiseReduction::Worker::FillFirstHistoryWindow()
+void EffectNoiseReduction::Worker::ProcessWindows
+(Statistics &statistics, WaveTrack *outputTrack, size_t nWindows)
+{
+   // Transform all the windows at once
+   mPool.ParallelFor(nWindows, [&](size_t ii){
+      FillHistoryWindow(mSlots[ii], &mInWaveBuffer[ii * mStepSize]);
+   });
+
+   // Each choice of gains depends on the one before
+   for (size_t ii = 0; ii < nWindows; ++ii) {
+      Slot &slot = mSlots[ii];
+      // The front of the queue is free, and takes the new record
+      std::swap(mQueue[0], slot.mRecord);
+      if (mDoProfile)
+         GatherStatistics(statistics);
+      else
+         ReduceNoise(statistics, slot);
+      ++mOutStepCount;
+      RotateHistoryWindows();
+   }
+
+   if (!mDoProfile) {
+      mPool.ParallelFor(nWindows, [&](size_t ii){
+         if (mSlots[ii].mSynthesize)
+            InvertWindow(mSlots[ii]);
+      });
+      for (size_t ii = 0; ii < nWindows; ++ii)
+         if (mSlots[ii].mSynthesize)
+            OverlapAdd(mSlots[ii], outputTrack);
+   }
+
+   // Rotate for overlap-add
+   const auto used = nWindows * mStepSize;
+   memmove(&mInWaveBuffer[0], &mInWaveBuffer[used],
+      (mInWaveBuffer.size() - used) * sizeof(float));
+   mInWavePos -= used;
+}
+
+void EffectNoiseReduction::Worker::FlushWindows
+(Statistics &statistics, WaveTrack *outputTrack)
+{
+   // Do the windows that are whole, though not a whole batch
+   if (mInWavePos >= (int)mWindowSize)
+      ProcessWindows(statistics, outputTrack,
+         1 + (mInWavePos - mWindowSize) / mStepSize);
+}
+
+void EffectNoiseReduction::Worker::FillHistoryWindow
+(Slot &slot, const float *samples)
 {
+   FloatVector &fftBuffer = slot.mFFTBuffer;
+
    // Transform samples to frequency domain, windowed as needed
    if (mInWindow.size() > 0)
       for (size_t ii = 0; ii < mWindowSize; ++ii)
-         mFFTBuffer[ii] = mInWaveBuffer[ii] * mInWindow[ii];
+         fftBuffer[ii] = samples[ii] * mInWindow[ii];
    else
-      memmove(&mFFTBuffer[0], &mInWaveBuffer[0], mWindowSize * sizeof(float));
-   RealFFTf(&mFFTBuffer[0], hFFT.get());
+      memmove(&fftBuffer[0], samples, mWindowSize * sizeof(float));
+   RealFFTf(&fftBuffer[0], hFFT.get());
 
-   Record &record = *mQueue[0];
+   Record &record = *slot.mRecord;
 
    // Store real and imaginary parts for later inverse FFT, and compute
    // power
@@ -988,16 +1068,16 @@ void EffectNoiseReduction::Worker::FillFirstHistoryWindow()
       const auto last = mSpectrumSize - 1;
       for (unsigned int ii = 1; ii < last; ++ii) {
          const int kk = *pBitReversed++;
-         const float realPart = *pReal++ = mFFTBuffer[kk];
-         const float imagPart = *pImag++ = mFFTBuffer[kk + 1];
+         const float realPart = *pReal++ = fftBuffer[kk];
+         const float imagPart = *pImag++ = fftBuffer[kk + 1];
          *pPower++ = realPart * realPart + imagPart * imagPart;
       }
       // DC and Fs/2 bins need to be handled specially
-      const float dc = mFFTBuffer[0];
+      const float dc = fftBuffer[0];
       record.mRealFFTs[0] = dc;
       record.mSpectrums[0] = dc*dc;
 
-      const float nyquist = mFFTBuffer[1];
+      const float nyquist = fftBuffer[1];
       record.mImagFFTs[0] = nyquist; // For Fs/2, not really imaginary
       record.mSpectrums[last] = nyquist * nyquist;
    }
@@ -1049,8 +1129,10 @@ void EffectNoiseReduction::Worker::FinishTrack
 
    FloatVector empty(mStepSize);
 
+   FlushWindows(statistics, outputTrack);
    while (mOutStepCount * mStepSize < mInSampleCount) {
       ProcessSamples(statistics, outputTrack, mStepSize, &empty[0]);
+      FlushWindows(statistics, outputTrack);
    }
 }
 
@@ -1161,7 +1243,7 @@ bool EffectNoiseReduction::Worker::Classify(const Statistics &statistics, int ba
 }
 
 void EffectNoiseReduction::Worker::ReduceNoise
-(const Statistics &statistics, WaveTrack *outputTrack)
+(const Statistics &statistics, Slot &slot)
 {
    // Raise the gain for elements in the center of the sliding history
    // or, if isolating noise, zero out the non-noise
@@ -1231,80 +1313,96 @@ void EffectNoiseReduction::Worker::ReduceNoise
    }
 
 
-   if (mOutStepCount >= -(int)(mStepsPerWindow - 1)) {
-      Record &record = *mQueue[mHistoryLen - 1];  // end of the queue
-      const auto last = mSpectrumSize - 1;
+   slot.mSynthesize = mOutStepCount >= -(int)(mStepsPerWindow - 1);
+   slot.mAppend = mOutStepCount >= 0;
+   if (slot.mSynthesize)
+      // The end of the queue is final now.  Take it for InvertWindow(), and
+      // leave the free record to come round to the front.
+      std::swap(mQueue[mHistoryLen - 1], slot.mRecord);
+}
 
-      if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
-         // Apply frequency smoothing to output gain
-         // Gains are not less than mNoiseAttenFactor
-         ApplyFreqSmoothing(record.mGains);
+void EffectNoiseReduction::Worker::InvertWindow(Slot &slot)
+{
+   Record &record = *slot.mRecord;
+   FloatVector &fftBuffer = slot.mFFTBuffer;
+   const auto last = mSpectrumSize - 1;
 
-      // Apply gain to FFT
-      {
-         const float *pGain = &record.mGains[1];
-         const float *pReal = &record.mRealFFTs[1];
-         const float *pImag = &record.mImagFFTs[1];
-         float *pBuffer = &mFFTBuffer[2];
-         auto nn = mSpectrumSize - 2;
-         if (mNoiseReductionChoice == NRC_LEAVE_RESIDUE) {
-            for (; nn--;) {
-               // Subtract the gain we would otherwise apply from 1, and
-               // negate that to flip the phase.
-               const double gain = *pGain++ - 1.0;
-               *pBuffer++ = *pReal++ * gain;
-               *pBuffer++ = *pImag++ * gain;
-            }
-            mFFTBuffer[0] = record.mRealFFTs[0] * (record.mGains[0] - 1.0);
-            // The Fs/2 component is stored as the imaginary part of the DC component
-            mFFTBuffer[1] = record.mImagFFTs[0] * (record.mGains[last] - 1.0);
-         }
-         else {
-            for (; nn--;) {
-               const double gain = *pGain++;
-               *pBuffer++ = *pReal++ * gain;
-               *pBuffer++ = *pImag++ * gain;
-            }
-            mFFTBuffer[0] = record.mRealFFTs[0] * record.mGains[0];
-            // The Fs/2 component is stored as the imaginary part of the DC component
-            mFFTBuffer[1] = record.mImagFFTs[0] * record.mGains[last];
-         }
-      }
+   if (mNoiseReductionChoice != NRC_ISOLATE_NOISE)
+      // Apply frequency smoothing to output gain
+      // Gains are not less than mNoiseAttenFactor
+      ApplyFreqSmoothing(record.mGains, slot.mScratch);
 
-      // Invert the FFT into the output buffer
-      InverseRealFFTf(&mFFTBuffer[0], hFFT.get());
-
-      // Overlap-add
-      if (mOutWindow.size() > 0) {
-         float *pOut = &mOutOverlapBuffer[0];
-         float *pWindow = &mOutWindow[0];
-         int *pBitReversed = &hFFT->BitReversed[0];
-         for (unsigned int jj = 0; jj < last; ++jj) {
-            int kk = *pBitReversed++;
-            *pOut++ += mFFTBuffer[kk] * (*pWindow++);
-            *pOut++ += mFFTBuffer[kk + 1] * (*pWindow++);
+   // Apply gain to FFT
+   {
+      const float *pGain = &record.mGains[1];
+      const float *pReal = &record.mRealFFTs[1];
+      const float *pImag = &record.mImagFFTs[1];
+      float *pBuffer = &fftBuffer[2];
+      auto nn = mSpectrumSize - 2;
+      if (mNoiseReductionChoice == NRC_LEAVE_RESIDUE) {
+         for (; nn--;) {
+            // Subtract the gain we would otherwise apply from 1, and
+            // negate that to flip the phase.
+            const double gain = *pGain++ - 1.0;
+            *pBuffer++ = *pReal++ * gain;
+            *pBuffer++ = *pImag++ * gain;
          }
+         fftBuffer[0] = record.mRealFFTs[0] * (record.mGains[0] - 1.0);
+         // The Fs/2 component is stored as the imaginary part of the DC component
+         fftBuffer[1] = record.mImagFFTs[0] * (record.mGains[last] - 1.0);
       }
       else {
-         float *pOut = &mOutOverlapBuffer[0];
-         int *pBitReversed = &hFFT->BitReversed[0];
-         for (unsigned int jj = 0; jj < last; ++jj) {
-            int kk = *pBitReversed++;
-            *pOut++ += mFFTBuffer[kk];
-            *pOut++ += mFFTBuffer[kk + 1];
+         for (; nn--;) {
+            const double gain = *pGain++;
+            *pBuffer++ = *pReal++ * gain;
+            *pBuffer++ = *pImag++ * gain;
          }
+         fftBuffer[0] = record.mRealFFTs[0] * record.mGains[0];
+         // The Fs/2 component is stored as the imaginary part of the DC component
+         fftBuffer[1] = record.mImagFFTs[0] * record.mGains[last];
       }
+   }
 
-      float *buffer = &mOutOverlapBuffer[0];
-      if (mOutStepCount >= 0) {
-         // Output the first portion of the overlap buffer, they're done
-         outputTrack->Append((samplePtr)buffer, floatSample, mStepSize);
+   // Invert the FFT into the output buffer
+   InverseRealFFTf(&fftBuffer[0], hFFT.get());
+}
+
+void EffectNoiseReduction::Worker::OverlapAdd
+(const Slot &slot, WaveTrack *outputTrack)
+{
+   const FloatVector &fftBuffer = slot.mFFTBuffer;
+   const auto last = mSpectrumSize - 1;
+
+   // Overlap-add
+   if (mOutWindow.size() > 0) {
+      float *pOut = &mOutOverlapBuffer[0];
+      const float *pWindow = &mOutWindow[0];
+      int *pBitReversed = &hFFT->BitReversed[0];
+      for (unsigned int jj = 0; jj < last; ++jj) {
+         int kk = *pBitReversed++;
+         *pOut++ += fftBuffer[kk] * (*pWindow++);
+         *pOut++ += fftBuffer[kk + 1] * (*pWindow++);
       }
+   }
+   else {
+      float *pOut = &mOutOverlapBuffer[0];
+      int *pBitReversed = &hFFT->BitReversed[0];
+      for (unsigned int jj = 0; jj < last; ++jj) {
+         int kk = *pBitReversed++;
+         *pOut++ += fftBuffer[kk];
+         *pOut++ += fftBuffer[kk + 1];
+      }
+   }
 
-      // Shift the remainder over.
-      memmove(buffer, buffer + mStepSize, sizeof(float) * (mWindowSize - mStepSize));
-      std::fill(buffer + mWindowSize - mStepSize, buffer + mWindowSize, 0.0f);
+   float *buffer = &mOutOverlapBuffer[0];
+   if (slot.mAppend) {
+      // Output the first portion of the overlap buffer, they're done
+      outputTrack->Append((samplePtr)buffer, floatSample, mStepSize);
    }
+
+   // Shift the remainder over.
+   memmove(buffer, buffer + mStepSize, sizeof(float) * (mWindowSize - mStepSize));
+   std::fill(buffer + mWindowSize - mStepSize, buffer + mWindowSize, 0.0f);
 }
 
 bool EffectNoiseReduction::Worker::ProcessOne
@@ -1347,8 +1445,10 @@ bool EffectNoiseReduction::Worker::ProcessOne
    }
 
    if (bLoopSuccess) {
-      if (mDoProfile)
+      if (mDoProfile) {
+         FlushWindows(statistics, nullptr);
          FinishTrackStatistics(statistics);
+      }
       else
          FinishTrack(statistics, &*outputTrack);
    }
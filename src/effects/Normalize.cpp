@@ -366,13 +366,13 @@ bool EffectNormalize::TransferDataFromWindow()
 bool EffectNormalize::AnalyseTrack(const WaveTrack * track, const TranslatableString &msg,
                                    double &progress, float &offset, float &extent)
 {
-   bool result = true;
    float min, max;
 
-   if(mGain)
+   if(mGain || mDC)
    {
       // Since we need complete summary data, we need to block until the OD tasks are done for this track
-      // This is needed for track->GetMinMax
+      // This is needed for track->GetMinMax, and for track->GetMean, which
+      // needs the data of blocks still being decoded
       // TODO: should we restrict the flags to just the relevant block files (for selections)
       while (ProjectFileManager::GetODFlags( *track )) {
          // update the gui
@@ -381,99 +381,35 @@ bool EffectNormalize::AnalyseTrack(const WaveTrack * track, const TranslatableSt
             return false;
          wxMilliSleep(100);
       }
+   }
 
+   if(mGain)
+   {
       // set mMin, mMax.  No progress bar here as it's fast.
       auto pair = track->GetMinMax(mCurT0, mCurT1); // may throw
       min = pair.first, max = pair.second;
-
-      if(mDC)
-      {
-         result = AnalyseTrackData(track, msg, progress, ANALYSE_DC, offset);
-         min += offset;
-         max += offset;
-      }
    }
-   else if(mDC)
-   {
+   else
       min = -1.0, max = 1.0;   // sensible defaults?
-      result = AnalyseTrackData(track, msg, progress, ANALYSE_DC, offset);
+
+   if(mDC)
+   {
+      // The blocks keep the sums of their samples, so this reads no more
+      // than the blocks at the ends of the selection
+      offset = -track->GetMean(mCurT0, mCurT1); // may throw
       min += offset;
       max += offset;
    }
    else
-   {
-      wxFAIL_MSG("Analysing Track when nothing to do!");
-      min = -1.0, max = 1.0;   // sensible defaults?
       offset = 0.0;
-   }
-   extent = fmax(fabs(min), fabs(max));
-
-   return result;
-}
-
-//AnalyseTrackData() takes a track, transforms it to bunch of buffer-blocks,
-//and executes selected AnalyseOperation on it...
-bool EffectNormalize::AnalyseTrackData(const WaveTrack * track, const TranslatableString &msg,
-                                double &progress, AnalyseOperation op, float &offset)
-{
-   bool rc = true;
-
-   //Transform the marker timepoints to samples
-   auto start = track->TimeToLongSamples(mCurT0);
-   auto end = track->TimeToLongSamples(mCurT1);
-
-   //Get the length of the buffer (as double). len is
-   //used simply to calculate a progress meter, so it is easier
-   //to make it a double now than it is to do it later
-   auto len = (end - start).as_double();
-
-   //Initiate a processing buffer.  This buffer will (most likely)
-   //be shorter than the length of the track being processed.
-   Floats buffer{ track->GetMaxBlockSize() };
-
-   mSum   = 0.0; // dc offset inits
-   mCount = 0;
 
-   sampleCount blockSamples;
-   sampleCount totalSamples = 0;
-
-   //Go through the track one buffer at a time. s counts which
-   //sample the current buffer starts at.
-   auto s = start;
-   while (s < end) {
-      //Get a block of samples (smaller than the size of the buffer)
-      //Adjust the block size if it is the final block in the track
-      const auto block = limitSampleBufferSize(
-         track->GetBestBlockSize(s),
-         end - s
-      );
-
-      //Get the samples from the track and put them in the buffer
-      track->Get((samplePtr) buffer.get(), floatSample, s, block, fillZero, true, &blockSamples);
-      totalSamples += blockSamples;
-
-      //Process the buffer.
-      if(op == ANALYSE_DC)
-         AnalyseDataDC(buffer.get(), block);
-
-      //Increment s one blockfull of samples
-      s += block;
+   if(!mGain && !mDC)
+      wxFAIL_MSG("Analysing Track when nothing to do!");
 
-      //Update the Progress meter
-      if (TotalProgress(progress +
-                        ((s - start).as_double() / len)/double(2*GetNumWaveTracks()), msg)) {
-         rc = false; //lda .. break, not return, so that buffer is deleted
-         break;
-      }
-   }
-   if( totalSamples > 0 )
-      offset = -mSum / totalSamples.as_double();  // calculate actual offset (amount that needs to be added on)
-   else
-      offset = 0.0;
+   extent = fmax(fabs(min), fabs(max));
 
    progress += 1.0/double(2*GetNumWaveTracks());
-   //Return true because the effect processing succeeded ... unless cancelled
-   return rc;
+   return !TotalProgress(progress, msg);
 }
 
 //ProcessOne() takes a track, transforms it to bunch of buffer-blocks,
@@ -534,14 +470,6 @@ bool EffectNormalize::ProcessOne(
    return rc;
 }
 
-/// @see AnalyseDataLoudnessDC
-void EffectNormalize::AnalyseDataDC(float *buffer, size_t len)
-{
-   for(decltype(len) i = 0; i < len; i++)
-      mSum += (double)buffer[i];
-   mCount += len;
-}
-
 void EffectNormalize::ProcessData(float *buffer, size_t len, float offset)
 {
    for(decltype(len) i = 0; i < len; i++) {
@@ -58,18 +58,10 @@ public:
 private:
    // EffectNormalize implementation
 
-   enum AnalyseOperation
-   {
-      ANALYSE_DC, ANALYSE_LOUDNESS, ANALYSE_LOUDNESS_DC
-   };
-
    bool ProcessOne(
       WaveTrack * t, const TranslatableString &msg, double& progress, float offset);
    bool AnalyseTrack(const WaveTrack * track, const TranslatableString &msg,
                      double &progress, float &offset, float &extent);
-   bool AnalyseTrackData(const WaveTrack * track, const TranslatableString &msg, double &progress,
-                     AnalyseOperation op, float &offset);
-   void AnalyseDataDC(float *buffer, size_t len);
    void ProcessData(float *buffer, size_t len, float offset);
 
    void OnUpdateUI(wxCommandEvent & evt);
@@ -84,8 +76,6 @@ private:
    double mCurT0;
    double mCurT1;
    float  mMult;
-   double mSum;
-   sampleCount    mCount;
 
    wxCheckBox *mGainCheckBox;
    wxCheckBox *mDCCheckBox;
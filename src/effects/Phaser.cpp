@@ -150,6 +150,11 @@ unsigned EffectPhaser::GetAudioOutCount()
    return 1;
 }
 
+bool EffectPhaser::SupportsParallelInstances()
+{
+   return true;
+}
+
 bool EffectPhaser::ProcessInitialize(sampleCount WXUNUSED(totalLen), ChannelNames chanMap)
 {
    InstanceInit(mMaster, mSampleRate);
@@ -253,6 +258,11 @@ bool EffectPhaser::SetAutomationParameters(CommandParameters & parms)
 
 // Effect implementation
 
+bool EffectPhaser::SupportsChaining()
+{
+   return true;
+}
+
 void EffectPhaser::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
@@ -15,8 +15,13 @@
 
 #include "audacity/EffectInterface.h"
 #include "MemoryX.h"
+#include "../Prefs.h"
+#include "../WorkerPool.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstring>
 #include <wx/time.h>
 
 class RealtimeEffectState
@@ -33,6 +38,16 @@ public:
       unsigned chans, float **inbuf, float **outbuf, size_t numSamples);
    bool IsRealtimeActive();
 
+   // RealtimeEffectManager::RealtimeProcessGroups() must not call one effect
+   // on two threads at once
+   bool TryLock() { return !mBusy.test_and_set(std::memory_order_acquire); }
+   void Unlock() { mBusy.clear(std::memory_order_release); }
+
+   // Time spent in RealtimeProcess() since the last call, for each callback
+   void EndCallback();
+   double GetSeconds() const;
+   double TakePeakSeconds();
+
 private:
    EffectClientInterface &mEffect;
 
@@ -40,6 +55,26 @@ private:
    int mCurrentProcessor;
 
    std::atomic<int> mRealtimeSuspendCount{ 1 };    // Effects are initially suspended
+
+   std::atomic_flag mBusy = ATOMIC_FLAG_INIT;
+
+   using Nanoseconds = std::chrono::nanoseconds::rep;
+   std::atomic<Nanoseconds> mCallbackTime{ 0 };
+   std::atomic<Nanoseconds> mLastTime{ 0 };
+   std::atomic<Nanoseconds> mPeakTime{ 0 };
+};
+
+// The progress of one group through the effects, in
+// RealtimeProcessGroups().  Only the thread that has claimed it touches the
+// rest.  Between batches the audio thread holds every group.
+struct RealtimeEffectManager::GroupProgress
+{
+   std::atomic<bool> claimed{ true };
+   bool done{ false };
+   size_t next{ 0 };
+   size_t called{ 0 };
+   std::vector<float *> ibuf;
+   std::vector<float *> obuf;
 };
 
 RealtimeEffectManager & RealtimeEffectManager::Get()
@@ -59,6 +94,16 @@ RealtimeEffectManager::RealtimeEffectManager()
 
 RealtimeEffectManager::~RealtimeEffectManager()
 {
+   StopWorkers();
+}
+
+size_t RealtimeEffectManager::GetRealtimeThreads()
+{
+   const auto nThreads =
+      gPrefs->Read(wxT("/Effects/RealtimeThreads"), 1L);
+   if (nThreads <= 0)
+      return WorkerPool::GetHardwareConcurrency();
+   return nThreads;
 }
 
 #if defined(EXPERIMENTAL_EFFECTS_RACK)
@@ -172,6 +217,13 @@ void RealtimeEffectManager::RealtimeInitialize(double rate)
    // (Re)Set processor parameters
    mRealtimeChans.clear();
    mRealtimeRates.clear();
+   WaitForWorkers();
+   mProgress.clear();
+   mRealtimeRate = rate;
+   mBudget = 0;
+
+   // The audio thread is one of the threads for RealtimeProcessGroups()
+   StartWorkers(GetRealtimeThreads() - 1);
 
    // RealtimeAdd/RemoveEffect() needs to know when we're active so it can
    // initialize newly added effects
@@ -194,6 +246,14 @@ void RealtimeEffectManager::RealtimeAddProcessor(int group, unsigned chans, floa
 
    mRealtimeChans.push_back(chans);
    mRealtimeRates.push_back(rate);
+
+   // Room for RealtimeProcessGroups() to pass the buffers of this group
+   // from effect to effect
+   auto progress = std::make_unique<GroupProgress>();
+   progress->ibuf.resize(std::max(2u, chans));
+   progress->obuf.resize(std::max(2u, chans));
+   WaitForWorkers();
+   mProgress.push_back(std::move(progress));
 }
 
 void RealtimeEffectManager::RealtimeFinalize()
@@ -211,6 +271,8 @@ void RealtimeEffectManager::RealtimeFinalize()
    // Reset processor parameters
    mRealtimeChans.clear();
    mRealtimeRates.clear();
+   StopWorkers();
+   mProgress.clear();
 
    // No longer active
    mRealtimeActive = false;
@@ -266,6 +328,8 @@ void RealtimeEffectManager::RealtimeProcessStart()
    // Protect ourselves from the main thread
    mRealtimeLock.Enter();
 
+   mBatchSamples = 0;
+
    // Can be suspended because of the audio stream being paused or because effects
    // have been suspended.
    if (!mRealtimeSuspended)
@@ -296,6 +360,8 @@ size_t RealtimeEffectManager::RealtimeProcess(int group, unsigned chans, float *
       return numSamples;
    }
 
+   mBatchSamples = std::max(mBatchSamples, numSamples);
+
    // Remember when we started so we can calculate the amount of latency we
    // are introducing
    wxMilliClock_t start = wxGetUTCTimeMillis();
@@ -355,6 +421,238 @@ size_t RealtimeEffectManager::RealtimeProcess(int group, unsigned chans, float *
    return numSamples;
 }
 
+//
+// This will be called in a different thread than the main GUI thread.
+//
+void RealtimeEffectManager::RealtimeProcessGroups(Group *groups, size_t nGroups)
+{
+   // Protect ourselves from the main thread
+   mRealtimeLock.Enter();
+
+   // Can be suspended because of the audio stream being paused or because effects
+   // have been suspended, so allow the samples to pass as-is.
+   if (mRealtimeSuspended || mStates.empty())
+   {
+      mRealtimeLock.Leave();
+      return;
+   }
+
+   // Without workers, or for groups not known to RealtimeAddProcessor(),
+   // process the groups in turn
+   bool parallel =
+      !mWorkers.empty() && nGroups > 1 && nGroups <= mProgress.size();
+   for (size_t ii = 0; parallel && ii < nGroups; ++ii)
+      parallel = groups[ii].chans <= mProgress[ii]->ibuf.size();
+   if (!parallel)
+   {
+      mRealtimeLock.Leave();
+      for (size_t ii = 0; ii < nGroups; ++ii)
+      {
+         const auto &group = groups[ii];
+         RealtimeProcess(
+            group.group, group.chans, group.buffers, group.numSamples);
+      }
+      return;
+   }
+
+   wxMilliClock_t start = wxGetUTCTimeMillis();
+   const auto startTime = std::chrono::steady_clock::now();
+
+   // Each group starts at the first effect, with its own buffers as input
+   size_t numSamples = 0;
+   for (size_t ii = 0; ii < nGroups; ++ii)
+   {
+      const auto &group = groups[ii];
+      auto &progress = *mProgress[ii];
+      progress.done = false;
+      progress.next = 0;
+      progress.called = 0;
+      for (unsigned c = 0; c < group.chans; c++)
+      {
+         progress.ibuf[c] = group.buffers[c];
+         progress.obuf[c] = group.scratch[c];
+      }
+      numSamples = std::max(numSamples, group.numSamples);
+   }
+   mBatchSamples = std::max(mBatchSamples, numSamples);
+   mBatchGroups = groups;
+   mnBatchGroups = nGroups;
+   mGroupsDone = 0;
+
+   // Wake the workers, without taking their mutex.  A worker that misses
+   // the notification only leaves more of the work to this thread.
+   const auto batch = ++mBatch;
+   mBatchOpen = true;
+   for (size_t ii = 0; ii < nGroups; ++ii)
+      mProgress[ii]->claimed.store(false, std::memory_order_release);
+   mWorkerCondition.notify_all();
+
+   // The workers run at ordinary priority, so this thread shares the work
+   // with them only for part of the duration of the buffers, and then does
+   // the rest alone
+   auto deadline = std::chrono::steady_clock::time_point::max();
+   if (mRealtimeRate > 0)
+      deadline = startTime +
+         std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(
+               WorkerShare * numSamples / mRealtimeRate));
+   ProcessJobs(batch, deadline);
+
+   // Take back every group, so that workers start no more jobs.  This waits
+   // only for jobs that workers are in the middle of, not for workers that
+   // have yet to look at the batch.
+   mBatchOpen = false;
+   for (size_t ii = 0; ii < nGroups; ++ii)
+   {
+      while (mProgress[ii]->claimed.exchange(true, std::memory_order_acquire))
+         std::this_thread::yield();
+   }
+   for (size_t ii = 0; ii < nGroups; ++ii)
+   {
+      auto &progress = *mProgress[ii];
+      while (!progress.done)
+         ProcessJob(progress, groups[ii]);
+   }
+
+   // Remember the latency
+   mRealtimeLatency = (int) (wxGetUTCTimeMillis() - start).GetValue();
+
+   mRealtimeLock.Leave();
+}
+
+// Runs jobs of the batch until every group has been through all the
+// effects, or the batch is closed, or the deadline has passed
+void RealtimeEffectManager::ProcessJobs(
+   unsigned batch, std::chrono::steady_clock::time_point deadline)
+{
+   // A late worker may read the count of a later batch, but then it can
+   // claim no group below
+   const auto nGroups = mnBatchGroups.load();
+   while (mGroupsDone < nGroups && mBatchOpen && mBatch == batch)
+   {
+      bool progressed = false;
+      for (size_t ii = 0; ii < nGroups; ++ii)
+      {
+         auto &progress = *mProgress[ii];
+         if (progress.claimed.exchange(true, std::memory_order_acquire))
+            continue;
+         // The audio thread holds the groups between batches, so a group
+         // claimed while the batch is open belongs to it
+         if (mBatchOpen && mBatch == batch && ii < mnBatchGroups &&
+             !progress.done)
+            progressed = ProcessJob(progress, mBatchGroups[ii]) || progressed;
+         progress.claimed.store(false, std::memory_order_release);
+      }
+
+      if (std::chrono::steady_clock::now() >= deadline)
+         break;
+
+      // Every group left waits for an effect busy with another group
+      if (!progressed)
+         std::this_thread::yield();
+   }
+}
+
+// Applies the next active effect to the claimed group, unless another
+// thread is using that effect.  Returns whether anything was done.
+bool RealtimeEffectManager::ProcessJob(
+   GroupProgress &progress, const Group &group)
+{
+   const auto nStates = mStates.size();
+   while (progress.next < nStates &&
+          !mStates[progress.next]->IsRealtimeActive())
+      progress.next++;
+
+   if (progress.next < nStates)
+   {
+      auto &state = *mStates[progress.next];
+      if (!state.TryLock())
+         return false;
+      state.RealtimeProcess(group.group, group.chans,
+         progress.ibuf.data(), progress.obuf.data(), group.numSamples);
+      state.Unlock();
+
+      // Feed the output to the next effect
+      std::swap(progress.ibuf, progress.obuf);
+      progress.called++;
+      progress.next++;
+   }
+
+   if (progress.next == nStates)
+   {
+      // As in RealtimeProcess(), an odd number of effects leaves the result
+      // in the scratch buffers
+      if (progress.called & 1)
+      {
+         for (unsigned int i = 0; i < group.chans; i++)
+         {
+            memcpy(group.buffers[i], progress.ibuf[i],
+               group.numSamples * sizeof(float));
+         }
+      }
+      progress.done = true;
+      mGroupsDone++;
+   }
+
+   return true;
+}
+
+void RealtimeEffectManager::StartWorkers(size_t nWorkers)
+{
+   if (mWorkers.size() == nWorkers)
+      return;
+
+   StopWorkers();
+   mStopWorkers = false;
+   for (size_t ii = 0; ii < nWorkers; ++ii)
+      mWorkers.emplace_back([this]{ WorkerLoop(); });
+}
+
+void RealtimeEffectManager::StopWorkers()
+{
+   {
+      std::lock_guard<std::mutex> lock{ mWorkerMutex };
+      mStopWorkers = true;
+   }
+   mWorkerCondition.notify_all();
+   for (auto &thread : mWorkers)
+      thread.join();
+   mWorkers.clear();
+}
+
+void RealtimeEffectManager::WaitForWorkers()
+{
+   while (mBusyWorkers > 0)
+      std::this_thread::yield();
+}
+
+void RealtimeEffectManager::WorkerLoop()
+{
+   auto seen = mBatch.load();
+   while (!mStopWorkers)
+   {
+      {
+         // Wake now and then, in case a notification was missed
+         std::unique_lock<std::mutex> lock{ mWorkerMutex };
+         mWorkerCondition.wait_for(lock, std::chrono::milliseconds(10),
+            [&]{ return mStopWorkers || mBatch != seen; });
+      }
+
+      const auto batch = mBatch.load();
+      if (batch == seen)
+         continue;
+      seen = batch;
+
+      // Join the batch only if RealtimeProcessGroups() has not yet finished
+      // it.  That does not wait for this thread, but the main thread does,
+      // before it changes mProgress.
+      mBusyWorkers++;
+      if (mBatchOpen && mBatch == seen)
+         ProcessJobs(seen, std::chrono::steady_clock::time_point::max());
+      mBusyWorkers--;
+   }
+}
+
 //
 // This will be called in a different thread than the main GUI thread.
 //
@@ -374,6 +672,13 @@ void RealtimeEffectManager::RealtimeProcessEnd()
       }
    }
 
+   // Times are per callback, and all effects together must take less than
+   // the duration of the buffer
+   for (auto &state : mStates)
+      state->EndCallback();
+   if (mRealtimeRate > 0)
+      mBudget = mBatchSamples / mRealtimeRate;
+
    mRealtimeLock.Leave();
 }
 
@@ -382,6 +687,24 @@ int RealtimeEffectManager::GetRealtimeLatency()
    return mRealtimeLatency;
 }
 
+RealtimeEffectManager::EffectLoads RealtimeEffectManager::GetRealtimeLoads()
+{
+   EffectLoads loads;
+
+   mRealtimeLock.Enter();
+   for (auto &state : mStates)
+      loads.push_back({ &state->GetEffect(),
+         state->GetSeconds(), state->TakePeakSeconds() });
+   mRealtimeLock.Leave();
+
+   return loads;
+}
+
+double RealtimeEffectManager::GetRealtimeBudget()
+{
+   return mBudget;
+}
+
 RealtimeEffectState::RealtimeEffectState( EffectClientInterface &effect )
    : mEffect{ effect }
 {
@@ -506,6 +829,12 @@ size_t RealtimeEffectState::RealtimeProcess(int group,
 
    int processor = mGroupProcessor[group];
 
+   const auto start = std::chrono::steady_clock::now();
+   auto addTime = finally( [&] {
+      mCallbackTime += std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - start).count();
+   } );
+
    // Call the client until we run out of input or output channels
    while (ichans > 0 && ochans > 0)
    {
@@ -599,3 +928,21 @@ bool RealtimeEffectState::IsRealtimeActive()
 {
    return mRealtimeSuspendCount == 0;
 }
+
+void RealtimeEffectState::EndCallback()
+{
+   const auto time = mCallbackTime.exchange(0);
+   mLastTime = time;
+   if (time > mPeakTime)
+      mPeakTime = time;
+}
+
+double RealtimeEffectState::GetSeconds() const
+{
+   return mLastTime * 1e-9;
+}
+
+double RealtimeEffectState::TakePeakSeconds()
+{
+   return mPeakTime.exchange(0) * 1e-9;
+}
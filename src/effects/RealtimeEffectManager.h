@@ -11,7 +11,12 @@
 #ifndef __AUDACITY_REALTIME_EFFECT_MANAGER__
 #define __AUDACITY_REALTIME_EFFECT_MANAGER__
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <wx/thread.h>
 
@@ -23,6 +28,26 @@ class AUDACITY_DLL_API RealtimeEffectManager final
 public:
    using EffectArray = std::vector <EffectClientInterface*> ;
 
+   // The buffers of one group, for RealtimeProcessGroups().  scratch has as
+   // many buffers of numSamples as buffers, for effects to write into.
+   struct Group {
+      int group;
+      unsigned chans;
+      float **buffers;
+      float **scratch;
+      size_t numSamples;
+   };
+
+   // Time spent in one effect in the last audio callback, summed over the
+   // groups, and the most spent in any callback since the last call of
+   // GetRealtimeLoads()
+   struct EffectLoad {
+      EffectClientInterface *effect;
+      double seconds;
+      double peakSeconds;
+   };
+   using EffectLoads = std::vector< EffectLoad >;
+
    /** Get the singleton instance of the RealtimeEffectManager. **/
    static RealtimeEffectManager & Get();
 
@@ -39,13 +64,39 @@ public:
    void RealtimeResume();
    void RealtimeProcessStart();
    size_t RealtimeProcess(int group, unsigned chans, float **buffers, size_t numSamples);
+   // Does what RealtimeProcess() does for each group, on the calling thread
+   // and on the threads started by RealtimeInitialize(), so that different
+   // effects may process different groups at once.  One effect never
+   // processes two groups at once.
+   void RealtimeProcessGroups(Group *groups, size_t nGroups);
    void RealtimeProcessEnd();
    int GetRealtimeLatency();
 
+   // For the main thread:  how long each effect took, and the duration of
+   // the last buffer, which is the time all of them may take together
+   EffectLoads GetRealtimeLoads();
+   double GetRealtimeBudget();
+
+   // Number of threads, counting the audio thread, for
+   // RealtimeProcessGroups().  Reads the preference /Effects/RealtimeThreads,
+   // in which zero means one thread per processor.
+   static size_t GetRealtimeThreads();
+
 private:
+   struct GroupProgress;
+
    RealtimeEffectManager();
    ~RealtimeEffectManager();
 
+   void StartWorkers(size_t nWorkers);
+   void StopWorkers();
+   void WorkerLoop();
+   // For the main thread, before it changes mProgress
+   void WaitForWorkers();
+   void ProcessJobs(
+      unsigned batch, std::chrono::steady_clock::time_point deadline);
+   bool ProcessJob(GroupProgress &progress, const Group &group);
+
    wxCriticalSection mRealtimeLock;
    std::vector< std::unique_ptr<RealtimeEffectState> > mStates;
    int mRealtimeLatency;
@@ -53,6 +104,31 @@ private:
    bool mRealtimeActive;
    std::vector<unsigned> mRealtimeChans;
    std::vector<double> mRealtimeRates;
+   double mRealtimeRate{ 0 };
+
+   // Longest buffer processed since RealtimeProcessStart(), and the
+   // duration of that of the last callback
+   size_t mBatchSamples{ 0 };
+   std::atomic<double> mBudget{ 0 };
+
+   // The job graph of RealtimeProcessGroups():  for each group, the next
+   // effect to apply, allocated as processors are added
+   std::vector< std::unique_ptr<GroupProgress> > mProgress;
+   Group *mBatchGroups{ nullptr };
+   std::atomic<size_t> mnBatchGroups{ 0 };
+   std::atomic<size_t> mGroupsDone{ 0 };
+
+   // Workers sleep until mBatch changes while mBatchOpen.  They may work
+   // on a batch for this fraction of the duration of its buffers, after
+   // which RealtimeProcessGroups() finishes it alone.
+   static constexpr double WorkerShare = 0.5;
+   std::vector< std::thread > mWorkers;
+   std::mutex mWorkerMutex;
+   std::condition_variable mWorkerCondition;
+   std::atomic<unsigned> mBatch{ 0 };
+   std::atomic<bool> mBatchOpen{ false };
+   std::atomic<size_t> mBusyWorkers{ 0 };
+   std::atomic<bool> mStopWorkers{ false };
 };
 
 #endif
@@ -173,6 +173,11 @@ unsigned EffectReverb::GetAudioOutCount()
    return mParams.mStereoWidth ? 2 : 1;
 }
 
+bool EffectReverb::SupportsParallelInstances()
+{
+   return true;
+}
+
 static size_t BLOCK = 16384;
 
 bool EffectReverb::ProcessInitialize(sampleCount WXUNUSED(totalLen), ChannelNames chanMap)
@@ -366,6 +371,11 @@ bool EffectReverb::LoadFactoryPreset(int id)
 
 // Effect implementation
 
+bool EffectReverb::SupportsChaining()
+{
+   return true;
+}
+
 bool EffectReverb::Startup()
 {
    wxString base = wxT("/Effects/Reverb/");
@@ -57,6 +57,7 @@ public:
 
    unsigned GetAudioInCount() override;
    unsigned GetAudioOutCount() override;
+   bool SupportsParallelInstances() override;
    bool ProcessInitialize(sampleCount totalLen, ChannelNames chanMap = NULL) override;
    bool ProcessFinalize() override;
    size_t ProcessBlock(float **inBlock, float **outBlock, size_t blockLen) override;
@@ -68,6 +69,7 @@ public:
 
    // Effect implementation
 
+   bool SupportsChaining() override;
    bool Startup() override;
    void PopulateOrExchange(ShuttleGui & S) override;
    bool TransferDataToWindow() override;
@@ -282,6 +282,11 @@ bool EffectScienFilter::SetAutomationParameters(CommandParameters & parms)
 
 // Effect implementation
 
+bool EffectScienFilter::SupportsChaining()
+{
+   return true;
+}
+
 bool EffectScienFilter::Startup()
 {
    wxString base = wxT("/SciFilter/");
@@ -59,6 +59,7 @@ public:
 
    // Effect implementation
 
+   bool SupportsChaining() override;
    bool Startup() override;
    bool Init() override;
    void PopulateOrExchange(ShuttleGui & S) override;
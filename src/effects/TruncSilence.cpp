@@ -30,9 +30,12 @@
 
 #include "../Prefs.h"
 #include "../Project.h"
+#include "../ProjectFileManager.h"
 #include "../ProjectSettings.h"
+#include "../Sequence.h"
 #include "../Shuttle.h"
 #include "../ShuttleGui.h"
+#include "../WaveClip.h"
 #include "../WaveTrack.h"
 #include "../widgets/valnum.h"
 #include "../widgets/AudacityMessageBox.h"
@@ -435,48 +438,139 @@ bool EffectTruncSilence::FindSilences
    // Start with the whole selection silent
    silences.push_back(Region(mT0, mT1));
 
-   // Remove non-silent regions in each track
-   int whichTrack = 0;
+   std::vector<const WaveTrack *> tracks;
    for (auto wt :
            list->Selected< const WaveTrack >()
                .StartingWith( firstTrack ).EndingAfter( lastTrack ) )
+      tracks.push_back(wt);
+   const auto nTracks = tracks.size();
+   if (nTracks == 0)
+      return true;
+
+   // Summaries of blocks still being computed can't be trusted
+   std::vector<char> useSummaries(nTracks);
+   for (size_t ii = 0; ii < nTracks; ++ii)
+      useSummaries[ii] = (ProjectFileManager::GetODFlags(*tracks[ii]) == 0);
+
+   //
+   // Scan the tracks for silences, all at once
+   //
+   std::vector<RegionList> trackSilences(nTracks);
+   std::vector<std::atomic<double>> fractions(nTracks);
+   std::vector<char> results(nTracks, 0);
+   std::atomic<bool> cancelled{ false };
+   const bool finished = RunWithProgress(nTracks,
+      [&](size_t ii) {
+         results[ii] = DetectSilences(tracks[ii], useSummaries[ii] != 0,
+            trackSilences[ii], fractions[ii], cancelled);
+      },
+      [&] {
+         double total = 0;
+         for (const auto &fraction : fractions)
+            total += fraction;
+         return detectFrac * total / (double)GetNumWaveTracks();
+      },
+      cancelled);
+
+   if (!finished ||
+       !std::all_of(results.begin(), results.end(),
+          [](char result){ return result != 0; }))
    {
-      // Smallest silent region to detect in frames
-      auto minSilenceFrames =
-         sampleCount(std::max(mInitialAllowedSilence, DEF_MinTruncMs) * wt->GetRate());
+      ReplaceProcessedTracks(false);
+      return false;
+   }
 
-      //
-      // Scan the track for silences
-      //
-      RegionList trackSilences;
+   // Intersect with the overall silent region list.  Regions that became
+   // too short are ignored by DoRemoval().
+   for (const auto &regions : trackSilences)
+      Intersect(silences, regions);
 
-      auto index = wt->TimeToLongSamples(mT0);
-      sampleCount silentFrame = 0;
+   return true;
+}
 
-      // Detect silences
-      bool cancelled = !(Analyze(silences, trackSilences, wt, &silentFrame, &index, whichTrack));
+bool EffectTruncSilence::DetectSilences(const WaveTrack *wt,
+                                        bool useSummaries,
+                                        RegionList &trackSilences,
+                                        std::atomic<double> &fraction,
+                                        const std::atomic<bool> &cancelled)
+   const
+{
+   // Smallest silent region to detect in frames
+   auto minSilenceFrames =
+      sampleCount(std::max(mInitialAllowedSilence, DEF_MinTruncMs) * wt->GetRate());
+
+   const double truncDbSilenceThreshold = DB_TO_LINEAR( mThresholdDB );
+   const auto start = wt->TimeToLongSamples(mT0);
+   const auto end = wt->TimeToLongSamples(mT1);
+
+   // Is every sample of the range quieter than the threshold, by the
+   // summaries of the blocks?  Gaps between clips are silent.
+   auto isSilent = [&](sampleCount s0, size_t len) {
+      const auto s1 = s0 + len;
+      for (const auto &clip : wt->GetClips()) {
+         const auto clipStart = clip->GetStartSample();
+         const auto clipEnd = clip->GetEndSample();
+         if (clipEnd <= s0 || clipStart >= s1)
+            continue;
+         const auto from = std::max(s0, clipStart);
+         const auto to = std::min(s1, clipEnd);
+         auto results = clip->GetSequence()->GetMinMax(
+            from - clipStart, to - from, true);
+         if (std::max(-results.first, results.second) >=
+             truncDbSilenceThreshold)
+            return false;
+      }
+      return true;
+   };
 
-      // Buffer has been freed, so we're OK to return if cancelled
+   Floats buffer{ wt->GetMaxBlockSize() };
+   sampleCount silentFrame = 0; // length of the current silence
+
+   auto index = start;
+   while (index < end) {
       if (cancelled)
-      {
-         ReplaceProcessedTracks(false);
          return false;
+      fraction = (index - start).as_double() / (end - start).as_double();
+
+      // Take one storage block at a time, so that its summary serves
+      const auto count =
+         limitSampleBufferSize( wt->GetBestBlockSize(index), end - index );
+
+      if (useSummaries && isSilent(index, count)) {
+         silentFrame += count;
+         index += count;
+         continue;
       }
 
-      if (silentFrame >= minSilenceFrames)
-      {
-         // Track ended in silence -- record region
-         trackSilences.push_back(Region(
-            wt->LongSamplesToTime(index - silentFrame),
-            wt->LongSamplesToTime(index)
-         ));
+      // Loud or mixed; only the samples tell where silences begin and end
+      wt->Get((samplePtr)(buffer.get()), floatSample, index, count);
+      for (size_t i = 0; i < count; ++i) {
+         if (fabs(buffer[i]) < truncDbSilenceThreshold)
+            ++silentFrame;
+         else {
+            if (silentFrame >= minSilenceFrames) {
+               // Record the silent region
+               trackSilences.push_back(Region(
+                  wt->LongSamplesToTime(index + i - silentFrame),
+                  wt->LongSamplesToTime(index + i)
+               ));
+            }
+            silentFrame = 0;
+         }
       }
+      index += count;
+   }
 
-      // Intersect with the overall silent region list
-      Intersect(silences, trackSilences);
-      whichTrack++;
+   if (silentFrame >= minSilenceFrames)
+   {
+      // Track ended in silence -- record region
+      trackSilences.push_back(Region(
+         wt->LongSamplesToTime(index - silentFrame),
+         wt->LongSamplesToTime(index)
+      ));
    }
 
+   fraction = 1.0;
    return true;
 }
 
@@ -19,6 +19,8 @@
 
 #include "Effect.h"
 
+#include <atomic>
+
 class ShuttleGui;
 class wxChoice;
 class wxTextCtrl;
@@ -91,6 +93,14 @@ private:
       (const RegionList &silences, unsigned iGroup, unsigned nGroups, Track *firstTrack, Track *lastTrack,
        double &totalCutLen);
 
+   // Find the silences of one track in the whole selection, whatever the
+   // other tracks hold, so that several tracks can be scanned at once.
+   // Blocks that are silent by their summaries are not read.
+   bool DetectSilences(const WaveTrack *wt, bool useSummaries,
+                       RegionList &trackSilences,
+                       std::atomic<double> &fraction,
+                       const std::atomic<bool> &cancelled) const;
+
 private:
 
    double mThresholdDB {} ;
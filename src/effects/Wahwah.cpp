@@ -141,6 +141,11 @@ unsigned EffectWahwah::GetAudioOutCount()
    return 1;
 }
 
+bool EffectWahwah::SupportsParallelInstances()
+{
+   return true;
+}
+
 bool EffectWahwah::ProcessInitialize(sampleCount WXUNUSED(totalLen), ChannelNames chanMap)
 {
    InstanceInit(mMaster, mSampleRate);
@@ -237,6 +242,11 @@ bool EffectWahwah::SetAutomationParameters(CommandParameters & parms)
 
 // Effect implementation
 
+bool EffectWahwah::SupportsChaining()
+{
+   return true;
+}
+
 void EffectWahwah::PopulateOrExchange(ShuttleGui & S)
 {
    S.SetBorder(5);
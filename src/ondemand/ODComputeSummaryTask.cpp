@@ -19,20 +19,32 @@ updating the ODPCMAliasBlockFile and the GUI of the newly available data.
 
 
 #include "ODComputeSummaryTask.h"
+#include "ODManager.h"
 #include "../blockfile/ODPCMAliasBlockFile.h"
 #include "../Sequence.h"
 #include "../WaveClip.h"
 #include "../WaveTrack.h"
+#include "../WorkerPool.h"
 #include <wx/wx.h>
 
+#include <algorithm>
+#include <chrono>
+
 //36 blockfiles > 3 minutes stereo 44.1kHz per ODTask::DoSome
 #define nBlockFilesPerDoSome 36
 
+//blockfiles per thread per DoSomeInternal.  Small, so that an ODRequest
+//(DemandTrackUpdate) soon takes effect.
+#define nBlockFilesPerRange 4
+
 ///Creates a NEW task that computes summaries for a wavetrack that needs to be specified through SetWaveTrack()
 ODComputeSummaryTask::ODComputeSummaryTask()
 {
    mMaxBlockFiles = 0;
    mHasUpdateRan=false;
+   mSummarizedSamples = 0;
+   mSummarizingSeconds = 0;
+   mRate = 0;
 }
 
 std::unique_ptr<ODTask> ODComputeSummaryTask::Clone() const
@@ -54,7 +66,9 @@ void ODComputeSummaryTask::Terminate()
    mBlockFilesMutex.Unlock();
 }
 
-///Computes and writes the data for one BlockFile if it still has a refcount.
+///Computes and writes the data for the BlockFiles at the front of the queue that still
+///have a refcount.  The queue is split into ranges of neighboring blocks that are
+///summarized in parallel on the worker pool of the ODManager.
 void ODComputeSummaryTask::DoSomeInternal()
 {
    if(mBlockFiles.size()<=0)
@@ -65,71 +79,116 @@ void ODComputeSummaryTask::DoSomeInternal()
       return;
    }
 
-   mBlockFilesMutex.Lock();
-   for(size_t j=0; j < mWaveTracks.size() && mBlockFiles.size();j++)
-   {
-      bool success = false;
-      const auto bf = mBlockFiles[0].lock();
+   auto &pool = ODManager::Instance()->GetWorkerPool();
 
-      sampleCount blockStartSample = 0;
-      sampleCount blockEndSample = 0;
+   //The front of the queue is nearest the demand sample, so take only as much as
+   //keeps every thread busy once.
+   std::vector< std::weak_ptr< ODPCMAliasBlockFile > > taken;
+   std::vector< std::shared_ptr< ODPCMAliasBlockFile > > batch;
+   mBlockFilesMutex.Lock();
+   const auto nBatch = std::min(mBlockFiles.size(),
+      (pool.GetWorkerCount() + 1) * nBlockFilesPerRange);
+   for(size_t i = 0; i < nBatch; i++) {
+      taken.push_back(mBlockFiles[i]);
+      batch.push_back(mBlockFiles[i].lock());
+   }
+   //This is a bit of a convenience in case someone tries to terminate the task by closing the trackpanel or window.
+   //ODComputeSummaryTask::Terminate() uses this lock to remove everything, and we don't want it to wait since the UI is being blocked.
+   mBlockFilesMutex.Unlock();
 
-      if(bf)
+   // Not std::vector<bool>, which the threads could not write independently
+   std::vector<char> succeeded(nBatch);
+   const auto nRanges = (nBatch + nBlockFilesPerRange - 1) / nBlockFilesPerRange;
+   const auto startTime = std::chrono::steady_clock::now();
+   pool.ParallelFor(nRanges, [&](size_t range){
+      const auto end = std::min(nBatch, (range + 1) * nBlockFilesPerRange);
+      for(auto i = range * nBlockFilesPerRange; i < end; i++)
       {
-         // WriteSummary might throw, but this is a worker thread, so stop
-         // the exceptions here!
-         success = GuardedCall<bool>( [&] {
-            bf->DoWriteSummary();
-            return true;
-         } );
-         blockStartSample = bf->GetStart();
-         blockEndSample = blockStartSample + bf->GetLength();
+         const auto &bf = batch[i];
+         if(!bf)
+            // The block file disappeared.
+            succeeded[i] = true;
+         else
+            // WriteSummary might throw, but this is a worker thread, so stop
+            // the exceptions here!
+            succeeded[i] = GuardedCall<bool>( [&] {
+               bf->DoWriteSummary();
+               return true;
+            } );
       }
-      else
+   });
+   const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - startTime;
+
+   mBlockFilesMutex.Lock();
+   //take the finished ones out of the array - we are done with them.
+   //The others stay where they are; the task does not make progress on them.
+   //Terminate(), Update() or OrderBlockFiles() may have emptied or reordered
+   //the queue meanwhile, so find the blocks by identity, not position.
+   mBlockFiles.erase(
+      std::remove_if(mBlockFiles.begin(), mBlockFiles.end(),
+         [&](const std::weak_ptr< ODPCMAliasBlockFile > &wp){
+            //Compare owners, which works also for blocks that disappeared
+            for(size_t i = 0; i < nBatch; i++)
+               if(succeeded[i] &&
+                  !wp.owner_before(taken[i]) && !taken[i].owner_before(wp))
+                  return true;
+            return false;
+         }),
+      mBlockFiles.end());
+   mBlockFilesMutex.Unlock();
+
+   double samples = 0;
+   mWaveTrackMutex.Lock();
+   for(size_t i = 0; i < nBatch; i++)
+   {
+      const auto &bf = batch[i];
+      if(!bf)
       {
-         success = true;
-         // The block file disappeared.
          //the waveform in the wavetrack now is shorter, so we need to update mMaxBlockFiles
          //because now there is less work to do.
          mMaxBlockFiles--;
+         continue;
       }
+      if(!succeeded[i])
+         continue;
 
-      if (success)
-      {
-         //take it out of the array - we are done with it.
-         mBlockFiles.erase(mBlockFiles.begin());
-      }
-      else
-         // The task does not make progress
-         ;
-
-      //This is a bit of a convenience in case someone tries to terminate the task by closing the trackpanel or window.
-      //ODComputeSummaryTask::Terminate() uses this lock to remove everything, and we don't want it to wait since the UI is being blocked.
-      mBlockFilesMutex.Unlock();
-      wxThread::This()->Yield();
-      mBlockFilesMutex.Lock();
+      samples += bf->GetLength();
 
       //update the gui for all associated blocks.  It doesn't matter that we're hitting more wavetracks then we should
-      //because this loop runs a number of times equal to the number of tracks, they probably are getting processed in
-      //the next iteration at the same sample window.
-      if (success && bf) {
-         mWaveTrackMutex.Lock();
-         for(size_t i=0;i<mWaveTracks.size();i++)
-         {
-            auto waveTrack = mWaveTracks[i].lock();
-            if(success && waveTrack)
-               waveTrack->AddInvalidRegion(blockStartSample,blockEndSample);
-         }
-         mWaveTrackMutex.Unlock();
+      //because they probably are getting processed at the same sample window.
+      const auto blockStartSample = bf->GetStart();
+      const auto blockEndSample = blockStartSample + bf->GetLength();
+      for(size_t j=0;j<mWaveTracks.size();j++)
+      {
+         auto waveTrack = mWaveTracks[j].lock();
+         if(waveTrack)
+            waveTrack->AddInvalidRegion(blockStartSample,blockEndSample);
       }
    }
+   mWaveTrackMutex.Unlock();
 
-   mBlockFilesMutex.Unlock();
+   mThroughputMutex.Lock();
+   mSummarizedSamples += samples;
+   mSummarizingSeconds += elapsed.count();
+   mThroughputMutex.Unlock();
+
+   wxThread::This()->Yield();
 
    //update percentage complete.
    CalculatePercentComplete();
 }
 
+TranslatableString ODComputeSummaryTask::GetTip()
+{
+   ODLocker locker{ &mThroughputMutex };
+   if(mRate <= 0 || mSummarizingSeconds <= 0)
+      return XO("Import complete. Calculating waveform");
+   //The rate of all threads together
+   return XO("Import complete. Calculating waveform at %.0fx real time.")
+      .Format( mSummarizedSamples / mRate / mSummarizingSeconds );
+}
+
 ///compute the next time we should take a break in terms of overall percentage.
 ///We want to do a constant number of blockfiles.
 float ODComputeSummaryTask::ComputeNextWorkUntilPercentageComplete()
@@ -186,9 +245,13 @@ void ODComputeSummaryTask::Update()
       auto waveTrack = mWaveTracks[j].lock();
       if(waveTrack)
       {
-         BlockArray *blocks;
+         const BlockArray *blocks;
          Sequence *seq;
 
+         mThroughputMutex.Lock();
+         mRate = waveTrack->GetRate();
+         mThroughputMutex.Unlock();
+
          //gather all the blockfiles that we should process in the wavetrack.
          for (const auto &clip : waveTrack->GetAllClips()) {
             seq = clip->GetSequence();
@@ -200,7 +263,8 @@ void ODComputeSummaryTask::Update()
             //We don't need the mBlockFilesMutex here because it is only for the vector list.
             //These are existing blocks, and its wavetrack or blockfiles won't be deleted because
             //of the respective mWaveTrackMutex lock and LockDeleteUpdateMutex() call.
-            blocks = clip->GetSequenceBlockArray();
+            // Read only, so that summaries kept by the sequence stay valid
+            blocks = static_cast< const WaveClip & >( *clip ).GetSequenceBlockArray();
             int i;
             int insertCursor;
 
@@ -209,7 +273,7 @@ void ODComputeSummaryTask::Update()
             for(i=0; i<(int)blocks->size(); i++)
             {
                //if there is data but no summary, this blockfile needs summarizing.
-               SeqBlock &block = (*blocks)[i];
+               const SeqBlock block = (*blocks)[i];
                const auto &file = block.f;
                if(file->IsDataAvailable() && !file->IsSummaryAvailable())
                {
@@ -44,8 +44,8 @@ class ODComputeSummaryTask final : public ODTask
    ///Return the task name
    const char* GetTaskName() override { return "ODComputeSummaryTask"; }
 
-   TranslatableString GetTip() override
-      { return XO("Import complete. Calculating waveform"); }
+   ///Includes the rate of summarizing, once known.  Thread-safe.
+   TranslatableString GetTip() override;
 
    bool UsesCustomWorkUntilPercentage() override { return true; }
    float ComputeNextWorkUntilPercentageComplete() override;
@@ -57,7 +57,8 @@ protected:
    ///recalculates the percentage complete.
    void CalculatePercentComplete() override;
 
-   ///Computes and writes the data for one BlockFile if it still has a refcount.
+   ///Computes and writes the data for some BlockFiles that still have a refcount,
+   ///in parallel.
    void DoSomeInternal() override;
 
    ///Readjusts the blockfile order in the default manner.  If we have had an ODRequest
@@ -78,6 +79,13 @@ protected:
    int mMaxBlockFiles;
    ODLock  mHasUpdateRanMutex;
    bool mHasUpdateRan;
+
+   //for the status bar: samples summarized, time taken by DoSomeInternal, and
+   //sample rate of the tracks.
+   ODLock  mThroughputMutex;
+   double mSummarizedSamples;
+   double mSummarizingSeconds;
+   double mRate;
 };
 
 #endif
@@ -142,7 +142,7 @@ void ODDecodeTask::Update()
       auto waveTrack = mWaveTracks[j].lock();
       if(waveTrack)
       {
-         BlockArray *blocks;
+         const BlockArray *blocks;
          Sequence *seq;
 
          //gather all the blockfiles that we should process in the wavetrack.
@@ -152,7 +152,8 @@ void ODDecodeTask::Update()
             seq->LockDeleteUpdateMutex();
 
             //See Sequence::Delete() for why need this for now..
-            blocks = clip->GetSequenceBlockArray();
+            // Read only, so that summaries kept by the sequence stay valid
+            blocks = static_cast< const WaveClip & >( *clip ).GetSequenceBlockArray();
             int i;
             int insertCursor;
 
@@ -160,7 +161,7 @@ void ODDecodeTask::Update()
             for (i = 0; i<(int)blocks->size(); i++)
             {
                //since we have more than one ODDecodeBlockFile, we will need type flags to cast.
-               SeqBlock &block = (*blocks)[i];
+               const SeqBlock block = (*blocks)[i];
                const auto &file = block.f;
                std::shared_ptr<ODDecodeBlockFile> oddbFile;
                if (!file->IsDataAvailable() &&
@@ -20,6 +20,7 @@ ODTask requests and internals.
 #include "ODTask.h"
 #include "ODWaveTrackTaskQueue.h"
 #include "../Project.h"
+#include "../WorkerPool.h"
 #include <NonGuiThread.h>
 #include <wx/utils.h>
 #include <wx/wx.h>
@@ -320,6 +321,8 @@ void ODManager::Init()
 {
    mCurrentThreads = 0;
    mMaxThreads = 5;
+   mWorkerPool = std::make_unique<WorkerPool>(
+      WorkerPool::GetHardwareConcurrency() - 1);
 
    //   wxLogDebug(wxT("Initializing ODManager...Creating manager thread"));
    // This is a detached thread, so it deletes itself when it finishes
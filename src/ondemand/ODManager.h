@@ -19,6 +19,7 @@ number of threads.
 #ifndef __AUDACITY_ODMANAGER__
 #define __AUDACITY_ODMANAGER__
 
+#include <memory>
 #include <vector>
 #include "ODTaskThread.h"
 #include <wx/event.h> // for DECLARE_EXPORTED_EVENT_TYPE
@@ -42,6 +43,7 @@ class TranslatableString;
 class Track;
 class WaveTrack;
 class ODWaveTrackTaskQueue;
+class WorkerPool;
 class ODManager final
 {
  public:
@@ -87,6 +89,10 @@ class ODManager final
    ///Adds a task to the running queue.  Threas-safe.
    void AddTask(ODTask* task);
 
+   ///Threads, one fewer than the cores, for tasks to run independent parts of their work
+   ///in parallel with the task thread.  Shared by all tasks.  Thread-safe.
+   WorkerPool &GetWorkerPool() { return *mWorkerPool; }
+
    void RemoveTaskIfInQueue(ODTask* task);
 
    ///sets a flag that is set if we have loaded some OD blockfiles from PCM.
@@ -166,6 +172,8 @@ class ODManager final
    ///Maximum number of threads allowed out.
    int mMaxThreads;
 
+   std::unique_ptr<WorkerPool> mWorkerPool;
+
    volatile bool mTerminate;
    ODLock mTerminateMutex;
 
@@ -75,6 +75,10 @@ void BatchPrefs::PopulateOrExchange( ShuttleGui & S )
       S.TieCheckBox( XO("&Don't apply effects in batch mode"),
          {wxT("/Batch/Debug"), false});
 #endif
+      S.TieCheckBox( XO("Apply consecutive effects in one &pass"),
+         {wxT("/Batch/ChainEffects"), true});
+      S.TieIntegerTextBox(XO("&Files to process at once:"),
+         {wxT("/Batch/Jobs"), 1}, 3);
    }
    S.EndStatic();
    S.EndHorizontalLay();
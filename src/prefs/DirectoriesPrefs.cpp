@@ -32,6 +32,8 @@
 #include <wx/filename.h>
 #include <wx/utils.h>
 
+#include "../BlockSampleCache.h"
+#include "../SpectrogramTileCache.h"
 #include "../FileNames.h"
 #include "../Prefs.h"
 #include "../ShuttleGui.h"
@@ -120,6 +122,40 @@ void DirectoriesPrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 
+   S.StartStatic(XO("Sample cache"));
+   {
+      S.StartTwoColumn();
+      {
+         S.TieIntegerTextBox(XO("Ma&ximum size (MB):"),
+                             {wxT("/Directories/SampleCacheSize"),
+                              128},
+                             9);
+      }
+      S.EndTwoColumn();
+
+      S.AddVariableText(XO(
+"Recently read audio is kept in memory, so that repeated playback, drawing\nand effects need not read it from disk again.  Zero disables the cache."),
+         false, 0, 600);
+   }
+   S.EndStatic();
+
+   S.StartStatic(XO("Spectrogram cache"));
+   {
+      S.StartTwoColumn();
+      {
+         S.TieIntegerTextBox(XO("Maximum size &per project (MB):"),
+                             {wxT("/Directories/SpectrogramCacheSize"),
+                              512},
+                             9);
+      }
+      S.EndTwoColumn();
+
+      S.AddVariableText(XO(
+"Spectrograms are kept in the project's data folder, so that they are drawn\nat once when the project is opened again.  Zero disables the cache."),
+         false, 0, 600);
+   }
+   S.EndStatic();
+
 #ifdef DEPRECATED_AUDIO_CACHE
    // See http://bugzilla.audacityteam.org/show_bug.cgi?id=545.
    S.StartStatic(XO("Audio cache"));
@@ -287,6 +323,10 @@ bool DirectoriesPrefs::Commit()
    ShuttleGui S(this, eIsSavingToPrefs);
    PopulateOrExchange(S);
 
+   BlockSampleCache::Get().SetCapacity(BlockSampleCache::GetCapacityPref());
+   SpectrogramTileCache::Get().SetDiskCapacity(
+      SpectrogramTileCache::GetDiskCapacityPref());
+
    return true;
 }
 
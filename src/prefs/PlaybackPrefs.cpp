@@ -156,6 +156,30 @@ void PlaybackPrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 
+   S.StartStatic(XO("Performance"));
+   {
+      S.StartTwoColumn();
+      {
+         S.TieIntegerTextBox(XO("Mixing &threads:"),
+                             {wxT("/AudioIO/PlaybackMixingThreads"),
+                              0},
+                             9);
+         S.TieIntegerTextBox(XO("&Realtime effect threads:"),
+                             {wxT("/Effects/RealtimeThreads"),
+                              1},
+                             9);
+      }
+      S.EndTwoColumn();
+
+      S.AddVariableText(XO(
+"Tracks are prepared for playback on this many processors at once.\nZero uses all processors; one prepares the tracks one at a time.\nTakes effect when playback next starts."),
+         false, 0, 600);
+      S.AddVariableText(XO(
+"Realtime effects process different tracks on this many processors at once,\nthough one effect processes one track at a time.  Zero uses all processors.\nTakes effect when playback next starts."),
+         false, 0, 600);
+   }
+   S.EndStatic();
+
 
    S.EndScroller();
 
@@ -20,6 +20,7 @@ Paul Licameli split from WaveTrackView.cpp
 #include "../../../../AColor.h"
 #include "../../../../Prefs.h"
 #include "../../../../NumberScale.h"
+#include "../../../../SpectrumKernels.h"
 #include "../../../../TrackArtist.h"
 #include "../../../../TrackPanelDrawingContext.h"
 #include "../../../../ViewInfo.h"
@@ -93,14 +94,51 @@ std::shared_ptr<TrackVRulerControls> SpectrumView::DoGetVRulerControls()
 namespace
 {
 
+// Maximum method, and no apportionment of any single bins over multiple pixel rows
+// See Bug971
+static inline void findBins
+(float bin0, float bin1, unsigned nBins, bool autocorrelation,
+ int &index, int &limitIndex)
+{
+   if (autocorrelation) {
+      // bin = 2 * nBins / (nBins - 1 - array_index);
+      // Solve for index
+      index = std::max(0.0f, std::min(float(nBins - 1),
+         (nBins - 1) - (2 * nBins) / (std::max(1.0f, bin0))
+      ));
+      limitIndex = std::max(0.0f, std::min(float(nBins - 1),
+         (nBins - 1) - (2 * nBins) / (std::max(1.0f, bin1))
+      ));
+   }
+   else {
+      index = std::min<int>(nBins - 1, (int)(floor(0.5 + bin0)));
+      limitIndex = std::min<int>(nBins, (int)(floor(0.5 + bin1)));
+   }
+}
+
+// The greatest of the bins from index up to limitIndex, in a 0.0-1.0 range
+static inline float findValue
+(const float *spectrum, int index, int limitIndex,
+ bool autocorrelation, int gain, int range)
+{
+   float value = spectrum[index];
+   while (++index < limitIndex)
+      value = std::max(value, spectrum[index]);
+   if (!autocorrelation) {
+      // Last step converts dB to a 0.0-1.0 range
+      value = (value + range + gain) / (double)range;
+   }
+   value = std::min(1.0f, std::max(0.0f, value));
+   return value;
+}
+
 static inline float findValue
 (const float *spectrum, float bin0, float bin1, unsigned nBins,
  bool autocorrelation, int gain, int range)
 {
+#if 0
    float value;
 
-
-#if 0
    // Averaging method
    if ((int)(bin1) == (int)(bin0)) {
       value = spectrum[(int)(bin0)];
@@ -121,34 +159,17 @@ static inline float findValue
       value += spectrum[(int)(bin1)] * (bin1 - (int)(bin1));
       value /= binwidth;
    }
-#else
-   // Maximum method, and no apportionment of any single bins over multiple pixel rows
-   // See Bug971
-   int index, limitIndex;
-   if (autocorrelation) {
-      // bin = 2 * nBins / (nBins - 1 - array_index);
-      // Solve for index
-      index = std::max(0.0f, std::min(float(nBins - 1),
-         (nBins - 1) - (2 * nBins) / (std::max(1.0f, bin0))
-      ));
-      limitIndex = std::max(0.0f, std::min(float(nBins - 1),
-         (nBins - 1) - (2 * nBins) / (std::max(1.0f, bin1))
-      ));
-   }
-   else {
-      index = std::min<int>(nBins - 1, (int)(floor(0.5 + bin0)));
-      limitIndex = std::min<int>(nBins, (int)(floor(0.5 + bin1)));
-   }
-   value = spectrum[index];
-   while (++index < limitIndex)
-      value = std::max(value, spectrum[index]);
-#endif
    if (!autocorrelation) {
       // Last step converts dB to a 0.0-1.0 range
       value = (value + range + gain) / (double)range;
    }
    value = std::min(1.0f, std::max(0.0f, value));
    return value;
+#else
+   int index, limitIndex;
+   findBins(bin0, bin1, nBins, autocorrelation, index, limitIndex);
+   return findValue(spectrum, index, limitIndex, autocorrelation, gain, range);
+#endif
 }
 
 // dashCount counts both dashes and the spaces between them.
@@ -171,6 +192,63 @@ ChooseColorSet( float bin0, float bin1, float selBinLo,
    return  AColor::ColorGradientTimeSelected;
 }
 
+// Finds which bins each row of pixels shows, unless they are known already.
+// Returns whether they changed.
+bool UpdateRows(SpecPxCache::Rows &rows, const SpectrogramSettings &settings,
+   int height, float minFreq, float maxFreq, double rate)
+{
+   const auto nBins = settings.NBins();
+   if (rows.height == height &&
+       rows.scaleType == settings.scaleType &&
+       rows.algorithm == settings.algorithm &&
+       rows.nBins == nBins &&
+       rows.rate == rate &&
+       rows.minFreq == minFreq &&
+       rows.maxFreq == maxFreq)
+      return false;
+
+   rows.height = height;
+   rows.scaleType = settings.scaleType;
+   rows.algorithm = settings.algorithm;
+   rows.nBins = nBins;
+   rows.rate = rate;
+   rows.minFreq = minFreq;
+   rows.maxFreq = maxFreq;
+
+   const auto half = settings.GetFFTLength() / 2;
+   const double binUnit = rate / (2 * half);
+
+   // nearest frequency to each pixel row from number scale, for selecting
+   // the desired fft bin(s) for display on that row
+   auto &bins = rows.bins;
+   bins.resize(height + 1);
+   {
+      const NumberScale numberScale( settings.GetScale( minFreq, maxFreq ) );
+
+      NumberScale::Iterator it = numberScale.begin(height);
+      float nextBin = std::max( 0.0f, std::min( float(nBins - 1),
+         settings.findBin( *it, binUnit ) ) );
+
+      int yy;
+      for (yy = 0; yy < height; ++yy) {
+         bins[yy] = nextBin;
+         nextBin = std::max( 0.0f, std::min( float(nBins - 1),
+            settings.findBin( *++it, binUnit ) ) );
+      }
+      bins[yy] = nextBin;
+   }
+
+   const bool autocorrelation =
+      (settings.algorithm == SpectrogramSettings::algPitchEAC);
+   rows.first.resize(height);
+   rows.limit.resize(height);
+   for (int yy = 0; yy < height; ++yy)
+      findBins(bins[yy], bins[yy + 1], nBins, autocorrelation,
+         rows.first[yy], rows.limit[yy]);
+
+   return true;
+}
+
 void DrawClipSpectrum(TrackPanelDrawingContext &context,
                                    WaveTrackCache &waveTrackCache,
                                    const WaveClip *clip,
@@ -255,37 +333,47 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    const float *freq = 0;
    const sampleCount *where = 0;
    bool updated;
+   // Columns still being computed on other threads, if any
+   std::vector<bool> ready;
    {
       const double pps = averagePixelsPerSample * rate;
       updated = clip->GetSpectrogram(waveTrackCache, freq, where,
                                      (size_t)hiddenMid.width,
-         t0, pps);
+         t0, pps, &ready);
    }
    auto nBins = settings.NBins();
 
+   // Until a column is computed, show the nearest that is, if it is near
+   // enough, or else background.  Only ready columns may be read.
+   std::vector<int> sourceColumns;
+   if (!ready.empty()) {
+      enum { MaxDistance = 64 /* pixels */ };
+      const int width = ready.size();
+      sourceColumns.resize(width, -1);
+      for (int xx = 0; xx < width; ++xx) {
+         for (int dd = 0; dd <= MaxDistance; ++dd) {
+            if (xx - dd >= 0 && ready[xx - dd]) {
+               sourceColumns[xx] = xx - dd;
+               break;
+            }
+            if (xx + dd < width && ready[xx + dd]) {
+               sourceColumns[xx] = xx + dd;
+               break;
+            }
+         }
+      }
+   }
+
    float minFreq, maxFreq;
    track->GetSpectrumBounds(&minFreq, &maxFreq);
 
    const SpectrogramSettings::ScaleType scaleType = settings.scaleType;
 
-   // nearest frequency to each pixel row from number scale, for selecting
-   // the desired fft bin(s) for display on that row
-   float *bins = (float*)alloca(sizeof(*bins)*(hiddenMid.height + 1));
-   {
-      const NumberScale numberScale( settings.GetScale( minFreq, maxFreq ) );
-
-      NumberScale::Iterator it = numberScale.begin(mid.height);
-      float nextBin = std::max( 0.0f, std::min( float(nBins - 1),
-         settings.findBin( *it, binUnit ) ) );
-
-      int yy;
-      for (yy = 0; yy < hiddenMid.height; ++yy) {
-         bins[yy] = nextBin;
-         nextBin = std::max( 0.0f, std::min( float(nBins - 1),
-            settings.findBin( *++it, binUnit ) ) );
-      }
-      bins[yy] = nextBin;
-   }
+   auto &pxCache = *clip->mSpecPxCache;
+   const auto &rows = pxCache.rows;
+   const bool rowsChanged = UpdateRows(pxCache.rows, settings,
+      hiddenMid.height, minFreq, maxFreq, rate);
+   const float *const bins = rows.bins.data();
 
 #ifdef EXPERIMENTAL_FFT_Y_GRID
    const float
@@ -308,13 +396,13 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    }
 #endif //EXPERIMENTAL_FFT_Y_GRID
 
-   if (!updated && clip->mSpecPxCache->valid &&
-      ((int)clip->mSpecPxCache->len == hiddenMid.height * hiddenMid.width)
-      && scaleType == clip->mSpecPxCache->scaleType
-      && gain == clip->mSpecPxCache->gain
-      && range == clip->mSpecPxCache->range
-      && minFreq == clip->mSpecPxCache->minFreq
-      && maxFreq == clip->mSpecPxCache->maxFreq
+   if (!updated && !rowsChanged && pxCache.valid &&
+      ((int)pxCache.len == hiddenMid.height * hiddenMid.width)
+      && scaleType == pxCache.scaleType
+      && gain == pxCache.gain
+      && range == pxCache.range
+      && minFreq == pxCache.minFreq
+      && maxFreq == pxCache.maxFreq
 #ifdef EXPERIMENTAL_FFT_Y_GRID
    && fftYGrid==fftYGridOld
 #endif //EXPERIMENTAL_FFT_Y_GRID
@@ -329,14 +417,19 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
       // and so is the spectrum pixel cache
    }
    else {
-      // Update the spectrum pixel cache
-      clip->mSpecPxCache = std::make_unique<SpecPxCache>(hiddenMid.width * hiddenMid.height);
-      clip->mSpecPxCache->valid = true;
-      clip->mSpecPxCache->scaleType = scaleType;
-      clip->mSpecPxCache->gain = gain;
-      clip->mSpecPxCache->range = range;
-      clip->mSpecPxCache->minFreq = minFreq;
-      clip->mSpecPxCache->maxFreq = maxFreq;
+      // Update the spectrum pixel cache, keeping the rows
+      const size_t len = hiddenMid.width * hiddenMid.height;
+      if (pxCache.len != len) {
+         pxCache.len = len;
+         pxCache.values.reinit(len);
+      }
+      // Make it again at the next drawing, if columns are missing
+      pxCache.valid = ready.empty();
+      pxCache.scaleType = scaleType;
+      pxCache.gain = gain;
+      pxCache.range = range;
+      pxCache.minFreq = minFreq;
+      pxCache.maxFreq = maxFreq;
 #ifdef EXPERIMENTAL_FIND_NOTES
       fftFindNotesOld = fftFindNotes;
       findNotesMinAOld = findNotesMinA;
@@ -370,9 +463,19 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
 #pragma omp parallel for
 #endif
       for (int xx = 0; xx < hiddenMid.width; ++xx) {
+         // Each column of the cache is spread across the rows
+         float *const values = &pxCache.values[xx];
+         const int stride = hiddenMid.width;
+         const int column = sourceColumns.empty() ? xx : sourceColumns[xx];
+         if (column < 0) {
+            for (int yy = 0; yy < hiddenMid.height; ++yy)
+               values[yy * stride] = 0.0f;
+            continue;
+         }
+
 #ifdef EXPERIMENTAL_FIND_NOTES
          int maximas = 0;
-         const int x0 = nBins * xx;
+         const int x0 = nBins * column;
          if (fftFindNotes) {
             for (int i = maxTableSize - 1; i >= 0; i--)
                indexes[i] = -1;
@@ -436,13 +539,16 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
 #endif //EXPERIMENTAL_FIND_NOTES
 
          for (int yy = 0; yy < hiddenMid.height; ++yy) {
+#ifdef EXPERIMENTAL_FIND_NOTES
             const float bin     = bins[yy];
             const float nextBin = bins[yy+1];
+#endif
 
             if (settings.scaleType != SpectrogramSettings::stLogarithmic) {
                const float value = findValue
-                  (freq + nBins * xx, bin, nextBin, nBins, autocorrelation, gain, range);
-               clip->mSpecPxCache->values[xx * hiddenMid.height + yy] = value;
+                  (freq + nBins * column, rows.first[yy], rows.limit[yy],
+                   autocorrelation, gain, range);
+               values[yy * stride] = value;
             }
             else {
                float value;
@@ -478,9 +584,10 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
 #endif //EXPERIMENTAL_FIND_NOTES
                {
                   value = findValue
-                     (freq + nBins * xx, bin, nextBin, nBins, autocorrelation, gain, range);
+                     (freq + nBins * column, rows.first[yy], rows.limit[yy],
+                      autocorrelation, gain, range);
                }
-               clip->mSpecPxCache->values[xx * hiddenMid.height + yy] = value;
+               values[yy * stride] = value;
             } // logF
          } // each yy
       } // each xx
@@ -528,23 +635,19 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
    // left pixel column of the fisheye
    int fisheyeLeft = zoomInfo.GetFisheyeLeftBoundary(-leftOffset);
 
-#ifdef _OPENMP
-#pragma omp parallel for
-#endif
+   // For each column:  the spectrum to use instead of the cache, in the
+   // fisheye; and whether it may be selected, and if so, whether it is in
+   // a dash or in a space between
+   enum { Unselected = -1, InDash = 0, BetweenDashes = 1 };
+   std::vector<const float*> uncached(mid.width);
+   std::vector<signed char> selection(mid.width);
    for (int xx = 0; xx < mid.width; ++xx) {
-
-      int correctedX = xx + leftOffset - hiddenLeftOffset;
-
       // in fisheye mode the time scale has changed, so the row values aren't cached
       // in the loop above, and must be fetched from fft cache
-      float* uncached;
-      if (!zoomInfo.InFisheye(xx, -leftOffset)) {
-          uncached = 0;
-      }
-      else {
+      if (zoomInfo.InFisheye(xx, -leftOffset)) {
           int specIndex = (xx - fisheyeLeft) * nBins;
           wxASSERT(specIndex >= 0 && specIndex < (int)specCache.freq.size());
-          uncached = &specCache.freq[specIndex];
+          uncached[xx] = &specCache.freq[specIndex];
       }
 
       // zoomInfo must be queried for each column since with fisheye enabled
@@ -557,48 +660,79 @@ void DrawClipSpectrum(TrackPanelDrawingContext &context,
 
       bool maybeSelected = ssel0 <= w0 && w1 < ssel1;
 
-      for (int yy = 0; yy < hiddenMid.height; ++yy) {
-         const float bin     = bins[yy];
-         const float nextBin = bins[yy+1];
-
-         // For spectral selection, determine what colour
-         // set to use.  We use a darker selection if
-         // in both spectral range and time range.
-
-         AColor::ColorGradientChoice selected = AColor::ColorGradientUnselected;
+      // dashCount counts both dashes and the spaces between them.
+      const int dashCount = (xx + leftOffset - hiddenLeftOffset) / DASH_LENGTH;
+      selection[xx] = !maybeSelected
+         ? Unselected
+         : (0 == dashCount % 2) ? InDash : BetweenDashes;
+   }
 
+   // Rows are coloured a run of columns at a time, each run with one colour
+   // set, from values that are contiguous in the cache
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+   for (int yy = 0; yy < hiddenMid.height; ++yy) {
+      const float bin     = bins[yy];
+      const float nextBin = bins[yy+1];
+
+      // For spectral selection, determine what colour
+      // set to use.  We use a darker selection if
+      // in both spectral range and time range.
+      const AColor::ColorGradientChoice selectedSets[] = {
+         ChooseColorSet(bin, nextBin, selBinLo, selBinCenter, selBinHi,
+            0, isSpectral),
+         ChooseColorSet(bin, nextBin, selBinLo, selBinCenter, selBinHi,
+            1, isSpectral),
+      };
+      const auto colorSet = [&](int xx) {
          // If we are in the time selected range, then we may use a different color set.
-         if (maybeSelected)
-            selected =
-               ChooseColorSet(bin, nextBin, selBinLo, selBinCenter, selBinHi,
-                  (xx + leftOffset - hiddenLeftOffset) / DASH_LENGTH, isSpectral);
-
-         const float value = uncached
-            ? findValue(uncached, bin, nextBin, nBins, autocorrelation, gain, range)
-            : clip->mSpecPxCache->values[correctedX * hiddenMid.height + yy];
-
-         unsigned char rv, gv, bv;
-         GetColorGradient(value, selected, isGrayscale, &rv, &gv, &bv);
-
-#ifdef EXPERIMENTAL_FFT_Y_GRID
-         if (fftYGrid && yGrid[yy]) {
-            rv /= 1.1f;
-            gv /= 1.1f;
-            bv /= 1.1f;
+         return selection[xx] == Unselected
+            ? AColor::ColorGradientUnselected
+            : selectedSets[selection[xx]];
+      };
+
+      const float *const values = &pxCache.values[yy * hiddenMid.width];
+      const int px0 = (mid.height - 1 - yy) * mid.width;
+      unsigned char *const rgb = data + 3 * px0;
+
+      for (int xx = 0, nextX; xx < mid.width; xx = nextX) {
+         const auto selected = colorSet(xx);
+         nextX = xx + 1;
+         if (uncached[xx]) {
+            const float value = findValue(uncached[xx],
+               rows.first[yy], rows.limit[yy], autocorrelation, gain, range);
+            GetColorGradient(value, selected, isGrayscale,
+               &rgb[3 * xx], &rgb[3 * xx + 1], &rgb[3 * xx + 2]);
+#ifdef EXPERIMENTAL_SPECTROGRAM_OVERLAY
+            // More transparent the closer to zero intensity.
+            alpha[px0 + xx]= wxMin( 200, (value+0.3) * 500) ;
+#endif
+            continue;
          }
-#endif //EXPERIMENTAL_FFT_Y_GRID
 
-         int px = ((mid.height - 1 - yy) * mid.width + xx);
+         while (nextX < mid.width && !uncached[nextX] &&
+                colorSet(nextX) == selected)
+            ++nextX;
+         const int correctedX = xx + leftOffset - hiddenLeftOffset;
+         const float *const runValues = values + correctedX;
+         SpectrumKernels::ColorRow(runValues, nextX - xx,
+            AColor::gradient_rgbx[selected][isGrayscale],
+            AColor::gradientSteps, &rgb[3 * xx]);
 #ifdef EXPERIMENTAL_SPECTROGRAM_OVERLAY
-         // More transparent the closer to zero intensity.
-         alpha[px]= wxMin( 200, (value+0.3) * 500) ;
+         for (int ii = 0; ii < nextX - xx; ++ii)
+            // More transparent the closer to zero intensity.
+            alpha[px0 + xx + ii]= wxMin( 200, (runValues[ii]+0.3) * 500) ;
 #endif
-         px *=3;
-         data[px++] = rv;
-         data[px++] = gv;
-         data[px] = bv;
-      } // each yy
-   } // each xx
+      }
+
+#ifdef EXPERIMENTAL_FFT_Y_GRID
+      if (fftYGrid && yGrid[yy]) {
+         for (int ii = 0; ii < 3 * mid.width; ++ii)
+            rgb[ii] /= 1.1f;
+      }
+#endif //EXPERIMENTAL_FFT_Y_GRID
+   } // each yy
 
    wxBitmap converted = wxBitmap(image);
 
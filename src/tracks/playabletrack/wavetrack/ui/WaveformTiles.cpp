@@ -0,0 +1,397 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+WaveformTiles.cpp
+
+*******************************************************************//**
+
+\class WaveformTiles
+\brief Pictures of the min, max and rms of a clip, in tiles of fixed
+width, drawn on the threads of SpectrogramEngine.
+
+  WaveformView keeps one set for each clip it shows.  Painting copies the
+  tiles that are ready, draws the other columns itself as before, and
+  requests the missing tiles, which workers draw into plain arrays of
+  pixels, from a snapshot of the clip's sequence.  The arrays become
+  bitmaps on the main thread, when first painted.
+
+*//*******************************************************************/
+
+#include "../../../../Audacity.h"
+#include "WaveformTiles.h"
+
+#include "../../../../BlockFile.h"
+#include "../../../../Envelope.h"
+#include "../../../../Sequence.h"
+#include "../../../../SpectrogramEngine.h"
+#include "../../../../TrackArtist.h"
+#include "../../../../WaveClip.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <wx/bitmap.h>
+#include <wx/dc.h>
+#include <wx/image.h>
+
+struct WaveformTiles::Tile
+{
+   explicit Tile(long long index_) : index{ index_ } {}
+
+   const long long index;
+
+   // Values of the envelope at the column before the tile, which is
+   // computed only to make the waveform continuous, and at each column
+   std::vector<double> envelope;
+
+   // Set by the worker when it has drawn the tile
+   std::atomic<bool> ready{ false };
+   // False if some of the samples were not yet summarized, or unreadable
+   bool complete{ false };
+   // CountUnsummarized() when the tile was requested
+   size_t unsummarized{ 0 };
+
+   // Red, green and blue, and opacity, of each pixel, row by row, until
+   // the bitmap is made
+   std::vector<unsigned char> rgb;
+   std::vector<unsigned char> alpha;
+   std::unique_ptr<wxBitmap> pBitmap;
+};
+
+/// Draws tiles of one WaveformTiles, reading a copy of the clip's sequence
+/// that later edits can't change
+class WaveformTilesJob final : public SpectrogramEngine::Job
+{
+public:
+   using TilePtr = std::shared_ptr<WaveformTiles::Tile>;
+
+   WaveformTilesJob(std::vector<TilePtr> tiles,
+      const WaveformTiles::Style &style, std::unique_ptr<Sequence> samples)
+      : Job{ Indices(tiles.size()) }
+      , mTiles{ std::move(tiles) }
+      , mStyle{ style }
+      , mSamples{ std::move(samples) }
+   {
+   }
+
+   void Compute(const size_t *columns, size_t nColumns,
+      std::vector<float> &scratch) override
+   {
+      for (size_t ii = 0; ii < nColumns; ++ii) {
+         auto &tile = *mTiles[columns[ii]];
+         tile.complete = Render(tile, scratch);
+         tile.ready.store(true);
+      }
+   }
+
+private:
+   // The engine's columns are the tiles, in the order given
+   static std::vector<size_t> Indices(size_t size)
+   {
+      std::vector<size_t> result(size);
+      for (size_t ii = 0; ii < size; ++ii)
+         result[ii] = ii;
+      return result;
+   }
+
+   bool Render(WaveformTiles::Tile &tile, std::vector<float> &scratch);
+
+   const std::vector<TilePtr> mTiles;
+   const WaveformTiles::Style mStyle;
+   const std::unique_ptr<Sequence> mSamples;
+};
+
+bool WaveformTilesJob::Render(
+   WaveformTiles::Tile &tile, std::vector<float> &scratch)
+{
+   const int width = WaveformTiles::TileWidth;
+   const int height = mStyle.height;
+   // One more column, before the tile
+   const int len = width + 1;
+   const long long first = tile.index * width - 1;
+   const double samplesPerPixel = mStyle.rate / mStyle.pixelsPerSecond;
+   const auto numSamples = mSamples->GetNumSamples();
+
+   std::vector<sampleCount> where(len + 1);
+   for (int xx = 0; xx <= len; ++xx)
+      where[xx] = sampleCount(
+         floor(0.5 + double(first + xx) * samplesPerPixel));
+
+   // The columns within the clip; the last may be partly outside
+   int x0 = 0;
+   while (x0 < len && where[x0] < 0)
+      ++x0;
+   int x1 = x0;
+   while (x1 < len && where[x1] < numSamples)
+      ++x1;
+
+   scratch.resize(3 * len);
+   float *const min = scratch.data();
+   float *const max = min + len;
+   float *const rms = max + len;
+   std::vector<int> bl(len);
+   if (x1 > x0) {
+      try {
+         // Don't throw on a worker thread
+         if (!mSamples->GetWaveDisplay(&min[x0], &max[x0], &rms[x0], &bl[x0],
+               x1 - x0, &where[x0]))
+            return false;
+      }
+      catch (...) {
+         return false;
+      }
+   }
+   for (int xx = x0; xx < x1; ++xx)
+      if (bl[xx] < 0)
+         // Not yet summarized; draw it later
+         return false;
+
+   auto &rgb = tile.rgb;
+   auto &alpha = tile.alpha;
+   rgb.assign(3 * width * height, 0);
+   alpha.assign(width * height, 0);
+   const auto paint = [&](int column, int top, int bottom,
+      const unsigned char (&colour)[3])
+   {
+      top = std::max(0, top);
+      bottom = std::min(height - 1, bottom);
+      for (int yy = top; yy <= bottom; ++yy) {
+         const int px = yy * width + column;
+         std::copy(colour, colour + 3, &rgb[3 * px]);
+         alpha[px] = 255;
+      }
+   };
+
+   const auto zoomMin = mStyle.zoomMin, zoomMax = mStyle.zoomMax;
+   const auto dB = mStyle.dB;
+   const auto dBRange = mStyle.dBRange;
+   const auto showClipping = mStyle.showClipping;
+
+   // As in DrawMinMaxRMS() in WaveformView.cpp
+   int lasth1 = std::numeric_limits<int>::max();
+   int lasth2 = std::numeric_limits<int>::min();
+   for (int xx = x0; xx < x1; ++xx) {
+      const double env = tile.envelope[xx];
+      bool clipped = false;
+
+      double v = min[xx] * env;
+      if (showClipping && v <= -MAX_AUDIO)
+         clipped = true;
+      int h1 = GetWaveYPos(v, zoomMin, zoomMax,
+                           height, dB, true, dBRange, true);
+
+      v = max[xx] * env;
+      if (showClipping && v >= MAX_AUDIO)
+         clipped = true;
+      int h2 = GetWaveYPos(v, zoomMin, zoomMax,
+                           height, dB, true, dBRange, true);
+
+      // Keep the waveform continuous
+      if (xx > x0) {
+         if (h1 < lasth2)
+            h1 = lasth2 - 1;
+         if (h2 > lasth1)
+            h2 = lasth1 + 1;
+      }
+      lasth1 = h1;
+      lasth2 = h2;
+
+      // The column before the tile is drawn by the tile before
+      if (xx == 0)
+         continue;
+      const int column = xx - 1;
+
+      int r1 = GetWaveYPos(-rms[xx] * env, zoomMin, zoomMax,
+                           height, dB, true, dBRange, true);
+      int r2 = GetWaveYPos(rms[xx] * env, zoomMin, zoomMax,
+                           height, dB, true, dBRange, true);
+      // Make sure the rms isn't larger than the waveform min/max
+      r1 = std::min(r1, h1 - 1);
+      r2 = std::max(r2, h2 + 1);
+      r2 = std::min(r2, r1);
+
+      paint(column, h2, h1, mStyle.sampleColour);
+      if (r1 != r2)
+         paint(column, r2, r1, mStyle.rmsColour);
+      if (clipped)
+         paint(column, 0, height - 1, mStyle.clippedColour);
+   }
+
+   return true;
+}
+
+bool WaveformTiles::Style::operator== (const Style &other) const
+{
+   return pixelsPerSecond == other.pixelsPerSecond &&
+      rate == other.rate &&
+      height == other.height &&
+      zoomMin == other.zoomMin &&
+      zoomMax == other.zoomMax &&
+      dB == other.dB &&
+      dBRange == other.dBRange &&
+      showClipping == other.showClipping &&
+      0 == memcmp(sampleColour, other.sampleColour, 3) &&
+      0 == memcmp(rmsColour, other.rmsColour, 3) &&
+      0 == memcmp(clippedColour, other.clippedColour, 3) &&
+      dirty == other.dirty &&
+      numSamples == other.numSamples;
+}
+
+WaveformTiles::WaveformTiles()
+{
+}
+
+WaveformTiles::~WaveformTiles()
+{
+   CancelJob();
+}
+
+void WaveformTiles::CancelJob()
+{
+   if (mpJob) {
+      SpectrogramEngine::Get().Cancel(*mpJob);
+      mpJob.reset();
+   }
+}
+
+void WaveformTiles::SetStyle(const Style &style)
+{
+   if (style != mStyle) {
+      CancelJob();
+      mTiles.clear();
+      mStyle = style;
+   }
+}
+
+void WaveformTiles::GetEnvelope(const WaveClip &clip, long long tile,
+   std::vector<double> &values) const
+{
+   const double tstep = 1.0 / mStyle.pixelsPerSecond;
+   values.resize(TileWidth + 1);
+   clip.GetEnvelope()->GetValues(values.data(), values.size(),
+      clip.GetOffset() + (tile * TileWidth - 1) * tstep, tstep);
+}
+
+size_t WaveformTiles::CountUnsummarized(
+   const WaveClip &clip, long long tile) const
+{
+   const auto &blocks = clip.GetSequence()->GetBlockArray();
+   const auto numSamples = blocks.GetNumSamples();
+   const double samplesPerPixel = mStyle.rate / mStyle.pixelsPerSecond;
+   // The samples of the tile and of the column before it, as Render() finds
+   const auto start = std::max(sampleCount{ 0 }, sampleCount(
+      floor(0.5 + double(tile * TileWidth - 1) * samplesPerPixel)));
+   const auto end = sampleCount(
+      floor(0.5 + double((tile + 1) * TileWidth) * samplesPerPixel));
+   if (start >= numSamples)
+      return 0;
+
+   size_t result = 0;
+   for (auto ii = blocks.FindBlock(start), nn = blocks.size(); ii < nn; ++ii) {
+      const auto seqBlock = blocks[ii];
+      if (seqBlock.start >= end)
+         break;
+      if (!seqBlock.f->IsSummaryAvailable())
+         ++result;
+   }
+   return result;
+}
+
+bool WaveformTiles::IsReady(const WaveClip &clip, long long tile)
+{
+   const auto iter = mTiles.find(tile);
+   if (iter == mTiles.end())
+      return false;
+   const auto &pTile = iter->second;
+   if (!pTile->ready.load() || !pTile->complete)
+      return false;
+
+   GetEnvelope(clip, tile, mScratch);
+   if (mScratch != pTile->envelope) {
+      // No worker uses a tile that is ready
+      mTiles.erase(iter);
+      return false;
+   }
+   return true;
+}
+
+void WaveformTiles::Draw(wxDC &dc, long long tile, int x, const wxRect &rect)
+{
+   const auto iter = mTiles.find(tile);
+   if (iter == mTiles.end() || !iter->second->ready.load())
+      return;
+   auto &theTile = *iter->second;
+
+   if (!theTile.pBitmap) {
+      const int height = mStyle.height;
+      wxImage image(TileWidth, height, false);
+      memcpy(image.GetData(), theTile.rgb.data(), theTile.rgb.size());
+      image.InitAlpha();
+      memcpy(image.GetAlpha(), theTile.alpha.data(), theTile.alpha.size());
+      theTile.pBitmap = std::make_unique<wxBitmap>(image);
+
+      // The bitmap has them now
+      std::vector<unsigned char>{}.swap(theTile.rgb);
+      std::vector<unsigned char>{}.swap(theTile.alpha);
+   }
+
+   wxDCClipper clipper(dc, rect);
+   dc.DrawBitmap(*theTile.pBitmap, x, rect.y, true);
+}
+
+void WaveformTiles::Request(
+   const WaveClip &clip, long long first, long long last)
+{
+   // The job still running is drawing the same tiles
+   if (mpJob && !mpJob->IsFinished() &&
+       first == mFirst && last == mLast)
+      return;
+
+   CancelJob();
+   mFirst = first, mLast = last;
+
+   // Forget the tiles away from the view
+   for (auto iter = mTiles.begin(); iter != mTiles.end();) {
+      if (iter->first < first - 1 || iter->first > last + 1)
+         iter = mTiles.erase(iter);
+      else
+         ++iter;
+   }
+
+   const double samplesPerPixel = mStyle.rate / mStyle.pixelsPerSecond;
+   std::vector< std::shared_ptr<Tile> > tiles;
+   const auto add = [&](long long index) {
+      if (index < 0 ||
+          index * TileWidth * samplesPerPixel >=
+             mStyle.numSamples.as_double())
+         return;
+      auto &pTile = mTiles[index];
+      const auto unsummarized = CountUnsummarized(clip, index);
+      if (pTile && pTile->ready.load() &&
+          (pTile->complete || pTile->unsummarized <= unsummarized))
+         // Drawn, or drawing it again would fail as before, until
+         // summaries are computed, or an edit changes the style
+         return;
+      // The cancelled job left this one undone, or it must be drawn again
+      pTile = std::make_shared<Tile>(index);
+      pTile->unsummarized = unsummarized;
+      GetEnvelope(clip, index, pTile->envelope);
+      tiles.push_back(pTile);
+   };
+
+   // Those in view first, then those to either side
+   for (auto index = first; index <= last; ++index)
+      add(index);
+   add(first - 1);
+   add(last + 1);
+
+   if (!tiles.empty()) {
+      mpJob = std::make_shared<WaveformTilesJob>(
+         std::move(tiles), mStyle, clip.GetSequence()->Snapshot());
+      SpectrogramEngine::Get().Submit(mpJob);
+   }
+}
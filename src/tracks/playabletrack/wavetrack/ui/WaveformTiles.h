@@ -0,0 +1,106 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+WaveformTiles.h
+
+Images of the min, max and rms of a clip, drawn off the main thread
+
+**********************************************************************/
+
+#ifndef __AUDACITY_WAVEFORM_TILES__
+#define __AUDACITY_WAVEFORM_TILES__
+
+#include "../../../../MemoryX.h"
+#include "audacity/Types.h"
+
+#include <map>
+#include <vector>
+
+class wxDC;
+class wxRect;
+class WaveClip;
+class WaveformTilesJob;
+
+// The min, max and rms of one clip at one zoom, as pictures of TileWidth
+// pixel columns each, drawn on the threads of SpectrogramEngine, so that
+// painting need only copy them.  Columns are counted from the start of the
+// clip.  A tile is kept only while the clip, its envelope and the style
+// stay as they were when it was drawn.
+class WaveformTiles final
+{
+public:
+   enum : int { TileWidth = 256 };
+
+   // Everything but the samples and the envelope that the pictures
+   // depend on
+   struct Style {
+      double pixelsPerSecond{ 0 };
+      double rate{ 0 };
+      int height{ 0 };
+      float zoomMin{ -1 }, zoomMax{ 1 };
+      bool dB{ false };
+      float dBRange{ 0 };
+      bool showClipping{ false };
+      // Red, green and blue of the pens for samples, rms and clipping
+      unsigned char sampleColour[3]{};
+      unsigned char rmsColour[3]{};
+      unsigned char clippedColour[3]{};
+      // WaveClip::GetDirty() and the number of samples
+      int dirty{ 0 };
+      sampleCount numSamples{ 0 };
+
+      bool operator== (const Style &other) const;
+      bool operator!= (const Style &other) const
+         { return !(*this == other); }
+   };
+
+   WaveformTiles();
+   ~WaveformTiles();
+
+   WaveformTiles(const WaveformTiles&) PROHIBITED;
+   WaveformTiles &operator= (const WaveformTiles&) PROHIBITED;
+
+   // Forgets all tiles if the style is not that of the last call
+   void SetStyle(const Style &style);
+
+   // Whether the tile is drawn, and with the clip's envelope as it is now.
+   // A tile drawn with another envelope is forgotten.
+   bool IsReady(const WaveClip &clip, long long tile);
+
+   // Copies a ready tile, with its first column at x, clipped to rect
+   void Draw(wxDC &dc, long long tile, int x, const wxRect &rect);
+
+   // Starts drawing the tiles from first to last that are not ready, and
+   // one more on each side, and forgets the others.  A tile that could not
+   // be drawn completely is tried again only when fewer of its blocks lack
+   // summaries.  The clip must have no samples waiting to be appended.
+   void Request(const WaveClip &clip, long long first, long long last);
+
+   // The tile holding a column
+   static long long TileOf(long long column)
+   {
+      return column >= 0
+         ? column / TileWidth
+         : -((TileWidth - 1 - column) / TileWidth);
+   }
+
+private:
+   struct Tile;
+   friend WaveformTilesJob;
+
+   void CancelJob();
+   void GetEnvelope(const WaveClip &clip, long long tile,
+      std::vector<double> &values) const;
+   // How many blocks under the tile have no summaries yet
+   size_t CountUnsummarized(const WaveClip &clip, long long tile) const;
+
+   Style mStyle;
+   std::map< long long, std::shared_ptr<Tile> > mTiles;
+   std::shared_ptr<WaveformTilesJob> mpJob;
+   // The tiles in view when the job was submitted
+   long long mFirst{ 0 }, mLast{ -1 };
+   std::vector<double> mScratch;
+};
+
+#endif
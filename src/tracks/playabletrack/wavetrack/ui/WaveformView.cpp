@@ -13,6 +13,7 @@ Paul Licameli split from WaveTrackView.cpp
 
 #include "../../../../Experimental.h"
 
+#include "WaveformTiles.h"
 #include "WaveformVRulerControls.h"
 #include "WaveTrackView.h"
 #include "WaveTrackViewConstants.h"
@@ -464,6 +465,39 @@ void DrawMinMaxRMS(
    }
 }
 
+// Copies the tiles that are ready, column being that of the clip at the
+// left of rect, and draws the other columns as DrawMinMaxRMS() does, if
+// min is not null
+void DrawMinMaxRMSTiles(
+   TrackPanelDrawingContext &context, WaveformTiles &tiles,
+   const WaveClip &clip, long long column,
+   const wxRect & rect, const double env[],
+   float zoomMin, float zoomMax,
+   bool dB, float dBRange,
+   const float *min, const float *max, const float *rms, const int *bl,
+   bool showProgress, bool muted)
+{
+   auto &dc = context.dc;
+   for (int x0 = 0; x0 < rect.width;) {
+      const auto tile = WaveformTiles::TileOf(column + x0);
+      // Where the first column of the tile would be
+      const int tileX = rect.x + x0 -
+         (int)(column + x0 - tile * WaveformTiles::TileWidth);
+      const int next =
+         std::min(rect.width, tileX + WaveformTiles::TileWidth - rect.x);
+      const wxRect rectTile{ rect.x + x0, rect.y, next - x0, rect.height };
+      if (tiles.IsReady(clip, tile))
+         tiles.Draw(dc, tile, tileX, rectTile);
+      else if (min)
+         DrawMinMaxRMS( context, rectTile, env + x0,
+            zoomMin, zoomMax,
+            dB, dBRange,
+            min + x0, max + x0, rms + x0, bl + x0,
+            showProgress, muted );
+      x0 = next;
+   }
+}
+
 void DrawIndividualSamples(TrackPanelDrawingContext &context,
                                         int leftOffset, const wxRect &rect,
                                         float zoomMin, float zoomMax,
@@ -664,7 +698,8 @@ void DrawClipWaveform(TrackPanelDrawingContext &context,
                                    const WaveClip *clip,
                                    const wxRect & rect,
                                    bool dB,
-                                   bool muted)
+                                   bool muted,
+                                   WaveformTiles &tiles)
 {
    auto &dc = context.dc;
    const auto artist = TrackArtist::Get( context );
@@ -764,6 +799,45 @@ void DrawClipWaveform(TrackPanelDrawingContext &context,
    // Require at least 3 pixels per sample for drawing the draggable points.
    const double threshold2 = 3 * rate;
 
+   // Without a fisheye, the min, max and rms may be copied from tiles drawn
+   // on other threads, but not while samples are appended to the clip
+   const bool useTiles = nPortions == 1 && !portions[0].inFisheye &&
+      portions[0].averageZoom <= threshold1 &&
+      clip->GetSequence()->GetNumSamples() == clip->GetNumSamples();
+   // The column of the clip at the left of hiddenMid, and the tiles in view
+   const long long origin = llround(t0 * pps);
+   const auto firstTile = WaveformTiles::TileOf(origin);
+   const auto lastTile =
+      WaveformTiles::TileOf(origin + std::max(1, hiddenMid.width) - 1);
+   bool allTilesReady = false;
+   if (useTiles) {
+      const auto setColour = [](unsigned char (&rgb)[3], const wxPen &pen) {
+         const auto colour = pen.GetColour();
+         rgb[0] = colour.Red(), rgb[1] = colour.Green(), rgb[2] = colour.Blue();
+      };
+      WaveformTiles::Style style;
+      style.pixelsPerSecond = pps;
+      style.rate = rate;
+      style.height = mid.height;
+      style.zoomMin = zoomMin, style.zoomMax = zoomMax;
+      style.dB = dB;
+      style.dBRange = dBRange;
+      style.showClipping = artist->mShowClipping;
+      setColour(style.sampleColour,
+         muted ? artist->muteSamplePen : artist->samplePen);
+      setColour(style.rmsColour,
+         muted ? artist->muteRmsPen : artist->rmsPen);
+      setColour(style.clippedColour,
+         muted ? artist->muteClippedPen : artist->clippedPen);
+      style.dirty = clip->GetDirty();
+      style.numSamples = clip->GetNumSamples();
+      tiles.SetStyle(style);
+
+      allTilesReady = true;
+      for (auto tile = firstTile; allTilesReady && tile <= lastTile; ++tile)
+         allTilesReady = tiles.IsReady(*clip, tile);
+   }
+
    {
       bool showIndividualSamples = false;
       for (unsigned ii = 0; !showIndividualSamples && ii < nPortions; ++ii) {
@@ -772,7 +846,7 @@ void DrawClipWaveform(TrackPanelDrawingContext &context,
             !portion.inFisheye && portion.averageZoom > threshold1;
       }
 
-      if (!showIndividualSamples) {
+      if (!showIndividualSamples && !allTilesReady) {
          // The WaveClip class handles the details of computing the shape
          // of the waveform.  The only way GetWaveDisplay will fail is if
          // there's a serious error, like some of the waveform data can't
@@ -786,6 +860,10 @@ void DrawClipWaveform(TrackPanelDrawingContext &context,
          if (!clip->GetWaveDisplay(display,
             t0, pps, isLoadingOD))
             return;
+
+         // Tiles are drawn when the samples are all summarized
+         if (useTiles && !isLoadingOD)
+            tiles.Request(*clip, firstTile, lastTile);
       }
    }
 
@@ -844,13 +922,15 @@ void DrawClipWaveform(TrackPanelDrawingContext &context,
             useBl = fisheyeDisplay.bl;
          }
       }
-      else {
+      else if (!allTilesReady) {
          const int pos = leftOffset - params.hiddenLeftOffset;
          useMin = display.min + pos;
          useMax = display.max + pos;
          useRms = display.rms + pos;
          useBl = display.bl + pos;
       }
+      // else GetWaveDisplay() was skipped, and DrawMinMaxRMSTiles() only
+      // copies tiles, given null pointers
 
       leftOffset += skippedLeft;
 
@@ -866,11 +946,19 @@ void DrawClipWaveform(TrackPanelDrawingContext &context,
                  0, // 1.0 / rate,
 
                  env2, rectPortion.width, leftOffset, zoomInfo );
-            DrawMinMaxRMS( context, rectPortion, env2,
-               zoomMin, zoomMax,
-               dB, dBRange,
-               useMin, useMax, useRms, useBl,
-               isLoadingOD, muted );
+            if (useTiles)
+               DrawMinMaxRMSTiles( context, tiles, *clip,
+                  origin + (rectPortion.x - hiddenMid.x), rectPortion, env2,
+                  zoomMin, zoomMax,
+                  dB, dBRange,
+                  useMin, useMax, useRms, useBl,
+                  isLoadingOD, muted );
+            else
+               DrawMinMaxRMS( context, rectPortion, env2,
+                  zoomMin, zoomMax,
+                  dB, dBRange,
+                  useMin, useMax, useRms, useBl,
+                  isLoadingOD, muted );
          }
          else {
             bool highlight = false;
@@ -990,9 +1078,20 @@ void WaveformView::DoDraw(TrackPanelDrawingContext &context,
    TrackArt::DrawBackgroundWithSelection(
       context, rect, track, blankSelectedBrush, blankBrush );
 
-   for (const auto &clip: track->GetClips())
+   // Keep the tiles of the clips drawn now, and of no others
+   std::vector<ClipTiles> tiles;
+   for (const auto &clip: track->GetClips()) {
+      const auto end = mTiles.end();
+      const auto found = std::find_if(mTiles.begin(), end,
+         [&](const ClipTiles &pair){ return pair.first.lock() == clip; });
+      if (found != end)
+         tiles.push_back(std::move(*found));
+      else
+         tiles.emplace_back(clip, std::make_unique<WaveformTiles>());
       DrawClipWaveform(context, track, clip.get(), rect,
-                       dB, muted);
+                       dB, muted, *tiles.back().second);
+   }
+   mTiles.swap(tiles);
 
    DrawBoldBoundaries( context, track, rect );
 
@@ -13,7 +13,9 @@ Paul Licameli split from WaveTrackView.h
 
 #include "WaveTrackView.h" // to inherit
 
+class WaveClip;
 class WaveTrack;
+class WaveformTiles;
 class SampleHandle;
 class EnvelopeHandle;
 
@@ -36,7 +38,7 @@ private:
    void Draw(
       TrackPanelDrawingContext &context,
       const wxRect &rect, unsigned iPass ) override;
-   static void DoDraw(TrackPanelDrawingContext &context,
+   void DoDraw(TrackPanelDrawingContext &context,
                                const WaveTrack *track,
                                const wxRect & rect,
                                bool muted);
@@ -51,6 +53,11 @@ protected:
 
    std::weak_ptr<SampleHandle> mSampleHandle;
    std::weak_ptr<EnvelopeHandle> mEnvelopeHandle;
+
+   // Pictures of the clips last drawn, at the zoom they were drawn at
+   using ClipTiles = std::pair<
+      std::weak_ptr<const WaveClip>, std::unique_ptr<WaveformTiles> >;
+   std::vector<ClipTiles> mTiles;
 };
 
 #endif
@@ -11,7 +11,32 @@
 #include "AudacityMessageBox.h"
 #include "../Internat.h"
 
+#include <wx/log.h>
+
 TranslatableString AudacityMessageBoxCaptionStr()
 {
    return XO("Message");
 }
+
+static bool sSuppressed = false;
+
+void SuppressAudacityMessageBoxes( bool suppress )
+{
+   sSuppressed = suppress;
+}
+
+bool AudacityMessageBoxesSuppressed()
+{
+   return sSuppressed;
+}
+
+int SuppressedAudacityMessageBox(
+   const TranslatableString& message, long style )
+{
+   wxLogMessage( wxT("%s"), message.Translation() );
+   if (style & wxCANCEL)
+      return wxCANCEL;
+   if (style & wxYES_NO)
+      return wxNO;
+   return wxOK;
+}
@@ -16,6 +16,14 @@
 
 extern TranslatableString AudacityMessageBoxCaptionStr();
 
+// A batch worker process has nobody to answer message boxes.  While they
+// are suppressed, AudacityMessageBox() only logs the message, and returns
+// the cautious answer:  wxCANCEL if offered, else wxNO if offered, else wxOK
+extern void SuppressAudacityMessageBoxes( bool suppress );
+extern bool AudacityMessageBoxesSuppressed();
+extern int SuppressedAudacityMessageBox(
+   const TranslatableString& message, long style );
+
 // Do not use wxMessageBox!!  Its default window title does not translate!
 inline int AudacityMessageBox(const TranslatableString& message,
    const TranslatableString& caption = AudacityMessageBoxCaptionStr(),
@@ -23,6 +31,8 @@ inline int AudacityMessageBox(const TranslatableString& message,
    wxWindow *parent = NULL,
    int x = wxDefaultCoord, int y = wxDefaultCoord)
 {
+   if (AudacityMessageBoxesSuppressed())
+      return SuppressedAudacityMessageBox(message, style);
    return ::wxMessageBox(message.Translation(), caption.Translation(),
       style, parent, x, y);
 }
@@ -47,6 +47,7 @@
 #include <wx/setup.h> // for wxUSE_* macros
 #include <wx/wxcrtvararg.h>
 #include <wx/app.h>
+#include <wx/checkbox.h>
 #include <wx/defs.h>
 #include <wx/dialog.h>
 #include <wx/dcbuffer.h>
@@ -74,6 +75,7 @@
 #include "../ShuttleGui.h"
 
 #include "../AllThemeResources.h"
+#include "../effects/EBUR128.h"
 #include "../widgets/valnum.h"
 
 #if wxUSE_ACCESSIBILITY
@@ -313,6 +315,8 @@ MeterPanel::MeterPanel(AudacityProject *project,
    mMonitoring(false),
    mActive(false),
    mNumBars(0),
+   mLoudness(false),
+   mLoudnessLevel(-999),
    mLayoutValid(false),
    mBitmap{},
    mIcon{},
@@ -333,6 +337,9 @@ MeterPanel::MeterPanel(AudacityProject *project,
    SetAccessible(safenew MeterAx(this));
 #endif
 
+   for (auto &buffer : mLoudnessBuffers)
+      buffer.reinit(LoudnessChunk);
+
    // Do this BEFORE UpdatePrefs()!
    mRuler.SetFonts(GetFont(), GetFont(), GetFont());
    mRuler.SetFlip(mStyle != MixerTrackCluster);
@@ -360,6 +367,7 @@ MeterPanel::MeterPanel(AudacityProject *project,
       mBrush     = wxBrush( theTheme.Colour( clrMeterInputBrush       ), wxBRUSHSTYLE_SOLID);
       mRMSBrush  = wxBrush( theTheme.Colour( clrMeterInputRMSBrush    ), wxBRUSHSTYLE_SOLID);
       mClipBrush = wxBrush( theTheme.Colour( clrMeterInputClipBrush   ), wxBRUSHSTYLE_SOLID);
+      mLoudnessPen = wxPen( theTheme.Colour( clrMeterInputPen       ), 1, wxPENSTYLE_DOT);
 //      mLightPen  = wxPen(   theTheme.Colour( clrMeterInputLightPen    ), 1, wxSOLID);
 //      mDarkPen   = wxPen(   theTheme.Colour( clrMeterInputDarkPen     ), 1, wxSOLID);
    }
@@ -373,6 +381,7 @@ MeterPanel::MeterPanel(AudacityProject *project,
       mBrush     = wxBrush( theTheme.Colour( clrMeterOutputBrush      ), wxBRUSHSTYLE_SOLID);
       mRMSBrush  = wxBrush( theTheme.Colour( clrMeterOutputRMSBrush   ), wxBRUSHSTYLE_SOLID);
       mClipBrush = wxBrush( theTheme.Colour( clrMeterOutputClipBrush  ), wxBRUSHSTYLE_SOLID);
+      mLoudnessPen = wxPen( theTheme.Colour( clrMeterOutputPen      ), 1, wxPENSTYLE_DOT);
 //      mLightPen  = wxPen(   theTheme.Colour( clrMeterOutputLightPen   ), 1, wxSOLID);
 //      mDarkPen   = wxPen(   theTheme.Colour( clrMeterOutputDarkPen    ), 1, wxSOLID);
    }
@@ -405,6 +414,12 @@ MeterPanel::MeterPanel(AudacityProject *project,
    Reset(44100.0, true);
 }
 
+MeterPanel::~MeterPanel()
+{
+   delete mLoudnessPending.exchange(nullptr);
+   delete mLoudnessRetired.exchange(nullptr);
+}
+
 void MeterPanel::Clear()
 {
    mQueue.Clear();
@@ -420,6 +435,11 @@ void MeterPanel::UpdatePrefs()
    mGradient = gPrefs->Read(Key(wxT("Bars")), wxT("Gradient")) == wxT("Gradient");
    mDB = gPrefs->Read(Key(wxT("Type")), wxT("dB")) == wxT("dB");
    mMeterDisabled = gPrefs->Read(Key(wxT("Disabled")), (long)0);
+   const bool loudness = gPrefs->Read(Key(wxT("Loudness")), false);
+   if (loudness != mLoudness) {
+      mLoudness = loudness;
+      PrepareLoudness();
+   }
 
    if (mDesiredStyle != MixerTrackCluster)
    {
@@ -919,6 +939,8 @@ void MeterPanel::Reset(double sampleRate, bool resetClipping)
    {
       ResetBar(&mBar[j], resetClipping);
    }
+   mLoudnessLevel = -999;
+   PrepareLoudness();
 
    // wxTimers seem to be a little unreliable - sometimes they stop for
    // no good reason, so this "primes" it every now and then...
@@ -1004,9 +1026,68 @@ void MeterPanel::UpdateDisplay(unsigned numChannels, int numFrames, float *sampl
    for(unsigned int j=0; j<mNumBars; j++)
       msg.rms[j] = sqrt(msg.rms[j]/numFrames);
 
+   UpdateLoudness(numChannels, numFrames, sampleData, msg);
+
    mQueue.Put(msg);
 }
 
+// Called on the main thread, to start the measurement again
+void MeterPanel::PrepareLoudness()
+{
+   // Destroy what the audio thread gave back
+   delete mLoudnessRetired.exchange(nullptr);
+
+   std::unique_ptr<EBUR128> pMeter;
+   if (mLoudness && mRate > 0) {
+      // For the most channels; those missing are measured as silence
+      pMeter = std::make_unique<EBUR128>(mRate, kMaxMeterBars);
+      pMeter->Initialize();
+   }
+   // Replace any that the audio thread has not yet taken
+   delete mLoudnessPending.exchange(pMeter.release());
+}
+
+void MeterPanel::UpdateLoudness(unsigned numChannels, int numFrames,
+                                const float *sampleData, MeterUpdateMsg &msg)
+{
+   msg.loudness = -999;
+   if (!mLoudness || numFrames <= 0)
+      return;
+
+   // Take up a measurement from PrepareLoudness(), but only when there is
+   // room to give back the old one, which must not be destroyed here
+   if (!mLoudnessRetired.load()) {
+      if (auto pMeter = mLoudnessPending.exchange(nullptr)) {
+         mLoudnessRetired.store(mLoudnessMeter.release());
+         mLoudnessMeter.reset(pMeter);
+      }
+   }
+   if (!mLoudnessMeter)
+      return;
+
+   const auto num = std::min(numChannels, mNumBars);
+   const float *channels[kMaxMeterBars];
+   for (size_t start = 0; start < (size_t)numFrames; start += LoudnessChunk) {
+      const auto len = std::min<size_t>(LoudnessChunk, numFrames - start);
+      for (unsigned j = 0; j < kMaxMeterBars; j++) {
+         float *buffer = mLoudnessBuffers[j].get();
+         if (j < num) {
+            const float *sptr = sampleData + start * numChannels + j;
+            for (size_t i = 0; i < len; i++, sptr += numChannels)
+               buffer[i] = *sptr;
+         }
+         else
+            std::fill(buffer, buffer + len, 0.0f);
+         channels[j] = buffer;
+      }
+      mLoudnessMeter->ProcessBuffers(channels, len);
+   }
+
+   const auto loudness = mLoudnessMeter->MomentaryLoudness();
+   if (loudness > 0)
+      msg.loudness = mLoudnessMeter->IntegrativeLoudnessToLUFS(loudness);
+}
+
 // Vaughan, 2010-11-29: This not currently used. See comments in MixerTrackCluster::UpdateMeter().
 //void MeterPanel::UpdateDisplay(int numChannels, int numFrames,
 //                           // Need to make these double-indexed arrays if we handle more than 2 channels.
@@ -1061,6 +1142,9 @@ void MeterPanel::OnMeterUpdate(wxTimerEvent & WXUNUSED(event))
    bool discarded = false;
 #endif
 
+   // The audio thread may have replaced the loudness measurement
+   delete mLoudnessRetired.exchange(nullptr);
+
    // We shouldn't receive any events if the meter is disabled, but clear it to be safe
    if (mMeterDisabled) {
       mQueue.Clear();
@@ -1079,6 +1163,7 @@ void MeterPanel::OnMeterUpdate(wxTimerEvent & WXUNUSED(event))
       double deltaT = msg.numFrames / mRate;
 
       mT += deltaT;
+      mLoudnessLevel = msg.loudness;
       for(unsigned int j=0; j<mNumBars; j++) {
          mBar[j].isclipping = false;
 
@@ -1838,6 +1923,8 @@ void MeterPanel::DrawMeterBar(wxDC &dc, MeterBar *bar)
       }
    }
 
+   DrawLoudness(dc, bar);
+
    // If meter had a clipping indicator, draw or erase it
    // LLL:  At least I assume that's what "mClip" is supposed to be for as
    //       it is always "true".
@@ -1860,6 +1947,39 @@ void MeterPanel::DrawMeterBar(wxDC &dc, MeterBar *bar)
    }
 }
 
+// Draw a dotted line across the bar at the momentary loudness, on the same
+// scale as the levels
+void MeterPanel::DrawLoudness(wxDC &dc, MeterBar *bar)
+{
+   if (!mLoudness || mMeterDisabled || mLoudnessLevel <= -999)
+      return;
+
+   const float level = mDB
+      ? ClipZeroToOne((mLoudnessLevel + mDBRange) / mDBRange)
+      : ClipZeroToOne(DB_TO_LINEAR(mLoudnessLevel));
+
+   wxCoord x = bar->r.GetLeft();
+   wxCoord y = bar->r.GetTop();
+   wxCoord w = bar->r.GetWidth();
+   wxCoord h = bar->r.GetHeight();
+
+   dc.SetPen(mLoudnessPen);
+   if (bar->vert)
+   {
+      // (h - 1) corresponds to the mRuler.SetBounds() in HandleLayout()
+      wxCoord ht = (int)(level * (h - 1) + 0.5);
+      if (ht > 0)
+         AColor::Line(dc, x, y + h - ht - 1, x + w - 1, y + h - ht - 1);
+   }
+   else
+   {
+      // (w - 1) corresponds to the mRuler.SetBounds() in HandleLayout()
+      wxCoord wd = (int)(level * (w - 1) + 0.5);
+      if (wd > 0)
+         AColor::Line(dc, x + wd, y, x + wd, y + h - 1);
+   }
+}
+
 bool MeterPanel::IsMeterDisabled() const
 {
    return mMeterDisabled != 0;
@@ -1987,6 +2107,7 @@ void MeterPanel::OnPreferences(wxCommandEvent & WXUNUSED(event))
    wxRadioButton *automatic;
    wxRadioButton *horizontal;
    wxRadioButton *vertical;
+   wxCheckBox *loudness;
    int meterRefreshRate = mMeterRefreshRate;
 
    auto title = mIsInput ? XO("Recording Meter Options") : XO("Playback Meter Options");
@@ -2057,6 +2178,10 @@ void MeterPanel::OnPreferences(wxCommandEvent & WXUNUSED(event))
         S.EndStatic();
       }
       S.EndHorizontalLay();
+
+      loudness = S.AddCheckBox(
+         XO("Show momentary loudness (LUFS)"), mLoudness);
+
       S.AddStandardButtons();
    }
    S.EndVerticalLay();
@@ -2082,6 +2207,7 @@ void MeterPanel::OnPreferences(wxCommandEvent & WXUNUSED(event))
       gPrefs->Write(Key(wxT("Bars")), gradient->GetValue() ? wxT("Gradient") : wxT("RMS"));
       gPrefs->Write(Key(wxT("Type")), db->GetValue() ? wxT("dB") : wxT("Linear"));
       gPrefs->Write(Key(wxT("RefreshRate")), rate->GetValue());
+      gPrefs->Write(Key(wxT("Loudness")), loudness->GetValue());
 
       gPrefs->Flush();
 
@@ -2260,6 +2386,9 @@ wxAccStatus MeterAx::GetName(int WXUNUSED(childId), wxString* name)
       else
          *name += wxT(" ") + wxString::Format(_(" Peak %.2f "), peak);
 
+      if (m->mLoudness && m->mLoudnessLevel > -999)
+         *name += wxT(" ") + wxString::Format(_(" Loudness %.1f LUFS "), m->mLoudnessLevel);
+
       if (clipped)
          *name += wxT(" ") + _(" Clipped ");
    }
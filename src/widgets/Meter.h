@@ -21,12 +21,15 @@
 #include <wx/defs.h>
 #include <wx/timer.h> // member variable
 
+#include <atomic>
+
 #include "../SampleFormat.h"
 #include "../Prefs.h"
 #include "MeterPanelBase.h" // to inherit
 #include "Ruler.h" // member variable
 
 class AudacityProject;
+class EBUR128;
 
 // Increase this when we add support for multichannel meters
 // (most of the code is already there)
@@ -56,6 +59,8 @@ class MeterUpdateMsg
    bool clipping[kMaxMeterBars];
    int headPeakCount[kMaxMeterBars];
    int tailPeakCount[kMaxMeterBars];
+   // Momentary loudness of all channels, in LUFS, or -999 if not measured
+   float loudness;
 
    /* neither constructor nor destructor do anything */
    MeterUpdateMsg() { }
@@ -116,6 +121,7 @@ class MeterPanel final : public MeterPanelBase, private PrefsListener
          const wxSize& size = wxDefaultSize,
          Style style = HorizontalStereo,
          float fDecayRate = 60.0f);
+   ~MeterPanel() override;
 
    void SetFocusFromKbd() override;
 
@@ -212,6 +218,10 @@ class MeterPanel final : public MeterPanelBase, private PrefsListener
    void SetActiveStyle(Style style);
    void SetBarAndClip(int iBar, bool vert);
    void DrawMeterBar(wxDC &dc, MeterBar *meterBar);
+   void DrawLoudness(wxDC &dc, MeterBar *meterBar);
+   void PrepareLoudness();
+   void UpdateLoudness(unsigned numChannels, int numFrames,
+                       const float *sampleData, MeterUpdateMsg &msg);
    void ResetBar(MeterBar *bar, bool resetClipping);
    void RepaintBarsNow();
    wxFont GetFont() const;
@@ -259,6 +269,23 @@ class MeterPanel final : public MeterPanelBase, private PrefsListener
    unsigned  mNumBars;
    MeterBar  mBar[kMaxMeterBars];
 
+   // Live EBU R128 momentary loudness, measured by the thread that calls
+   // UpdateDisplay(), which must not allocate.  PrepareLoudness() makes each
+   // new measurement on the main thread and hands it over in
+   // mLoudnessPending; the audio thread hands back the one it replaces in
+   // mLoudnessRetired, for the main thread to destroy.
+   bool      mLoudness;
+   std::unique_ptr<EBUR128> mLoudnessMeter;
+   std::atomic<EBUR128*> mLoudnessPending{ nullptr };
+   std::atomic<EBUR128*> mLoudnessRetired{ nullptr };
+   // EBUR128 wants the channels apart; they are copied in pieces of at most
+   // this many frames
+   enum : size_t { LoudnessChunk = 1024 };
+   Floats    mLoudnessBuffers[kMaxMeterBars];
+   // Latest loudness shown, in LUFS
+   float     mLoudnessLevel;
+   wxPen     mLoudnessPen;
+
    bool      mLayoutValid;
 
    std::unique_ptr<wxBitmap> mBitmap;
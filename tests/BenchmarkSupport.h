@@ -0,0 +1,52 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  BenchmarkSupport.h
+
+  What the benchmarks in this directory have in common
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BENCHMARK_SUPPORT__
+#define __AUDACITY_BENCHMARK_SUPPORT__
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+
+// Base of each benchmark class:  prints the banner and seeds rand()
+class BenchmarkSupport
+{
+protected:
+   explicit BenchmarkSupport(const char *name)
+   {
+      std::cout << "==> Benchmarking " << name << "\n";
+      srand(time(NULL));
+   }
+
+   // Timings of wrong results are worthless, so unlike assert(), this
+   // checks also in builds with NDEBUG, and exits with a nonzero status
+   static void Check(bool condition, const char *what)
+   {
+      if (!condition)
+      {
+         std::cout << "FAILED: " << what << "\n";
+         std::exit(1);
+      }
+   }
+
+   // Seconds taken by function()
+   template< typename Function >
+   static double Time(const Function &function)
+   {
+      const auto start = std::chrono::steady_clock::now();
+      function();
+      const std::chrono::duration<double> elapsed =
+         std::chrono::steady_clock::now() - start;
+      return elapsed.count();
+   }
+};
+
+#endif
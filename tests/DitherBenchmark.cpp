@@ -0,0 +1,100 @@
+#include "BenchmarkSupport.h"
+#include "Dither.h"
+#include "DitherKernels.h"
+#include "SampleFormat.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Times Dither::Apply for each conversion that dithers, each dither type,
+// and each instruction set this machine has, after checking that the vector
+// code gives the same samples as the scalar code.
+class DitherBenchmark : private BenchmarkSupport
+{
+private:
+   enum { BufferLen = 65536, Repetitions = 200 };
+
+   std::vector<float> mFloatData;
+   std::vector<int> mInt24Data;
+   std::vector<int> mOutput;
+   std::vector<int> mReference;
+
+public:
+   DitherBenchmark()
+      : BenchmarkSupport{ "Dither" }
+   {
+   }
+
+   void SetUp()
+   {
+      mFloatData.resize(BufferLen);
+      mInt24Data.resize(BufferLen);
+      mOutput.resize(BufferLen);
+      mReference.resize(BufferLen);
+
+      for (int i = 0; i < BufferLen; i++)
+      {
+         // Somewhat beyond full scale, so that clipping happens too
+         mFloatData[i] = (rand() / (float)RAND_MAX - 0.5f) * 2.2f;
+         mInt24Data[i] = rand() % (1 << 24) - (1 << 23);
+      }
+   }
+
+   void Run(const char *name, sampleFormat srcFormat, sampleFormat dstFormat)
+   {
+      const samplePtr src = srcFormat == floatSample
+         ? (samplePtr)mFloatData.data() : (samplePtr)mInt24Data.data();
+
+      const DitherType types[] = { none, rectangle, triangle, shaped };
+      const char *typeNames[] = { "none", "rectangle", "triangle", "shaped" };
+
+      for (int t = 0; t < 4; t++)
+      {
+         const Dither initial;
+
+         for (int set = 0; set <= (int)DitherKernels::Available(); set++)
+         {
+            DitherKernels::Set((DitherKernels::InstructionSet)set);
+
+            // Lengths not a multiple of the vector size test the scalar ends
+            const int checkLen = BufferLen - 5;
+            Dither check = initial;
+            check.Apply(types[t], src + SAMPLE_SIZE(srcFormat), srcFormat,
+               (samplePtr)mOutput.data(), dstFormat, checkLen);
+            if (set == 0)
+               mReference = mOutput;
+            else if (types[t] != shaped)
+               Check(memcmp(mReference.data(), mOutput.data(),
+                  checkLen * SAMPLE_SIZE(dstFormat)) == 0,
+                  "vector dither differs from scalar dither");
+
+            Dither dither = initial;
+            const double seconds = Time([&]{
+               for (int r = 0; r < Repetitions; r++)
+                  dither.Apply(types[t], src, srcFormat,
+                     (samplePtr)mOutput.data(), dstFormat, BufferLen);
+            });
+
+            std::cout << "\t" << name << ", " << typeNames[t] << ", "
+               << DitherKernels::GetName((DitherKernels::InstructionSet)set)
+               << ": "
+               << (double)BufferLen * Repetitions / seconds / 1e6
+               << " Msamples/s\n";
+         }
+      }
+
+      DitherKernels::Set(DitherKernels::Available());
+   }
+};
+
+int main()
+{
+   DitherBenchmark benchmark;
+
+   benchmark.SetUp();
+   benchmark.Run("float to int16", floatSample, int16Sample);
+   benchmark.Run("float to int24", floatSample, int24Sample);
+   benchmark.Run("int24 to int16", int24Sample, int16Sample);
+
+   return 0;
+}
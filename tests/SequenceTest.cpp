@@ -1,7 +1,10 @@
 
 #include "Sequence.h"
 #include "DirManager.h"
+#include "blockfile/SilentBlockFile.h"
 #include <wx/hash.h>
+#include <cassert>
+#include <chrono>
 #include <vector>
 #include <iostream>
 
@@ -131,6 +134,83 @@ public:
       std::cout << "ok\n";
    }
 
+   void TestEditLatency()
+   {
+      /* Time edits in the middle of long sequences of silent blocks.
+       * The time should grow only slowly with the number of blocks,
+       * and an undo state (a copy of the sequence) should be cheap.
+       * The edits must leave the other blocks shared, and the copy must
+       * share all but the locked blocks, as of a saved project. */
+
+      std::cout << "\tedit latency by number of blocks:\n";
+
+      using Clock = std::chrono::steady_clock;
+      const int repetitions = 100;
+
+      for (size_t nBlocks : { 1000, 10000, 50000 })
+      {
+         auto dirManager = DirManager::Create();
+         Sequence sequence(dirManager, floatSample);
+         const auto blockLen = sequence.GetMaxBlockSize();
+         for (size_t ii = 0; ii < nBlocks; ++ii)
+            sequence.AppendBlockFile(
+               make_blockfile<SilentBlockFile>(blockLen));
+
+         Sequence clip(dirManager, floatSample);
+         clip.AppendBlockFile(make_blockfile<SilentBlockFile>(blockLen));
+
+         // Read only, so that summaries are not invalidated
+         const auto &blocks =
+            static_cast< const Sequence & >( sequence ).GetBlockArray();
+         const auto firstFile = blocks.front().f;
+         const auto lastFile = blocks.back().f;
+         // Locked as if saved, so the copies must copy it
+         const size_t locked = nBlocks / 4;
+         const auto lockedFile = blocks[locked].f;
+         lockedFile->Lock();
+
+         double paste = 0, remove = 0, copy = 0;
+         for (int rr = 0; rr < repetitions; ++rr)
+         {
+            const sampleCount where = (nBlocks / 2) * blockLen;
+
+            auto t0 = Clock::now();
+            sequence.Paste(where, &clip);
+            auto t1 = Clock::now();
+            assert(blocks.size() == nBlocks + 1);
+            sequence.Delete(where, blockLen);
+            auto t2 = Clock::now();
+            assert(blocks.size() == nBlocks);
+            assert(blocks.front().f == firstFile);
+            assert(blocks.back().f == lastFile);
+            assert(blocks[locked].f == lockedFile);
+            {
+               Sequence undoState(sequence, dirManager);
+               auto t3 = Clock::now();
+               copy += std::chrono::duration<double, std::micro>(t3 - t2).count();
+
+               const auto &copied = static_cast< const Sequence & >
+                  ( undoState ).GetBlockArray();
+               assert(copied.size() == nBlocks);
+               assert(copied.front().f == firstFile);
+               assert(copied.back().f == lastFile);
+               assert(copied[locked].f != lockedFile);
+               assert(copied[locked].f->GetLength() == blockLen);
+            }
+
+            paste += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            remove += std::chrono::duration<double, std::micro>(t2 - t1).count();
+         }
+
+         std::cout << "\t\t" << nBlocks << " blocks: paste "
+            << paste / repetitions << " us, delete "
+            << remove / repetitions << " us, copy "
+            << copy / repetitions << " us\n";
+
+         lockedFile->Unlock();
+      }
+   }
+
 };
 
 int main()
@@ -149,6 +229,8 @@ int main()
    tester.TestGetGarbageInput();
    tester.TearDown();
 
+   tester.TestEditLatency();
+
    return 0;
 }
 
@@ -0,0 +1,116 @@
+#include "BenchmarkSupport.h"
+#include "RealFFTf.h"
+#include "SpectrumKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// Times SpectrumKernels::ComputeSpectra, in spectrogram columns per second,
+// for each transform size a spectrogram may use and each instruction set
+// this machine has, after checking that the vector code gives the same
+// spectra as the scalar code.  Windows are as long as the transform, or
+// half as long, as with zero padding, and the checks begin with scratch
+// full of NaN, as a reused one may be.
+class SpectrumBenchmark : private BenchmarkSupport
+{
+private:
+   // Not a multiple of any batch size, so that partial batches are tested
+   enum { Columns = 61 };
+
+   std::vector<float> mSamples;
+   std::vector<float> mWindow;
+   std::vector<const float*> mBuffers;
+   std::vector<float> mScratch;
+   std::vector<float> mOutput;
+   std::vector<float> mReference;
+   std::vector<float*> mOutputs;
+
+public:
+   SpectrumBenchmark()
+      : BenchmarkSupport{ "spectrogram columns" }
+   {
+   }
+
+   // Transforms of fftLen points, of windows of len samples
+   void Run(size_t fftLen, size_t len)
+   {
+      const auto hFFT = GetFFT(fftLen);
+      const auto nBins = fftLen / 2;
+
+      // Overlapping windows, a quarter of the window apart
+      const auto hop = std::max< size_t >(1, len / 4);
+      mSamples.resize(hop * (Columns - 1) + len);
+      for (auto &sample : mSamples)
+         sample = rand() / (float)RAND_MAX - 0.5f;
+      mBuffers.resize(Columns);
+      for (size_t ii = 0; ii < Columns; ii++)
+         mBuffers[ii] = &mSamples[ii * hop];
+
+      // Hann
+      mWindow.resize(len);
+      for (size_t ii = 0; ii < len; ii++)
+         mWindow[ii] = 0.5 - 0.5 * cos(2 * M_PI * ii / len);
+
+      mScratch.resize(SpectrumKernels::GetScratchSize(fftLen));
+      mOutput.resize(Columns * nBins);
+      mOutputs.resize(Columns);
+      for (size_t ii = 0; ii < Columns; ii++)
+         mOutputs[ii] = &mOutput[ii * nBins];
+
+      // Enough repetitions for some tens of milliseconds
+      const int repetitions = std::max< size_t >(1, (1 << 21) / fftLen);
+
+      for (int set = 0;
+           set <= (int)SpectrumKernels::Available(); set++)
+      {
+         SpectrumKernels::Set((SpectrumKernels::InstructionSet)set);
+
+         std::fill(mScratch.begin(), mScratch.end(),
+            std::numeric_limits<float>::quiet_NaN());
+         SpectrumKernels::ComputeSpectra(mBuffers.data(), Columns,
+            hFFT.get(), mWindow.data(), len,
+            mOutputs.data(), mScratch.data());
+         Check(std::none_of(mOutput.begin(), mOutput.end(),
+               [](float power){ return std::isnan(power); }),
+            "no NaN from dirty scratch");
+         if (set == 0)
+            mReference = mOutput;
+         else
+            Check(memcmp(mReference.data(), mOutput.data(),
+                  mOutput.size() * sizeof(float)) == 0,
+               "vector spectra equal scalar spectra");
+
+         const double elapsed = Time([&]{
+            for (int r = 0; r < repetitions; r++)
+               SpectrumKernels::ComputeSpectra(mBuffers.data(), Columns,
+                  hFFT.get(), mWindow.data(), len,
+                  mOutputs.data(), mScratch.data());
+         });
+
+         std::cout << "\t" << fftLen << " points, window " << len << ", "
+            << SpectrumKernels::GetName((SpectrumKernels::InstructionSet)set)
+            << ": "
+            << (double)Columns * repetitions / elapsed
+            << " columns/s\n";
+      }
+
+      SpectrumKernels::Set(SpectrumKernels::Available());
+   }
+};
+
+int main()
+{
+   SpectrumBenchmark benchmark;
+
+   for (size_t fftLen = 256; fftLen <= 32768; fftLen *= 2)
+   {
+      benchmark.Run(fftLen, fftLen);
+      benchmark.Run(fftLen, fftLen / 2);
+   }
+
+   return 0;
+}